@@ -19,7 +19,7 @@ layout (std140) uniform matrixBuffer
 	mat4 projection;
 };
 
-uniform mat4 model;
+layout (location = 4) in mat4 model; // per instance
 
 uniform bool invertNormals;	
 
@@ -11,7 +11,7 @@ out VS_OUT
 } vs_out;
 
 
-uniform mat4 model;
+layout (location = 4) in mat4 model; // per instance
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -157,10 +157,11 @@ struct MeshVSGF : public IHRMesh
   const void* GetData() const override
   {
     auto chunk = g_objManager.scnData.m_vbCache.chunk_at(m_chunkId);
+    const void* data = chunk.GetMemoryNow(); // chunk is paged in if it was evicted
 
-    if(chunk.InMemory())
+    if(data != nullptr)
     {
-      return chunk.GetMemoryNow();
+      return data;
     }
     else
     {
@@ -592,9 +593,9 @@ std::shared_ptr<IHRMesh> HydraFactoryCommon::CreateVSGFFromFile(HRMesh* pSysObj,
   if(g_objManager.m_attachMode && pMeshImpl->m_chunkId >= 0 && pMeshImpl->m_chunkId < totalChunks)
     chunk = g_objManager.scnData.m_vbCache.chunk_at(pMeshImpl->m_chunkId);
   
-  if(chunk.InMemory())
+  const char* data = (const char*)chunk.GetMemoryNow(); // owner may evict chunk at any moment, so don't trust chunk.InMemory()
+  if(data != nullptr)
   {
-    const char* data = (const char*)chunk.GetMemoryNow();
     memcpy(mindices.data(), data + moffset, msize);
   }
   else
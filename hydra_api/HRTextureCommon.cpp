@@ -33,16 +33,13 @@ bool IHRTextureNode::ReadDataFromChunkTo(std::vector<int>& a_dataConteiner)
   if (a_dataConteiner.size() < sizeInInts)
     a_dataConteiner.resize(sizeInInts);
 
-  // copy from memory
+  // copy from memory (chunk is paged in if it was evicted)
   //
-  if (chunk.InMemory())
+  char* data = (char*)chunk.GetMemoryNow();
+  if (data != nullptr)
   {
-    char* data = (char*)chunk.GetMemoryNow();
-    if (data != nullptr)
-    {
-      memcpy(a_dataConteiner.data(), data + sizeof(int)*2, DataSizeInBytes());
-      return true;
-    }
+    memcpy(a_dataConteiner.data(), data + sizeof(int)*2, DataSizeInBytes());
+    return true;
   }
 
   // if fail then try to load from file
@@ -62,9 +59,6 @@ const void* IHRTextureNode::GetData() const
     return nullptr;
   
   auto chunk = g_objManager.scnData.m_vbCache.chunk_at(chunkId());
-  if (!chunk.InMemory())
-    return nullptr;
-
   const char* ptr = (const char*)chunk.GetMemoryNow();
   if (ptr == nullptr)
     return nullptr;
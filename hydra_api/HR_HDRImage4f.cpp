@@ -240,8 +240,8 @@ namespace HydraRender
       {
         const int offsetY = j*w * 4;
 
-        const int offsetY0 = (j * 2 * pInputImage->width() + 0) * 4;
-        const int offsetY1 = (j * 2 * pInputImage->width() + 1) * 4;
+        const int offsetY0 = (j * 2 + 0) * pInputImage->width() * 4;
+        const int offsetY1 = (j * 2 + 1) * pInputImage->width() * 4;
 
         for (int i = 0; i < w; ++i)
         {
@@ -286,126 +286,146 @@ namespace HydraRender
   ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  void HDRImage4f::medianFilterInPlace(float a_thresholdValue)
+  // cvex::set_ftz() for the current thread until the end of scope; filters below set it inside their parallel regions only.
+  // OpenMP threads are created at the start of a region and inherit MXCSR of the caller, so it must not be changed there yet,
+  // otherwise pool threads would keep rounding toward zero after the filter returns.
+  //
+  struct ScopedFTZ
   {
-    cvex::set_ftz();
+    ScopedFTZ() : m_csr(_mm_getcsr()) { cvex::set_ftz(); }
+    ~ScopedFTZ() { _mm_setcsr(m_csr); }
+
+    unsigned int m_csr;
+  };
+
+  // Median filters read pixels from an unchanged copy of the input and write the result to the image, so each output pixel depends
+  // only on the input. They run by bands of FILTER_BAND_HEIGHT rows, one band per thread at a time; the result is the same as
+  // in a single-threaded run for any number of threads.
+  //
+  constexpr int FILTER_BAND_HEIGHT = 32;
 
+  static inline int FilterBandsNum(int a_height) { return (a_height + FILTER_BAND_HEIGHT - 1) / FILTER_BAND_HEIGHT; }
+
+  void HDRImage4f::medianFilterInPlace(float a_thresholdValue)
+  {
     const int w = width();
     const int h = height();
 
     const float ts2         = a_thresholdValue*a_thresholdValue;
-    const vfloat4 invEight  = cvex::splat(1.0f / 8.0f);
     const vfloat4 threshold = {ts2, ts2, ts2, 100000.0f};
 
-    float* pData = data();
+    const HDRImage4f input = (*this);
+    const float* pInput    = input.data();
+    float*       pData     = data();
+    const int    bandsNum  = FilterBandsNum(h);
 
-    for (int j = 0; j < h; ++j)
+    #pragma omp parallel
     {
-      int offsetY0 = (j - 1)*w * 4;
-      int offsetY1 = (j + 0)*w * 4;
-      int offsetY2 = (j + 1)*w * 4;
+      ScopedFTZ ftz;
 
-      if (j - 1 < 0)
-        offsetY0 = offsetY1;
+      #pragma omp for schedule(dynamic, 1)
+      for (int band = 0; band < bandsNum; band++)
+      {
+        for (int j = band*FILTER_BAND_HEIGHT; j < std::min(h, (band + 1)*FILTER_BAND_HEIGHT); ++j)
+        {
+          const float* pRow0 = pInput + size_t(std::max(j - 1, 0))*size_t(w)*4;
+          const float* pRow1 = pInput + size_t(j)*size_t(w)*4;
+          const float* pRow2 = pInput + size_t(std::min(j + 1, h - 1))*size_t(w)*4;
+          float*       pOut  = pData  + size_t(j)*size_t(w)*4;
 
-      if (j + 1 >= h)
-        offsetY2 = offsetY1;
+          for (int i = 0; i < w; ++i)
+          {
+            int offsetX0 = (i - 1) * 4;
+            int offsetX1 = (i + 0) * 4;
+            int offsetX2 = (i + 1) * 4;
 
-      for (int i = 0; i < w; ++i)
-      {
-        int offsetX0 = (i - 1) * 4;
-        int offsetX1 = (i + 0) * 4;
-        int offsetX2 = (i + 1) * 4;
+            if (i - 1 < 0)
+              offsetX0 = offsetX1;
 
-        if (i - 1 < 0)
-          offsetX0 = offsetX1;
+            if (i + 1 >= w)
+              offsetX2 = offsetX1;
 
-        if (i + 1 >= w)
-          offsetX2 = offsetX1;
+            const vfloat4 xm = cvex::load(pRow1 + offsetX1);
 
-        const vfloat4 xm = cvex::load(pData + offsetY1 + offsetX1);
+            const vfloat4 x0 = cvex::load(pRow1 + offsetX0);
+            const vfloat4 x1 = cvex::load(pRow1 + offsetX2);
+            const vfloat4 x2 = cvex::load(pRow0 + offsetX1);
+            const vfloat4 x3 = cvex::load(pRow2 + offsetX1);
 
-        const vfloat4 x0 = cvex::load(pData + offsetY1 + offsetX0);
-        const vfloat4 x1 = cvex::load(pData + offsetY1 + offsetX2);
-        const vfloat4 x2 = cvex::load(pData + offsetY0 + offsetX1);
-        const vfloat4 x3 = cvex::load(pData + offsetY2 + offsetX1);
+            const vfloat4 diff0sq = (xm - x0)*(xm - x0);
+            const vfloat4 diff1sq = (xm - x1)*(xm - x1);
+            const vfloat4 diff2sq = (xm - x2)*(xm - x2);
+            const vfloat4 diff3sq = (xm - x3)*(xm - x3);
 
-        const vfloat4 diff0sq = (xm - x0)*(xm - x0);
-        const vfloat4 diff1sq = (xm - x1)*(xm - x1);
-        const vfloat4 diff2sq = (xm - x2)*(xm - x2);
-        const vfloat4 diff3sq = (xm - x3)*(xm - x3);
+            int numFailed = 0;
 
-        int numFailed = 0;
+            if (cvex::cmpgt_any(diff0sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff0sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff1sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff1sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff2sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff2sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff3sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff3sq, threshold))
-          numFailed++;
+            if (numFailed >= 3)
+            {
+              const vfloat4 x4 = cvex::load(pRow0 + offsetX0);
+              const vfloat4 x5 = cvex::load(pRow0 + offsetX2);
+              const vfloat4 x6 = cvex::load(pRow2 + offsetX0);
+              const vfloat4 x7 = cvex::load(pRow2 + offsetX2);
 
-        if (numFailed >= 3)
-        {
-          const vfloat4 x4 = cvex::load(pData + offsetY0 + offsetX0);
-          const vfloat4 x5 = cvex::load(pData + offsetY0 + offsetX2);
-          const vfloat4 x6 = cvex::load(pData + offsetY2 + offsetX0);
-          const vfloat4 x7 = cvex::load(pData + offsetY2 + offsetX2);
+              const vfloat4 xi[9] = { xm, x0, x1, x2, x3, x4, x5, x6, x7 };
 
-          const vfloat4 xi[9] = { xm, x0, x1, x2, x3, x4, x5, x6, x7 };
+              float red  [9];
+              float green[9];
+              float blue [9];
 
-          float red  [9];
-          float green[9];
-          float blue [9];
+              #pragma gcc ivdep
+              for (int i = 0; i < 9; i++)
+              {
+                const vfloat4 xc = xi[i];
 
-          #pragma gcc ivdep
-          for (int i = 0; i < 9; i++)
-          {
-            const vfloat4 xc = xi[i];
+                cvex::store_s(red   + i, xc);
+                cvex::store_s(green + i, cvex::splat_1(xc));
+                cvex::store_s(blue  + i, cvex::splat_2(xc));
+              }
 
-            cvex::store_s(red   + i, xc);
-            cvex::store_s(green + i, cvex::splat_1(xc));
-            cvex::store_s(blue  + i, cvex::splat_2(xc));
-          }
+              std::sort(red,   red   + 9);
+              std::sort(green, green + 9);
+              std::sort(blue,  blue  + 9);
 
-          std::sort(red,   red   + 9);
-          std::sort(green, green + 9);
-          std::sort(blue,  blue  + 9);
+              pOut[offsetX1 + 0] = red  [4];
+              pOut[offsetX1 + 1] = green[4];
+              pOut[offsetX1 + 2] = blue [4];
+              pOut[offsetX1 + 3] = 1.0f;
+            }
 
-          pData[offsetY1 + offsetX1 + 0] = red  [4];
-          pData[offsetY1 + offsetX1 + 1] = green[4];
-          pData[offsetY1 + offsetX1 + 2] = blue [4];
-          pData[offsetY1 + offsetX1 + 3] = 1.0f;
-        }
+          } // for (int i = 0; i < w; ++i)
 
-      } // for (int i = 0; i < w; ++i)
+        } // for (int j = band*FILTER_BAND_HEIGHT; ...)
 
-    } //  for (int j = 0; j < h; ++j)
+      } // for (int band = 0; band < bandsNum; band++)
+
+    } // #pragma omp parallel
 
   }
 
 
   void HDRImage4f::medianFilterInPlace(float a_thresholdValue, int a_windowSize, const int a_pixelsNum)
   {
-    cvex::set_ftz();
-
     constexpr int maxWindowsSize = 7;
     constexpr int maxWindowWidth = 2*maxWindowsSize + 1;
 
     if (a_windowSize > maxWindowsSize)
       a_windowSize = maxWindowsSize;
 
-    const int windowWidth = 2 * a_windowSize + 1;
-
     const int w = width();
     const int h = height();
 
-    HDRImage4f tempImage = (*this);
-
     /////////////////////////////////////////////////////////////////////////////////////
     struct ALIGN(16) Pixel
     {
@@ -418,137 +438,146 @@ namespace HydraRender
       vfloat4 color;
     };
 
-    std::vector<Pixel, aligned16<Pixel> > badPixels;
-    badPixels.reserve(w*h);
+    typedef std::vector<Pixel, aligned16<Pixel> > PixelArray;
     //////////////////////////////////////////////////////////////////////////////////////
 
     const float ts2 = a_thresholdValue*a_thresholdValue;
-    const vfloat4 invEight = cvex::splat(1.0f / 8.0f);
     const vfloat4 threshold = { ts2, ts2, ts2, 100000.0f };
 
-    float* pData = tempImage.data();
+    const float* pData    = data(); // not changed until all bad pixels are found
+    const int    bandsNum = FilterBandsNum(h);
+    std::vector<PixelArray> badPixelsPerBand(bandsNum);
 
-    float red       [maxWindowWidth*maxWindowWidth];
-    float green     [maxWindowWidth*maxWindowWidth];
-    float blue      [maxWindowWidth*maxWindowWidth];
-
-    for (int j = 0; j < h; ++j)
+    #pragma omp parallel
     {
-      const int minY = std::max(j - a_windowSize, 0);
-      const int maxY = std::min(j + a_windowSize, h - 1);
+      ScopedFTZ ftz;
 
-      int offsetY0 = (j - 1)*w * 4;
-      int offsetY1 = (j + 0)*w * 4;
-      int offsetY2 = (j + 1)*w * 4;
+      float red  [maxWindowWidth*maxWindowWidth];
+      float green[maxWindowWidth*maxWindowWidth];
+      float blue [maxWindowWidth*maxWindowWidth];
 
-      if (j - 1 < 0)
-        offsetY0 = offsetY1;
+      #pragma omp for schedule(dynamic, 1)
+      for (int band = 0; band < bandsNum; band++)
+      {
+        PixelArray& badPixels = badPixelsPerBand[band];
 
-      if (j + 1 >= h)
-        offsetY2 = offsetY1;
+        for (int j = band*FILTER_BAND_HEIGHT; j < std::min(h, (band + 1)*FILTER_BAND_HEIGHT); ++j)
+        {
+          const int minY = std::max(j - a_windowSize, 0);
+          const int maxY = std::min(j + a_windowSize, h - 1);
 
-      for (int i = 0; i < w; ++i)
-      {
-        const int minX = std::max(i - a_windowSize, 0);
-        const int maxX = std::min(i + a_windowSize, w - 1);
+          const float* pRow0 = pData + size_t(std::max(j - 1, 0))*size_t(w)*4;
+          const float* pRow1 = pData + size_t(j)*size_t(w)*4;
+          const float* pRow2 = pData + size_t(std::min(j + 1, h - 1))*size_t(w)*4;
 
-        int offsetX0 = (i - 1) * 4;
-        int offsetX1 = (i + 0) * 4;
-        int offsetX2 = (i + 1) * 4;
+          for (int i = 0; i < w; ++i)
+          {
+            const int minX = std::max(i - a_windowSize, 0);
+            const int maxX = std::min(i + a_windowSize, w - 1);
 
-        if (i - 1 < 0)
-          offsetX0 = offsetX1;
+            int offsetX0 = (i - 1) * 4;
+            int offsetX1 = (i + 0) * 4;
+            int offsetX2 = (i + 1) * 4;
 
-        if (i + 1 >= w)
-          offsetX2 = offsetX1;
+            if (i - 1 < 0)
+              offsetX0 = offsetX1;
 
-        const vfloat4 xm = cvex::load(pData + offsetY1 + offsetX1);
+            if (i + 1 >= w)
+              offsetX2 = offsetX1;
 
-        const vfloat4 x0 = cvex::load(pData + offsetY1 + offsetX0);
-        const vfloat4 x1 = cvex::load(pData + offsetY1 + offsetX2);
-        const vfloat4 x2 = cvex::load(pData + offsetY0 + offsetX1);
-        const vfloat4 x3 = cvex::load(pData + offsetY2 + offsetX1);
+            const vfloat4 xm = cvex::load(pRow1 + offsetX1);
 
-        const vfloat4 diff0sq = (xm - x0)*(xm - x0);
-        const vfloat4 diff1sq = (xm - x1)*(xm - x1);
-        const vfloat4 diff2sq = (xm - x2)*(xm - x2);
-        const vfloat4 diff3sq = (xm - x3)*(xm - x3);
+            const vfloat4 x0 = cvex::load(pRow1 + offsetX0);
+            const vfloat4 x1 = cvex::load(pRow1 + offsetX2);
+            const vfloat4 x2 = cvex::load(pRow0 + offsetX1);
+            const vfloat4 x3 = cvex::load(pRow2 + offsetX1);
 
-        int numFailed = 0;
+            const vfloat4 diff0sq = (xm - x0)*(xm - x0);
+            const vfloat4 diff1sq = (xm - x1)*(xm - x1);
+            const vfloat4 diff2sq = (xm - x2)*(xm - x2);
+            const vfloat4 diff3sq = (xm - x3)*(xm - x3);
 
-        if (cvex::cmpgt_any(diff0sq, threshold))
-          numFailed++;
+            int numFailed = 0;
 
-        if (cvex::cmpgt_any(diff1sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff0sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff2sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff1sq, threshold))
+              numFailed++;
 
-        if (cvex::cmpgt_any(diff3sq, threshold))
-          numFailed++;
+            if (cvex::cmpgt_any(diff2sq, threshold))
+              numFailed++;
 
-        if (numFailed < 3)
-          continue;
+            if (cvex::cmpgt_any(diff3sq, threshold))
+              numFailed++;
 
-        const vfloat4 curr = cvex::load(pData + (j*w + i)*4);
+            if (numFailed < 3)
+              continue;
 
-        ///////////////////////////////////////////////////////////////////////////////////////
-        int counter = 0;
-        for (int y = minY; y <= maxY; y++)
-        {
-          for (int x = minX; x <= maxX; x++)
-          {
-            const vfloat4 p_xy = cvex::load(pData + (y*w + x)*4);
+            const vfloat4 curr = xm;
 
-            cvex::store_s(red   + counter, p_xy);
-            cvex::store_s(green + counter, cvex::splat_1(p_xy));
-            cvex::store_s(blue  + counter, cvex::splat_2(p_xy));
-            counter++;
-          }
-        }
-        ///////////////////////////////////////////////////////////////////////////////////////
+            ///////////////////////////////////////////////////////////////////////////////////////
+            int counter = 0;
+            for (int y = minY; y <= maxY; y++)
+            {
+              const float* pRow = pData + size_t(y)*size_t(w)*4;
+              for (int x = minX; x <= maxX; x++)
+              {
+                const vfloat4 p_xy = cvex::load(pRow + x*4);
 
-        std::sort(red,   red   + counter);
-        std::sort(green, green + counter);
-        std::sort(blue,  blue  + counter);
+                cvex::store_s(red   + counter, p_xy);
+                cvex::store_s(green + counter, cvex::splat_1(p_xy));
+                cvex::store_s(blue  + counter, cvex::splat_2(p_xy));
+                counter++;
+              }
+            }
+            ///////////////////////////////////////////////////////////////////////////////////////
 
-        const int medId = counter / 2;
+            std::sort(red,   red   + counter);
+            std::sort(green, green + counter);
+            std::sort(blue,  blue  + counter);
 
-        const vfloat4 filtered = { red[medId], green[medId], blue[medId], 1.0f };
-        const vfloat4 diff     = (curr - filtered);
-        const float diffVal    = sqrtf(cvex::dot3f(diff, diff));
+            const int medId = counter / 2;
 
-        if (diffVal > a_thresholdValue)
-        {
-          Pixel pix;
-          pix.x     = i;
-          pix.y     = j;
-          pix.dummy = 0;
-          pix.diff  = diffVal;
-          pix.color = filtered;
-          badPixels.push_back(pix);
-        }
+            const vfloat4 filtered = { red[medId], green[medId], blue[medId], 1.0f };
+            const vfloat4 diff     = (curr - filtered);
+            const float diffVal    = sqrtf(cvex::dot3f(diff, diff));
+
+            if (diffVal > a_thresholdValue)
+            {
+              Pixel pix;
+              pix.x     = i;
+              pix.y     = j;
+              pix.dummy = 0;
+              pix.diff  = diffVal;
+              pix.color = filtered;
+              badPixels.push_back(pix);
+            }
+
+          } // for (int i = 0; i < w; ++i)
+
+        } // for (int j = band*FILTER_BAND_HEIGHT; ...)
 
-        cvex::store(pData + (j*w + i) * 4, filtered);
+      } // for (int band = 0; band < bandsNum; band++)
 
-      } // for (int i = 0; i < w; ++i)
+    } // #pragma omp parallel
 
-    } //  for (int j = 0; j < h; ++j)
+    PixelArray badPixels;
+    for (const auto& bandPixels : badPixelsPerBand)
+      badPixels.insert(badPixels.end(), bandPixels.begin(), bandPixels.end());
 
     std::cout << "badPixels.size() = " << badPixels.size() << std::endl;
 
     std::sort(badPixels.begin(), badPixels.end());
 
-    float* pData2 = data();
+    float* pOut = data();
 
-    for (int i = 0; i < a_pixelsNum; i++)
+    const int pixelsNum = std::min(a_pixelsNum, int(badPixels.size()));
+    for (int i = 0; i < pixelsNum; i++)
     {
       const Pixel& pix = badPixels[i];
-      cvex::store(pData2 + 4*(pix.y*w + pix.x), pix.color);
+      cvex::store(pOut + 4*(pix.y*w + pix.x), pix.color);
     }
-
-    //(*this) = tempImage;
   }
 
 
@@ -583,75 +612,86 @@ namespace HydraRender
 
   void HDRImage4f::gaussBlur(int BLUR_RADIUS2, float a_sigma)
   {
-    cvex::set_ftz();
-
-    size_t imSize = size_t(m_width)*size_t(m_height) * sizeof(vfloat4);
-
     float sigma = a_sigma; // = 0.85f + 0.05f*float(BLUR_RADIUS2);
     std::vector<float> kernel = createGaussKernelWeights1D_HDRImage(BLUR_RADIUS2 * 2 + 1, sigma);
 
     // init weights
     //
-    vfloat4 weights[64];
-
-    for (int i = 0; i < 64; i++)
-      weights[i] = cvex::splat(0.0f);
+    std::vector<float, aligned16<float> > weightsData(kernel.size()*4);
 
     for (int i = 0; i < kernel.size(); i++)
     {
       float w = kernel[i] * 1.0f;
-      weights[i] = cvex::splat(w);
+      cvex::store(weightsData.data() + i*4, cvex::splat(w));
     }
 
+    const vfloat4* weights = (const vfloat4*)weightsData.data();
+
     const float* m_dataInBrightPixels = this->data();
     float*       m_dataOut = this->data();
     HDRImage4f temp(this->width(), this->height());
 
-    // horisontal blur pass
-    //
-
     float* tmpData = temp.data();
 
-    memset(tmpData, 0, imSize); // THIS IS IMPORTANT BECAUSE BOUNDARIES ARE NOT SET BY THE FINAL PASS
+    // pixels closer than BLUR_RADIUS2 to the border are not set by the passes and stay zero;
+    // 'temp' is zero after resize, the output rows are cleared by the vertical pass
+    //
+    const size_t rowSize = size_t(m_width) * sizeof(vfloat4);
 
-    for (int y = 0; y < m_height; y++)
+    #pragma omp parallel
     {
-      int offset = y*m_width * 4;
+      ScopedFTZ ftz;
 
-      for (int x = BLUR_RADIUS2; x < m_width - BLUR_RADIUS2; x++)
+      // horisontal blur pass
+      //
+      #pragma omp for
+      for (int y = 0; y < m_height; y++)
       {
-        vfloat4 summ = weights[BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x + 0) * 4);
+        int offset = y*m_width * 4;
 
-        for (int wid = 1; wid < BLUR_RADIUS2; wid++)
+        for (int x = BLUR_RADIUS2; x < m_width - BLUR_RADIUS2; x++)
         {
-          vfloat4 p0 = weights[wid + BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x - wid) * 4);
-          vfloat4 p1 = weights[wid + BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x + wid) * 4);
-          summ = summ + (p0 + p1);
-        }
-
-        cvex::store(tmpData + offset + x * 4, summ);
-      }
+          vfloat4 summ = weights[BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x + 0) * 4);
 
-    }
+          for (int wid = 1; wid < BLUR_RADIUS2; wid++)
+          {
+            vfloat4 p0 = weights[wid + BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x - wid) * 4);
+            vfloat4 p1 = weights[wid + BLUR_RADIUS2]*cvex::load(m_dataInBrightPixels + offset + (x + wid) * 4);
+            summ = summ + (p0 + p1);
+          }
 
-    memset(m_dataOut, 0, imSize); // THIS IS IMPORTANT BECAUSE BOUNDARIES ARE NOT SET BY THE FINAL PASS
+          cvex::store(tmpData + offset + x * 4, summ);
+        }
+      }
 
-    // vertical blur pass and blend pass
-    //
-    for (int x = 0; x < m_width; x++)
-    {
-      for (int y = BLUR_RADIUS2; y < m_height - BLUR_RADIUS2; y++)
+      // vertical blur pass; row by row, so that each thread slides down the same few rows of 'temp' in cache
+      //
+      #pragma omp for
+      for (int y = 0; y < m_height; y++)
       {
-        vfloat4 summ = weights[BLUR_RADIUS2]*cvex::load(tmpData + y*m_width * 4 + x * 4);
+        float* rowOut = m_dataOut + y*m_width * 4;
 
-        for (int wid = 1; wid < BLUR_RADIUS2; wid++)
+        if (y < BLUR_RADIUS2 || y >= m_height - BLUR_RADIUS2)
         {
-          vfloat4 p0 = weights[wid + BLUR_RADIUS2]*cvex::load(tmpData + 4 * (y - wid)*m_width + x * 4);
-          vfloat4 p1 = weights[wid + BLUR_RADIUS2]*cvex::load(tmpData + 4 * (y + wid)*m_width + x * 4);
-          summ = summ + (p0 + p1);
+          memset(rowOut, 0, rowSize);
+          continue;
         }
 
-        cvex::store(m_dataOut + y*m_width * 4 + x * 4, summ);
+        const float* rowIn = tmpData + y*m_width * 4;
+
+        for (int x = 0; x < m_width; x++)
+        {
+          vfloat4 summ = weights[BLUR_RADIUS2]*cvex::load(rowIn + x * 4);
+
+          for (int wid = 1; wid < BLUR_RADIUS2; wid++)
+          {
+            vfloat4 p0 = weights[wid + BLUR_RADIUS2]*cvex::load(rowIn - 4 * wid*m_width + x * 4);
+            vfloat4 p1 = weights[wid + BLUR_RADIUS2]*cvex::load(rowIn + 4 * wid*m_width + x * 4);
+            summ = summ + (p0 + p1);
+          }
+
+          cvex::store(rowOut + x * 4, summ);
+        }
       }
     }
 
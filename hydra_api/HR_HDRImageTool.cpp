@@ -9,6 +9,7 @@
 #include "HR_HDRImage.h"
 #include "HR_HDRImageTool.h"
 #include "HydraObjectManager.h"
+#include "ssemath.h"
 
 #include "FreeImage.h"
 #pragma comment(lib, "FreeImage.lib")
@@ -356,22 +357,6 @@ void InternalImageTool::SaveLDRImageToFileLDR(const wchar_t* a_fileName, int w,
 
 namespace HydraRender
 {
-  static inline float clamp(float u, float a, float b) { return fminf(fmaxf(a, u), b); }
-  static inline uint32_t RealColorToUint32(float x, float y, float z, float w)
-  {
-    float  r = clamp(x*255.0f, 0.0f, 255.0f);
-    float  g = clamp(y*255.0f, 0.0f, 255.0f);
-    float  b = clamp(z*255.0f, 0.0f, 255.0f);
-    float  a = clamp(w*255.0f, 0.0f, 255.0f);
-
-    unsigned char red   = (unsigned char)r;
-    unsigned char green = (unsigned char)g;
-    unsigned char blue  = (unsigned char)b;
-    unsigned char alpha = (unsigned char)a;
-
-    return red | (green << 8) | (blue << 16) | (alpha << 24);
-  }
-
   void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message)
   {
     std::cout << "\n***\n";
@@ -409,20 +394,7 @@ namespace HydraRender
   {
     std::vector<unsigned int> ldrImageData(image.width()*image.height());
 
-    struct float4 { float x, y, z, w; };
-    const float4* in_buff = (const float4*)image.data();
-
-    const float invGamma = 1.0f / a_gamma;
-
-    for (int i = 0; i < image.width()*image.height(); i++)
-    {
-      float4 data = in_buff[i];
-      data.x      = powf(data.x, invGamma);
-      data.y      = powf(data.y, invGamma);
-      data.z      = powf(data.z, invGamma);
-      data.w      = 1.0f;
-      ldrImageData[i] = RealColorToUint32(data.x, data.y, data.z, data.w);
-    }
+    HydraSSE::ConvertLineToLDR(image.data(), image.width()*image.height(), 1.0f, 1.0f / a_gamma, (int32_t*)ldrImageData.data());
 
     SaveImageToFile(a_fileName, image.width(), image.height(), &ldrImageData[0]);
   }
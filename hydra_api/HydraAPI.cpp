@@ -37,37 +37,37 @@ extern HRObjectManager   g_objManager;
 
 std::wstring ToWString(uint64_t i)
 {
-  std::wstringstream out;
-  out << i;
-  return out.str();
+  wchar_t out[HydraXMLHelpers::INT_STR_MAX];
+  HydraXMLHelpers::FormatUInt(i, out);
+  return out;
 }
 
 std::wstring ToWString(int64_t i)
 {
-  std::wstringstream out;
-  out << i;
-  return out.str();
+  wchar_t out[HydraXMLHelpers::INT_STR_MAX];
+  HydraXMLHelpers::FormatInt(i, out);
+  return out;
 }
 
 std::wstring ToWString(int i)
 {
-  std::wstringstream out;
-  out << i;
-  return out.str();
+  wchar_t out[HydraXMLHelpers::INT_STR_MAX];
+  HydraXMLHelpers::FormatInt(i, out);
+  return out;
 }
 
 std::wstring ToWString(float i)
 {
-  std::wstringstream out;
-  out << i;
-  return out.str();
+  wchar_t out[HydraXMLHelpers::FLOAT_STR_MAX];
+  HydraXMLHelpers::FormatFloat(i, out);
+  return out;
 }
 
 std::wstring ToWString(unsigned int i)
 {
-  std::wstringstream out;
-  out << i;
-  return out.str();
+  wchar_t out[HydraXMLHelpers::INT_STR_MAX];
+  HydraXMLHelpers::FormatUInt(i, out);
+  return out;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -117,13 +117,13 @@ HAPI void hrInfoCallback(HR_INFO_CALLBACK pCallback)
 HAPI void hrErrorCallerPlace(const wchar_t* a_placeName, int a_line)
 {
   if (a_placeName == nullptr)
-    g_lastErrorCallerPlace = L"";
+    HrSetErrorCallerPlace(L"");
   else
   {
     std::wstringstream strOut;
     if (a_line != 0)
       strOut << L", line " << a_line;
-    g_lastErrorCallerPlace = a_placeName + strOut.str();
+    HrSetErrorCallerPlace(a_placeName + strOut.str());
   }
 }
 
@@ -195,6 +195,7 @@ HAPI int32_t hrSceneLibraryOpen(const wchar_t* a_libPath, HR_OPEN_MODE a_openMod
 
   g_objManager.scnData.clear();
   g_objManager.m_tempBuffer = std::vector<int>();
+  g_objManager.m_tempPathToChangeFile = L"";
 
   if (g_objManager.m_pDriver != nullptr)
   {
@@ -251,6 +252,21 @@ HAPI HRSceneLibraryInfo hrSceneLibraryInfo()
   result.scenesNum        = int32_t(g_objManager.scnInst.size());
   result.renderDriversNum = int32_t(g_objManager.renderSettings.size());
 
+  const VirtualBufferStats& vbStats = g_objManager.scnData.m_vbCache.Stats();
+  result.vbCacheHits        = int64_t(vbStats.hits);
+  result.vbCacheMisses      = int64_t(vbStats.misses);
+  result.vbCacheEvictions   = int64_t(vbStats.evictions);
+  result.vbCachePageInFails = int64_t(vbStats.pageInFails);
+  result.vbBytesPagedIn     = int64_t(vbStats.bytesPagedIn);
+  result.vbBytesEvicted     = int64_t(vbStats.bytesEvicted);
+
+  const HRLibraryLoadTimes& loadTimes = g_objManager.scnData.m_loadTimes;
+  result.loadTimeXml           = loadTimes.xmlParse;
+  result.loadTimeVirtualBuffer = loadTimes.virtualBuffer;
+  result.loadTimeObjects       = loadTimes.objects;
+  result.loadTimeInstances     = loadTimes.instances;
+  result.loadTimeTotal         = loadTimes.total;
+
   return result;
 }
 
@@ -370,6 +386,7 @@ HAPI void hrSceneOpen(HRSceneInstRef a_pScn, HR_OPEN_MODE a_mode)
   }
 
   pugi::xml_node sceneNode = pScn->xml_node();
+  pScn->m_drawListVersion++;
 
   if (a_mode == HR_WRITE_DISCARD)
   {
@@ -387,6 +404,11 @@ HAPI void hrSceneOpen(HRSceneInstRef a_pScn, HR_OPEN_MODE a_mode)
 
     pScn->m_remapList.clear();
     pScn->m_remapCache.clear();
+    pScn->m_tracker.clear();
+
+    for (size_t chunkId : pScn->m_instanceTables) // scene node does not reference them any more
+      g_objManager.scnData.m_vbCache.FreeChunk(chunkId);
+    pScn->m_instanceTables.clear();
   }
   else if (a_mode == HR_OPEN_EXISTING)
   {
@@ -416,6 +438,59 @@ HAPI pugi::xml_node hrSceneParamNode(HRSceneInstRef a_pScn)
   return pScn->xml_node(); // pScn->_xml_node_curr();  //
 }
 
+/**
+\brief pack drawList[a_begin, end) to CHUNK_TYPE_INSTANCES chunk and reference it from 'instance_table' scene node.
+\return false if chunk could not be allocated; in this case nothing is appended to scene node.
+*/
+static bool _hrAppendInstanceTable(HRSceneInst* pScn, pugi::xml_node a_sceneNode, size_t a_begin)
+{
+  const size_t instNum  = pScn->drawList.size() - a_begin;
+  const size_t byteSize = instNum*sizeof(HRInstanceRecord);
+
+  const size_t chunkId = g_objManager.scnData.m_vbCache.AllocChunk(byteSize, pScn->id);
+  if (chunkId == size_t(-1))
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"hrSceneClose: can't allocate instance table chunk, instances will be stored in xml");
+    return false;
+  }
+
+  auto& chunk       = g_objManager.scnData.m_vbCache.chunk_at(chunkId);
+  chunk.type        = CHUNK_TYPE_INSTANCES;
+  chunk.sysObjectId = uint32_t(pScn->id);
+  pScn->m_instanceTables.push_back(chunkId);
+
+  HRInstanceRecord* records = (HRInstanceRecord*)chunk.GetMemoryNow();
+  if (records == nullptr)
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"hrSceneClose: instance table chunk is not in memory, instances will be stored in xml");
+    g_objManager.scnData.m_vbCache.FreeChunk(chunkId);
+    pScn->m_instanceTables.pop_back();
+    return false;
+  }
+
+  for (size_t i = 0; i < instNum; i++)
+  {
+    const auto& elem = pScn->drawList[a_begin + i];
+
+    records[i].meshId      = elem.meshId;
+    records[i].remapListId = elem.remapListId;
+    records[i].sceneId     = elem.scene_id;
+    records[i].sceneSid    = elem.scene_sid;
+    memcpy(records[i].matrix, elem.m, sizeof(records[i].matrix));
+  }
+
+  pugi::xml_node tableNode = a_sceneNode.append_child(L"instance_table");
+
+  tableNode.append_attribute(L"id").set_value(uint64_t(a_begin));
+  tableNode.append_attribute(L"count").set_value(uint64_t(instNum));
+  tableNode.append_attribute(L"chunk_id").set_value(uint64_t(chunkId));
+  tableNode.append_attribute(L"offset").set_value(L"0");
+  tableNode.append_attribute(L"bytesize").set_value(uint64_t(byteSize));
+  g_objManager.SetLoc(tableNode, ChunkName(chunk));
+
+  return true;
+}
+
 HAPI void hrSceneClose(HRSceneInstRef a_pScn)
 {
   HRSceneInst* pScn = g_objManager.PtrById(a_pScn);
@@ -442,14 +517,19 @@ HAPI void hrSceneClose(HRSceneInstRef a_pScn)
 
     pugi::xml_node allLists = sceneNode.force_child(L"remap_lists");
     clear_node_childs(allLists);
+    pScn->m_remapListsVersion++;
     for (int id = 0; id < pScn->m_remapList.size(); id++)
     {
       const auto& remapList = pScn->m_remapList[id];
 
-      std::wstringstream strOut;
+      std::wstring finalStr;
+      finalStr.reserve(remapList.size()*4);
+      wchar_t numStr[HydraXMLHelpers::INT_STR_MAX];
       for (size_t i = 0; i < remapList.size(); i++)
-        strOut << remapList[i] << " ";
-      const std::wstring finalStr = strOut.str();
+      {
+        finalStr.append(numStr, HydraXMLHelpers::FormatInt(remapList[i], numStr));
+        finalStr.push_back(L' ');
+      }
 
       pugi::xml_node rlist = allLists.append_child(L"remap_list");
 
@@ -461,30 +541,25 @@ HAPI void hrSceneClose(HRSceneInstRef a_pScn)
 
   //// add all instances to xml
   //
-  for (size_t i = pScn->drawBegin; i < pScn->drawList.size(); i++)
+  const bool packedToTable = g_objManager.m_binaryInstances && (pScn->drawList.size() > pScn->drawBegin) &&
+                             _hrAppendInstanceTable(pScn, sceneNode, pScn->drawBegin);
+
+  for (size_t i = pScn->drawBegin; i < pScn->drawList.size() && !packedToTable; i++)
   {
     pugi::xml_node nodeXML = sceneNode.append_child(L"instance");
     
     auto& elem = pScn->drawList[i];
 
-    std::wstring id      = ToWString(i);
-    std::wstring mod_id  = ToWString(elem.meshId);
-    std::wstring mat_id  = ToWString(elem.remapListId);
-    std::wstring scn_id  = ToWString(elem.scene_id);
-    std::wstring scn_sid = ToWString(elem.scene_sid);
-
-    std::wstringstream outMat;
-    for (int j = 0; j < 16;j++)
-      outMat << elem.m[j] << L" ";
+    wchar_t mstr[16*HydraXMLHelpers::FLOAT_STR_MAX + 1];
+    const int mlen = HydraXMLHelpers::FormatFloats(elem.m, 16, mstr);
+    mstr[mlen] = L' '; mstr[mlen + 1] = 0;
 
-    std::wstring mstr = outMat.str();
-
-    nodeXML.append_attribute(L"id").set_value(id.c_str());
-    nodeXML.append_attribute(L"mesh_id").set_value(mod_id.c_str());
-    nodeXML.append_attribute(L"rmap_id").set_value(mat_id.c_str());
-    nodeXML.append_attribute(L"scn_id").set_value(scn_id.c_str());
-    nodeXML.append_attribute(L"scn_sid").set_value(scn_sid.c_str());
-    nodeXML.append_attribute(L"matrix").set_value(mstr.c_str());
+    nodeXML.append_attribute(L"id").set_value(int64_t(i));
+    nodeXML.append_attribute(L"mesh_id").set_value(elem.meshId);
+    nodeXML.append_attribute(L"rmap_id").set_value(elem.remapListId);
+    nodeXML.append_attribute(L"scn_id").set_value(elem.scene_id);
+    nodeXML.append_attribute(L"scn_sid").set_value(elem.scene_sid);
+    nodeXML.append_attribute(L"matrix").set_value(mstr);
   }
 
   // lights
@@ -495,20 +570,14 @@ HAPI void hrSceneClose(HRSceneInstRef a_pScn)
     
     auto& elem = pScn->drawListLights[i];
 
-    std::wstring id     = ToWString(i);
-    std::wstring mod_id = ToWString(elem.lightId);
-    std::wstring lgi_id = ToWString(elem.lightGroupInstId);
-
-    std::wstringstream outMat;
-    for (int j = 0; j < 16;j++)
-      outMat << elem.m[j] << L" ";
+    wchar_t mstr[16*HydraXMLHelpers::FLOAT_STR_MAX + 1];
+    const int mlen = HydraXMLHelpers::FormatFloats(elem.m, 16, mstr);
+    mstr[mlen] = L' '; mstr[mlen + 1] = 0;
 
-    std::wstring mstr = outMat.str();
-
-    nodeXML.append_attribute(L"id").set_value(id.c_str());
-    nodeXML.append_attribute(L"light_id").set_value(mod_id.c_str());
-    nodeXML.append_attribute(L"matrix").set_value(mstr.c_str());
-    nodeXML.append_attribute(L"lgroup_id").set_value(lgi_id.c_str());
+    nodeXML.append_attribute(L"id").set_value(int64_t(i));
+    nodeXML.append_attribute(L"light_id").set_value(elem.lightId);
+    nodeXML.append_attribute(L"matrix").set_value(mstr);
+    nodeXML.append_attribute(L"lgroup_id").set_value(elem.lightGroupInstId);
     
     if (i < pScn->drawLightsCustom.size())
     {
@@ -525,7 +594,7 @@ HAPI void hrSceneClose(HRSceneInstRef a_pScn)
           nodeXML.append_attribute(attrib.name()) = attrib.value();
       }
       else if (customAttribs != L"")
-        HrError(L"hrSceneClose: bad custom attribute string for light instance with id = ", id);
+        HrError(L"hrSceneClose: bad custom attribute string for light instance with id = ", i);
     }
 
     pScn->drawListLights[i].node = nodeXML; // store reference to instance xml node.
@@ -535,6 +604,7 @@ HAPI void hrSceneClose(HRSceneInstRef a_pScn)
   pScn->drawBeginLight  = pScn->drawListLights.size();
   pScn->opened          = false;
   pScn->driverDirtyFlag = true;
+  pScn->wasChanged      = pScn->wasChanged || (pScn->openMode != HR_OPEN_READ_ONLY);
 }
 
 HAPI int hrMeshInstance(HRSceneInstRef a_pScn, HRMeshRef a_pMesh, 
@@ -713,6 +783,8 @@ std::unique_ptr<IHRRenderDriver> CreateRenderFromString(const wchar_t *a_classNa
     return std::unique_ptr<IHRRenderDriver>(CreateOpenGL32Deferred_RenderDriver());
   else if (!wcscmp(a_className, L"opengl3Utility"))
     return std::unique_ptr<IHRRenderDriver>(CreateOpenGL3_Utilty_RenderDriver());
+  else if (!wcscmp(a_className, L"cpuRayCast"))
+    return std::unique_ptr<IHRRenderDriver>(CreateCPURayCast_RenderDriver());
   else if (!wcscmp(a_className, L"HydraModern"))
     return std::unique_ptr<IHRRenderDriver>(CreateHydraConnection_RenderDriver());
   else
@@ -964,70 +1036,83 @@ HAPI IHRRenderDriver* hrRenderDriverPointer(HRRenderRef a_pRender)
 }
 
 
-void _hrSaveCurrentChanges(HRSceneData& a_scnData)
+std::string ws2s(const std::wstring& s);
+
+/**
+\brief append only writer for change_XXXXX.xml; nodes are printed directly from the library DOM without copying them to temporary document.
+*/
+struct ChangeLogWriter
 {
-  const std::wstring& fileName = g_objManager.m_tempPathToChangeFile;
-  
-  pugi::xml_document  xmlDoc;
-  auto texturesLib  = xmlDoc.append_child(L"textures_lib");
-  auto materialsLib = xmlDoc.append_child(L"materials_lib");
-  auto geometryLib  = xmlDoc.append_child(L"geometry_lib");
-  auto lightsLib    = xmlDoc.append_child(L"lights_lib");
-  auto cameraLib    = xmlDoc.append_child(L"cam_lib");
-  auto settingsNode = xmlDoc.append_child(L"render_lib");
-  auto sceneNode    = xmlDoc.append_child(L"scenes");
-  
-  for(auto& texture : a_scnData.textures)
+  ChangeLogWriter(const std::wstring& a_fileName, bool a_append) : m_writer(m_out)
   {
-    if(texture.wasChanged)
-    {
-      texturesLib.append_copy(texture.xml_node());
-      texture.wasChanged = false;
-    }
-  }
-  
-  for(auto& material : a_scnData.materials)
-  {
-    if(material.wasChanged)
-    {
-      materialsLib.append_copy(material.xml_node());
-      material.wasChanged = false;
-    }
-  }
-  
-  for(auto& mesh : a_scnData.meshes)
-  {
-    if(mesh.wasChanged)
-    {
-      geometryLib.append_copy(mesh.xml_node());
-      mesh.wasChanged = false;
-    }
+#ifdef WIN32
+    m_out.open(a_fileName.c_str(), a_append ? (std::ios::binary | std::ios::app) : std::ios::binary);
+#else
+    const std::string fileNameA = ws2s(a_fileName);
+    m_out.open(fileNameA.c_str(), a_append ? (std::ios::binary | std::ios::app) : std::ios::binary);
+#endif
+    if (m_out.is_open() && !a_append)
+      m_out << "<?xml version=\"1.0\"?>\n";
   }
-  
-  for(auto& light : a_scnData.lights)
+
+  bool IsOpen() const { return m_out.is_open(); }
+
+  template<typename ObjectType>
+  void WriteLib(const char* a_libName, std::vector<ObjectType>& a_objects)
   {
-    if(light.wasChanged)
+    bool libOpened = false;
+
+    for (auto& obj : a_objects)
     {
-      lightsLib.append_copy(light.xml_node());
-      light.wasChanged = false;
+      if (!obj.wasChanged)
+        continue;
+
+      if (!libOpened)
+      {
+        m_out << "<" << a_libName << ">\n";
+        libOpened = true;
+      }
+
+      obj.xml_node().print(m_writer, L"  ", pugi::format_default, pugi::encoding_utf8, 1);
+      obj.wasChanged = false;
     }
+
+    if (libOpened)
+      m_out << "</" << a_libName << ">\n";
+    else
+      WriteEmptyLib(a_libName);
   }
-  
-  for(auto& cam : a_scnData.cameras)
+
+  void WriteEmptyLib(const char* a_libName) { m_out << "<" << a_libName << " />\n"; }
+
+private:
+  std::ofstream           m_out;
+  pugi::xml_writer_stream m_writer;
+};
+
+void _hrSaveCurrentChanges(HRSceneData& a_scnData)
+{
+  const std::wstring& fileName = g_objManager.m_tempPathToChangeFile;
+  if (fileName.empty()) // no hrFlush was called yet; keep changes for the first change file
+    return;
+
+  ChangeLogWriter changes(fileName, g_objManager.m_appendToChangeFile);
+  if (!changes.IsOpen())
   {
-    if(cam.wasChanged)
-    {
-      cameraLib.append_copy(cam.xml_node());
-      cam.wasChanged = false;
-    }
+    HrError(L"_hrSaveCurrentChanges: can't open change file ", fileName.c_str());
+    return;
   }
+
+  changes.WriteLib("textures_lib",  a_scnData.textures);
+  changes.WriteLib("materials_lib", a_scnData.materials);
+  changes.WriteLib("geometry_lib",  a_scnData.meshes);
+  changes.WriteLib("lights_lib",    a_scnData.lights);
+  changes.WriteLib("cam_lib",       a_scnData.cameras);
   
-  for(auto& scene : g_objManager.scnInst)
-    sceneNode.append_copy(scene.xml_node());
-  
-  //#TODO: add renderer settings ...
-  
-  xmlDoc.save_file(fileName.c_str(), L"  ");
+  changes.WriteEmptyLib("render_lib"); //#TODO: add renderer settings ...
+  changes.WriteLib("scenes",        g_objManager.scnInst);
+
+  g_objManager.m_appendToChangeFile = true; // next hrCommit before hrFlush appends its changes to the same file
 }
 
 HAPI void hrCommit(HRSceneInstRef a_pScn, HRRenderRef a_pRender, HRCameraRef a_pCam) ///< non blocking commit, send commands to renderer and return immediately 
@@ -1075,19 +1160,8 @@ HAPI void hrCommit(HRSceneInstRef a_pScn, HRRenderRef a_pRender, HRCameraRef a_p
   // note that you don't have to lock mutex due to all data is appended to the end of virtual buffer.
   // due to this new object should not damadge previouse and only garbage collector operation must lock mutex
   //
-  int64_t* chunkTable = g_objManager.scnData.m_vbCache.ChunksTablePtr();
-  if(chunkTable != nullptr && !g_objManager.m_attachMode)
-  {
-    const size_t chunksNum = g_objManager.scnData.m_vbCache.size();
-    for(size_t i=0;i<chunksNum;i++)
-    {
-      const auto& chunk = g_objManager.scnData.m_vbCache.chunk_at(i);
-      if(chunk.InMemory())
-        chunkTable[i] = int64_t(chunk.localAddress);
-      else
-        chunkTable[i] = int64_t(-1);
-    }
-  }
+  if(!g_objManager.m_attachMode)
+    g_objManager.scnData.m_vbCache.UpdateChunksTable();
   
   if(g_objManager.m_tempBuffer.size() > TEMP_BUFFER_MAX_SIZE_DONT_FREE)
     g_objManager.m_tempBuffer = g_objManager.EmptyBuffer();
@@ -1106,12 +1180,21 @@ HAPI void hrFlush(HRSceneInstRef a_pScn, HRRenderRef a_pRender, HRCameraRef a_pC
   std::wstring newPath = outStr3.str();
 
   //g_objManager.scnData.m_xmlDoc.save_file(oldPath.c_str(), L"  ");
-  g_objManager.m_tempPathToChangeFile = cngPath; // postpone g_objManager.scnData.m_xmlDocChanges.save_file(cngPath.c_str(), L"  ");
+  if (g_objManager.m_tempPathToChangeFile != cngPath) // hrCommit calls after previous hrFlush may already have appended their changes to this file
+  {
+    g_objManager.m_tempPathToChangeFile = cngPath;    // postpone g_objManager.scnData.m_xmlDocChanges.save_file(cngPath.c_str(), L"  ");
+    g_objManager.m_appendToChangeFile   = false;
+  }
 
   hrCommit(a_pScn, a_pRender, a_pCam);
   
   g_objManager.scnData.m_commitId++;
   g_objManager.scnData.m_xmlDoc.save_file(newPath.c_str(), L"  ");
+
+  std::wstringstream outStr4;
+  outStr4 << g_objManager.scnData.m_path.c_str() << L"/change_" << std::setfill(L"0"[0]) << std::setw(5) << g_objManager.scnData.m_commitId << L".xml";
+  g_objManager.m_tempPathToChangeFile = outStr4.str(); // changes of next hrCommit calls are for the next state
+  g_objManager.m_appendToChangeFile   = false;
   
   HRRender* pSettings = g_objManager.PtrById(a_pRender);
   
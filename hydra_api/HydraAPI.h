@@ -62,7 +62,9 @@
 struct HRSceneLibraryInfo
 {
   HRSceneLibraryInfo() : texturesNum(0), materialsNum(0), meshesNum(0), 
-                         camerasNum(0), scenesNum(0), renderDriversNum(0){}
+                         camerasNum(0), scenesNum(0), renderDriversNum(0),
+                         vbCacheHits(0), vbCacheMisses(0), vbCacheEvictions(0), vbCachePageInFails(0), vbBytesPagedIn(0), vbBytesEvicted(0),
+                         loadTimeXml(0.0f), loadTimeVirtualBuffer(0.0f), loadTimeObjects(0.0f), loadTimeInstances(0.0f), loadTimeTotal(0.0f) {}
 
   int32_t texturesNum;
   int32_t materialsNum;
@@ -72,6 +74,19 @@ struct HRSceneLibraryInfo
   int32_t scenesNum;
   int32_t renderDriversNum;
 
+  int64_t vbCacheHits;        ///< virtual buffer chunk accesses when chunk was in memory
+  int64_t vbCacheMisses;      ///< virtual buffer chunk accesses when chunk was evicted to disk and had to be paged in
+  int64_t vbCacheEvictions;   ///< number of chunks swapped to disk because virtual buffer was full
+  int64_t vbCachePageInFails; ///< misses that could not be paged in (chunk was never saved or saved in compressed format)
+  int64_t vbBytesPagedIn;
+  int64_t vbBytesEvicted;
+
+  float loadTimeXml;           ///< ms; phases of the last hrSceneLibraryOpen with HR_OPEN_EXISTING: xml parsing
+  float loadTimeVirtualBuffer; ///< ms; virtual buffer init
+  float loadTimeObjects;       ///< ms; textures, materials, meshes, lights and cameras
+  float loadTimeInstances;     ///< ms; scene instances
+  float loadTimeTotal;         ///< ms; whole load
+
 };
 
 struct HRMeshRef     { int32_t id; HRMeshRef()     : id(-1) {} }; ///< Mesh  reference
@@ -172,12 +187,14 @@ typedef void(*HR_TEXTURE2D_PROC_LDR_CALLBACK)(unsigned char* a_buffer, int w, in
 struct HRInitInfo
 {
   HRInitInfo() : copyTexturesToLocalFolder(false), localDataPath(true), sortMaterialIndices(true), computeMeshBBoxes(true),
-                 vbSize(int64_t(2048)*int64_t(1024*1024)) {}
+                 binaryInstances(false), mapMeshFiles(false), vbSize(int64_t(2048)*int64_t(1024*1024)) {}
 
   bool    copyTexturesToLocalFolder; ///<!
   bool    localDataPath            ; ///<!
   bool    sortMaterialIndices      ; ///<!
   bool    computeMeshBBoxes        ; ///<!
+  bool    binaryInstances          ; ///<! hrSceneClose stores mesh instances as packed binary chunk referenced by 'instance_table' node instead of 'instance' nodes; render processes that read state xml directly will not see them
+  bool    mapMeshFiles             ; ///<! meshes that are not in virtual buffer are passed to render driver directly from memory mapped '.vsgf' file instead of reading them to temporary buffer
   int64_t vbSize                   ; ///<! virtual buffer size in bytes
 };
 
@@ -1018,6 +1035,35 @@ struct HRGBufferPixel
 
 HAPI void hrRenderGetGBufferLine(HRRenderRef a_pRender, int32_t a_lineNumber, HRGBufferPixel* a_lineData, int32_t a_startX, int32_t a_endX);  // w*4*sizeof(float)
 
+/**
+\brief structure of arrays gbuffer output; each not null pointer is a plane of width*height elements (row major, y*width + x).
+       Only not null planes are unpacked, so ask only for the layers you need.
+*/
+struct HRGBufferPlanes
+{
+  HRGBufferPlanes() : depth(nullptr), norm(), texc(), rgba(), shadow(nullptr), coverage(nullptr),
+                      matId(nullptr), objId(nullptr), instId(nullptr) {}
+
+  float*   depth;
+  float*   norm[3];
+  float*   texc[2];
+  float*   rgba[4];
+  float*   shadow;
+  float*   coverage;
+  int32_t* matId;
+  int32_t* objId;
+  int32_t* instId;
+};
+
+/**
+\brief unpack the whole gbuffer to caller planes in one pass; much faster than hrRenderGetGBufferLine for each line.
+* \param a_pRender - render reference
+* \param a_planes  - output planes; each not null plane must have at least width*height elements
+*
+* Return false if GBuffer was not evaluated (set 'evalgbuffer' = 1 in render settings) or the render is not valid.
+*/
+HAPI bool hrRenderGetGBuffer(HRRenderRef a_pRender, const HRGBufferPlanes* a_planes);
+
 /**
 \brief save custom gbuffer layer
 * \param a_pRender     - render reference
@@ -1195,10 +1241,68 @@ namespace HRUtils
 
   BBox transformBBox(const BBox &a_bbox, const float m[16]);
 
-  void getRandomPointsOnMesh(HRMeshRef mesh_ref, float *points, uint32_t n_points, bool tri_area_weighted, uint32_t seed = 0u);
+  /**
+  \brief scatter points over mesh surface.
+  \param mesh_ref          - mesh to sample
+  \param points            - output, n_points*3 floats (x,y,z)
+  \param n_points          - number of points
+  \param tri_area_weighted - select triangles proportionally to their area (uniform density over surface); if false all triangles are equiprobable
+  \param seed              - result depends only on seed and not on the number of threads
+  \param use_qmc           - use 'hr_qmc' low discrepancy sequence instead of pseudo random numbers; gives more even coverage with fewer points
+
+  */
+  void getRandomPointsOnMesh(HRMeshRef mesh_ref, float *points, uint32_t n_points, bool tri_area_weighted, uint32_t seed = 0u, bool use_qmc = false);
 
   HRTextureNodeRef Cube2SphereLDR(HRTextureNodeRef a_cube[6]);
 
+  /**
+  \brief result of scene ray picking; instId is the index in scene draw list, i.e. the value that hrMeshInstance returned.
+  */
+  struct PickResult
+  {
+    int32_t instId; ///< -1 if nothing was hit
+    int32_t meshId;
+    int32_t triId;  ///< -1 if mesh data is not available in memory and instance box was hit instead
+    float   t;      ///< distance along a_rayDir in units of its length
+    float   u, v;   ///< barycentric coordinates of the hit in the triangle
+  };
+
+  /**
+  \brief build or update two level BVH of the scene that is used by scenePickRay, sceneFrustumCull and sceneBoxOverlap.
+
+   Queries call it themselves; call it explicitly to move build time out of interactive queries.
+   The tree is rebuilt if the set of instanced meshes or mesh data were changed; if only instance matrices were changed it is refitted.
+   Per mesh BVHs are shared by all scenes and built once per mesh data.
+  */
+  void sceneUpdateSpatialIndex(HRSceneInstRef a_scn);
+
+  /**
+  \brief find the closest instance triangle hit by the ray.
+  \param a_scn     - scene instance
+  \param a_rayPos  - ray origin in world space
+  \param a_rayDir  - ray direction in world space, normalization is not required
+  \param a_tMax    - max hit distance in units of a_rayDir length
+  \param a_pResult - output, may be nullptr
+
+   Triangles are two sided. Light geometry instances are also hit. Returns true if something was hit.
+  */
+  bool scenePickRay(HRSceneInstRef a_scn, const float a_rayPos[3], const float a_rayDir[3], PickResult* a_pResult, float a_tMax = std::numeric_limits<float>::max());
+
+  /**
+  \brief find instances whose world boxes intersect view frustum.
+  \param a_scn           - scene instance
+  \param a_worldViewProj - row major matrix from world space to OpenGL clip space, proj*view
+  \param a_outInstances  - output draw list indices; the vector is cleared first
+
+   Test is conservative: instances whose boxes only touch the frustum planes or lie near its corners may be reported.
+  */
+  void sceneFrustumCull(HRSceneInstRef a_scn, const float a_worldViewProj[16], std::vector<int32_t>& a_outInstances);
+
+  /**
+  \brief find instances whose world boxes overlap a_box; output is cleared first.
+  */
+  void sceneBoxOverlap(HRSceneInstRef a_scn, const BBox& a_box, std::vector<int32_t>& a_outInstances);
+
   BBox InstanceSceneIntoScene(HRSceneInstRef a_scnFrom, HRSceneInstRef a_scnTo, float a_mat[16], bool origin = true,
                               const int32_t* remapListOverride = nullptr, int32_t remapListSize = 0);
 
@@ -1246,6 +1350,28 @@ HAPI HRLightRef hrFindLightByName(const wchar_t *a_lightName);
 */
 HAPI HRCameraRef hrFindCameraByName(const wchar_t *a_cameraName);
 
+/**
+\brief resolve many material names in one call.
+\param a_matNames - array of material names
+\param a_namesNum - size of a_matNames and a_outRefs
+\param a_outRefs  - output references; id = -1 for names that does not exist
+
+ Unlike hrFindMaterialByName, missing names are not reported as errors. Returns the number of found materials.
+ Name lookups use index that is updated on create, library load and on hrMaterialClose if "name" attribute was changed.
+
+*/
+HAPI int32_t hrFindMaterialsByName(const wchar_t** a_matNames, int32_t a_namesNum, HRMaterialRef* a_outRefs);
+
+/**
+\brief resolve many light names in one call. Same as hrFindMaterialsByName, but for lights.
+*/
+HAPI int32_t hrFindLightsByName(const wchar_t** a_lightNames, int32_t a_namesNum, HRLightRef* a_outRefs);
+
+/**
+\brief resolve many camera names in one call. Same as hrFindMaterialsByName, but for cameras.
+*/
+HAPI int32_t hrFindCamerasByName(const wchar_t** a_cameraNames, int32_t a_namesNum, HRCameraRef* a_outRefs);
+
 /**
 \brief get HRRenderRef by its type name from the library.
 \param a_renderTypeName - render type name
@@ -38,6 +38,7 @@ HAPI HRCameraRef hrCameraCreate(const wchar_t* a_objectName)
 
   g_objManager.scnData.cameras[ref.id].update(nodeXml);
   g_objManager.scnData.cameras[ref.id].id = ref.id;
+  HRSceneData::add_name(g_objManager.scnData.m_cameraNames, cam.name, ref.id);
 
   return ref;
 }
@@ -103,6 +104,10 @@ HAPI void hrCameraClose(HRCameraRef a_pCam)
     return;
   }
 
+  const std::wstring nameInXml = pCam->xml_node().attribute(L"name").as_string();
+  if (!nameInXml.empty() && nameInXml != pCam->name)
+    HRSceneData::rename_object(g_objManager.scnData.cameras, g_objManager.scnData.m_cameraNames, pCam->id, nameInXml);
+
   pCam->opened     = false;
   pCam->wasChanged = true;
   //g_objManager.scnData.m_changeList.cameraChanged.insert(pCam->id);
@@ -129,18 +134,7 @@ HAPI pugi::xml_node hrCameraParamNode(HRCameraRef a_camRef)
 HAPI HRCameraRef hrFindCameraByName(const wchar_t *a_cameraName)
 {
   HRCameraRef camera;
-
-  if(a_cameraName != nullptr)
-  {
-    for (auto cam : g_objManager.scnData.cameras)
-    {
-      if (cam.name == std::wstring(a_cameraName))
-      {
-        camera.id = cam.id;
-        break;
-      }
-    }
-  }
+  camera.id = HRSceneData::find_name(g_objManager.scnData.m_cameraNames, a_cameraName);
 
   if(camera.id == -1)
   {
@@ -152,6 +146,27 @@ HAPI HRCameraRef hrFindCameraByName(const wchar_t *a_cameraName)
   return camera;
 }
 
+HAPI int32_t hrFindCamerasByName(const wchar_t** a_cameraNames, int32_t a_namesNum, HRCameraRef* a_outRefs)
+{
+  if (a_cameraNames == nullptr || a_outRefs == nullptr)
+  {
+    HrError(L"hrFindCamerasByName: nullptr input");
+    return 0;
+  }
+
+  const auto& index = g_objManager.scnData.m_cameraNames;
+  int32_t found     = 0;
+
+  for (int32_t i = 0; i < a_namesNum; i++)
+  {
+    a_outRefs[i].id = HRSceneData::find_name(index, a_cameraNames[i]);
+    if (a_outRefs[i].id != -1)
+      found++;
+  }
+
+  return found;
+}
+
 
 HAPI HRRenderRef hrFindRenderByTypeName(const wchar_t* a_renderTypeName)
 {
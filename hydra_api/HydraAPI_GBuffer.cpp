@@ -3,6 +3,8 @@
 
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <map>
 
@@ -35,6 +37,64 @@ HAPI void hrRenderGetGBufferLine(HRRenderRef a_pRender, int32_t a_lineNumber, HR
   pDriver->GetGBufferLine(a_lineNumber, a_lineData, a_startX, a_endX, g_objManager.scnData.m_shadowCatchers);
 }
 
+void IHRRenderDriver::GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers)
+{
+  std::vector<HRGBufferPixel> gbufferLine(a_width); // serial: GetGBufferLine is not required to be thread safe
+
+  for (int y = 0; y < a_height; y++)
+  {
+    GetGBufferLine(y, gbufferLine.data(), 0, a_width, a_shadowCatchers);
+    StoreGBufferLine(a_planes, size_t(y)*size_t(a_width), gbufferLine.data(), a_width);
+  }
+}
+
+static bool GetGBufferFromDriver(HRRenderRef a_pRender, const HRGBufferPlanes& a_planes, const wchar_t* a_funcName)
+{
+  HRRender* pRender = g_objManager.PtrById(a_pRender);
+
+  if (pRender == nullptr)
+  {
+    HrError(std::wstring(a_funcName) + L": nullptr input");
+    return false;
+  }
+
+  auto pDriver = pRender->m_pDriver;
+  if (pDriver == nullptr)
+    return false;
+
+  auto renderSettingsNode = pRender->xml_node();
+
+  const int width     = renderSettingsNode.child(L"width").text().as_int();
+  const int height    = renderSettingsNode.child(L"height").text().as_int();
+  const int evalgbuff = renderSettingsNode.child(L"evalgbuffer").text().as_int();
+
+  if (evalgbuff != 1)
+  {
+    HrError(std::wstring(a_funcName) + L": don't have gbuffer; set 'evalgbuffer' = 1 and render again; ");
+    return false;
+  }
+
+  if (width <= 0 || height <= 0)
+    return true;
+
+  hrRenderLockFrameBufferUpdate(a_pRender);
+  pDriver->GetGBuffer(width, height, a_planes, g_objManager.scnData.m_shadowCatchers);
+  hrRenderUnlockFrameBufferUpdate(a_pRender);
+
+  return true;
+}
+
+HAPI bool hrRenderGetGBuffer(HRRenderRef a_pRender, const HRGBufferPlanes* a_planes)
+{
+  if (a_planes == nullptr)
+  {
+    HrError(L"hrRenderGetGBuffer: nullptr input");
+    return false;
+  }
+
+  return GetGBufferFromDriver(a_pRender, *a_planes, L"hrRenderGetGBuffer");
+}
+
 static inline int RealColorToUint32(const float real_color[4])
 {
   float  r = fminf(real_color[0] * 255.0f, 255.0f);
@@ -50,29 +110,11 @@ static inline int RealColorToUint32(const float real_color[4])
   return red | (green << 8) | (blue << 16) | (alpha << 24);
 }
 
-static void ExtractDepthLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width, const float dmin, const float dmax)
+static void ExtractDepthLineU16(const float* a_depth, const int32_t* a_matId, unsigned short* a_outLine, int a_width, const float dmin, const float dmax)
 {
   for (int x = 0; x < a_width; x++)
   {
-    float d = (a_inLine[x].depth - dmin) / (dmax - dmin);
-    if (d > 1e5f || a_inLine[x].matId < 0)
-      d = 1.0f;
-
-    float depth[4];
-    depth[0] = 1.0f - d;
-    depth[1] = 1.0f - d;
-    depth[2] = 1.0f - d;
-    depth[3] = 1.0f;
-
-    a_outLine[x] = RealColorToUint32(depth);
-  }
-}
-
-static void ExtractDepthLineU16(const HRGBufferPixel* a_inLine, unsigned short* a_outLine, int a_width, const float dmin, const float dmax)
-{
-  for (int x = 0; x < a_width; x++)
-  {
-    const float d = (a_inLine[x].depth - dmin) / (dmax - dmin);
+    const float d = (a_depth[x] - dmin) / (dmax - dmin);
 
     int r = (int)((1.0f-d)*65535.0f);
     if(r > 65535)
@@ -80,35 +122,44 @@ static void ExtractDepthLineU16(const HRGBufferPixel* a_inLine, unsigned short*
     else if (r < 1)
       r = 1;
 
-    if (d > 1e5f || a_inLine[x].matId < 0)
+    if (d > 1e5f || a_matId[x] < 0)
       r = 0;
 
     a_outLine[x] = (unsigned short)(r);
   }
 }
 
+static void ExtractGreyLine(const float* a_value, int32_t* a_outLine, int a_width)
+{
+  for (int x = 0; x < a_width; x++)
+  {
+    const float val    = a_value[x];
+    const float col[4] = { val, val, val, 1.0f };
+    a_outLine[x] = RealColorToUint32(col);
+  }
+}
 
-static void ExtractNormalsLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
+static void ExtractNormalsLine(const float* a_normX, const float* a_normY, const float* a_normZ, int32_t* a_outLine, int a_width)
 {
   for (int x = 0; x < a_width; x++)
   {
     float norm[4];
-    norm[0] = fabs(a_inLine[x].norm[0]);
-    norm[1] = fabs(a_inLine[x].norm[1]);
-    norm[2] = fabs(a_inLine[x].norm[2]);
+    norm[0] = fabs(a_normX[x]);
+    norm[1] = fabs(a_normY[x]);
+    norm[2] = fabs(a_normZ[x]);
     norm[3] = 1.0f;
 
     a_outLine[x] = RealColorToUint32(norm);
   }
 }
 
-static void ExtractTexCoordLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
+static void ExtractTexCoordLine(const float* a_texcU, const float* a_texcV, int32_t* a_outLine, int a_width)
 {
   for (int x = 0; x < a_width; x++)
   {
     float texc[4];
-    texc[0] = a_inLine[x].texc[0];
-    texc[1] = a_inLine[x].texc[1];
+    texc[0] = a_texcU[x];
+    texc[1] = a_texcV[x];
     texc[2] = 0.0f;
     texc[3] = 1.0f;
 
@@ -116,121 +167,73 @@ static void ExtractTexCoordLine(const HRGBufferPixel* a_inLine, int32_t* a_outLi
   }
 }
 
-static void ExtractTexColorLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
+static void ExtractTexColorLine(const float* a_red, const float* a_green, const float* a_blue, int32_t* a_outLine, int a_width)
 {
   const float invGamma = 1.0f / 2.2f;
 
   for (int x = 0; x < a_width; x++)
   {
-    float texc[4];
-    texc[0] = a_inLine[x].rgba[0];
-    texc[1] = a_inLine[x].rgba[1];
-    texc[2] = a_inLine[x].rgba[2];
-    texc[3] = 1.0f;
-
-    const float color[4] = { powf(texc[0], invGamma),
-                             powf(texc[1], invGamma),
-                             powf(texc[2], invGamma),
-                             texc[3]
+    const float color[4] = { powf(a_red[x],   invGamma),
+                             powf(a_green[x], invGamma),
+                             powf(a_blue[x],  invGamma),
+                             1.0f
     };
 
     a_outLine[x] = RealColorToUint32(color);
   }
 }
 
-static void ExtractAlphaLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
+static void ExtractMaterialId(const int32_t* a_matId, const int32_t* a_instId, int32_t* a_outLine, int a_width)
 {
   for (int x = 0; x < a_width; x++)
   {
-    float texc[4];
-    texc[0] = a_inLine[x].rgba[3];
-    texc[1] = a_inLine[x].rgba[3];
-    texc[2] = a_inLine[x].rgba[3];
-    texc[3] = 1.0f;
-
-    a_outLine[x] = RealColorToUint32(texc);
-  }
-}
-
-static void ExtractShadowLine(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
-{
-  for (int x = 0; x < a_width; x++)
-  {
-    float texc[4];
-    texc[0] = a_inLine[x].shadow;
-    texc[1] = a_inLine[x].shadow;
-    texc[2] = a_inLine[x].shadow;
-    texc[3] = 1.0f;
-
-    a_outLine[x] = RealColorToUint32(texc);
+    if (a_instId[x] < 0)
+      a_outLine[x] = -1;
+    else
+      a_outLine[x] = a_matId[x];
   }
 }
 
-void FindDepthMinMax(std::shared_ptr<IHRRenderDriver> a_pDriver, int width, int height,
-                     float& dmin, float& dmax)
+static void FindDepthMinMax(const float* a_depth, const int a_width, const int a_height,
+                            float& dmin, float& dmax)
 {
-  std::vector<HRGBufferPixel> gbufferLine(width);
-
-  // #TODO: replace this with minmaxheap or simply downsample image 
+  // min/max of each line in parallel, then of lines
   //
-  dmin = 1e38f;
-  dmax = 0.0f;
+  std::vector<float> lineMin(a_height), lineMax(a_height);
 
-  for (int y = 0; y < height; y++)
+  #pragma omp parallel for
+  for (int y = 0; y < a_height; y++)
   {
-    a_pDriver->GetGBufferLine(y, &gbufferLine[0], 0, width, g_objManager.scnData.m_shadowCatchers);
-    for (int x = 0; x < width; x++)
+    float lmin = 1e38f;
+    float lmax = 0.0f;
+    const float* line = a_depth + size_t(y)*size_t(a_width);
+    for (int x = 0; x < a_width; x++)
     {
-      const float d = gbufferLine[x].depth;
+      const float d = line[x];
       if (d < 1e5f && d >= 0.0f && std::isfinite(d))
       {
-        if (d < dmin) dmin = d;
-        if (d > dmax) dmax = d;
+        if (d < lmin) lmin = d;
+        if (d > lmax) lmax = d;
       }
     }
+    lineMin[y] = lmin;
+    lineMax[y] = lmax;
   }
 
-  if (dmax - dmin < 1e-5f)
+  dmin = 1e38f;
+  dmax = 0.0f;
+  for (int y = 0; y < a_height; y++)
   {
-    dmin = 0.0f;
-    dmax = 1.0f;
+    dmin = std::min(dmin, lineMin[y]);
+    dmax = std::max(dmax, lineMax[y]);
   }
 
-}
-
-static void ExtractMaterialId(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
-{
-  for (int x = 0; x < a_width; x++)
+  if (dmax - dmin < 1e-5f)
   {
-    if (a_inLine[x].instId < 0)
-      a_outLine[x] = -1;
-    else
-      a_outLine[x] = a_inLine[x].matId;
+    dmin = 0.0f;
+    dmax = 1.0f;
   }
-}
-
-static void ExtractObjId(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
-{
-  for (int x = 0; x < a_width; x++)
-    a_outLine[x] = a_inLine[x].objId;
-}
-
-static void ExtractInstId(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
-{
-  for (int x = 0; x < a_width; x++)
-    a_outLine[x] = a_inLine[x].instId;
-}
-
-
 
-static void ExtractCoverage(const HRGBufferPixel* a_inLine, int32_t* a_outLine, int a_width)
-{
-  for (int x = 0; x < a_width; x++)
-  {
-    const float cov    = a_inLine[x].coverage;
-    const float col[4] = { cov, cov, cov, 1};
-    a_outLine[x]  = RealColorToUint32(col);
-  }
 }
 
 HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_outFileName, const wchar_t* a_layerName,
@@ -244,34 +247,77 @@ HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_ou
     return false;
   }
 
-  auto pDriver = pRender->m_pDriver;
-  if (pDriver == nullptr)
+  if (pRender->m_pDriver == nullptr)
     return false;
 
-  std::wstring lname = std::wstring(a_layerName);
+  const std::wstring lname = std::wstring(a_layerName);
 
   auto renderSettingsNode = pRender->xml_node();
 
-  const int width     = renderSettingsNode.child(L"width").text().as_int();
-  const int height    = renderSettingsNode.child(L"height").text().as_int();
-  const int evalgbuff = renderSettingsNode.child(L"evalgbuffer").text().as_int();
+  const int    width  = renderSettingsNode.child(L"width").text().as_int();
+  const int    height = renderSettingsNode.child(L"height").text().as_int();
+  const size_t size   = size_t(std::max(width, 0))*size_t(std::max(height, 0));
 
-  if (evalgbuff != 1)
+  // unpack only planes that are needed for this layer, all in one pass over gbuffer
+  //
+  const bool isDepth    = (lname == L"depth");
+  const bool isIdLayer  = (lname == L"matid" || lname == L"mid" || lname == L"objid" || lname == L"instid");
+  const bool isScnLayer = (lname == L"scnsid" || lname == L"scnid");
+
+  std::vector<float>   floatPlanes[4];
+  std::vector<int32_t> intPlanes[2];
+  HRGBufferPlanes      planes;
+
+  auto addFloatPlane = [&](int a_index) -> float*   { floatPlanes[a_index].resize(size); return floatPlanes[a_index].data(); };
+  auto addIntPlane   = [&](int a_index) -> int32_t* { intPlanes[a_index].resize(size);   return intPlanes[a_index].data(); };
+
+  if (isDepth)
   {
-    HrError(L"hrRenderSaveGBufferLayerLDR: don't have gbuffer; set 'evalgbuffer' = 1 and render again; ");
-    return false;
+    planes.depth = addFloatPlane(0);
+    planes.matId = addIntPlane(0);
+  }
+  else if (lname == L"normals")
+  {
+    for (int k = 0; k < 3; k++)
+      planes.norm[k] = addFloatPlane(k);
+  }
+  else if (lname == L"texcoord")
+  {
+    for (int k = 0; k < 2; k++)
+      planes.texc[k] = addFloatPlane(k);
+  }
+  else if (lname == L"diffcolor")
+  {
+    for (int k = 0; k < 3; k++)
+      planes.rgba[k] = addFloatPlane(k);
   }
+  else if (lname == L"alpha")
+    planes.rgba[3] = addFloatPlane(0);
+  else if (lname == L"shadow")
+    planes.shadow = addFloatPlane(0);
+  else if (lname == L"coverage")
+    planes.coverage = addFloatPlane(0);
+  else if (lname == L"matid" || lname == L"mid")
+  {
+    planes.matId  = addIntPlane(0);
+    planes.instId = addIntPlane(1);
+  }
+  else if (lname == L"catcher")
+    planes.matId = addIntPlane(0);
+  else if (lname == L"objid")
+    planes.objId = addIntPlane(0);
+  else if (lname == L"instid" || isScnLayer)
+    planes.instId = addIntPlane(0);
+
+  if (!GetGBufferFromDriver(a_pRender, planes, L"hrRenderSaveGBufferLayerLDR"))
+    return false;
+
+  std::vector<int32_t> imageLDR(size);
 
-  std::vector<int32_t>        imageLDR(width * height);
-  std::vector<HRGBufferPixel> gbufferLine(width);
-  
   float dmin = 1e38f;
   float dmax = 0.0f;
-  if (lname == L"depth")
-  {
-    FindDepthMinMax(pDriver, width, height,
-                    dmin, dmax);
-  }
+  if (isDepth)
+    FindDepthMinMax(planes.depth, width, height, dmin, dmax);
 
   // #TODO: refactor, put to separate procedure
   //
@@ -292,59 +338,56 @@ HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_ou
   HRSceneInstRef scnRef;
   scnRef.id = g_objManager.m_currSceneId;
   HRSceneInst *pScn = g_objManager.PtrById(scnRef);
-  auto scnNode = pScn->xml_node();
 
   std::vector <int32_t> instanceIdToScnId(pScn->drawList.size(), 0);
 
 
-  if(lname == L"scnsid")
-  {
-    for (auto node = scnNode.first_child(); node != nullptr; node = node.next_sibling())
-      if (std::wstring(node.name()) == L"instance")
-        instanceIdToScnId[node.attribute(L"id").as_int()] = node.attribute(L"scn_sid").as_int();
-  }
-  else if(lname == L"scnid")
+  // take scene ids from drawList because instances may be packed to 'instance_table' instead of xml nodes
+  //
+  if(isScnLayer)
   {
-    for (auto node = scnNode.first_child(); node != nullptr; node = node.next_sibling())
-      if (std::wstring(node.name()) == L"instance")
-        instanceIdToScnId[node.attribute(L"id").as_int()] = node.attribute(L"scn_id").as_int();
+    for (size_t i = 0; i < pScn->drawList.size(); i++)
+    {
+      const auto& inst = pScn->drawList[i];
+      if (inst.lightId >= 0) // light geometry instances don't have scene ids
+        continue;
+      instanceIdToScnId[i] = (lname == L"scnsid") ? inst.scene_sid : inst.scene_id;
+    }
   }
 
+  const auto& shadowCatchers = g_objManager.scnData.m_shadowCatchers;
+  unsigned short* imageU16   = (unsigned short*)imageLDR.data();
 
-  unsigned short* imageU16 = (unsigned short*)imageLDR.data();
-
-  hrRenderLockFrameBufferUpdate(a_pRender);
-
+  #pragma omp parallel for
   for (int y = 0; y < height; y++)
   {
-    pDriver->GetGBufferLine(y, &gbufferLine[0], 0, width, g_objManager.scnData.m_shadowCatchers);
+    const size_t offset = size_t(y)*size_t(width);
+    int32_t*     outLine = imageLDR.data() + offset;
 
-    if (lname == L"depth")
-      //ExtractDepthLine(&gbufferLine[0], &imageLDR[y*width], width, dmin, dmax);
-      ExtractDepthLineU16(&gbufferLine[0], &imageU16[y*width], width, dmin, dmax);
+    if (isDepth)
+      ExtractDepthLineU16(planes.depth + offset, planes.matId + offset, imageU16 + offset, width, dmin, dmax);
     else if (lname == L"normals")
-      ExtractNormalsLine(&gbufferLine[0], &imageLDR[y*width], width);
+      ExtractNormalsLine(planes.norm[0] + offset, planes.norm[1] + offset, planes.norm[2] + offset, outLine, width);
     else if (lname == L"texcoord")
-      ExtractTexCoordLine(&gbufferLine[0], &imageLDR[y*width], width);
+      ExtractTexCoordLine(planes.texc[0] + offset, planes.texc[1] + offset, outLine, width);
     else if (lname == L"diffcolor")
-      ExtractTexColorLine(&gbufferLine[0], &imageLDR[y*width], width);
+      ExtractTexColorLine(planes.rgba[0] + offset, planes.rgba[1] + offset, planes.rgba[2] + offset, outLine, width);
     else if (lname == L"alpha")
-      ExtractAlphaLine(&gbufferLine[0], &imageLDR[y*width], width);
+      ExtractGreyLine(planes.rgba[3] + offset, outLine, width);
     else if (lname == L"shadow")
-      ExtractShadowLine(&gbufferLine[0], &imageLDR[y*width], width);
-    else if (lname == L"matid" || lname == L"mid" || lname == L"catcher")
-      ExtractMaterialId(&gbufferLine[0], &imageLDR[y*width], width);
-    else if (lname == L"objid")
-      ExtractObjId(&gbufferLine[0], &imageLDR[y*width], width);
-    else if (lname == L"instid" || lname == L"scnsid" || lname == L"scnid")
-      ExtractInstId(&gbufferLine[0], &imageLDR[y*width], width);
+      ExtractGreyLine(planes.shadow + offset, outLine, width);
     else if (lname == L"coverage")
-      ExtractCoverage(&gbufferLine[0], &imageLDR[y*width], width);
-
+      ExtractGreyLine(planes.coverage + offset, outLine, width);
+    else if (lname == L"matid" || lname == L"mid")
+      ExtractMaterialId(planes.matId + offset, planes.instId + offset, outLine, width);
+    else if (lname == L"objid")
+      memcpy(outLine, planes.objId + offset, width*sizeof(int32_t));
+    else if (lname == L"instid" || isScnLayer)
+      memcpy(outLine, planes.instId + offset, width*sizeof(int32_t));
 
-    if (lname == L"matid" || lname == L"mid" || lname == L"objid" || lname == L"instid")
+    if (isIdLayer)
     {
-      auto* line = (unsigned int*)&imageLDR[y*width];
+      auto* line = (unsigned int*)outLine;
       for (int x = 0; x < width; x++)
       {
         const int index = line[x];
@@ -354,30 +397,29 @@ HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_ou
           line[x] = palette[index % paletteSize];
       }
     }
-
-    else if (lname == L"scnsid" || lname == L"scnid")
+    else if (isScnLayer)
     {
-      auto* line = (unsigned int*)&imageLDR[y*width];
+      auto* line = (unsigned int*)outLine;
       for (int x = 0; x < width; x++)
       {
         const int index = line[x];
-        if (index < 0)
+        if (index < 0 || index >= int(instanceIdToScnId.size())) // can't throw from parallel loop
           line[x] = 0;
         else
         {
-          int new_index = instanceIdToScnId.at(index);
+          int new_index = instanceIdToScnId[index];
           line[x] = palette[new_index % paletteSize];
         }
       }
     }
     else if(lname == L"catcher")
     {
-      auto* line = (unsigned int*)&imageLDR[y*width];
+      auto* line = (unsigned int*)outLine;
       for (int x = 0; x < width; x++)
       {
-        const int index = gbufferLine[x].matId;// & 0x00FFFFFF;
+        const int index = planes.matId[offset + x];// & 0x00FFFFFF;
 
-        if (g_objManager.scnData.m_shadowCatchers.find(index) != g_objManager.scnData.m_shadowCatchers.end())
+        if (shadowCatchers.find(index) != shadowCatchers.end())
           line[x] = 0x00FFFFFF;
         else
           line[x] = 0;
@@ -385,9 +427,7 @@ HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_ou
     }
   }
 
-  hrRenderUnlockFrameBufferUpdate(a_pRender);
-
-  if (lname == L"depth")
+  if (isDepth)
     g_objManager.m_pImgTool->Save16BitMonoImageTo16BitPNG(a_outFileName, width, height, imageU16);
   else
     g_objManager.m_pImgTool->SaveLDRImageToFileLDR(a_outFileName, width, height, imageLDR.data());
@@ -397,6 +437,7 @@ HAPI bool hrRenderSaveGBufferLayerLDR(HRRenderRef a_pRender, const wchar_t* a_ou
 
 bool HRUtils::hrRenderSaveDepthRaw(HRRenderRef a_pRender, const wchar_t* a_outFileName)
 {
+  int width = 0, height = 0;
   HRRender* pRender = g_objManager.PtrById(a_pRender);
 
   if (pRender == nullptr)
@@ -405,44 +446,20 @@ bool HRUtils::hrRenderSaveDepthRaw(HRRenderRef a_pRender, const wchar_t* a_outFi
     return false;
   }
 
-  auto pDriver = pRender->m_pDriver;
-  if (pDriver == nullptr)
-    return false;
-
   auto renderSettingsNode = pRender->xml_node();
+  width  = std::max(renderSettingsNode.child(L"width").text().as_int(),  0);
+  height = std::max(renderSettingsNode.child(L"height").text().as_int(), 0);
 
-  const int width     = renderSettingsNode.child(L"width").text().as_int();
-  const int height    = renderSettingsNode.child(L"height").text().as_int();
-  const int evalgbuff = renderSettingsNode.child(L"evalgbuffer").text().as_int();
+  std::vector<float> rawDepth(size_t(width)*size_t(height));
 
-  if (evalgbuff != 1)
-  {
-    HrError(L"hrRenderSaveGBufferLayerLDR: don't have gbuffer; set 'evalgbuffer' = 1 and render again; ");
-    return false;
-  }
+  HRGBufferPlanes planes;
+  planes.depth = rawDepth.data();
 
-  std::vector<float>          rawDepth(width * height);
-  std::vector<HRGBufferPixel> gbufferLine(width);
+  if (!GetGBufferFromDriver(a_pRender, planes, L"hrRenderSaveDepthRaw"))
+    return false;
 
   float* data = rawDepth.data();
 
-  for (int y = 0; y < height; y++)
-  {
-    pDriver->GetGBufferLine(y, &gbufferLine[0], 0, width, g_objManager.scnData.m_shadowCatchers);
-    for (int x = 0; x < width; x++)
-    {
-      const float d = gbufferLine[x].depth;
-
-      float res[4];
-      res[0] = d;
-      res[1] = d;
-      res[2] = d;
-      res[3] = 1.0f;
-
-      data[y * width + x] = d;
-    }
-  }
-
   std::wstring s1(a_outFileName);
   std::string  s2(s1.begin(), s1.end());
   std::ofstream fout(s2.c_str(), std::ios::out | std::ios::binary);
@@ -484,7 +484,9 @@ void OpenHRMesh(HRMesh* pMesh, pugi::xml_node nodeXml)
   if(chunkId != size_t(-1))
     chunk   = g_objManager.scnData.m_vbCache.chunk_at(chunkId);
 
-  if (chunk.InMemory() && chunkId != size_t(-1))
+  ChunkPin chunkData(g_objManager.scnData.m_vbCache, size_t(chunkId)); // chunk is paged in if it was evicted and is kept in place while arrays are read
+
+  if (chunkId != size_t(-1) && chunkData.data() != nullptr)
   {
     // (1) read common mesh attributes
     //
@@ -1452,6 +1454,8 @@ HAPI void hrMeshSaveVSGF(HRMeshRef a_meshRef, const wchar_t* a_fileName)
     return;
   }
 
+  ChunkPin meshData(g_objManager.scnData.m_vbCache, size_t(pMesh->pImpl->chunkId()));
+
   if(pMesh->pImpl->DataSizeInBytes() == 0 || pMesh->pImpl->GetData() == 0)
   {
     HrError(L"hrMeshSaveVSGF: mesh data in not avaliable; meshId = ", a_meshRef.id);
@@ -1527,6 +1531,8 @@ HAPI void hrMeshSaveVSGFCompressed(HRMeshRef a_meshRef, const wchar_t* a_fileNam
   PrintMaterialListNames(strOut, pMesh);
   std::string matnames = strOut.str();
 
+  ChunkPin meshData(g_objManager.scnData.m_vbCache, size_t(pMesh->pImpl->chunkId()));
+
   if(pMesh->pImpl->DataSizeInBytes() == 0 || pMesh->pImpl->GetData() == 0)
   {
     HrError(L"hrMeshSaveVSGFCompressed: mesh data in not avaliable; meshId = ", a_meshRef.id);
@@ -20,6 +20,8 @@
 #include <cmath>
 #include <random>
 
+#include <omp.h>
+
 using std::isnan;
 using std::isinf;
 
@@ -299,36 +301,150 @@ float smoothing_coeff(uint32_t valence)
   return (4.0f - 2.0f * cosf((2.0f * 3.14159265358979323846f) / valence )) / 9.0f;
 }
 
-std::vector<uint32_t> find_vertex_neighbours(int vertex_index, const HRMesh::InputTriMesh& mesh)
+// Triangle mesh adjacency.
+//
+// Half-edge h = 3*face + k goes from triIndices[h] to triIndices[3*face + (k+1)%3]. twin[h] is the opposite half-edge of the same
+// edge in other triangle, -1 for boundary edges and -2 for edges shared by more than two triangles. Vertex one-rings are stored
+// in CSR form (neighbOffsets/neighbours) and sorted by vertex index. Everything is built in linear time with counting sort:
+// the structure is built once per subdivision step and shared by face point, edge and smoothing passes.
+//
+struct MeshTopology
 {
-  std::set<uint32_t> neighbours;
-  for(int i = 0; i < mesh.triIndices.size(); i += 3)
+  std::vector<int32_t>  twin;
+  std::vector<uint32_t> neighbOffsets; ///< size of vertNum + 1
+  std::vector<uint32_t> neighbours;
+
+  uint32_t valence(uint32_t v) const { return neighbOffsets[v + 1] - neighbOffsets[v]; }
+
+  void Build(const std::vector<uint32_t>& a_triIndices, uint32_t a_vertNum);
+};
+
+void MeshTopology::Build(const std::vector<uint32_t>& a_triIndices, uint32_t a_vertNum)
+{
+  const int halfNum = int(a_triIndices.size() / 3) * 3;
+
+  // (1) bucket half-edges by their smaller vertex
+  //
+  std::vector<uint32_t> bucketOffsets(a_vertNum + 1, 0);
+  for (int h = 0; h < halfNum; h++)
   {
-    uint32_t indA = mesh.triIndices[i + 0];
-    uint32_t indB = mesh.triIndices[i + 1];
-    uint32_t indC = mesh.triIndices[i + 2];
+    const uint32_t a = a_triIndices[h];
+    const uint32_t b = a_triIndices[(h % 3 == 2) ? h - 2 : h + 1];
+    bucketOffsets[std::min(a, b) + 1]++;
+  }
+  for (uint32_t v = 0; v < a_vertNum; v++)
+    bucketOffsets[v + 1] += bucketOffsets[v];
 
-    if(vertex_index == indA)
+  std::vector<uint32_t> buckets(halfNum);
+  {
+    std::vector<uint32_t> pos(bucketOffsets.begin(), bucketOffsets.end() - 1);
+    for (int h = 0; h < halfNum; h++)
     {
-      neighbours.insert(indB);
-      neighbours.insert(indB);
-      neighbours.insert(indC);
+      const uint32_t a = a_triIndices[h];
+      const uint32_t b = a_triIndices[(h % 3 == 2) ? h - 2 : h + 1];
+      buckets[pos[std::min(a, b)]++] = uint32_t(h);
     }
-    else if(vertex_index == indB)
+  }
+
+  // (2) match half-edges with equal larger vertex inside each bucket; buckets are small and independent
+  //
+  twin.assign(halfNum, -1);
+
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for (int v = 0; v < int(a_vertNum); v++)
+  {
+    const uint32_t begin = bucketOffsets[v];
+    const uint32_t end   = bucketOffsets[v + 1];
+    for (uint32_t i = begin; i < end; i++)
     {
-      neighbours.insert(indA);
-      neighbours.insert(indC);
+      const uint32_t h = buckets[i];
+      if (twin[h] != -1)
+        continue;
+
+      const uint32_t a  = a_triIndices[h];
+      const uint32_t b  = a_triIndices[(h % 3 == 2) ? h - 2 : h + 1];
+      const uint32_t hi = std::max(a, b);
+
+      int32_t other   = -1;
+      int     matches = 0;
+      for (uint32_t j = i + 1; j < end; j++)
+      {
+        const uint32_t h2 = buckets[j];
+        const uint32_t a2 = a_triIndices[h2];
+        const uint32_t b2 = a_triIndices[(h2 % 3 == 2) ? h2 - 2 : h2 + 1];
+        if (std::max(a2, b2) == hi && twin[h2] == -1)
+        {
+          other = int32_t(h2);
+          matches++;
+        }
+      }
+
+      if (matches == 1)
+      {
+        twin[h]     = other;
+        twin[other] = int32_t(h);
+      }
+      else if (matches > 1)
+      {
+        twin[h] = -2;
+        for (uint32_t j = i + 1; j < end; j++)
+        {
+          const uint32_t h2 = buckets[j];
+          const uint32_t a2 = a_triIndices[h2];
+          const uint32_t b2 = a_triIndices[(h2 % 3 == 2) ? h2 - 2 : h2 + 1];
+          if (std::max(a2, b2) == hi)
+            twin[h2] = -2;
+        }
+      }
     }
-    else if(vertex_index == indC)
+  }
+
+  // (3) vertex one-rings: every half-edge adds both of its vertices to each other, then sort and remove duplicates
+  //
+  std::vector<uint32_t> ringOffsets(a_vertNum + 1, 0);
+  for (int h = 0; h < halfNum; h++)
+  {
+    const uint32_t a = a_triIndices[h];
+    const uint32_t b = a_triIndices[(h % 3 == 2) ? h - 2 : h + 1];
+    ringOffsets[a + 1]++;
+    ringOffsets[b + 1]++;
+  }
+  for (uint32_t v = 0; v < a_vertNum; v++)
+    ringOffsets[v + 1] += ringOffsets[v];
+
+  std::vector<uint32_t> ring(ringOffsets[a_vertNum]);
+  {
+    std::vector<uint32_t> pos(ringOffsets.begin(), ringOffsets.end() - 1);
+    for (int h = 0; h < halfNum; h++)
     {
-      neighbours.insert(indA);
-      neighbours.insert(indB);
+      const uint32_t a = a_triIndices[h];
+      const uint32_t b = a_triIndices[(h % 3 == 2) ? h - 2 : h + 1];
+      ring[pos[a]++] = b;
+      ring[pos[b]++] = a;
     }
   }
-  std::vector<uint32_t> res;
-  res.assign(neighbours.begin(), neighbours.end());
 
-  return res;
+  std::vector<uint32_t> uniqueNum(a_vertNum, 0);
+
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for (int v = 0; v < int(a_vertNum); v++)
+  {
+    uint32_t* begin = ring.data() + ringOffsets[v];
+    uint32_t* end   = ring.data() + ringOffsets[v + 1];
+    std::sort(begin, end);
+    uniqueNum[v] = uint32_t(std::unique(begin, end) - begin);
+  }
+
+  neighbOffsets.resize(a_vertNum + 1);
+  neighbOffsets[0] = 0;
+  for (uint32_t v = 0; v < a_vertNum; v++)
+    neighbOffsets[v + 1] = neighbOffsets[v] + uniqueNum[v];
+
+  neighbours.resize(neighbOffsets[a_vertNum]);
+
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for (int v = 0; v < int(a_vertNum); v++)
+    std::copy(ring.data() + ringOffsets[v], ring.data() + ringOffsets[v] + uniqueNum[v], neighbours.data() + neighbOffsets[v]);
 }
 
 float4 vertex_attrib_by_index_f4(const std::string &attrib_name, uint32_t vertex_index, const HRMesh::InputTriMesh& mesh)
@@ -378,16 +494,25 @@ void update_vertex_attrib_by_index_f2(float2 new_val, uint32_t vertex_index, std
   attrib_vec.at(vertex_index * 2 + 1) = new_val.y;
 }
 
-void smooth_common_vertex_attributes(uint32_t vertex_index, const HRMesh::InputTriMesh& mesh, float4 &pos, float4 &normal,
-                                     float4 &tangent, float2 &uv)
+static inline float4 load_f4(const std::vector<float>& a_attrib, uint32_t a_index)
 {
-  auto neighbours  = find_vertex_neighbours(vertex_index, mesh);
-  uint32_t valence = uint32_t(neighbours.size());
+  return float4(a_attrib[a_index * 4 + 0], a_attrib[a_index * 4 + 1], a_attrib[a_index * 4 + 2], a_attrib[a_index * 4 + 3]);
+}
 
-  pos      = vertex_attrib_by_index_f4("pos", vertex_index, mesh);
-  normal   = vertex_attrib_by_index_f4("normal", vertex_index, mesh);
-  tangent  = vertex_attrib_by_index_f4("tangent", vertex_index, mesh);
-  uv       = vertex_attrib_by_index_f2("uv", vertex_index, mesh);
+static inline float2 load_f2(const std::vector<float>& a_attrib, uint32_t a_index)
+{
+  return float2(a_attrib[a_index * 2 + 0], a_attrib[a_index * 2 + 1]);
+}
+
+void smooth_common_vertex_attributes(uint32_t vertex_index, const HRMesh::InputTriMesh& mesh, const MeshTopology& topo,
+                                     float4 &pos, float4 &normal, float4 &tangent, float2 &uv)
+{
+  const uint32_t valence = topo.valence(vertex_index);
+
+  pos      = load_f4(mesh.verticesPos, vertex_index);
+  normal   = load_f4(mesh.verticesNorm, vertex_index);
+  tangent  = load_f4(mesh.verticesTangent, vertex_index);
+  uv       = load_f2(mesh.verticesTexCoord, vertex_index);
 
   //only handle ordinary vertices for now
   if(valence == 6)
@@ -397,17 +522,14 @@ void smooth_common_vertex_attributes(uint32_t vertex_index, const HRMesh::InputT
     float4 tangent_;
     float2 uv_;
 
-    for (const auto &n : neighbours)
+    for (uint32_t i = topo.neighbOffsets[vertex_index]; i < topo.neighbOffsets[vertex_index + 1]; i++)
     {
-      float4 pos_n = vertex_attrib_by_index_f4("pos", n, mesh);
-      float4 norm_n = vertex_attrib_by_index_f4("normal", n, mesh);
-      float4 tan_n = vertex_attrib_by_index_f4("tangent", n, mesh);
-      float2 uv_n = vertex_attrib_by_index_f2("uv", n, mesh);
-
-      pos_ += pos_n;
-      norm_ += norm_n;
-      tangent_ += tan_n;
-      uv_ += uv_n;
+      const uint32_t n = topo.neighbours[i];
+
+      pos_     += load_f4(mesh.verticesPos, n);
+      norm_    += load_f4(mesh.verticesNorm, n);
+      tangent_ += load_f4(mesh.verticesTangent, n);
+      uv_      += load_f2(mesh.verticesTexCoord, n);
     }
 
     float alpha = smoothing_coeff(valence);
@@ -419,24 +541,40 @@ void smooth_common_vertex_attributes(uint32_t vertex_index, const HRMesh::InputT
   }
 }
 
-
-void addEdge(uint32_t indA, uint32_t indB, uint32_t faceInd, std::unordered_map<uint2, std::vector<uint32_t>, uint2_hash> &edgeToTris)
+// append face centers as new vertices oldVertNum + face; faces are independent, so they are computed in parallel
+//
+static void AppendFacePoints(HRMesh::InputTriMesh& mesh)
 {
-  uint2 edge1(indA, indB);
-  uint2 edge2(indB, indA);
+  const uint32_t oldVertNum = uint32_t(mesh.verticesPos.size() / 4);
+  const int      triNum     = int(mesh.triIndices.size() / 3);
+  const size_t   newVertNum = size_t(oldVertNum) + size_t(triNum);
 
-  if(edgeToTris.find(edge1) != edgeToTris.end())
-  {
-    edgeToTris[edge1].push_back(faceInd);
-  }
-  else if(edgeToTris.find(edge2) != edgeToTris.end())
-  {
-    edgeToTris[edge2].push_back(faceInd);
-  }
-  else
+  mesh.verticesPos.resize(newVertNum * 4);
+  mesh.verticesNorm.resize(newVertNum * 4);
+  mesh.verticesTangent.resize(newVertNum * 4);
+  mesh.verticesTexCoord.resize(newVertNum * 2);
+
+  #pragma omp parallel for
+  for (int face = 0; face < triNum; face++)
   {
-    std::vector<uint32_t> tmp = {faceInd};
-    edgeToTris[edge1] = tmp;
+    const uint32_t indA = mesh.triIndices[face * 3 + 0];
+    const uint32_t indB = mesh.triIndices[face * 3 + 1];
+    const uint32_t indC = mesh.triIndices[face * 3 + 2];
+
+    float4 P     = (load_f4(mesh.verticesPos, indA)     + load_f4(mesh.verticesPos, indB)     + load_f4(mesh.verticesPos, indC)) / 3.0f;
+    float4 PNorm = (load_f4(mesh.verticesNorm, indA)    + load_f4(mesh.verticesNorm, indB)    + load_f4(mesh.verticesNorm, indC)) / 3.0f;
+    float4 PTan  = (load_f4(mesh.verticesTangent, indA) + load_f4(mesh.verticesTangent, indB) + load_f4(mesh.verticesTangent, indC)) / 3.0f;
+    float2 Puv   = (load_f2(mesh.verticesTexCoord, indA) + load_f2(mesh.verticesTexCoord, indB) + load_f2(mesh.verticesTexCoord, indC)) / 3.0f;
+
+    float3 PNorm3 = normalize(make_float3(PNorm.x, PNorm.y, PNorm.z));
+    PNorm.x = PNorm3.x;
+    PNorm.y = PNorm3.y;
+
+    const size_t indP = size_t(oldVertNum) + size_t(face);
+    update_vertex_attrib_by_index_f4(P,     uint32_t(indP), mesh.verticesPos);
+    update_vertex_attrib_by_index_f4(PNorm, uint32_t(indP), mesh.verticesNorm);
+    update_vertex_attrib_by_index_f4(PTan,  uint32_t(indP), mesh.verticesTangent);
+    update_vertex_attrib_by_index_f2(Puv,   uint32_t(indP), mesh.verticesTexCoord);
   }
 }
 
@@ -452,124 +590,92 @@ void hrMeshSubdivideSqrt3(HRMeshRef a_mesh, int a_iterations)
 
   HRMesh::InputTriMesh &mesh = pMesh->m_input;
 
+  MeshTopology topo;
+
   for(int i = 0; i < a_iterations; ++i)
   {
-
     const auto old_vertex_count = uint32_t(mesh.verticesPos.size() / 4);
-    const auto old_tri_count = uint32_t(mesh.triIndices.size() / 3);
-
-    std::vector<uint32_t> indices;
-    indices.reserve(mesh.triIndices.size() * 3);
-    std::vector<uint32_t> mat_indices;
-    mat_indices.reserve(mesh.triIndices.size() * 3 / 3);
+    const auto old_tri_count    = int(mesh.triIndices.size() / 3);
 
-    std::unordered_map<uint2, std::vector<uint32_t>, uint2_hash> edgeToTris;
+    topo.Build(mesh.triIndices, old_vertex_count);
 
-    uint32_t face_num = 0;
     //insert middle point
-    for (int j = 0; j < mesh.triIndices.size(); j += 3)
+    AppendFacePoints(mesh);
+
+    //flip edges; every edge is emitted by its first half-edge: interior edges give 2 triangles, boundary edges give 1,
+    //edges of more than 2 triangles are dropped
+    std::vector<uint32_t> faceOffsets(old_tri_count + 1, 0);
+    for (int face = 0; face < old_tri_count; face++)
     {
-      uint32_t indA = mesh.triIndices[j + 0];
-      uint32_t indB = mesh.triIndices[j + 1];
-      uint32_t indC = mesh.triIndices[j + 2];
-
-      addEdge(indA, indB, face_num, edgeToTris);
-      addEdge(indB, indC, face_num, edgeToTris);
-      addEdge(indC, indA, face_num, edgeToTris);
-
-
-      float4 A = vertex_attrib_by_index_f4("pos", indA, mesh);
-      float4 B = vertex_attrib_by_index_f4("pos", indB, mesh);
-      float4 C = vertex_attrib_by_index_f4("pos", indC, mesh);
-
-      float4 ANorm = vertex_attrib_by_index_f4("normal", indA, mesh);
-      float4 BNorm = vertex_attrib_by_index_f4("normal", indB, mesh);
-      float4 CNorm = vertex_attrib_by_index_f4("normal", indC, mesh);
-
-      float4 ATan = vertex_attrib_by_index_f4("tangent", indA, mesh);
-      float4 BTan = vertex_attrib_by_index_f4("tangent", indB, mesh);
-      float4 CTan = vertex_attrib_by_index_f4("tangent", indC, mesh);
-
-      float2 Auv = vertex_attrib_by_index_f2("uv", indA, mesh);
-      float2 Buv = vertex_attrib_by_index_f2("uv", indB, mesh);
-      float2 Cuv = vertex_attrib_by_index_f2("uv", indC, mesh);
-
-      float4 P = (A + B + C) / 3.0f;
-      float4 PNorm = (ANorm + BNorm + CNorm) / 3.0f;
-      float3 PNorm3 = normalize(make_float3(PNorm.x, PNorm.y, PNorm.z));
-      PNorm.x = PNorm3.x;
-      PNorm.y = PNorm3.y;
-      PNorm.z = PNorm.z;
-      float4 PTan = (ATan + BTan + CTan) / 3.0f;
-      float2 Puv = (Auv + Buv + Cuv) / 3.0f;
-
-      uint32_t indP = uint32_t(mesh.verticesPos.size() / 4);
-      mesh.verticesPos.push_back(P.x);
-      mesh.verticesPos.push_back(P.y);
-      mesh.verticesPos.push_back(P.z);
-      mesh.verticesPos.push_back(P.w);
-
-      mesh.verticesNorm.push_back(PNorm.x);
-      mesh.verticesNorm.push_back(PNorm.y);
-      mesh.verticesNorm.push_back(PNorm.z);
-      mesh.verticesNorm.push_back(PNorm.w);
-
-      mesh.verticesTangent.push_back(PTan.x);
-      mesh.verticesTangent.push_back(PTan.y);
-      mesh.verticesTangent.push_back(PTan.z);
-      mesh.verticesTangent.push_back(PTan.w);
-
-      mesh.verticesTexCoord.push_back(Puv.x);
-      mesh.verticesTexCoord.push_back(Puv.y);
-
-      face_num++;
+      uint32_t newTris = 0;
+      for (int k = 0; k < 3; k++)
+      {
+        const int32_t h    = face * 3 + k;
+        const int32_t twin = topo.twin[h];
+        newTris += (twin == -1) ? 1 : ((twin > h) ? 2 : 0);
+      }
+      faceOffsets[face + 1] = faceOffsets[face] + newTris;
     }
 
-    //flip edges
-    for (const auto &edge : edgeToTris)
+    std::vector<uint32_t> indices(faceOffsets[old_tri_count] * 3);
+    std::vector<uint32_t> mat_indices(faceOffsets[old_tri_count]);
+
+    #pragma omp parallel for
+    for (int face = 0; face < old_tri_count; face++)
     {
-      if (edge.second.size() == 2)
-      {
-        uint32_t center1 = (old_vertex_count + edge.second[0]);
-        uint32_t center2 = (old_vertex_count + edge.second[1]);
-        uint32_t A = edge.first.x;
-        uint32_t B = edge.first.y;
-
-        indices.push_back(center1);
-        indices.push_back(center2);
-        indices.push_back(B);
-        mat_indices.push_back(mesh.matIndices[edge.second[0]]);
-
-        indices.push_back(center2);
-        indices.push_back(center1);
-        indices.push_back(A);
-        mat_indices.push_back(mesh.matIndices[edge.second[1]]);
-      } else if (edge.second.size() == 1)
+      uint32_t outTri = faceOffsets[face];
+      for (int k = 0; k < 3; k++)
       {
-        uint32_t center = (old_vertex_count + edge.second[0]);
-        uint32_t A = edge.first.x;
-        uint32_t B = edge.first.y;
-
-        indices.push_back(center);
-        indices.push_back(A);
-        indices.push_back(B);
-        mat_indices.push_back(mesh.matIndices[edge.second[0]]);
+        const int32_t  h    = face * 3 + k;
+        const int32_t  twin = topo.twin[h];
+        const uint32_t A    = mesh.triIndices[h];
+        const uint32_t B    = mesh.triIndices[(k == 2) ? h - 2 : h + 1];
+
+        if (twin > h)
+        {
+          uint32_t center1 = (old_vertex_count + uint32_t(face));
+          uint32_t center2 = (old_vertex_count + uint32_t(twin / 3));
+
+          indices[outTri * 3 + 0] = center1;
+          indices[outTri * 3 + 1] = center2;
+          indices[outTri * 3 + 2] = B;
+          mat_indices[outTri]     = mesh.matIndices[face];
+          outTri++;
+
+          indices[outTri * 3 + 0] = center2;
+          indices[outTri * 3 + 1] = center1;
+          indices[outTri * 3 + 2] = A;
+          mat_indices[outTri]     = mesh.matIndices[twin / 3];
+          outTri++;
+        }
+        else if (twin == -1)
+        {
+          uint32_t center = (old_vertex_count + uint32_t(face));
+
+          indices[outTri * 3 + 0] = center;
+          indices[outTri * 3 + 1] = A;
+          indices[outTri * 3 + 2] = B;
+          mat_indices[outTri]     = mesh.matIndices[face];
+          outTri++;
+        }
       }
     }
 
+    //smooth old vertices with the one-rings of the old triangles
     std::vector<float> pos_new(old_vertex_count * 4, 0.0f);
     std::vector<float> normal_new(old_vertex_count * 4, 0.0f);
     std::vector<float> tangent_new(old_vertex_count * 4, 0.0f);
     std::vector<float> uv_new(old_vertex_count * 2, 0.0f);
 
-    for (uint32_t k = 0; k < old_vertex_count; ++k)
+    #pragma omp parallel for
+    for (int k = 0; k < int(old_vertex_count); ++k)
     {
       float4 pos;
       float4 normal;
       float4 tangent;
       float2 uv;
 
-      smooth_common_vertex_attributes(k, mesh, pos, normal, tangent, uv);
+      smooth_common_vertex_attributes(uint32_t(k), mesh, topo, pos, normal, tangent, uv);
 
       update_vertex_attrib_by_index_f4(pos, k, pos_new);
       update_vertex_attrib_by_index_f4(normal, k, normal_new);
@@ -577,18 +683,13 @@ void hrMeshSubdivideSqrt3(HRMeshRef a_mesh, int a_iterations)
       update_vertex_attrib_by_index_f2(uv, k, uv_new);
     }
 
-    for (uint32_t ii = 0; ii < pos_new.size(); ++ii)
-    {
-      mesh.verticesPos.at(ii)     = pos_new.at(ii);
-      mesh.verticesNorm.at(ii)    = normal_new.at(ii);
-      mesh.verticesTangent.at(ii) = tangent_new.at(ii);
-
-      if (ii < pos_new.size() / 2)
-        mesh.verticesTexCoord.at(ii) = uv_new.at(ii);
-    }
+    std::copy(pos_new.begin(),     pos_new.end(),     mesh.verticesPos.begin());
+    std::copy(normal_new.begin(),  normal_new.end(),  mesh.verticesNorm.begin());
+    std::copy(tangent_new.begin(), tangent_new.end(), mesh.verticesTangent.begin());
+    std::copy(uv_new.begin(),      uv_new.end(),      mesh.verticesTexCoord.begin());
 
-    mesh.triIndices = indices;
-    mesh.matIndices = mat_indices;
+    mesh.triIndices = std::move(indices);
+    mesh.matIndices = std::move(mat_indices);
   }
 }
 
@@ -603,75 +704,39 @@ void hrMeshSubdivide(HRMeshRef a_mesh, int a_iterations)
 
   HRMesh::InputTriMesh &mesh = pMesh->m_input;
 
-//  const auto vertexCount = int(mesh.verticesPos.size() / 4);
-//  const auto triangleCount = int(mesh.triIndices.size() / 3);
-
-  std::vector<uint32_t> indices;
-  indices.reserve(mesh.triIndices.size() * 3);
-  std::vector<uint32_t> mat_indices;
-  mat_indices.reserve(mesh.triIndices.size() * 3 / 3);
-
-  int face_num = 0;
-  for(int i = 0; i < mesh.triIndices.size(); i += 3)
+  // 1 --> 3 split does not need adjacency: face points and new triangles of each face are independent
+  //
+  for(int iter = 0; iter < a_iterations; iter++)
   {
-    uint32_t indA = mesh.triIndices[i + 0];
-    uint32_t indB = mesh.triIndices[i + 1];
-    uint32_t indC = mesh.triIndices[i + 2];
-
-    float4 A = vertex_attrib_by_index_f4("pos", indA, mesh);
-    float4 B = vertex_attrib_by_index_f4("pos", indB, mesh);
-    float4 C = vertex_attrib_by_index_f4("pos", indC, mesh);
-
-    float4 ANorm = vertex_attrib_by_index_f4("normal", indA, mesh);
-    float4 BNorm = vertex_attrib_by_index_f4("normal", indB, mesh);
-    float4 CNorm = vertex_attrib_by_index_f4("normal", indC, mesh);
-
-    float4 ATan = vertex_attrib_by_index_f4("tangent", indA, mesh);
-    float4 BTan = vertex_attrib_by_index_f4("tangent", indB, mesh);
-    float4 CTan = vertex_attrib_by_index_f4("tangent", indC, mesh);
-
-    float2 Auv = vertex_attrib_by_index_f2("uv", indA, mesh);
-    float2 Buv = vertex_attrib_by_index_f2("uv", indB, mesh);
-    float2 Cuv = vertex_attrib_by_index_f2("uv", indC, mesh);
-
-    float4 P = (A + B + C) / 3.0f;
-    float4 PNorm = (ANorm + BNorm + CNorm) / 3.0f;
-    float3 PNorm3 = normalize(make_float3(PNorm.x, PNorm.y, PNorm.z));
-    PNorm.x = PNorm3.x; PNorm.y = PNorm3.y; PNorm.z = PNorm.z;
-    float4 PTan = (ATan + BTan + CTan) / 3.0f;
-    float2 Puv = (Auv + Buv + Cuv) / 3.0f;
-
-    uint32_t indP = uint32_t(mesh.verticesPos.size() / 4);
-    mesh.verticesPos.push_back(P.x);
-    mesh.verticesPos.push_back(P.y);
-    mesh.verticesPos.push_back(P.z);
-    mesh.verticesPos.push_back(P.w);
-
-    mesh.verticesNorm.push_back(PNorm.x);
-    mesh.verticesNorm.push_back(PNorm.y);
-    mesh.verticesNorm.push_back(PNorm.z);
-    mesh.verticesNorm.push_back(PNorm.w);
+    const auto old_vertex_count = uint32_t(mesh.verticesPos.size() / 4);
+    const auto old_tri_count    = int(mesh.triIndices.size() / 3);
 
-    mesh.verticesTangent.push_back(PTan.x);
-    mesh.verticesTangent.push_back(PTan.y);
-    mesh.verticesTangent.push_back(PTan.z);
-    mesh.verticesTangent.push_back(PTan.w);
+    AppendFacePoints(mesh);
 
-    mesh.verticesTexCoord.push_back(Puv.x);
-    mesh.verticesTexCoord.push_back(Puv.y);
+    std::vector<uint32_t> indices(size_t(old_tri_count) * 9);
+    std::vector<uint32_t> mat_indices(size_t(old_tri_count) * 3);
 
-    indices.push_back(indA); indices.push_back(indB); indices.push_back(indP);
-    mat_indices.push_back(mesh.matIndices[face_num]);
-    indices.push_back(indB); indices.push_back(indC); indices.push_back(indP);
-    mat_indices.push_back(mesh.matIndices[face_num]);
-    indices.push_back(indC); indices.push_back(indA); indices.push_back(indP);
-    mat_indices.push_back(mesh.matIndices[face_num]);
+    #pragma omp parallel for
+    for(int face = 0; face < old_tri_count; face++)
+    {
+      const uint32_t indA = mesh.triIndices[face * 3 + 0];
+      const uint32_t indB = mesh.triIndices[face * 3 + 1];
+      const uint32_t indC = mesh.triIndices[face * 3 + 2];
+      const uint32_t indP = old_vertex_count + uint32_t(face);
+
+      uint32_t* out = indices.data() + size_t(face) * 9;
+      out[0] = indA; out[1] = indB; out[2] = indP;
+      out[3] = indB; out[4] = indC; out[5] = indP;
+      out[6] = indC; out[7] = indA; out[8] = indP;
+
+      mat_indices[face * 3 + 0] = mesh.matIndices[face];
+      mat_indices[face * 3 + 1] = mesh.matIndices[face];
+      mat_indices[face * 3 + 2] = mesh.matIndices[face];
+    }
 
-    face_num++;
+    mesh.triIndices = std::move(indices);
+    mesh.matIndices = std::move(mat_indices);
   }
-
-  mesh.triIndices = indices;
-  mesh.matIndices = mat_indices;
 }
 
 void displaceByNoise(HRMesh *pMesh, const pugi::xml_node &noiseXMLNode, std::vector<uint3> &triangleList)
@@ -830,27 +895,30 @@ void displaceByHeightMap(HRMesh *pMesh, const pugi::xml_node &heightXMLNode, std
     HRTextureNodeRef texRef;
     texRef.id = texNode.attribute(L"id").as_int();
 
-    hrTexture2DGetSize(texRef, &w, &h, &bpp);
-    if(bpp > 4)
+    #pragma omp critical(hr_displace_textures) // meshes are displaced in parallel by HR_PreprocessMeshes; texture API is not thread safe
     {
-      isHDR = true;
-      imageDataHDR.resize(w * h * 4);
-      hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+      hrTexture2DGetSize(texRef, &w, &h, &bpp);
+      if(bpp > 4)
       {
-        hrTexture2DGetDataHDR(texRef, &w, &h, &imageDataHDR[0]);
+        isHDR = true;
+        imageDataHDR.resize(w * h * 4);
+        hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+        {
+          hrTexture2DGetDataHDR(texRef, &w, &h, &imageDataHDR[0]);
+        }
+        hrTextureNodeClose(texRef);
       }
-      hrTextureNodeClose(texRef);
-    }
-    else
-    {
-      isLDR = true;
-      imageDataLDR.resize(w * h);
-
-      hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+      else
       {
-        hrTexture2DGetDataLDR(texRef, &w, &h, &imageDataLDR[0]);
+        isLDR = true;
+        imageDataLDR.resize(w * h);
+
+        hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+        {
+          hrTexture2DGetDataLDR(texRef, &w, &h, &imageDataLDR[0]);
+        }
+        hrTextureNodeClose(texRef);
       }
-      hrTextureNodeClose(texRef);
     }
 
     float mat[16];
@@ -980,29 +1048,32 @@ void displaceByHeightMapTriPlanar(HRMesh *pMesh, const pugi::xml_node &heightXML
       texRef.id = texIds[i];
       int w = 0;
       int h = 0;
-      hrTexture2DGetSize(texRef, &w, &h, &bpp);
-      texSizes[i].x = w;
-      texSizes[i].y = h;
-      if (bpp > 4)
+      #pragma omp critical(hr_displace_textures)
       {
-        isHDR = true;
-        imageDataHDR.at(i).resize(w * h * 4);
-        hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+        hrTexture2DGetSize(texRef, &w, &h, &bpp);
+        texSizes[i].x = w;
+        texSizes[i].y = h;
+        if (bpp > 4)
         {
-          hrTexture2DGetDataHDR(texRef, &w, &h, &imageDataHDR.at(i)[0]);
+          isHDR = true;
+          imageDataHDR.at(i).resize(w * h * 4);
+          hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+          {
+            hrTexture2DGetDataHDR(texRef, &w, &h, &imageDataHDR.at(i)[0]);
+          }
+          hrTextureNodeClose(texRef);
         }
-        hrTextureNodeClose(texRef);
-      }
-      else
-      {
-        isLDR = true;
-        imageDataLDR.at(i).resize(w * h);
-
-        hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+        else
         {
-          hrTexture2DGetDataLDR(texRef, &w, &h, &imageDataLDR.at(i)[0]);
+          isLDR = true;
+          imageDataLDR.at(i).resize(w * h);
+
+          hrTextureNodeOpen(texRef, HR_OPEN_READ_ONLY);
+          {
+            hrTexture2DGetDataLDR(texRef, &w, &h, &imageDataLDR.at(i)[0]);
+          }
+          hrTextureNodeClose(texRef);
         }
-        hrTextureNodeClose(texRef);
       }
 
       float mat[16];
@@ -1213,6 +1284,7 @@ void doDisplacement(HRMesh *pMesh, const pugi::xml_node &displaceXMLNode, std::v
   }
   else if(customNode != nullptr)
   {
+    #pragma omp critical(hr_displace_custom) // user callbacks are not required to be thread safe
     displaceCustom(pMesh, customNode, triangleList, bbox);
   }
 }
@@ -1250,36 +1322,31 @@ void InsertFixedMeshesAndInstancesXML(pugi::xml_document &stateToProcess,
                                       std::unordered_map<uint32_t, int32_t> &instToFixedMesh, int32_t sceneId)
 {
   auto geolib = stateToProcess.child(L"geometry_lib");
-  std::vector <std::pair<int, pugi::xml_node> > tmp_nodes;
-  if (geolib != nullptr)
+  if (geolib == nullptr)
+    return;
+
+  // several instances may share one fixed mesh, so each mesh node is copied only once
+  //
+  std::set<int32_t> fixedMeshes;
+  for (auto& meshMap : instToFixedMesh)
   {
-    for (auto& meshMap : instToFixedMesh)
+    if(meshMap.second >= 0 && meshMap.second < g_objManager.scnData.meshes.size())
+      fixedMeshes.insert(meshMap.second);
+  }
+
+  auto sceneNode = stateToProcess.child(L"scenes").find_child_by_attribute(L"scene", L"id", std::to_wstring(sceneId).c_str());
+  if (sceneNode != nullptr)
+  {
+    for (auto node = sceneNode.child(L"instance"); node != nullptr; node = node.next_sibling(L"instance"))
     {
-      //auto geoLib_ch = g_objManager.scnData.m_geometryLibChanges;
-      //auto mesh_node = geoLib_ch.find_child_by_attribute(L"id", std::to_wstring(meshMap.second).c_str());
-      if(meshMap.second < 0 || meshMap.second >= g_objManager.scnData.meshes.size())
-        continue;
-      
-      auto mesh_node = g_objManager.scnData.meshes[meshMap.second].xml_node();
-      
-      std::pair<int, pugi::xml_node> p(meshMap.second, mesh_node);
-      tmp_nodes.push_back(p);
-      auto sceneNode = stateToProcess.child(L"scenes").find_child_by_attribute(L"scene", L"id", std::to_wstring(sceneId).c_str());
-      if (sceneNode != nullptr)
-      {
-        auto node = sceneNode.find_child_by_attribute(L"instance", L"id", std::to_wstring(meshMap.first).c_str());
-        if(node != nullptr)
-        {
-          node.attribute(L"mesh_id").set_value(meshMap.second);
-        }
-      }
+      auto p = instToFixedMesh.find(node.attribute(L"id").as_uint());
+      if (p != instToFixedMesh.end() && fixedMeshes.find(p->second) != fixedMeshes.end())
+        node.attribute(L"mesh_id").set_value(p->second);
     }
   }
-  std::sort(tmp_nodes.begin(), tmp_nodes.end(),
-            [&](auto a, auto b) { return a.first < b.first; });
-  
-  for (auto& node : tmp_nodes)
-    geolib.append_copy(node.second);
+
+  for (auto meshId : fixedMeshes) // std::set keeps them sorted by id
+    geolib.append_copy(g_objManager.scnData.meshes[meshId].xml_node());
 }
 
 
@@ -1411,7 +1478,7 @@ std::wstring HR_PreprocessMeshes(const wchar_t *state_path)
   bool anyChanges = false;
   if (g_objManager.m_currSceneId < g_objManager.scnInst.size())
   {
-    auto scn = g_objManager.scnInst[g_objManager.m_currSceneId];
+    const auto& scn = g_objManager.scnInst[g_objManager.m_currSceneId];
 
     std::vector<std::unordered_map<uint32_t, uint32_t> > remapLists;
     std::unordered_map<uint32_t, int32_t> instToFixedMesh;
@@ -1423,90 +1490,142 @@ std::wstring HR_PreprocessMeshes(const wchar_t *state_path)
         int listSize = listNode.attribute(L"size").as_int();
 
         std::unordered_map<uint32_t, uint32_t> remapList;
-        const wchar_t* listStr = listNode.attribute(L"val").as_string();
-        if(listStr != nullptr)
-        {
-          std::wstringstream inputStream(listStr);
-          for(int i = 0; i < listSize; i += 2)
-          {
-            uint32_t a = 0;
-            uint32_t b = 0;
-
-            inputStream >> a;
-            inputStream >> b;
-
-            remapList[a] = b;
-          }
-        }
+        std::vector<int32_t> listData(listSize, 0);
+        const int readNum = HydraXMLHelpers::ReadInts(listNode.attribute(L"val").as_string(), listData.data(), listSize);
+        for(int i = 0; i + 1 < readNum; i += 2)
+          remapList[uint32_t(listData[i])] = uint32_t(listData[i + 1]);
         remapLists.emplace_back(remapList);
       }
     }
 
-    std::set<int32_t > displacementMatIDs;
-    for(int i = 0; i < scn.drawList.size(); ++i)
+    // (1) find unique displacement jobs. Displaced mesh depends only on source mesh and on materials its triangles get after remapping,
+    //     so instances with equal (mesh, effective remap list) share one fixed mesh; each (mesh, remap list) pair is checked once.
+    //
+    struct DisplaceJob
     {
-      auto inst = scn.drawList.at(i);
+      HRMeshRef     meshRef;
+      HRUtils::BBox bboxOld;
+      int           subdivs;
+      std::unordered_map<uint32_t, uint32_t> remapList;
+      std::vector<uint32_t> key;  // meshId and (material, remapped material) pairs for all materials of the mesh
+    };
+
+    std::vector<DisplaceJob>              jobs;
+    std::unordered_map<uint64_t, int32_t> pairToJob; // (meshId, remapListId) --> job index or -1
+    std::unordered_map<uint64_t, int32_t> keyToJob;  // hash of effective key --> job index
+    std::vector<int32_t>                  instToJob(scn.drawList.size(), -1);
+    std::set<int32_t >                    displacementMatIDs;
+
+    for(int i = 0; i < int(scn.drawList.size()); ++i)
+    {
+      const auto& inst = scn.drawList[i];
+      const uint64_t pairKey = (uint64_t(uint32_t(inst.meshId)) << 32) | uint64_t(uint32_t(inst.remapListId + 1));
+
+      auto pPair = pairToJob.find(pairKey);
+      if(pPair != pairToJob.end())
+      {
+        instToJob[i] = pPair->second;
+        continue;
+      }
+
       HRMeshRef mesh_ref;
       mesh_ref.id = inst.meshId;
 
-      auto inst_id = i;
-      auto inst_id_str = std::to_wstring(inst_id);
-
       std::unordered_map<uint32_t, uint32_t> remap_list;
-      if(inst.remapListId >= 0)
+      if(inst.remapListId >= 0 && size_t(inst.remapListId) < remapLists.size())
         remap_list = remapLists[inst.remapListId];
 
       pugi::xml_node displaceXMLNode;
       HRMaterialRef matRef;
+      int32_t jobId = -1;
 
       hrMeshOpen(mesh_ref, HR_TRIANGLE_IND3, HR_OPEN_READ_ONLY);
       if(instanceHasDisplacementMat(mesh_ref, remap_list, displaceXMLNode, matRef))
       {
-        //displacementMats.
         displacementMatIDs.insert(matRef.id);
         HRMesh& mesh = g_objManager.scnData.meshes[inst.meshId];
-        HRUtils::BBox bbox_old = mesh.pImpl->getBBox();
-        std::vector<float> verticesPos(mesh.m_input.verticesPos);       ///< float4
-        std::vector<float> verticesNorm(mesh.m_input.verticesNorm);      ///< float4
-        std::vector<float> verticesTexCoord(mesh.m_input.verticesTexCoord);  ///< float2
-        std::vector<float> verticesTangent(mesh.m_input.verticesTangent);   ///< float4
-        std::vector<uint32_t> triIndices(mesh.m_input.triIndices);        ///< size of 3*triNum
-        std::vector<uint32_t> matIndices(mesh.m_input.matIndices);        ///< size of 1*triNum
-        auto mesh_name = mesh.name;
-        hrMeshClose(mesh_ref);
-
-        std::wstring new_mesh_name = mesh_name.append(L"_fixed_").append(inst_id_str);
-        HRMeshRef mesh_ref_new = hrMeshCreate(new_mesh_name.c_str());
-        hrMeshOpen(mesh_ref_new, HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
-        hrMeshVertexAttribPointer4f(mesh_ref_new, L"pos", &verticesPos[0]);
-        hrMeshVertexAttribPointer4f(mesh_ref_new, L"norm", &verticesNorm[0]);
-        hrMeshVertexAttribPointer2f(mesh_ref_new, L"texcoord", &verticesTexCoord[0]);
-        hrMeshPrimitiveAttribPointer1i(mesh_ref_new, L"mind", (int *) (&matIndices[0]));
-        hrMeshAppendTriangles3(mesh_ref_new, int(triIndices.size()), (int *) (&triIndices[0]), false);
 
-        int subdivs = displaceXMLNode.attribute(L"subdivs").as_int();
-
-        //std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-        hrMeshSubdivideSqrt3(mesh_ref_new, max(subdivs, 0));
-        //std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
-        //std::cout << "Subdivision time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" <<std::endl;
-
-        //begin = std::chrono::steady_clock::now();
-        hrMeshDisplace(mesh_ref_new, remap_list, stateToProcess, bbox_old);
-        //end = std::chrono::steady_clock::now();
-        //std::cout << "Displacement time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << " ms" <<std::endl;
+        std::set<uint32_t> usedMats(mesh.m_input.matIndices.begin(), mesh.m_input.matIndices.end());
+        std::vector<uint32_t> key;
+        key.reserve(1 + 2*usedMats.size());
+        key.push_back(uint32_t(inst.meshId));
+        for(auto mI : usedMats)
+        {
+          auto p = remap_list.find(mI);
+          key.push_back(mI);
+          key.push_back((p == remap_list.end()) ? mI : p->second);
+        }
 
-        hrMeshClose(mesh_ref_new);
+        uint64_t keyHash = 14695981039346656037ULL; // FNV-1a over 32 bit words
+        for(auto k : key)
+          keyHash = (keyHash ^ k) * 1099511628211ULL;
 
-        instToFixedMesh[inst_id] = mesh_ref_new.id;
-        anyChanges = true;
+        auto pKey = keyToJob.find(keyHash);
+        if(pKey != keyToJob.end() && jobs[pKey->second].key == key) // compare full keys, hash collision must not merge different jobs
+        {
+          jobId = pKey->second;
+          hrMeshClose(mesh_ref);
+        }
+        else
+        {
+          HRUtils::BBox bbox_old = mesh.pImpl->getBBox();
+          std::vector<float> verticesPos(mesh.m_input.verticesPos);       ///< float4
+          std::vector<float> verticesNorm(mesh.m_input.verticesNorm);      ///< float4
+          std::vector<float> verticesTexCoord(mesh.m_input.verticesTexCoord);  ///< float2
+          std::vector<uint32_t> triIndices(mesh.m_input.triIndices);        ///< size of 3*triNum
+          std::vector<uint32_t> matIndices(mesh.m_input.matIndices);        ///< size of 1*triNum
+          auto mesh_name = mesh.name;
+          hrMeshClose(mesh_ref);
+
+          std::wstring new_mesh_name = mesh_name.append(L"_fixed_").append(std::to_wstring(i));
+          HRMeshRef mesh_ref_new = hrMeshCreate(new_mesh_name.c_str());
+          hrMeshOpen(mesh_ref_new, HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
+          hrMeshVertexAttribPointer4f(mesh_ref_new, L"pos", &verticesPos[0]);
+          hrMeshVertexAttribPointer4f(mesh_ref_new, L"norm", &verticesNorm[0]);
+          hrMeshVertexAttribPointer2f(mesh_ref_new, L"texcoord", &verticesTexCoord[0]);
+          hrMeshPrimitiveAttribPointer1i(mesh_ref_new, L"mind", (int *) (&matIndices[0]));
+          hrMeshAppendTriangles3(mesh_ref_new, int(triIndices.size()), (int *) (&triIndices[0]), false);
+
+          DisplaceJob job;
+          job.meshRef   = mesh_ref_new;
+          job.bboxOld   = bbox_old;
+          job.subdivs   = max(displaceXMLNode.attribute(L"subdivs").as_int(), 0);
+          job.remapList = remap_list;
+          job.key       = key;
+
+          jobId = int32_t(jobs.size());
+          jobs.push_back(job);
+          keyToJob.emplace(keyHash, jobId); // on collision the first job stays in the table, the new one is just not shared
+        }
       }
       else
       {
         hrMeshClose(mesh_ref);
       }
+
+      pairToJob[pairKey] = jobId;
+      instToJob[i]       = jobId;
+    }
+
+    // (2) subdivide and displace unique meshes in parallel; all of them stay opened, so scnData.meshes is not resized here
+    //
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int j = 0; j < int(jobs.size()); ++j)
+    {
+      hrMeshSubdivideSqrt3(jobs[j].meshRef, jobs[j].subdivs);
+      hrMeshDisplace(jobs[j].meshRef, jobs[j].remapList, stateToProcess, jobs[j].bboxOld);
     }
 
+    for(auto& job : jobs)
+      hrMeshClose(job.meshRef);
+
+    for(int i = 0; i < int(instToJob.size()); ++i)
+    {
+      if(instToJob[i] >= 0)
+        instToFixedMesh[i] = jobs[instToJob[i]].meshRef.id;
+    }
+    anyChanges = !jobs.empty();
+
     if(anyChanges)
     {
       InsertFixedMeshesAndInstancesXML(stateToProcess, instToFixedMesh, g_objManager.m_currSceneId);
@@ -1521,6 +1640,130 @@ std::wstring HR_PreprocessMeshes(const wchar_t *state_path)
 }
 
 
+// Vertex welding.
+//
+// Two corners are merged when their vertex_cache values have equal vertex_cache_hash and pass vertex_cache_eq
+// (the same rule the previous std::unordered_map based welder used). Corners are distributed into partitions by hash
+// with a stable counting sort, each partition is welded independently with a small open addressing table and the
+// final vertex indices are assigned in the order of first occurrence. So the result does not depend on threads number.
+//
+static constexpr int      WELD_PARTITION_BITS = 10;
+static constexpr uint32_t WELD_PARTITIONS     = (1u << WELD_PARTITION_BITS);
+
+struct WeldSlot
+{
+  size_t  hash;
+  int32_t first; ///< oldest representative with this hash, -1 for empty slot
+  int32_t last;  ///< newest representative with this hash
+};
+
+struct WeldRep
+{
+  vertex_cache attr;   ///< attributes of the new vertex
+  uint32_t     corner; ///< corner where this vertex was met for the first time
+  int32_t      next;   ///< next representative with the same hash or -1
+};
+
+static inline vertex_cache WeldVertexCache(const HRMesh::InputTriMesh& mesh, uint32_t a_vertex)
+{
+  const float* pos  = mesh.verticesPos.data()      + size_t(a_vertex) * 4;
+  const float* norm = mesh.verticesNorm.data()     + size_t(a_vertex) * 4;
+  const float* uv   = mesh.verticesTexCoord.data() + size_t(a_vertex) * 2;
+  const float* tan  = mesh.verticesTangent.data()  + size_t(a_vertex) * 4;
+
+  vertex_cache res;
+  res.pos     = float3(pos[0], pos[1], pos[2]);
+  res.normal  = float3(norm[0], norm[1], norm[2]);
+  res.uv      = float2(uv[0], uv[1]);
+  res.tangent = float4(tan[0], tan[1], tan[2], tan[3]);
+  return res;
+}
+
+static inline uint32_t WeldPartitionOf(size_t a_hash)
+{
+  return uint32_t((uint64_t(a_hash) * 0x9E3779B97F4A7C15ull) >> (64 - WELD_PARTITION_BITS));
+}
+
+static inline int WeldChunkBegin(int a_size, int a_chunk, int a_chunkNum)
+{
+  return int(int64_t(a_size) * int64_t(a_chunk) / int64_t(a_chunkNum));
+}
+
+static void WeldPartitionCorners(const HRMesh::InputTriMesh& mesh, const size_t* a_vertHash, const uint32_t* a_cornerVert,
+                                 const uint32_t* a_corners, uint32_t a_cornersNum,
+                                 int32_t* a_vertRep, uint32_t* a_cornerRep,
+                                 std::vector<WeldSlot>& a_table, std::vector<WeldRep>& a_reps)
+{
+  if (a_cornersNum == 0)
+    return;
+
+  uint32_t tableSize = 16;
+  while (tableSize < a_cornersNum * 2)
+    tableSize *= 2;
+
+  WeldSlot emptySlot;
+  emptySlot.hash  = 0;
+  emptySlot.first = -1;
+  emptySlot.last  = -1;
+
+  a_table.assign(tableSize, emptySlot);
+  a_reps.clear();
+
+  const vertex_cache_eq eq;
+
+  for (uint32_t i = 0; i < a_cornersNum; i++)
+  {
+    const uint32_t corner = a_corners[i];
+    const uint32_t vertex = a_cornerVert[corner];
+
+    if (a_vertRep[vertex] >= 0) // all other corners of this old vertex go to the same place
+    {
+      a_cornerRep[corner] = uint32_t(a_vertRep[vertex]);
+      continue;
+    }
+
+    const size_t hash = a_vertHash[vertex];
+    uint32_t slot     = uint32_t((uint64_t(hash) * 0xC2B2AE3D27D4EB4Full) >> 32) & (tableSize - 1);
+    while (a_table[slot].first >= 0 && a_table[slot].hash != hash)
+      slot = (slot + 1) & (tableSize - 1);
+
+    WeldSlot& s = a_table[slot];
+
+    const vertex_cache key = WeldVertexCache(mesh, vertex);
+    int32_t found = -1;
+    for (int32_t r = s.first; r >= 0; r = a_reps[r].next)
+    {
+      if (eq(key, a_reps[r].attr))
+      {
+        found = r;
+        break;
+      }
+    }
+
+    if (found < 0)
+    {
+      WeldRep rep;
+      rep.attr   = key;
+      rep.corner = corner;
+      rep.next   = -1;
+      a_reps.push_back(rep);
+      found = int32_t(a_reps.size() - 1);
+
+      if (s.first < 0)
+      {
+        s.hash  = hash;
+        s.first = found;
+      }
+      else
+        a_reps[s.last].next = found;
+      s.last = found;
+    }
+
+    a_vertRep[vertex]    = int32_t(a_reps[found].corner);
+    a_cornerRep[corner] = a_reps[found].corner;
+  }
+}
+
 void hrMeshWeldVertices(HRMeshRef a_mesh, int &indexNum)
 {
   HRMesh *pMesh = g_objManager.PtrById(a_mesh);
@@ -1538,206 +1781,195 @@ void hrMeshWeldVertices(HRMeshRef a_mesh, int &indexNum)
   }
 
   HRMesh::InputTriMesh &mesh = pMesh->m_input;
-  //const bool hasNormals  = (pMesh->m_inputPointers.normals != nullptr);
 
-  std::vector<uint32_t> indices_new;
-  //std::unordered_map<float3, uint32_t, float3_hash, pos_eq> vertex_hash;
-  std::unordered_map<vertex_cache, uint32_t, vertex_cache_hash, vertex_cache_eq> vertex_hash;
+  const size_t vertNum = mesh.verticesPos.size() / 4;
+  if (mesh.verticesNorm.size() < vertNum * 4 || mesh.verticesTexCoord.size() < vertNum * 2 || mesh.verticesTangent.size() < vertNum * 4)
+  {
+    HrError(L"hrMeshWeldVertices: vertex attributes are incomplete, id = ", a_mesh.id);
+    return;
+  }
 
-  std::vector<float> vertices_new(mesh.verticesPos.size()*2, 0.0f);
-  std::vector<float> normals_new(mesh.verticesNorm.size()*2, 0.0f);
-  std::vector<float> uv_new(mesh.verticesTexCoord.size()*2, 0.0f);
-  std::vector<float> tangents_new(mesh.verticesTangent.size()*2, 0.0f);
-  std::vector<int32_t> mid_new;
+  // (1) drop degenerate triangles
+  //
+  std::vector<uint32_t> cornerVert;
+  std::vector<uint32_t> mid_new;
+  cornerVert.reserve(mesh.triIndices.size());
   mid_new.reserve(mesh.matIndices.size());
 
-  uint32_t index = 0;
-  for (auto i = 0u; i < mesh.triIndices.size(); i += 3)
+  for (size_t i = 0; i + 2 < mesh.triIndices.size(); i += 3)
   {
-    uint32_t indA = mesh.triIndices[i + 0];
-    uint32_t indB = mesh.triIndices[i + 1];
-    uint32_t indC = mesh.triIndices[i + 2];
+    const uint32_t indA = mesh.triIndices[i + 0];
+    const uint32_t indB = mesh.triIndices[i + 1];
+    const uint32_t indC = mesh.triIndices[i + 2];
 
     if (indA == indB || indA == indC || indB == indC)
       continue;
 
-    auto old_mid = mesh.matIndices.at(i / 3);
-    mid_new.push_back(old_mid);
-
-    float4 tmp = vertex_attrib_by_index_f4("pos", indA, mesh);
-    float3 A(tmp.x, tmp.y, tmp.z);
-    tmp = vertex_attrib_by_index_f4("normal", indA, mesh);
-    float3 A_normal(tmp.x, tmp.y, tmp.z);
-    float2 tmp2 = vertex_attrib_by_index_f2("uv", indA, mesh);
-    float2 A_uv(tmp2.x, tmp2.y);
-    float4 A_tan = vertex_attrib_by_index_f4("tangent", indA, mesh);
-
-    vertex_cache A_cache;
-    A_cache.pos = A;
-    A_cache.normal = A_normal;
-    A_cache.uv = A_uv;
-    A_cache.tangent = A_tan;
-
-    auto it = vertex_hash.find(A_cache);
-
-    if(it != vertex_hash.end())
+    if (indA >= vertNum || indB >= vertNum || indC >= vertNum)
     {
-      indices_new.push_back(it->second);
+      HrError(L"hrMeshWeldVertices: vertex index out of range, id = ", a_mesh.id);
+      return;
     }
-    else
-    {
-      vertex_hash[A_cache] = index;
-      indices_new.push_back(index);
 
-      vertices_new.at(index * 4 + 0) = A.x;
-      vertices_new.at(index * 4 + 1) = A.y;
-      vertices_new.at(index * 4 + 2) = A.z;
-      vertices_new.at(index * 4 + 3) = 1.0f;
+    cornerVert.push_back(indA);
+    cornerVert.push_back(indB);
+    cornerVert.push_back(indC);
+    mid_new.push_back(mesh.matIndices.at(i / 3));
+  }
 
-      normals_new.at(index * 4 + 0) = A_normal.x;
-      normals_new.at(index * 4 + 1) = A_normal.y;
-      normals_new.at(index * 4 + 2) = A_normal.z;
-      normals_new.at(index * 4 + 3) = 0.0f;
+  const int cornerNum = int(cornerVert.size());
+  const int chunkNum  = omp_get_max_threads();
 
-      uv_new.at(index * 2 + 0) = A_uv.x;
-      uv_new.at(index * 2 + 1) = A_uv.y;
+  // (2) hash each old vertex only once
+  //
+  std::vector<size_t>  vertHash(vertNum);
+  std::vector<int32_t> vertRep(vertNum, -1);
 
-      tangents_new.at(index * 4 + 0) = A_tan.x;
-      tangents_new.at(index * 4 + 1) = A_tan.y;
-      tangents_new.at(index * 4 + 2) = A_tan.z;
-      tangents_new.at(index * 4 + 3) = A_tan.w;
+  const vertex_cache_hash hasher;
 
-      index++;
-    }
+  #pragma omp parallel for
+  for (int v = 0; v < int(vertNum); v++)
+    vertHash[v] = hasher(WeldVertexCache(mesh, uint32_t(v)));
+
+  // (3) stable counting sort of corners by partition
+  //
+  std::vector<uint32_t> histogram(size_t(chunkNum) * WELD_PARTITIONS, 0);
 
-    tmp = vertex_attrib_by_index_f4("pos", indB, mesh);
-    float3 B(tmp.x, tmp.y, tmp.z);
-    tmp = vertex_attrib_by_index_f4("normal", indB, mesh);
-    float3 B_normal(tmp.x, tmp.y, tmp.z);
-    tmp2 = vertex_attrib_by_index_f2("uv", indB, mesh);
-    float2 B_uv(tmp2.x, tmp2.y);
-    float4 B_tan = vertex_attrib_by_index_f4("tangent", indB, mesh);
-
-    vertex_cache B_cache;
-    B_cache.pos = B;
-    B_cache.normal = B_normal;
-    B_cache.uv = B_uv;
-    B_cache.tangent = B_tan;
-
-    it = vertex_hash.find(B_cache);
-    if(it != vertex_hash.end())
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < chunkNum; chunk++)
+  {
+    uint32_t* hist  = histogram.data() + size_t(chunk) * WELD_PARTITIONS;
+    const int begin = WeldChunkBegin(cornerNum, chunk, chunkNum);
+    const int end   = WeldChunkBegin(cornerNum, chunk + 1, chunkNum);
+    for (int c = begin; c < end; c++)
+      hist[WeldPartitionOf(vertHash[cornerVert[c]])]++;
+  }
+
+  std::vector<uint32_t> partBegin(WELD_PARTITIONS + 1, 0);
+  uint32_t offset = 0;
+  for (uint32_t p = 0; p < WELD_PARTITIONS; p++)
+  {
+    partBegin[p] = offset;
+    for (int chunk = 0; chunk < chunkNum; chunk++)
     {
-      indices_new.push_back(it->second);
+      uint32_t& h         = histogram[size_t(chunk) * WELD_PARTITIONS + p];
+      const uint32_t count = h;
+      h       = offset;
+      offset += count;
     }
-    else
-    {
-      vertex_hash[B_cache] = index;
-      indices_new.push_back(index);
+  }
+  partBegin[WELD_PARTITIONS] = offset;
 
-      vertices_new.at(index * 4 + 0) = B.x;
-      vertices_new.at(index * 4 + 1) = B.y;
-      vertices_new.at(index * 4 + 2) = B.z;
-      vertices_new.at(index * 4 + 3) = 1.0f;
+  std::vector<uint32_t> sortedCorners(cornerNum);
 
-      normals_new.at(index * 4 + 0) = B_normal.x;
-      normals_new.at(index * 4 + 1) = B_normal.y;
-      normals_new.at(index * 4 + 2) = B_normal.z;
-      normals_new.at(index * 4 + 3) = 0.0f;
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < chunkNum; chunk++)
+  {
+    uint32_t* hist  = histogram.data() + size_t(chunk) * WELD_PARTITIONS;
+    const int begin = WeldChunkBegin(cornerNum, chunk, chunkNum);
+    const int end   = WeldChunkBegin(cornerNum, chunk + 1, chunkNum);
+    for (int c = begin; c < end; c++)
+      sortedCorners[hist[WeldPartitionOf(vertHash[cornerVert[c]])]++] = uint32_t(c);
+  }
 
-      uv_new.at(index * 2 + 0) = B_uv.x;
-      uv_new.at(index * 2 + 1) = B_uv.y;
+  // (4) weld partitions independently; cornerRep[c] is the corner where the vertex of 'c' was met for the first time
+  //
+  std::vector<uint32_t> cornerRep(cornerNum);
 
-      tangents_new.at(index * 4 + 0) = B_tan.x;
-      tangents_new.at(index * 4 + 1) = B_tan.y;
-      tangents_new.at(index * 4 + 2) = B_tan.z;
-      tangents_new.at(index * 4 + 3) = B_tan.w;
+  #pragma omp parallel
+  {
+    std::vector<WeldSlot> table;
+    std::vector<WeldRep>  reps;
 
-      index++;
+    #pragma omp for schedule(dynamic)
+    for (int p = 0; p < int(WELD_PARTITIONS); p++)
+    {
+      WeldPartitionCorners(mesh, vertHash.data(), cornerVert.data(), sortedCorners.data() + partBegin[p], partBegin[p + 1] - partBegin[p],
+                           vertRep.data(), cornerRep.data(), table, reps);
     }
+  }
 
-    tmp = vertex_attrib_by_index_f4("pos", indC, mesh);
-    float3 C(tmp.x, tmp.y, tmp.z);
-    tmp = vertex_attrib_by_index_f4("normal", indC, mesh);
-    float3 C_normal(tmp.x, tmp.y, tmp.z);
-    tmp2 = vertex_attrib_by_index_f2("uv", indC, mesh);
-    float2 C_uv(tmp2.x, tmp2.y);
-    float4 C_tan = vertex_attrib_by_index_f4("tangent", indC, mesh);
+  // (5) number new vertices in the order of first occurrence and copy their attributes
+  //
+  std::vector<uint32_t> chunkOffset(chunkNum + 1, 0);
 
-    vertex_cache C_cache;
-    C_cache.pos = C;
-    C_cache.normal = C_normal;
-    C_cache.uv = C_uv;
-    C_cache.tangent = C_tan;
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < chunkNum; chunk++)
+  {
+    const int begin = WeldChunkBegin(cornerNum, chunk, chunkNum);
+    const int end   = WeldChunkBegin(cornerNum, chunk + 1, chunkNum);
+    uint32_t count  = 0;
+    for (int c = begin; c < end; c++)
+      count += (cornerRep[c] == uint32_t(c)) ? 1 : 0;
+    chunkOffset[chunk + 1] = count;
+  }
 
+  for (int chunk = 0; chunk < chunkNum; chunk++)
+    chunkOffset[chunk + 1] += chunkOffset[chunk];
 
-    it = vertex_hash.find(C_cache);
-    if(it != vertex_hash.end())
-    {
-      indices_new.push_back(it->second);
-    }
-    else
+  const size_t newVertNum = chunkOffset[chunkNum];
+
+  std::vector<uint32_t> indices_new(cornerNum);
+  std::vector<float>    vertices_new(newVertNum * 4);
+  std::vector<float>    normals_new(newVertNum * 4);
+  std::vector<float>    uv_new(newVertNum * 2);
+  std::vector<float>    tangents_new(newVertNum * 4);
+
+  #pragma omp parallel for
+  for (int chunk = 0; chunk < chunkNum; chunk++)
+  {
+    const int begin = WeldChunkBegin(cornerNum, chunk, chunkNum);
+    const int end   = WeldChunkBegin(cornerNum, chunk + 1, chunkNum);
+    size_t index    = chunkOffset[chunk];
+
+    for (int c = begin; c < end; c++)
     {
-      vertex_hash[C_cache] = index;
-      indices_new.push_back(index);
+      if (cornerRep[c] != uint32_t(c))
+        continue;
 
-      vertices_new.at(index * 4 + 0) = C.x;
-      vertices_new.at(index * 4 + 1) = C.y;
-      vertices_new.at(index * 4 + 2) = C.z;
-      vertices_new.at(index * 4 + 3) = 1.0f;
+      const vertex_cache v = WeldVertexCache(mesh, cornerVert[c]);
+      indices_new[c] = uint32_t(index);
 
-      normals_new.at(index * 4 + 0) = C_normal.x;
-      normals_new.at(index * 4 + 1) = C_normal.y;
-      normals_new.at(index * 4 + 2) = C_normal.z;
-      normals_new.at(index * 4 + 3) = 0.0f;
+      vertices_new[index * 4 + 0] = v.pos.x;
+      vertices_new[index * 4 + 1] = v.pos.y;
+      vertices_new[index * 4 + 2] = v.pos.z;
+      vertices_new[index * 4 + 3] = 1.0f;
 
-      uv_new.at(index * 2 + 0) = C_uv.x;
-      uv_new.at(index * 2 + 1) = C_uv.y;
+      normals_new[index * 4 + 0] = v.normal.x;
+      normals_new[index * 4 + 1] = v.normal.y;
+      normals_new[index * 4 + 2] = v.normal.z;
+      normals_new[index * 4 + 3] = 0.0f;
 
-      tangents_new.at(index * 4 + 0) = C_tan.x;
-      tangents_new.at(index * 4 + 1) = C_tan.y;
-      tangents_new.at(index * 4 + 2) = C_tan.z;
-      tangents_new.at(index * 4 + 3) = C_tan.w;
+      uv_new[index * 2 + 0] = v.uv.x;
+      uv_new[index * 2 + 1] = v.uv.y;
+
+      tangents_new[index * 4 + 0] = v.tangent.x;
+      tangents_new[index * 4 + 1] = v.tangent.y;
+      tangents_new[index * 4 + 2] = v.tangent.z;
+      tangents_new[index * 4 + 3] = v.tangent.w;
 
       index++;
     }
-
   }
 
-  vertices_new.resize(index * 4);
-  normals_new.resize(index * 4);
-  uv_new.resize(index * 2);
-  tangents_new.resize(index * 4);
-
-  //std::cout << "vert old : " << mesh.verticesPos.size() << "  vert new :" << vertices_new.size() << std::endl;
+  #pragma omp parallel for
+  for (int c = 0; c < cornerNum; c++)
+  {
+    if (cornerRep[c] != uint32_t(c))
+      indices_new[c] = indices_new[cornerRep[c]];
+  }
 
-  pMesh->m_inputPointers.normals = nullptr;
+  pMesh->m_inputPointers.normals  = nullptr;
   pMesh->m_inputPointers.tangents = nullptr;
 
-  mesh.verticesPos.clear();
-  mesh.verticesPos.resize(vertices_new.size());
-  std::copy(vertices_new.begin(), vertices_new.end(), mesh.verticesPos.begin());
-
-  mesh.verticesNorm.clear();
-  mesh.verticesNorm.resize(normals_new.size());
-  std::copy(normals_new.begin(), normals_new.end(), mesh.verticesNorm.begin());
-
-  mesh.verticesTexCoord.clear();
-  mesh.verticesTexCoord.resize(uv_new.size());
-  std::copy(uv_new.begin(), uv_new.end(), mesh.verticesTexCoord.begin());
-
-  mesh.verticesTangent.clear();
-  mesh.verticesTangent.resize(tangents_new.size());
-  std::copy(tangents_new.begin(), tangents_new.end(), mesh.verticesTangent.begin());
+  mesh.verticesPos      = std::move(vertices_new);
+  mesh.verticesNorm     = std::move(normals_new);
+  mesh.verticesTexCoord = std::move(uv_new);
+  mesh.verticesTangent  = std::move(tangents_new);
+  mesh.triIndices       = std::move(indices_new);
+  mesh.matIndices       = std::move(mid_new);
 
-  mesh.triIndices.clear();
-  mesh.triIndices.resize(indices_new.size());
-  std::copy(indices_new.begin(), indices_new.end(), mesh.triIndices.begin());
-
-  mesh.matIndices.clear();
-  mesh.matIndices.resize(mid_new.size());
-  std::copy(mid_new.begin(), mid_new.end(), mesh.matIndices.begin());
-
-  indexNum = int(indices_new.size());
+  indexNum = cornerNum;
 }
 
 
@@ -1862,7 +2094,97 @@ void runTSpaceCalc(HRMeshRef mesh_ref, bool basic)
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //// Mesh sampling
 
-void HRUtils::getRandomPointsOnMesh(HRMeshRef mesh_ref, float *points, uint32_t n_points, bool tri_area_weighted, uint32_t seed)
+namespace
+{
+  /**
+  \brief Walker/Vose alias table; O(T) to build and O(1) per sample.
+  */
+  struct TriangleAliasTable
+  {
+    std::vector<float>    prob;
+    std::vector<uint32_t> alias;
+
+    void build(const std::vector<double>& a_weights, double a_totalWeight)
+    {
+      const uint32_t n = uint32_t(a_weights.size());
+      prob.resize(n);
+      alias.resize(n);
+
+      std::vector<double>   scaled(n);
+      std::vector<uint32_t> small, large;
+      small.reserve(n);
+      large.reserve(n);
+
+      for (uint32_t i = 0; i < n; ++i)
+      {
+        scaled[i] = a_weights[i] * double(n) / a_totalWeight;
+        alias[i]  = i;
+        if (scaled[i] < 1.0)
+          small.push_back(i);
+        else
+          large.push_back(i);
+      }
+
+      while (!small.empty() && !large.empty())
+      {
+        const uint32_t s = small.back(); small.pop_back();
+        const uint32_t l = large.back();
+
+        prob[s]   = float(scaled[s]);
+        alias[s]  = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+
+        if (scaled[l] < 1.0)
+        {
+          large.pop_back();
+          small.push_back(l);
+        }
+      }
+
+      // leftovers are 1.0 up to rounding error
+      for (auto i : large) prob[i] = 1.0f;
+      for (auto i : small) prob[i] = 1.0f;
+    }
+
+    uint32_t sample(uint32_t a_rndColumn, float a_rndCoin) const
+    {
+      const auto column = uint32_t((uint64_t(a_rndColumn) * uint64_t(prob.size())) >> 32);
+      return (a_rndCoin < prob[column]) ? column : alias[column];
+    }
+  };
+
+  inline float rndUnitFloat(std::mt19937& a_gen) { return float(a_gen() >> 8) * (1.0f / 16777216.0f); } ///< [0,1) with 24 bits
+
+  inline float shiftModOne(float a_val, float a_shift)
+  {
+    float res = a_val + a_shift;
+    if (res >= 1.0f) res -= 1.0f;
+    return std::min(res, 0.99999994f);
+  }
+
+  /**
+  \brief the same as hr_qmc::rndFloat for dimensions 0,1,2 at once; stops when there are no more set bits in a_pos.
+  */
+  inline void qmcFloat3(uint32_t a_pos, const unsigned int a_table[hr_qmc::QRNG_DIMENSIONS][hr_qmc::QRNG_RESOLUTION], float a_out[3])
+  {
+    uint32_t res[3] = {0, 0, 0};
+    for (int bit = 0; a_pos != 0 && bit < hr_qmc::QRNG_RESOLUTION; bit++, a_pos >>= 1)
+    {
+      if (a_pos & 1)
+      {
+        res[0] ^= a_table[0][bit];
+        res[1] ^= a_table[1][bit];
+        res[2] ^= a_table[2][bit];
+      }
+    }
+    for (int k = 0; k < 3; k++)
+      a_out[k] = float(res[k] + 1) * hr_qmc::INT_SCALE;
+  }
+
+  constexpr uint32_t MESH_SAMPLING_BLOCK_SIZE = 4096; ///< points per independent rng stream; results do not depend on threads number
+}
+
+void HRUtils::getRandomPointsOnMesh(HRMeshRef mesh_ref, float *points, uint32_t n_points, bool tri_area_weighted, uint32_t seed, bool use_qmc)
 {
   HRMesh *pMesh = g_objManager.PtrById(mesh_ref);
 
@@ -1883,86 +2205,148 @@ void HRUtils::getRandomPointsOnMesh(HRMeshRef mesh_ref, float *points, uint32_t
     hrMeshOpen(mesh_ref, HR_TRIANGLE_IND3, HR_OPEN_EXISTING);
   }
 
-  HRMesh::InputTriMesh &mesh = pMesh->m_input;
-
-  uint32_t vert_num = mesh.verticesPos.size();
-  uint32_t tri_num = mesh.triIndices.size() / 3;
+  const HRMesh::InputTriMesh &mesh = pMesh->m_input;
 
-//  std::random_device rand;
-  std::mt19937 rng(seed);
-  std::uniform_real_distribution<float> select(0.0f, 1.0f);
+  const uint32_t vert_num = uint32_t(mesh.verticesPos.size() / 4);
+  const uint32_t tri_num  = uint32_t(mesh.triIndices.size() / 3);
 
-  std::vector<uint32_t> triangle_indices;
-  if(tri_area_weighted)
+  if (tri_num == 0)
   {
-    float min_area = std::numeric_limits<float>::max();
-    std::vector<float> triangle_areas(tri_num, 0.0f);
-    for(uint32_t i = 0; i < tri_num; ++i )
-    {
-      uint32_t idx_A = mesh.triIndices.at(i * 3 + 0);
-      uint32_t idx_B = mesh.triIndices.at(i * 3 + 1);
-      uint32_t idx_C = mesh.triIndices.at(i * 3 + 2);
-      float3 A = make_float3(mesh.verticesPos.at(idx_A * 4 + 0), mesh.verticesPos.at(idx_A * 4 + 1), mesh.verticesPos.at(idx_A * 4 + 2));
-      float3 B = make_float3(mesh.verticesPos.at(idx_B * 4 + 0), mesh.verticesPos.at(idx_B * 4 + 1), mesh.verticesPos.at(idx_B * 4 + 2));
-      float3 C = make_float3(mesh.verticesPos.at(idx_C * 4 + 0), mesh.verticesPos.at(idx_C * 4 + 1), mesh.verticesPos.at(idx_C * 4 + 2));
-
-      float3 edge1A = normalize(B - A);
-      float3 edge2A = normalize(C - A);
-
-      float face_area = 0.5f * sqrtf(powf(edge1A.y * edge2A.z - edge1A.z * edge2A.y, 2) +
-                                     powf(edge1A.z * edge2A.x - edge1A.x * edge2A.z, 2) +
-                                     powf(edge1A.x * edge2A.y - edge1A.y * edge2A.x, 2));
+    HrError(L"HRUtils::getRandomPointsOnMesh: mesh has no triangles");
+    return;
+  }
 
-//      float cos_theta = dot(edge1A, edge2A);
-//      float sin_theta = sqrtf(1.0f - cos_theta * cos_theta);
-//      float face_area = 0.5f * dot(edge1A, edge1A) * dot(edge2A, edge2A) * sin_theta;
+  // validate indices once, so that sampling loop can use unchecked reads
+  //
+  std::vector<double> triangle_areas(tri_area_weighted ? tri_num : 0);
+  double total_area = 0.0;
 
-      if(face_area < min_area)
-        min_area = face_area;
+  for (uint32_t i = 0; i < tri_num; ++i)
+  {
+    const uint32_t idx_A = mesh.triIndices[i * 3 + 0];
+    const uint32_t idx_B = mesh.triIndices[i * 3 + 1];
+    const uint32_t idx_C = mesh.triIndices[i * 3 + 2];
 
-      triangle_areas[i] = face_area;
+    if (idx_A >= vert_num || idx_B >= vert_num || idx_C >= vert_num)
+    {
+      HrError(L"HRUtils::getRandomPointsOnMesh: bad vertex index in triangle ", i);
+      return;
     }
 
-    //std::vector<uint32_t> tmp_vec(triangle_areas.size(), 0u);
-    for(uint32_t i = 0; i < triangle_areas.size(); ++i)
+    if (tri_area_weighted)
     {
-      auto tmp = static_cast<uint32_t >(std::ceil(triangle_areas[i] / min_area));
+      const float3 A = make_float3(mesh.verticesPos[idx_A * 4 + 0], mesh.verticesPos[idx_A * 4 + 1], mesh.verticesPos[idx_A * 4 + 2]);
+      const float3 B = make_float3(mesh.verticesPos[idx_B * 4 + 0], mesh.verticesPos[idx_B * 4 + 1], mesh.verticesPos[idx_B * 4 + 2]);
+      const float3 C = make_float3(mesh.verticesPos[idx_C * 4 + 0], mesh.verticesPos[idx_C * 4 + 1], mesh.verticesPos[idx_C * 4 + 2]);
 
-      for(int j = 0; j <= tmp; ++j)
-        triangle_indices.push_back(i);
+      const float face_area = 0.5f * length(cross(B - A, C - A));
+      triangle_areas[i] = std::isfinite(face_area) ? double(face_area) : 0.0;
+      total_area       += triangle_areas[i];
     }
   }
 
+  if (tri_area_weighted && !(total_area > 0.0))
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"HRUtils::getRandomPointsOnMesh: mesh has zero area, triangles are selected uniformly");
+    tri_area_weighted = false;
+  }
 
-  for(uint32_t i = 0; i < n_points; ++i)
+  // random mode selects triangle with alias table;
+  // qmc mode inverts prefix sum instead, because alias table would destroy stratification of the sequence
+  //
+  TriangleAliasTable  aliasTable;
+  std::vector<double> cdf;
+
+  if (tri_area_weighted && !use_qmc)
+    aliasTable.build(triangle_areas, total_area);
+  else if (tri_area_weighted && use_qmc)
   {
-    uint32_t triangle = 0u;
-    if(tri_area_weighted)
-      triangle = triangle_indices[uint32_t(triangle_indices.size() * select(rng))];
-    else
-      triangle = uint32_t(tri_num * select(rng));
+    cdf.resize(tri_num);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < tri_num; ++i)
+    {
+      sum   += triangle_areas[i];
+      cdf[i] = sum / total_area;
+    }
+    cdf[tri_num - 1] = 1.0;
+  }
+  triangle_areas = std::vector<double>();
+
+  unsigned int qmcTable[hr_qmc::QRNG_DIMENSIONS][hr_qmc::QRNG_RESOLUTION];
+  float qmcShift[3] = {0.0f, 0.0f, 0.0f};
+  if (use_qmc)
+  {
+    hr_qmc::init(qmcTable);
+    std::mt19937 shiftGen(seed);                 // Cranley-Patterson rotation, different seeds give different point sets
+    for (int k = 0; k < 3; ++k)
+      qmcShift[k] = rndUnitFloat(shiftGen);
+  }
 
-    uint32_t idx_A = mesh.triIndices.at(triangle * 3 + 0);
-    uint32_t idx_B = mesh.triIndices.at(triangle * 3 + 1);
-    uint32_t idx_C = mesh.triIndices.at(triangle * 3 + 2);
+  const uint32_t* triIndices = mesh.triIndices.data();
+  const float*    vertPos    = mesh.verticesPos.data();
 
-    float3 A = make_float3(mesh.verticesPos.at(idx_A * 4 + 0), mesh.verticesPos.at(idx_A * 4 + 1), mesh.verticesPos.at(idx_A * 4 + 2));
-    float3 B = make_float3(mesh.verticesPos.at(idx_B * 4 + 0), mesh.verticesPos.at(idx_B * 4 + 1), mesh.verticesPos.at(idx_B * 4 + 2));
-    float3 C = make_float3(mesh.verticesPos.at(idx_C * 4 + 0), mesh.verticesPos.at(idx_C * 4 + 1), mesh.verticesPos.at(idx_C * 4 + 2));
+  const int64_t blocksNum = (int64_t(n_points) + MESH_SAMPLING_BLOCK_SIZE - 1) / MESH_SAMPLING_BLOCK_SIZE;
 
-    float u = select(rng);
-    float v = select(rng);
-    if( u + v > 1.0f)
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t block = 0; block < blocksNum; ++block)
+  {
+    const uint32_t begin = uint32_t(block) * MESH_SAMPLING_BLOCK_SIZE;
+    const uint32_t end   = uint32_t(std::min<int64_t>(int64_t(begin) + MESH_SAMPLING_BLOCK_SIZE, n_points));
+
+    std::seed_seq seq{seed, uint32_t(block)};
+    std::mt19937  rng(seq);
+
+    for (uint32_t i = begin; i < end; ++i)
     {
-      u = 1.0f - u;
-      v = 1.0f - v;
-    }
+      uint32_t triangle = 0u;
+      float u, v;
 
-    float3 pt = u * A + v * B + (1 - (u + v)) * C;
+      if (use_qmc)
+      {
+        float qmc[3];
+        qmcFloat3(i + 1, qmcTable, qmc);
+        const float r0 = shiftModOne(qmc[0], qmcShift[0]);
+        u              = shiftModOne(qmc[1], qmcShift[1]);
+        v              = shiftModOne(qmc[2], qmcShift[2]);
+
+        if (tri_area_weighted)
+          triangle = uint32_t(std::upper_bound(cdf.begin(), cdf.end(), double(r0)) - cdf.begin());
+        else
+          triangle = uint32_t(r0 * float(tri_num));
+        triangle = std::min(triangle, tri_num - 1);
+      }
+      else
+      {
+        const uint32_t r0 = rng();
+        if (tri_area_weighted)
+          triangle = aliasTable.sample(r0, rndUnitFloat(rng));
+        else
+          triangle = uint32_t((uint64_t(r0) * uint64_t(tri_num)) >> 32);
+
+        u = rndUnitFloat(rng);
+        v = rndUnitFloat(rng);
+      }
+
+      if (u + v > 1.0f)
+      {
+        u = 1.0f - u;
+        v = 1.0f - v;
+      }
+
+      const float* pA = vertPos + triIndices[triangle * 3 + 0] * 4;
+      const float* pB = vertPos + triIndices[triangle * 3 + 1] * 4;
+      const float* pC = vertPos + triIndices[triangle * 3 + 2] * 4;
+
+      const float3 A = make_float3(pA[0], pA[1], pA[2]);
+      const float3 B = make_float3(pB[0], pB[1], pB[2]);
+      const float3 C = make_float3(pC[0], pC[1], pC[2]);
 
-    points[i * 3 + 0] = pt.x;
-    points[i * 3 + 1] = pt.y;
-    points[i * 3 + 2] = pt.z;
+      const float3 pt = u * A + v * B + (1 - (u + v)) * C;
+
+      points[size_t(i) * 3 + 0] = pt.x;
+      points[size_t(i) * 3 + 1] = pt.y;
+      points[size_t(i) * 3 + 2] = pt.z;
+    }
   }
 }
 
@@ -44,6 +44,7 @@ HAPI HRLightRef hrLightCreate(const wchar_t* a_objectName)
   light.name = std::wstring(a_objectName);
   light.id = ref.id;
   g_objManager.scnData.lights.push_back(light);
+  HRSceneData::add_name(g_objManager.scnData.m_lightNames, light.name, ref.id);
 
 
   pugi::xml_node nodeXml = g_objManager.lights_lib_append_child();
@@ -165,6 +166,10 @@ HAPI void hrLightClose(HRLightRef a_pLight)
     }
   }
 
+  const std::wstring nameInXml = lightNode.attribute(L"name").as_string();
+  if (!nameInXml.empty() && nameInXml != pLight->name)
+    HRSceneData::rename_object(g_objManager.scnData.lights, g_objManager.scnData.m_lightNames, pLight->id, nameInXml);
+
   pLight->opened     = false;
   pLight->wasChanged = true;
   g_objManager.scnData.m_changeList.lightUsed.insert(pLight->id);
@@ -712,6 +717,10 @@ void HR_UpdateLightsGeometryAndMaterial(pugi::xml_node a_lightLib, pugi::xml_nod
       if((HR_LightHaveShape(lshape) && !invisiable) || isSkyPortal)
         instToAdd.push_back(LightInstance(matrixStr, meshId, lightId, instId));
     }
+    else if (std::wstring(inst.name()) == L"instance_table") // packed mesh instances, see HRInitInfo::binaryInstances
+    {
+      nextInstId += inst.attribute(L"count").as_int();
+    }
     else
     {
       if (inst.attribute(L"linst_id") != nullptr)
@@ -756,6 +765,7 @@ void HR_UpdateLightsGeometryAndMaterial(pugi::xml_node a_lightLib, pugi::xml_nod
 
     HydraXMLHelpers::ReadMatrix4x4(nodeXML, L"matrix", model.m);
     pScn->drawList.push_back(model);
+    pScn->wasChanged = true;
 
     nextInstId++;
   }
@@ -766,18 +776,7 @@ void HR_UpdateLightsGeometryAndMaterial(pugi::xml_node a_lightLib, pugi::xml_nod
 HAPI HRLightRef hrFindLightByName(const wchar_t *a_lightName)
 {
   HRLightRef light;
-
-  if(a_lightName != nullptr)
-  {
-    for (auto lgt : g_objManager.scnData.lights)
-    {
-      if (lgt.name == std::wstring(a_lightName))
-      {
-        light.id = lgt.id;
-        break;
-      }
-    }
-  }
+  light.id = HRSceneData::find_name(g_objManager.scnData.m_lightNames, a_lightName);
 
   if(light.id == -1)
   {
@@ -788,3 +787,24 @@ HAPI HRLightRef hrFindLightByName(const wchar_t *a_lightName)
 
   return light;
 }
+
+HAPI int32_t hrFindLightsByName(const wchar_t** a_lightNames, int32_t a_namesNum, HRLightRef* a_outRefs)
+{
+  if (a_lightNames == nullptr || a_outRefs == nullptr)
+  {
+    HrError(L"hrFindLightsByName: nullptr input");
+    return 0;
+  }
+
+  const auto& index = g_objManager.scnData.m_lightNames;
+  int32_t found     = 0;
+
+  for (int32_t i = 0; i < a_namesNum; i++)
+  {
+    a_outRefs[i].id = HRSceneData::find_name(index, a_lightNames[i]);
+    if (a_outRefs[i].id != -1)
+      found++;
+  }
+
+  return found;
+}
@@ -8,6 +8,8 @@
 
 #include <sstream>
 #include <iomanip>
+#include <fstream>
+#include <chrono>
 
 #include "HydraObjectManager.h"
 
@@ -66,6 +68,7 @@ HRMaterialRef _hrMaterialCreateFromNode(pugi::xml_node a_node)
   mat.id = ref.id;
   g_objManager.scnData.materials.push_back(mat);
   g_objManager.scnData.materials[ref.id].update(a_node);
+  HRSceneData::add_name(g_objManager.scnData.m_materialNames, mat.name, ref.id);
 
   return ref;
 }
@@ -84,29 +87,22 @@ const std::wstring GetRealFilePathOfDelayedMesh(pugi::xml_node a_node)
 }
 
 
-HAPI HRMeshRef _hrMeshCreateFromNode(pugi::xml_node a_node)
+/**
+\brief create mesh object from xml node without adding it to scene data; reads only mesh header, so it can be called from several threads.
+*/
+static void _hrMeshFromNode(pugi::xml_node a_node, HRMesh& a_mesh)
 {
   const std::wstring filePathStr = GetRealFilePathOfDelayedMesh(a_node);
   const wchar_t* a_fileName      = filePathStr.c_str();
   const wchar_t* a_objectName    = a_node.attribute(L"name").as_string();
 
-  HRMeshRef ref;
-
-  ref.id = a_node.attribute(L"id").as_int(); //HR_IDType(g_objManager.scnData.meshes.size());
-
-  HRMesh mesh;
-  mesh.name = std::wstring(a_objectName);
-  mesh.id   = ref.id;
-  mesh.update(a_node);
-  g_objManager.scnData.meshes.push_back(mesh);
+  a_mesh.name  = std::wstring(a_objectName);
+  a_mesh.id    = a_node.attribute(L"id").as_int();
+  a_mesh.update(a_node);
+  a_mesh.pImpl = g_objManager.m_pFactory->CreateVSGFProxy(a_fileName); // delay mesh load untill it will be needed by RenderDriver::UpdateMesh
 
-  HRMesh* pMesh = &g_objManager.scnData.meshes.back();
-  pMesh->pImpl  = g_objManager.m_pFactory->CreateVSGFProxy(a_fileName); // delay mesh load untill it will be needed by RenderDriver::UpdateMesh
-
-  if (pMesh->pImpl == nullptr)
-    HrError(L"LoadExistingLibrary, _hrMeshCreateFromNode can't load mesh from location = ", a_fileName);
-
-  return ref;
+  if (a_mesh.pImpl == nullptr)
+    HrError(L"LoadExistingLibrary, _hrMeshFromNode can't load mesh from location = ", a_fileName);
 }
 
 HRLightRef _hrLightCreateFromNode(pugi::xml_node a_node)
@@ -123,6 +119,7 @@ HRLightRef _hrLightCreateFromNode(pugi::xml_node a_node)
 
   g_objManager.scnData.lights[ref.id].update(a_node);
   g_objManager.scnData.lights[ref.id].id = ref.id;
+  HRSceneData::add_name(g_objManager.scnData.m_lightNames, light.name, ref.id);
 
   return ref;
 }
@@ -142,6 +139,7 @@ HAPI HRCameraRef _hrCameraCreateFromNode(pugi::xml_node a_node)
 
   g_objManager.scnData.cameras[ref.id].update(a_node);
   g_objManager.scnData.cameras[ref.id].id = ref.id;
+  HRSceneData::add_name(g_objManager.scnData.m_cameraNames, cam.name, ref.id);
 
   return ref;
 }
@@ -152,72 +150,157 @@ HAPI HRCameraRef _hrCameraCreateFromNode(pugi::xml_node a_node)
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-HAPI void _hrMeshInstanceFromNode(HRSceneInstRef a_pScn, pugi::xml_node a_node)
+static void _hrMeshInstanceFromNode(pugi::xml_node a_node, HRSceneInst::Instance& a_model)
 {
-  HRSceneInst* pScn = g_objManager.PtrById(a_pScn);
-  if (pScn == nullptr)
-  {
-    HrError(L"hrMeshInstance: nullptr input");
-    return;
-  }
-
-  HRSceneInst::Instance model;
-  model.meshId = a_node.attribute(L"mesh_id").as_int();
+  a_model.meshId = a_node.attribute(L"mesh_id").as_int();
 
   if (a_node.attribute(L"linst_id") == nullptr)
   {
-    model.lightId     = -1;
-    model.lightInstId = -1;
+    a_model.lightId     = -1;
+    a_model.lightInstId = -1;
   }
   else
   {
-    model.lightId     = a_node.attribute(L"light_id").as_int();
-    model.lightInstId = a_node.attribute(L"linst_id").as_int();
+    a_model.lightId     = a_node.attribute(L"light_id").as_int();
+    a_model.lightInstId = a_node.attribute(L"linst_id").as_int();
   }
 
   if(a_node.attribute(L"rmap_id") == nullptr)
-    model.remapListId = -1;
+    a_model.remapListId = -1;
   else
-    model.remapListId = a_node.attribute(L"rmap_id").as_int();
-
-  /////////////////////////////////////////////////////////////////////////////////////////////
-  const wchar_t* matString = a_node.attribute(L"matrix").as_string();
-  std::wstringstream matStream(matString);
-  float a_mat[16];
-  for (int i = 0; i < 16; i++)
-    matStream >> a_mat[i];
-  /////////////////////////////////////////////////////////////////////////////////////////////
-
-  memcpy(model.m, a_mat, 16 * sizeof(float));
-  pScn->drawList.push_back(model);
+    a_model.remapListId = a_node.attribute(L"rmap_id").as_int();
+
+  a_model.scene_id  = a_node.attribute(L"scn_id").as_int(-1);
+  a_model.scene_sid = a_node.attribute(L"scn_sid").as_int(0);
+
+  HydraXMLHelpers::ReadFloats(a_node.attribute(L"matrix").as_string(), a_model.m, 16);
 }
 
-HAPI void _hrLightInstanceFromNode(HRSceneInstRef a_pScn, pugi::xml_node a_node)
+static bool _hrReadInstanceTable(pugi::xml_node a_node, const std::wstring& a_path, std::vector<HRInstanceRecord>& a_records)
 {
-  HRSceneInst* pScn = g_objManager.PtrById(a_pScn);
-  if (pScn == nullptr)
+  const size_t instNum  = size_t(a_node.attribute(L"count").as_ullong());
+  const size_t byteSize = instNum*sizeof(HRInstanceRecord);
+
+  if (byteSize != size_t(a_node.attribute(L"bytesize").as_ullong()))
   {
-    HrError(L"hrMeshInstance: nullptr input");
-    return;
+    HrError(L"_hrReadInstanceTable: bad bytesize of instance table at loc = ", a_path.c_str());
+    return false;
+  }
+
+  a_records.resize(instNum);
+  if (instNum == 0)
+    return true;
+
+  std::ifstream fin;
+  hr_ifstream_open(fin, a_path.c_str());
+  if (!fin.is_open())
+  {
+    HrError(L"_hrReadInstanceTable: can't open instance table at loc = ", a_path.c_str());
+    return false;
+  }
+
+  fin.seekg(std::streamoff(a_node.attribute(L"offset").as_ullong()));
+  fin.read((char*)a_records.data(), std::streamsize(byteSize));
+
+  if (size_t(fin.gcount()) != byteSize)
+  {
+    HrError(L"_hrReadInstanceTable: instance table is truncated, loc = ", a_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+static void _hrLightInstanceFromNode(pugi::xml_node a_node, HRSceneInst::Instance& a_model)
+{
+  a_model.lightId          = a_node.attribute(L"light_id").as_int();
+  a_model.lightGroupInstId = a_node.attribute(L"lgroup_id").as_int();
+  a_model.meshId           = -1;
+  a_model.remapListId      = -1;
+  a_model.node             = a_node;
+
+  HydraXMLHelpers::ReadFloats(a_node.attribute(L"matrix").as_string(), a_model.m, 16);
+}
+
+/**
+\brief read all instances of a scene; xml instances are parsed in parallel, each one to its own place, so the order is the same as in xml.
+*/
+static void _hrSceneInstancesFromNode(pugi::xml_node a_sceneNode, HRSceneInst& a_scn)
+{
+  struct TableInfo
+  {
+    pugi::xml_node node;
+    size_t         offset;
+  };
+
+  std::vector<pugi::xml_node> meshNodes;
+  std::vector<size_t>         meshOffsets;
+  std::vector<pugi::xml_node> lightNodes;
+  std::vector<TableInfo>      tables;
+
+  size_t drawListSize = 0;
+  for (pugi::xml_node nodeInst = a_sceneNode.first_child(); nodeInst != nullptr; nodeInst = nodeInst.next_sibling())
+  {
+    const wchar_t* nodeName = nodeInst.name();
+    if (wcscmp(nodeName, L"instance") == 0)
+    {
+      meshNodes.push_back(nodeInst);
+      meshOffsets.push_back(drawListSize);
+      drawListSize++;
+    }
+    else if (wcscmp(nodeName, L"instance_table") == 0)
+    {
+      tables.push_back({nodeInst, drawListSize});
+      drawListSize += size_t(nodeInst.attribute(L"count").as_ullong());
+    }
+    else if (wcscmp(nodeName, L"instance_light") == 0)
+      lightNodes.push_back(nodeInst);
+  }
+
+  a_scn.drawList.resize(drawListSize);
+  a_scn.m_drawListVersion++;
+  a_scn.m_remapListsVersion++;
+  a_scn.drawListLights.resize(lightNodes.size());
+
+  const int meshInstNum = int(meshNodes.size());
+  #pragma omp parallel for schedule(static, 4096)
+  for (int i = 0; i < meshInstNum; i++)
+    _hrMeshInstanceFromNode(meshNodes[i], a_scn.drawList[meshOffsets[i]]);
+
+  const int lightInstNum = int(lightNodes.size());
+  #pragma omp parallel for schedule(static, 1024)
+  for (int i = 0; i < lightInstNum; i++)
+    _hrLightInstanceFromNode(lightNodes[i], a_scn.drawListLights[i]);
+
+  // tables are big binary reads, do them one by one; remove instances of a table that can't be read as old loader did
+  //
+  std::vector<TableInfo> badTables;
+  for (const auto& table : tables)
+  {
+    std::vector<HRInstanceRecord> records;
+    if (!_hrReadInstanceTable(table.node, g_objManager.GetLoc(table.node), records))
+    {
+      badTables.push_back(table);
+      continue;
+    }
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+      const auto& rec                  = records[i];
+      HRSceneInst::Instance& model     = a_scn.drawList[table.offset + i];
+      model.meshId      = rec.meshId;
+      model.remapListId = rec.remapListId;
+      model.scene_id    = rec.sceneId;
+      model.scene_sid   = rec.sceneSid;
+      memcpy(model.m, rec.matrix, sizeof(model.m));
+    }
   }
 
-  HRSceneInst::Instance model;
-  model.lightId          = a_node.attribute(L"light_id").as_int();
-  model.lightGroupInstId = a_node.attribute(L"lgroup_id").as_int();
-  model.meshId           = -1;
-  model.remapListId      = -1;
-
-  /////////////////////////////////////////////////////////////////////////////////////////////
-  const wchar_t* matString = a_node.attribute(L"matrix").as_string();
-  std::wstringstream matStream(matString);
-  float a_mat[16];
-  for (int i = 0; i < 16; i++)
-    matStream >> a_mat[i];
-  /////////////////////////////////////////////////////////////////////////////////////////////
-
-  memcpy(model.m, a_mat, 16 * sizeof(float));
-  model.node = a_node;
-  pScn->drawListLights.push_back(model);
+  for (auto p = badTables.rbegin(); p != badTables.rend(); ++p)
+  {
+    const size_t count = size_t(p->node.attribute(L"count").as_ullong());
+    a_scn.drawList.erase(a_scn.drawList.begin() + p->offset, a_scn.drawList.begin() + p->offset + count);
+  }
 }
 
 HRRenderRef _hrRenderSettingsFromNode(pugi::xml_node a_node)
@@ -313,6 +396,8 @@ void _hrFindTargetOrLastState(const wchar_t* a_libPath, int32_t a_stateId,
 
 int32_t _hrSceneLibraryLoad(const wchar_t* a_libPath, int a_stateId, const std::wstring& a_stateFileName)
 {
+  const auto timeBegin = std::chrono::high_resolution_clock::now();
+
   // (0) (a_stateId == -1) => find last state in folder
   //
   std::wstring fileName = a_stateFileName;
@@ -350,17 +435,23 @@ int32_t _hrSceneLibraryLoad(const wchar_t* a_libPath, int a_stateId, const std::
     return -1;
   }
 
+  const auto timeXml = std::chrono::high_resolution_clock::now();
+
   if (g_objManager.m_attachMode)
     HrPrint(HR_SEVERITY_INFO, L"HydraAPI, initialising virtual buffer");
 
-  g_objManager.scnData.init_existing(g_objManager.m_attachMode, g_objManager.m_pVBSysMutex, g_objManager.m_lastInitInfo.vbSize);
+  g_objManager.scnData.init_existing(g_objManager.m_attachMode, g_objManager.m_lastInitInfo.vbSize);
+
+  const auto timeVB = std::chrono::high_resolution_clock::now();
 
   // (2) set change id to curr value
   //
   g_objManager.scnData.changeId   = stateId;
   g_objManager.scnData.m_commitId = stateId;
 
-  // (3) load textures
+  // (3) load objects; textures, materials, lights and cameras are added to global object lists, name indices and texture cache, 
+  //     so they are created serially, their ids are their order in xml as before. 
+  //     Mesh headers are only parsed from xml and '.vsgf' files to local list, so they are read in parallel chunks; meshes have explicit ids.
   //
   g_objManager.scnData.textures.reserve(HRSceneData::TEXTURES_RESERVE);
   g_objManager.scnData.meshes.reserve(HRSceneData::MESHES_RESERVE);
@@ -368,58 +459,59 @@ int32_t _hrSceneLibraryLoad(const wchar_t* a_libPath, int a_stateId, const std::
   g_objManager.scnData.materials.reserve(HRSceneData::MATERIAL_RESERVE);
   g_objManager.scnData.cameras.reserve(HRSceneData::CAMERAS_RESERVE);
 
-  if (g_objManager.m_attachMode)
-    HrPrint(HR_SEVERITY_INFO, L"HydraAPI, before system mutex lock");
-
-  if(g_objManager.m_attachMode && g_objManager.m_pVBSysMutex != nullptr)
-    hr_lock_system_mutex(g_objManager.m_pVBSysMutex, VB_LOCK_WAIT_TIME_MS); // need to lock here because _hrMeshCreateFromNode may load data from virtual buffer
-  
   if (g_objManager.m_attachMode)
     HrPrint(HR_SEVERITY_INFO, L"HydraAPI, loading objects from xml ... ");
 
+  std::vector<pugi::xml_node> meshNodes;
+  for (pugi::xml_node node = g_objManager.scnData.m_geometryLib.first_child(); node != nullptr; node = node.next_sibling())
+    if(node.attribute(L"id") != nullptr)
+      meshNodes.push_back(node);
+
   for (pugi::xml_node node = g_objManager.scnData.m_texturesLib.first_child(); node != nullptr; node = node.next_sibling())
     if(node.attribute(L"id") != nullptr)
       _hrTexture2DCreateFromNode(node);
 
-  // (4) load materials
-  //
   for (pugi::xml_node node = g_objManager.scnData.m_materialsLib.first_child(); node != nullptr; node = node.next_sibling())
     if(node.attribute(L"id") != nullptr)
       _hrMaterialCreateFromNode(node);
 
-  // (5) load geom
-  //
-  for (pugi::xml_node node = g_objManager.scnData.m_geometryLib.first_child(); node != nullptr; node = node.next_sibling())
-    if(node.attribute(L"id") != nullptr)
-      _hrMeshCreateFromNode(node);
-
-  std::sort(
-          g_objManager.scnData.meshes.begin(), g_objManager.scnData.meshes.end(),
-          [&](auto a, auto b) { return a.id < b.id; });
-
-  // (6) load lights
-  //
   for (pugi::xml_node node = g_objManager.scnData.m_lightsLib.first_child(); node != nullptr; node = node.next_sibling())
     _hrLightCreateFromNode(node);
 
-  // (7) load camera
-  //
   for (pugi::xml_node node = g_objManager.scnData.m_cameraLib.first_child(); node != nullptr; node = node.next_sibling())
     _hrCameraCreateFromNode(node);
 
+  std::vector<HRMesh> meshes(meshNodes.size());
+
+  const int MESH_CHUNK_SIZE = 64;
+  const int meshChunks      = int(meshNodes.size() + MESH_CHUNK_SIZE - 1) / MESH_CHUNK_SIZE;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int job = 0; job < meshChunks; job++)
+  {
+    const size_t begin = size_t(job)*MESH_CHUNK_SIZE;
+    const size_t end   = std::min(begin + MESH_CHUNK_SIZE, meshNodes.size());
+    for (size_t i = begin; i < end; i++)
+      _hrMeshFromNode(meshNodes[i], meshes[i]);
+  }
+
+  // merge meshes in id order
+  //
+  std::sort(meshes.begin(), meshes.end(), [](const HRMesh& a, const HRMesh& b) { return a.id < b.id; });
+  g_objManager.scnData.meshes.insert(g_objManager.scnData.meshes.end(), std::make_move_iterator(meshes.begin()), std::make_move_iterator(meshes.end()));
+  meshes = std::vector<HRMesh>();
+
+  const auto timeObjects = std::chrono::high_resolution_clock::now();
+
   g_objManager.scnInst.resize(0);
-  
-  if(g_objManager.m_attachMode && g_objManager.m_pVBSysMutex != nullptr)
-    hr_unlock_system_mutex(g_objManager.m_pVBSysMutex);
 
   if (g_objManager.m_attachMode)
     HrPrint(HR_SEVERITY_INFO, L"HydraAPI, generating instances");
 
-  // (8) load instanced objects (i.e. scenes)
+  // (4) load instanced objects (i.e. scenes)
   //
   for (pugi::xml_node node = g_objManager.scnData.m_sceneNode.first_child(); node != nullptr; node = node.next_sibling())
   {
-
     HRSceneInstRef a_pScn;
     a_pScn.id = HR_IDType(g_objManager.scnInst.size());
 
@@ -429,29 +521,20 @@ int32_t _hrSceneLibraryLoad(const wchar_t* a_libPath, int a_stateId, const std::
 
     g_objManager.scnInst.push_back(scn);
 
-    /*g_objManager.scnInst.push_back(HRSceneInst());
-
-    HRSceneInstRef a_pScn;
-    a_pScn.id = HR_IDType(g_objManager.scnInst.size()-1);*/
-
-    for (pugi::xml_node nodeInst = node.first_child(); nodeInst != nullptr; nodeInst = nodeInst.next_sibling())
-    {
-      if (std::wstring(nodeInst.name()) == L"instance")
-        _hrMeshInstanceFromNode(a_pScn, nodeInst);
-      else if (std::wstring(nodeInst.name()) == L"instance_light")
-        _hrLightInstanceFromNode(a_pScn, nodeInst);
-    }
+    _hrSceneInstancesFromNode(node, g_objManager.scnInst[a_pScn.id]);
     
     g_objManager.scnInst[a_pScn.id].driverDirtyFlag = true; // driver need to Update this scene
     g_objManager.scnInst[a_pScn.id].update(node);
   }
 
-  // (9) load render settings
+  const auto timeInstances = std::chrono::high_resolution_clock::now();
+
+  // (5) load render settings
   //
   for(pugi::xml_node renderSettings : g_objManager.scnData.m_settingsNode.children())
     _hrRenderSettingsFromNode(renderSettings);
 
-  // (10) load empty chunks to have correct chunk id for new objects if we are not in 'attach mode'
+  // (6) load empty chunks to have correct chunk id for new objects if we are not in 'attach mode'
   //
   if(!g_objManager.m_attachMode)
   {
@@ -459,6 +542,25 @@ int32_t _hrSceneLibraryLoad(const wchar_t* a_libPath, int a_stateId, const std::
     g_objManager.scnData.m_vbCache.ResizeAndAllocEmptyChunks(chunks);
   }
   
+  // (7) remember time of each phase, see hrSceneLibraryInfo()
+  //
+  auto elapsedMs = [](std::chrono::high_resolution_clock::time_point a_begin, std::chrono::high_resolution_clock::time_point a_end)
+  {
+    return float(std::chrono::duration_cast<std::chrono::microseconds>(a_end - a_begin).count())/1000.0f;
+  };
+
+  HRLibraryLoadTimes& times = g_objManager.scnData.m_loadTimes;
+  times.xmlParse      = elapsedMs(timeBegin,     timeXml);
+  times.virtualBuffer = elapsedMs(timeXml,       timeVB);
+  times.objects       = elapsedMs(timeVB,        timeObjects);
+  times.instances     = elapsedMs(timeObjects,   timeInstances);
+  times.total         = elapsedMs(timeBegin,     std::chrono::high_resolution_clock::now());
+
+  std::wstringstream timesOut;
+  timesOut << std::fixed << std::setprecision(2) << L"HydraAPI, library loaded in " << times.total << L" ms: xml = " << times.xmlParse 
+           << L" ms, virtual buffer = " << times.virtualBuffer << L" ms, objects = " << times.objects << L" ms, instances = " << times.instances << L" ms";
+  HrPrint(HR_SEVERITY_INFO, timesOut.str().c_str());
+
   return 0;
 }
 
@@ -728,6 +830,26 @@ void _hrInstanceMergeFromNode(HRSceneInstRef a_scn, pugi::xml_node a_node, int32
 }
 
 
+void _hrInstanceTableMergeFromNode(HRSceneInstRef a_scn, pugi::xml_node a_node, const std::wstring &a_libPath, int32_t numMeshesPreMerge,
+                                   const std::vector<std::vector<int> > &remap_lists)
+{
+  std::vector<HRInstanceRecord> records;
+  if (!_hrReadInstanceTable(a_node, a_libPath + L"/" + a_node.attribute(L"loc").as_string(), records))
+    return;
+
+  for (auto& rec : records)
+  {
+    HRMeshRef ref;
+    ref.id = rec.meshId + numMeshesPreMerge;
+
+    if (rec.remapListId == -1)
+      hrMeshInstance(a_scn, ref, rec.matrix);
+    else
+      hrMeshInstance(a_scn, ref, rec.matrix, &remap_lists.at((unsigned long) rec.remapListId)[0],
+                     int32_t(remap_lists.at((unsigned long) rec.remapListId).size()));
+  }
+}
+
 HRSceneInstRef HRUtils::MergeLibraryIntoLibrary(const wchar_t* a_libPath, bool mergeLights, bool copyScene,
                                                 const wchar_t* a_stateFileName, MergeInfo* pInfo)
 {
@@ -829,6 +951,10 @@ HRSceneInstRef HRUtils::MergeLibraryIntoLibrary(const wchar_t* a_libPath, bool m
           }*/
         }
       }
+      else if(node.name() == std::wstring(L"instance_table"))
+      {
+        _hrInstanceTableMergeFromNode(mergedScn, node, std::wstring(a_libPath), numMeshesPreMerge, remap_lists);
+      }
       else
       {
         _hrInstanceMergeFromNode(mergedScn, node, numMeshesPreMerge, remap_lists, mergeLights, numLightsPreMerge);
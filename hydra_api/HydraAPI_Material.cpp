@@ -39,6 +39,7 @@ HAPI HRMaterialRef hrMaterialCreate(const wchar_t* a_objectName)
   mat.name = std::wstring(a_objectName);
   mat.id = ref.id;
   g_objManager.scnData.materials.push_back(mat);
+  HRSceneData::add_name(g_objManager.scnData.m_materialNames, mat.name, ref.id);
 
   pugi::xml_node matNodeXml = g_objManager.materials_lib_append_child();
 
@@ -80,6 +81,7 @@ HAPI HRMaterialRef hrMaterialCreateBlend(const wchar_t* a_objectName, HRMaterial
   mat.name = std::wstring(a_objectName);
   mat.id = ref.id;
   g_objManager.scnData.materials.push_back(mat);
+  HRSceneData::add_name(g_objManager.scnData.m_materialNames, mat.name, ref.id);
 
 
   pugi::xml_node matNodeXml = g_objManager.materials_lib_append_child();
@@ -248,6 +250,10 @@ HAPI void hrMaterialClose(HRMaterialRef a_pMat)
 
   auto matNode = pMat->xml_node();
   VerifyTex(a_pMat.id, matNode);
+
+  const std::wstring nameInXml = matNode.attribute(L"name").as_string();
+  if (!nameInXml.empty() && nameInXml != pMat->name)
+    HRSceneData::rename_object(g_objManager.scnData.materials, g_objManager.scnData.m_materialNames, pMat->id, nameInXml);
   
   pMat->opened     = false;
   pMat->pImpl      = nullptr;
@@ -277,18 +283,7 @@ HAPI pugi::xml_node hrMaterialParamNode(HRMaterialRef a_matRef)
 HAPI HRMaterialRef hrFindMaterialByName(const wchar_t *a_matName)
 {
   HRMaterialRef material;
-
-  if(a_matName != nullptr)
-  {
-    for (auto mat : g_objManager.scnData.materials)
-    {
-      if (mat.name == std::wstring(a_matName))
-      {
-        material.id = mat.id;
-        break;
-      }
-    }
-  }
+  material.id = HRSceneData::find_name(g_objManager.scnData.m_materialNames, a_matName);
 
   if(material.id == -1)
   {
@@ -298,4 +293,25 @@ HAPI HRMaterialRef hrFindMaterialByName(const wchar_t *a_matName)
   }
 
   return material;
-}
\ No newline at end of file
+}
+
+HAPI int32_t hrFindMaterialsByName(const wchar_t** a_matNames, int32_t a_namesNum, HRMaterialRef* a_outRefs)
+{
+  if (a_matNames == nullptr || a_outRefs == nullptr)
+  {
+    HrError(L"hrFindMaterialsByName: nullptr input");
+    return 0;
+  }
+
+  const auto& index = g_objManager.scnData.m_materialNames;
+  int32_t found     = 0;
+
+  for (int32_t i = 0; i < a_namesNum; i++)
+  {
+    a_outRefs[i].id = HRSceneData::find_name(index, a_matNames[i]);
+    if (a_outRefs[i].id != -1)
+      found++;
+  }
+
+  return found;
+}
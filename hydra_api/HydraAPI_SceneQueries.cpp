@@ -0,0 +1,557 @@
+#include "HydraAPI.h"
+#include "HydraInternal.h"
+
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "LiteMath.h"
+using namespace HydraLiteMath;
+
+#include "HydraObjectManager.h"
+#include "HydraXMLHelpers.h"
+#include "HydraBVH.h"
+
+#ifdef WIN32
+#undef min
+#undef max
+#endif
+
+extern HRObjectManager g_objManager;
+
+using HydraBVH::Box3f;
+using HydraBVH::BVHNode;
+using HydraBVH::TriangleBVH;
+
+constexpr int      SPATIAL_STACK_SIZE   = 128; ///< HydraBVH trees are not deeper than this
+constexpr uint32_t SPATIAL_TLAS_MAX_LEAF = 4;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+\brief true if BLAS was built (or was tried to build, if mesh data were not available) for current mesh data.
+*/
+static bool MeshBLASIsActual(const HRMesh& a_mesh)
+{
+  if (a_mesh.pImpl == nullptr)
+    return true;
+  return !a_mesh.m_blasSource.expired() && a_mesh.m_blasSource.lock() == a_mesh.pImpl;
+}
+
+/**
+\brief (re)build BLAS for meshes whose data were changed; mesh data are copied one by one because reading next mesh may page previous one out.
+*/
+static void UpdateMeshBLASes(const std::vector<int32_t>& a_meshIds)
+{
+  struct BuildJob
+  {
+    int32_t            meshId;
+    std::vector<float> pos4f;
+    std::vector<int>   indices;
+    std::shared_ptr<TriangleBVH> blas;
+  };
+
+  std::vector<BuildJob> jobs;
+
+  for (int32_t meshId : a_meshIds)
+  {
+    HRMesh& mesh = g_objManager.scnData.meshes[meshId];
+    if (mesh.pImpl == nullptr || MeshBLASIsActual(mesh))
+      continue;
+
+    mesh.m_blas       = nullptr;
+    mesh.m_blasSource = mesh.pImpl; // don't page mesh in again on each query if it can't be read
+
+    const HRMeshDataPin meshData((size_t)meshId);
+    const HRMeshDriverInput& input = meshData.input;
+    if (input.pos4f == nullptr || input.indices == nullptr || input.triNum <= 0)
+      continue;
+
+    bool badIndex = false;
+    for (int i = 0; i < input.triNum * 3; i++)
+      badIndex = badIndex || (input.indices[i] < 0 || input.indices[i] >= input.vertNum);
+
+    if (badIndex)
+    {
+      HrPrint(HR_SEVERITY_WARNING, L"sceneUpdateSpatialIndex: bad vertex index in mesh ", meshId);
+      continue;
+    }
+
+    BuildJob job;
+    job.meshId = meshId;
+    job.pos4f.assign(input.pos4f, input.pos4f + size_t(input.vertNum) * 4);
+    job.indices.assign(input.indices, input.indices + size_t(input.triNum) * 3);
+    if (meshData.IsTorn()) // attached process: owner moved mesh chunk while it was copied; try again on the next query
+    {
+      mesh.m_blasSource.reset();
+      continue;
+    }
+    jobs.push_back(std::move(job));
+  }
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < int(jobs.size()); i++)
+  {
+    jobs[i].blas = std::make_shared<TriangleBVH>();
+    jobs[i].blas->Build(jobs[i].pos4f.data(), jobs[i].indices.data(), int(jobs[i].indices.size() / 3));
+    jobs[i].pos4f   = std::vector<float>();
+    jobs[i].indices = std::vector<int>();
+  }
+
+  for (auto& job : jobs)
+  {
+    HRMesh& mesh = g_objManager.scnData.meshes[job.meshId];
+    mesh.m_blas  = job.blas;
+  }
+}
+
+/**
+\brief mesh box in object space; meshes without data in memory use bbox from xml.
+*/
+static Box3f MeshLocalBox(HRMesh& a_mesh)
+{
+  if (a_mesh.m_blas != nullptr && !a_mesh.m_blas->tree.nodes.empty())
+    return a_mesh.m_blas->tree.RootBox();
+
+  BBox bbox;
+  HydraXMLHelpers::ReadBBox(a_mesh.xml_node(), bbox);
+  if (bbox.x_min > bbox.x_max && a_mesh.pImpl != nullptr)
+    bbox = a_mesh.pImpl->getBBox();
+
+  Box3f res;
+  if (bbox.x_min <= bbox.x_max)
+  {
+    res.boxMin[0] = bbox.x_min; res.boxMin[1] = bbox.y_min; res.boxMin[2] = bbox.z_min;
+    res.boxMax[0] = bbox.x_max; res.boxMax[1] = bbox.y_max; res.boxMax[2] = bbox.z_max;
+  }
+  return res;
+}
+
+/**
+\brief transform box with center and extent instead of 8 corners.
+*/
+static inline Box3f TransformBox(const Box3f& a_box, const float a_m[16])
+{
+  Box3f res;
+  if (a_box.empty())
+    return res;
+
+  for (int row = 0; row < 3; row++)
+  {
+    float center = a_m[row * 4 + 3];
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++)
+    {
+      center += a_m[row * 4 + k] * 0.5f*(a_box.boxMax[k] + a_box.boxMin[k]);
+      extent += fabsf(a_m[row * 4 + k]) * 0.5f*(a_box.boxMax[k] - a_box.boxMin[k]);
+    }
+    res.boxMin[row] = center - extent;
+    res.boxMax[row] = center + extent;
+  }
+  return res;
+}
+
+static void UpdateSpatialIndex(HRSceneInst& a_scn)
+{
+  auto& meshes   = g_objManager.scnData.meshes;
+  auto& drawList = a_scn.drawList;
+
+  if (a_scn.m_spatial == nullptr)
+    a_scn.m_spatial = std::make_shared<HRSceneInst::SpatialIndex>();
+
+  HRSceneInst::SpatialIndex& index = *a_scn.m_spatial;
+
+  // (1) nothing changed in the draw list, only mesh data could be rewritten
+  //
+  const bool sameDrawList = (index.drawListVersion == a_scn.m_drawListVersion) && (index.meshIds.size() == drawList.size());
+
+  std::vector<int32_t> usedMeshes;
+  if (sameDrawList)
+  {
+    bool meshDataChanged = false;
+    for (int32_t meshId : index.usedMeshes)
+      meshDataChanged = meshDataChanged || !MeshBLASIsActual(meshes[meshId]);
+    if (!meshDataChanged)
+      return;
+    usedMeshes = index.usedMeshes;
+  }
+  else
+  {
+    std::vector<char> meshIsUsed(meshes.size(), 0);
+    for (const auto& inst : drawList)
+    {
+      if (inst.meshId >= 0 && size_t(inst.meshId) < meshes.size())
+        meshIsUsed[inst.meshId] = 1;
+    }
+    for (size_t i = 0; i < meshIsUsed.size(); i++)
+    {
+      if (meshIsUsed[i])
+        usedMeshes.push_back(int32_t(i));
+    }
+  }
+
+  UpdateMeshBLASes(usedMeshes);
+
+  std::vector<Box3f> meshBoxes(meshes.size());
+  for (int32_t meshId : usedMeshes)
+    meshBoxes[meshId] = MeshLocalBox(meshes[meshId]);
+
+  // (2) world boxes of all instances
+  //
+  const int64_t instNum = int64_t(drawList.size());
+  index.instBoxes.resize(drawList.size());
+
+  const bool sameSize   = (index.meshIds.size() == drawList.size()) && !index.tlas.nodes.empty();
+  int64_t    changedNum = 0;
+  int64_t    validNum   = 0;
+
+  #pragma omp parallel for reduction(+:changedNum, validNum)
+  for (int64_t i = 0; i < instNum; i++)
+  {
+    const auto& inst = drawList[i];
+    const bool  haveMesh = (inst.meshId >= 0 && size_t(inst.meshId) < meshes.size());
+    index.instBoxes[i] = haveMesh ? TransformBox(meshBoxes[inst.meshId], inst.m) : Box3f();
+    validNum          += index.instBoxes[i].empty() ? 0 : 1;
+    changedNum        += (sameSize && index.meshIds[i] == inst.meshId) ? 0 : 1;
+  }
+
+  // (3) refit if the same meshes are at the same places of the draw list, otherwise rebuild
+  //
+  if (changedNum == 0 && sameSize && size_t(validNum) == index.tlas.primIndices.size())
+    index.tlas.Refit(index.instBoxes.data());
+  else
+  {
+    index.tlas.Build(index.instBoxes.data(), uint32_t(drawList.size()), SPATIAL_TLAS_MAX_LEAF);
+    index.meshIds.resize(drawList.size());
+    for (size_t i = 0; i < drawList.size(); i++)
+      index.meshIds[i] = drawList[i].meshId;
+  }
+
+  index.usedMeshes      = usedMeshes;
+  index.drawListVersion = a_scn.m_drawListVersion;
+}
+
+static HRSceneInst* SceneForQuery(HRSceneInstRef a_scn, const wchar_t* a_funcName)
+{
+  HRSceneInst* pScn = g_objManager.PtrById(a_scn);
+  if (pScn == nullptr)
+  {
+    HrError(std::wstring(a_funcName) + L": nullptr input");
+    return nullptr;
+  }
+
+  if (pScn->opened)
+  {
+    HrError(std::wstring(a_funcName) + L": scene is opened; close it before queries");
+    return nullptr;
+  }
+
+  UpdateSpatialIndex(*pScn);
+  return pScn;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline float RayBoxEntry(const float a_boxMin[3], const float a_boxMax[3], const float3& a_pos, const float3& a_invDir, float a_tMax)
+{
+  const float tx1 = (a_boxMin[0] - a_pos.x)*a_invDir.x, tx2 = (a_boxMax[0] - a_pos.x)*a_invDir.x;
+  const float ty1 = (a_boxMin[1] - a_pos.y)*a_invDir.y, ty2 = (a_boxMax[1] - a_pos.y)*a_invDir.y;
+  const float tz1 = (a_boxMin[2] - a_pos.z)*a_invDir.z, tz2 = (a_boxMax[2] - a_pos.z)*a_invDir.z;
+
+  const float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+  const float tFar  = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), a_tMax));
+
+  return (tNear <= tFar) ? tNear : std::numeric_limits<float>::infinity();
+}
+
+static inline float3 SafeInverse(const float3& a_dir)
+{
+  auto inv = [](float x) { return 1.0f / ((fabsf(x) > 1e-20f) ? x : (x >= 0.0f ? 1e-20f : -1e-20f)); };
+  return float3(inv(a_dir.x), inv(a_dir.y), inv(a_dir.z));
+}
+
+/**
+\brief depth first traversal of nodes that are hit closer than current t; children are visited near first.
+\param a_leaf - void(uint32_t first, uint32_t num, float& tMax)
+*/
+template<typename LeafFunc>
+static void TraverseRay(const std::vector<BVHNode>& a_nodes, const float3& a_pos, const float3& a_dir, float& a_tMax, LeafFunc a_leaf)
+{
+  if (a_nodes.empty())
+    return;
+
+  const float3 invDir = SafeInverse(a_dir);
+
+  uint32_t stack[SPATIAL_STACK_SIZE];
+  float    stackT[SPATIAL_STACK_SIZE];
+  int      top = 0;
+
+  stackT[top] = RayBoxEntry(a_nodes[0].boxMin, a_nodes[0].boxMax, a_pos, invDir, a_tMax);
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    --top;
+    if (stackT[top] > a_tMax) // closer hit was found after this node was pushed
+      continue;
+
+    const BVHNode& node = a_nodes[stack[top]];
+    if (node.primsNum != 0)
+    {
+      a_leaf(node.leftOrFirst, node.primsNum, a_tMax);
+      continue;
+    }
+
+    const uint32_t left  = node.leftOrFirst;
+    const uint32_t right = node.leftOrFirst + 1;
+    const float    tL    = RayBoxEntry(a_nodes[left].boxMin,  a_nodes[left].boxMax,  a_pos, invDir, a_tMax);
+    const float    tR    = RayBoxEntry(a_nodes[right].boxMin, a_nodes[right].boxMax, a_pos, invDir, a_tMax);
+
+    if (tL <= tR)
+    {
+      if (tR <= a_tMax) { stack[top] = right; stackT[top++] = tR; }
+      if (tL <= a_tMax) { stack[top] = left;  stackT[top++] = tL; }
+    }
+    else
+    {
+      if (tL <= a_tMax) { stack[top] = left;  stackT[top++] = tL; }
+      if (tR <= a_tMax) { stack[top] = right; stackT[top++] = tR; }
+    }
+  }
+}
+
+bool HRUtils::scenePickRay(HRSceneInstRef a_scn, const float a_rayPos[3], const float a_rayDir[3], PickResult* a_pResult, float a_tMax)
+{
+  PickResult res;
+  res.instId = -1;
+  res.meshId = -1;
+  res.triId  = -1;
+  res.t      = a_tMax;
+  res.u      = 0.0f;
+  res.v      = 0.0f;
+
+  if (a_pResult != nullptr)
+    (*a_pResult) = res;
+
+  if (a_rayPos == nullptr || a_rayDir == nullptr)
+  {
+    HrError(L"HRUtils::scenePickRay: nullptr ray");
+    return false;
+  }
+
+  HRSceneInst* pScn = SceneForQuery(a_scn, L"HRUtils::scenePickRay");
+  if (pScn == nullptr)
+    return false;
+
+  const HRSceneInst::SpatialIndex& index = *pScn->m_spatial;
+  const auto& meshes = g_objManager.scnData.meshes;
+
+  const float3 rayPos(a_rayPos);
+  const float3 rayDir(a_rayDir);
+  float tBest = a_tMax;
+
+  TraverseRay(index.tlas.nodes, rayPos, rayDir, tBest, [&](uint32_t a_first, uint32_t a_num, float& a_tBest)
+  {
+    for (uint32_t i = a_first; i < a_first + a_num; i++)
+    {
+      const uint32_t instId = index.tlas.primIndices[i];
+      const auto&    inst   = pScn->drawList[instId];
+      const Box3f&   box    = index.instBoxes[instId];
+
+      const float tBox = RayBoxEntry(box.boxMin, box.boxMax, rayPos, SafeInverse(rayDir), a_tBest);
+      if (tBox > a_tBest)
+        continue;
+
+      const auto& blas = meshes[inst.meshId].m_blas;
+      if (blas == nullptr) // mesh data were not available, box is the best we can do
+      {
+        a_tBest    = tBox;
+        res.instId = int32_t(instId);
+        res.meshId = inst.meshId;
+        res.triId  = -1;
+        res.t      = tBox;
+        res.u      = res.v = 0.0f;
+        continue;
+      }
+
+      // object space ray is not normalized, so t is the same as in world space
+      //
+      const float4x4 invMatrix = inverse4x4(float4x4(inst.m));
+      const float3   localPos  = mul(invMatrix, rayPos);
+      const float3   localDir  = mul3x3(invMatrix, rayDir);
+
+      TraverseRay(blas->tree.nodes, localPos, localDir, a_tBest, [&](uint32_t a_firstTri, uint32_t a_numTri, float& a_tBestTri)
+      {
+        for (uint32_t j = a_firstTri; j < a_firstTri + a_numTri; j++)
+        {
+          const float4* tri = &blas->triData[j * 3];
+          const float3  e1(tri[1].x, tri[1].y, tri[1].z);
+          const float3  e2(tri[2].x, tri[2].y, tri[2].z);
+          const float3  p   = cross(localDir, e2);
+          const float   det = dot(e1, p);
+          if (det == 0.0f)
+            continue;
+
+          const float  invDet = 1.0f / det;
+          const float3 s      = localPos - float3(tri[0].x, tri[0].y, tri[0].z);
+          const float  u      = dot(s, p)*invDet;
+          const float3 q      = cross(s, e1);
+          const float  v      = dot(localDir, q)*invDet;
+          const float  t      = dot(e2, q)*invDet;
+
+          if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < a_tBestTri)
+          {
+            a_tBestTri = t;
+            res.instId = int32_t(instId);
+            res.meshId = inst.meshId;
+            res.triId  = int32_t(blas->triIndex[j]);
+            res.t      = t;
+            res.u      = u;
+            res.v      = v;
+          }
+        }
+      });
+    }
+  });
+
+  if (a_pResult != nullptr)
+    (*a_pResult) = res;
+
+  return res.instId >= 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+\brief collect instances of a_root subtree that pass a_test; subtrees with a_contains == true are taken without tests.
+\param a_overlaps - bool(const float boxMin[3], const float boxMax[3])
+\param a_contains - bool(const float boxMin[3], const float boxMax[3]); may return false if not sure
+*/
+template<typename OverlapFunc, typename ContainsFunc>
+static void CollectInstances(const HRSceneInst::SpatialIndex& a_index, OverlapFunc a_overlaps, ContainsFunc a_contains, std::vector<int32_t>& a_out)
+{
+  const auto& nodes = a_index.tlas.nodes;
+  if (nodes.empty())
+    return;
+
+  uint32_t stack[SPATIAL_STACK_SIZE];
+  bool     inside[SPATIAL_STACK_SIZE];
+  int      top = 0;
+
+  stack[top]    = 0;
+  inside[top++] = false;
+
+  while (top > 0)
+  {
+    --top;
+    const BVHNode& node     = nodes[stack[top]];
+    bool           isInside = inside[top];
+
+    if (!isInside)
+    {
+      if (!a_overlaps(node.boxMin, node.boxMax))
+        continue;
+      isInside = a_contains(node.boxMin, node.boxMax);
+    }
+
+    if (node.primsNum == 0)
+    {
+      stack[top] = node.leftOrFirst + 1; inside[top++] = isInside;
+      stack[top] = node.leftOrFirst + 0; inside[top++] = isInside;
+      continue;
+    }
+
+    for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.primsNum; i++)
+    {
+      const uint32_t instId = a_index.tlas.primIndices[i];
+      const Box3f&   box    = a_index.instBoxes[instId];
+      if (isInside || a_overlaps(box.boxMin, box.boxMax))
+        a_out.push_back(int32_t(instId));
+    }
+  }
+}
+
+void HRUtils::sceneFrustumCull(HRSceneInstRef a_scn, const float a_worldViewProj[16], std::vector<int32_t>& a_outInstances)
+{
+  a_outInstances.clear();
+
+  if (a_worldViewProj == nullptr)
+  {
+    HrError(L"HRUtils::sceneFrustumCull: nullptr matrix");
+    return;
+  }
+
+  HRSceneInst* pScn = SceneForQuery(a_scn, L"HRUtils::sceneFrustumCull");
+  if (pScn == nullptr)
+    return;
+
+  // planes from rows of clip matrix (Gribb-Hartmann); point is inside if dot(plane.xyz, p) + plane.w >= 0 for all planes
+  //
+  const float4x4 m(a_worldViewProj);
+  const float4 planes[6] = { m.row[3] + m.row[0], m.row[3] - m.row[0],
+                             m.row[3] + m.row[1], m.row[3] - m.row[1],
+                             m.row[3] + m.row[2], m.row[3] - m.row[2] };
+
+  auto overlaps = [&planes](const float a_boxMin[3], const float a_boxMax[3])
+  {
+    for (int k = 0; k < 6; k++)
+    {
+      const float4& pl = planes[k];
+      const float   d  = pl.x*(pl.x >= 0.0f ? a_boxMax[0] : a_boxMin[0]) + pl.y*(pl.y >= 0.0f ? a_boxMax[1] : a_boxMin[1]) + pl.z*(pl.z >= 0.0f ? a_boxMax[2] : a_boxMin[2]) + pl.w;
+      if (d < 0.0f)
+        return false;
+    }
+    return true;
+  };
+
+  auto contains = [&planes](const float a_boxMin[3], const float a_boxMax[3])
+  {
+    for (int k = 0; k < 6; k++)
+    {
+      const float4& pl = planes[k];
+      const float   d  = pl.x*(pl.x >= 0.0f ? a_boxMin[0] : a_boxMax[0]) + pl.y*(pl.y >= 0.0f ? a_boxMin[1] : a_boxMax[1]) + pl.z*(pl.z >= 0.0f ? a_boxMin[2] : a_boxMax[2]) + pl.w;
+      if (d < 0.0f)
+        return false;
+    }
+    return true;
+  };
+
+  CollectInstances(*pScn->m_spatial, overlaps, contains, a_outInstances);
+}
+
+void HRUtils::sceneBoxOverlap(HRSceneInstRef a_scn, const BBox& a_box, std::vector<int32_t>& a_outInstances)
+{
+  a_outInstances.clear();
+
+  HRSceneInst* pScn = SceneForQuery(a_scn, L"HRUtils::sceneBoxOverlap");
+  if (pScn == nullptr)
+    return;
+
+  const float qMin[3] = { a_box.x_min, a_box.y_min, a_box.z_min };
+  const float qMax[3] = { a_box.x_max, a_box.y_max, a_box.z_max };
+
+  auto overlaps = [&](const float a_boxMin[3], const float a_boxMax[3])
+  {
+    return a_boxMin[0] <= qMax[0] && a_boxMax[0] >= qMin[0] &&
+           a_boxMin[1] <= qMax[1] && a_boxMax[1] >= qMin[1] &&
+           a_boxMin[2] <= qMax[2] && a_boxMax[2] >= qMin[2];
+  };
+
+  auto contains = [&](const float a_boxMin[3], const float a_boxMax[3])
+  {
+    return a_boxMin[0] >= qMin[0] && a_boxMax[0] <= qMax[0] &&
+           a_boxMin[1] >= qMin[1] && a_boxMax[1] <= qMax[1] &&
+           a_boxMin[2] >= qMin[2] && a_boxMax[2] <= qMax[2];
+  };
+
+  CollectInstances(*pScn->m_spatial, overlaps, contains, a_outInstances);
+}
+
+void HRUtils::sceneUpdateSpatialIndex(HRSceneInstRef a_scn)
+{
+  SceneForQuery(a_scn, L"HRUtils::sceneUpdateSpatialIndex");
+}
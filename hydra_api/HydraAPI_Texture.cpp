@@ -284,6 +284,7 @@ HAPI HRTextureNodeRef hrTexture2DUpdateFromMemory(HRTextureNodeRef currentRef, i
 
     if (pImpl != nullptr)
     {
+      ChunkPin texData(g_objManager.scnData.m_vbCache, size_t(pImpl->chunkId()));
       const void* data     = pImpl->GetData();
       const size_t texSize = pImpl->DataSizeInBytes();
 
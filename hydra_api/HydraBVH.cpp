@@ -0,0 +1,357 @@
+#include "HydraBVH.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using HydraLiteMath::float4;
+
+namespace HydraBVH
+{
+  constexpr int      SAH_BINS      = 16;
+  constexpr uint32_t MAX_SAH_DEPTH = 48; ///< deeper nodes are split by median, so the depth is bounded by MAX_SAH_DEPTH + log2(primsNum)
+  constexpr uint32_t PARALLEL_TASK_MIN = 65536; ///< smaller subtrees are built by the thread that split their parent
+
+  static inline bool BoxIsFinite(const Box3f& a_box)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      if (!std::isfinite(a_box.boxMin[k]) || !std::isfinite(a_box.boxMax[k]))
+        return false;
+    }
+    return true;
+  }
+
+  static inline void WriteBox(BVHNode& a_node, const Box3f& a_box)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      a_node.boxMin[k] = a_box.boxMin[k];
+      a_node.boxMax[k] = a_box.boxMax[k];
+    }
+  }
+
+  Box3f BVHTree::RootBox() const
+  {
+    Box3f res;
+    if (nodes.empty())
+      return res;
+    for (int k = 0; k < 3; k++)
+    {
+      res.boxMin[k] = nodes[0].boxMin[k];
+      res.boxMax[k] = nodes[0].boxMax[k];
+    }
+    return res;
+  }
+
+  struct BuildTask { uint32_t node, begin, end, depth; };
+
+  /**
+  \brief primitive box with its index; builder partitions these records instead of indices, so that all passes over a node read memory sequentially.
+  */
+  struct PrimRef
+  {
+    float    boxMin[3];
+    uint32_t id;
+    float    boxMax[3];
+    float    dummy;
+
+    inline float centroid(int a_axis) const { return 0.5f*(boxMin[a_axis] + boxMax[a_axis]); }
+  };
+
+  struct BuildContext
+  {
+    PrimRef*               prims;
+    BVHNode*               nodes;
+    std::atomic<uint32_t>* nodesNum;
+    uint32_t               maxLeafSize;
+  };
+
+  struct Bin
+  {
+    Box3f    box;
+    uint32_t count;
+
+    inline void clear() { box = Box3f(); count = 0; }
+  };
+
+  static inline void IncludeRef(Box3f& a_box, const PrimRef& a_ref)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      a_box.boxMin[k] = std::min(a_box.boxMin[k], a_ref.boxMin[k]);
+      a_box.boxMax[k] = std::max(a_box.boxMax[k], a_ref.boxMax[k]);
+    }
+  }
+
+  /**
+  \brief build subtree of a_root; big right subtrees are given to other threads as OpenMP tasks.
+  */
+  static void BuildSubtree(const BuildContext* a_ctx, BuildTask a_root)
+  {
+    PrimRef* prims = a_ctx->prims;
+    BVHNode* nodes = a_ctx->nodes;
+
+    std::vector<BuildTask> stack;
+    stack.push_back(a_root);
+
+    while (!stack.empty())
+    {
+      const BuildTask task = stack.back();
+      stack.pop_back();
+
+      Box3f box, centroidBox;
+      for (uint32_t i = task.begin; i < task.end; i++)
+      {
+        IncludeRef(box, prims[i]);
+        const float centroid[3] = { prims[i].centroid(0), prims[i].centroid(1), prims[i].centroid(2) };
+        centroidBox.include(centroid);
+      }
+
+      WriteBox(nodes[task.node], box);
+
+      const uint32_t count = task.end - task.begin;
+      if (count == 1)
+      {
+        nodes[task.node].leftOrFirst = task.begin;
+        nodes[task.node].primsNum    = count;
+        continue;
+      }
+
+      // find best split plane with binned SAH; all 3 axes are binned in one pass;
+      // most nodes are small, so they use less bins to keep the cost per node proportional to its size
+      //
+      const int binsNum = std::min(SAH_BINS, std::max(4, int(count)));
+
+      float binScale[3];
+      for (int axis = 0; axis < 3; axis++)
+      {
+        const float extent = centroidBox.boxMax[axis] - centroidBox.boxMin[axis];
+        binScale[axis]     = (extent > 0.0f) ? float(binsNum) / extent : 0.0f;
+      }
+
+      Bin bins[3][SAH_BINS];
+      for (int axis = 0; axis < 3; axis++)
+      {
+        for (int bin = 0; bin < binsNum; bin++)
+          bins[axis][bin].clear();
+      }
+
+      for (uint32_t i = task.begin; i < task.end; i++)
+      {
+        for (int axis = 0; axis < 3; axis++)
+        {
+          const int bin = std::min(int((prims[i].centroid(axis) - centroidBox.boxMin[axis])*binScale[axis]), binsNum - 1);
+          bins[axis][bin].count++;
+          IncludeRef(bins[axis][bin].box, prims[i]);
+        }
+      }
+
+      int   bestAxis  = -1;
+      int   bestSplit = 0;
+      float bestCost  = 1e38f;
+
+      for (int axis = 0; axis < 3; axis++)
+      {
+        if (binScale[axis] == 0.0f)
+          continue;
+
+        float    rightCost[SAH_BINS];
+        Box3f    accBox;
+        uint32_t accCount = 0;
+        for (int bin = binsNum - 1; bin > 0; bin--)
+        {
+          accBox.include(bins[axis][bin].box);
+          accCount      += bins[axis][bin].count;
+          rightCost[bin] = accBox.halfArea()*float(accCount);
+        }
+
+        accBox   = Box3f();
+        accCount = 0;
+        for (int bin = 0; bin < binsNum - 1; bin++)
+        {
+          accBox.include(bins[axis][bin].box);
+          accCount += bins[axis][bin].count;
+          const float cost = accBox.halfArea()*float(accCount) + rightCost[bin + 1];
+          if (accCount != 0 && accCount != count && cost < bestCost)
+          {
+            bestCost  = cost;
+            bestAxis  = axis;
+            bestSplit = bin;
+          }
+        }
+      }
+
+      // traversal step is counted as one triangle test
+      //
+      const float area      = box.halfArea();
+      const bool  splitPays = (bestAxis >= 0) && (area <= 0.0f || 1.0f + bestCost/area < float(count));
+
+      if (count <= a_ctx->maxLeafSize && !splitPays)
+      {
+        nodes[task.node].leftOrFirst = task.begin;
+        nodes[task.node].primsNum    = count;
+        continue;
+      }
+
+      uint32_t middle = task.begin + count/2;
+      if (task.depth >= MAX_SAH_DEPTH)
+      {
+        int axis = 0;
+        for (int k = 1; k < 3; k++)
+        {
+          if (centroidBox.boxMax[k] - centroidBox.boxMin[k] > centroidBox.boxMax[axis] - centroidBox.boxMin[axis])
+            axis = k;
+        }
+        std::nth_element(prims + task.begin, prims + middle, prims + task.end,
+                         [axis](const PrimRef& a, const PrimRef& b) { return a.centroid(axis) < b.centroid(axis); });
+      }
+      else if (bestAxis >= 0)
+      {
+        const float cmin  = centroidBox.boxMin[bestAxis];
+        const float scale = binScale[bestAxis];
+        PrimRef* pMiddle  = std::partition(prims + task.begin, prims + task.end, [=](const PrimRef& a_ref)
+        {
+          return std::min(int((a_ref.centroid(bestAxis) - cmin)*scale), binsNum - 1) <= bestSplit;
+        });
+        middle = uint32_t(pMiddle - prims);
+      }
+
+      if (middle == task.begin || middle == task.end) // all centroids are the same, split in the middle
+        middle = task.begin + count/2;
+
+      const uint32_t left = a_ctx->nodesNum->fetch_add(2);
+      nodes[task.node].leftOrFirst = left;
+      nodes[task.node].primsNum    = 0;
+
+      const BuildTask rightTask = { left + 1, middle, task.end, task.depth + 1 };
+      if (task.end - middle >= PARALLEL_TASK_MIN)
+      {
+        #pragma omp task firstprivate(rightTask)
+        BuildSubtree(a_ctx, rightTask);
+      }
+      else
+        stack.push_back(rightTask);
+
+      stack.push_back({ left + 0, task.begin, middle, task.depth + 1 });
+    }
+  }
+
+  void BVHTree::Build(const Box3f* a_boxes, uint32_t a_primsNum, uint32_t a_maxLeafSize)
+  {
+    nodes.clear();
+    primIndices.clear();
+    a_maxLeafSize = std::max(a_maxLeafSize, 1u);
+
+    std::vector<PrimRef> prims;
+    prims.reserve(a_primsNum);
+
+    for (uint32_t i = 0; i < a_primsNum; i++)
+    {
+      if (a_boxes[i].empty() || !BoxIsFinite(a_boxes[i]))
+        continue;
+      PrimRef ref;
+      for (int k = 0; k < 3; k++)
+      {
+        ref.boxMin[k] = a_boxes[i].boxMin[k];
+        ref.boxMax[k] = a_boxes[i].boxMax[k];
+      }
+      ref.id    = i;
+      ref.dummy = 0.0f;
+      prims.push_back(ref);
+    }
+
+    if (prims.empty())
+      return;
+
+    // binary tree with n leafs has 2n-1 nodes, so tasks may allocate nodes with atomic counter without reallocation
+    //
+    std::atomic<uint32_t> nodesNum(1);
+    nodes.resize(2 * prims.size());
+
+    BuildContext ctx;
+    ctx.prims       = prims.data();
+    ctx.nodes       = nodes.data();
+    ctx.nodesNum    = &nodesNum;
+    ctx.maxLeafSize = a_maxLeafSize;
+
+    const BuildTask root = { 0, 0, uint32_t(prims.size()), 0 };
+
+    if (prims.size() >= PARALLEL_TASK_MIN)
+    {
+      #pragma omp parallel
+      {
+        #pragma omp single
+        BuildSubtree(&ctx, root);
+      }
+    }
+    else
+      BuildSubtree(&ctx, root);
+
+    nodes.resize(nodesNum.load());
+    nodes.shrink_to_fit();
+
+    primIndices.resize(prims.size());
+    for (size_t i = 0; i < prims.size(); i++)
+      primIndices[i] = prims[i].id;
+  }
+
+  void BVHTree::Refit(const Box3f* a_boxes)
+  {
+    // children are always after parent, so the reverse order is bottom up
+    //
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+      BVHNode& node = nodes[i];
+      Box3f box;
+      if (node.primsNum == 0)
+      {
+        for (uint32_t child = node.leftOrFirst; child < node.leftOrFirst + 2; child++)
+        {
+          for (int k = 0; k < 3; k++)
+          {
+            box.boxMin[k] = std::min(box.boxMin[k], nodes[child].boxMin[k]);
+            box.boxMax[k] = std::max(box.boxMax[k], nodes[child].boxMax[k]);
+          }
+        }
+      }
+      else
+      {
+        for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.primsNum; j++)
+          box.include(a_boxes[primIndices[j]]);
+      }
+      WriteBox(node, box);
+    }
+  }
+
+  void TriangleBVH::Build(const float* a_pos4f, const int* a_indices, int a_triNum)
+  {
+    Clear();
+    if (a_triNum <= 0)
+      return;
+
+    std::vector<Box3f> boxes(a_triNum);
+    for (int i = 0; i < a_triNum; i++)
+    {
+      for (int v = 0; v < 3; v++)
+        boxes[i].include(a_pos4f + a_indices[i * 3 + v] * 4);
+    }
+
+    tree.Build(boxes.data(), uint32_t(a_triNum), 4);
+
+    triIndex = tree.primIndices;
+    triData.resize(triIndex.size() * 3);
+
+    for (size_t i = 0; i < triIndex.size(); i++)
+    {
+      const float* A = a_pos4f + a_indices[triIndex[i] * 3 + 0] * 4;
+      const float* B = a_pos4f + a_indices[triIndex[i] * 3 + 1] * 4;
+      const float* C = a_pos4f + a_indices[triIndex[i] * 3 + 2] * 4;
+
+      triData[i * 3 + 0] = float4(A[0], A[1], A[2], 0.0f);
+      triData[i * 3 + 1] = float4(B[0] - A[0], B[1] - A[1], B[2] - A[2], 0.0f);
+      triData[i * 3 + 2] = float4(C[0] - A[0], C[1] - A[1], C[2] - A[2], 0.0f);
+    }
+  }
+
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+/**
+\file
+\brief Bounding volume hierarchies for CPU ray casting: binned SAH builder over arbitrary boxes and triangle BVH on top of it.
+
+*/
+
+#include <cstdint>
+#include <vector>
+
+#include "LiteMath.h"
+
+namespace HydraBVH
+{
+  /**
+  \brief BVH node, 32 bytes.
+  Interior node (primsNum == 0): children are nodes[leftOrFirst] and nodes[leftOrFirst+1].
+  Leaf (primsNum != 0): primitives are primIndices[leftOrFirst ... leftOrFirst+primsNum-1].
+  */
+  struct BVHNode
+  {
+    float    boxMin[3];
+    uint32_t leftOrFirst;
+    float    boxMax[3];
+    uint32_t primsNum;
+  };
+
+  /**
+  \brief axis aligned box of primitive; for empty box boxMin > boxMax.
+  */
+  struct Box3f
+  {
+    Box3f() : boxMin{ +1e38f, +1e38f, +1e38f }, boxMax{ -1e38f, -1e38f, -1e38f } {}
+
+    float boxMin[3];
+    float boxMax[3];
+
+    inline void include(const float a_point[3])
+    {
+      for (int k = 0; k < 3; k++)
+      {
+        boxMin[k] = (a_point[k] < boxMin[k]) ? a_point[k] : boxMin[k];
+        boxMax[k] = (a_point[k] > boxMax[k]) ? a_point[k] : boxMax[k];
+      }
+    }
+
+    inline void include(const Box3f& a_box)
+    {
+      for (int k = 0; k < 3; k++)
+      {
+        boxMin[k] = (a_box.boxMin[k] < boxMin[k]) ? a_box.boxMin[k] : boxMin[k];
+        boxMax[k] = (a_box.boxMax[k] > boxMax[k]) ? a_box.boxMax[k] : boxMax[k];
+      }
+    }
+
+    inline bool  empty() const { return boxMin[0] > boxMax[0] || boxMin[1] > boxMax[1] || boxMin[2] > boxMax[2]; }
+    inline float halfArea() const
+    {
+      if (empty())
+        return 0.0f;
+      const float dx = boxMax[0] - boxMin[0], dy = boxMax[1] - boxMin[1], dz = boxMax[2] - boxMin[2];
+      return dx*dy + dy*dz + dz*dx;
+    }
+  };
+
+  /**
+  \brief binned SAH BVH over arbitrary boxes (triangles, instances, ...).
+  */
+  struct BVHTree
+  {
+    std::vector<BVHNode>  nodes;       ///< nodes[0] is root; empty if there are no primitives
+    std::vector<uint32_t> primIndices; ///< leaf references to input primitives
+
+    /**
+    \brief build tree from scratch.
+    \param a_boxes        - primitive boxes; primitives with empty or not finite boxes are not inserted to the tree
+    \param a_primsNum     - primitives number
+    \param a_maxLeafSize  - max primitives in leaf; leafs may have less primitives if SAH decides so
+
+    Subtrees of big nodes are built in parallel (OpenMP tasks); child nodes always have greater indices than their parent.
+    */
+    void Build(const Box3f* a_boxes, uint32_t a_primsNum, uint32_t a_maxLeafSize = 4);
+
+    /**
+    \brief update node boxes for moved primitives without changing the tree topology; O(nodes), much faster than Build.
+    \param a_boxes - new primitive boxes, indexed as in Build; primitives that were skipped by Build stay out of the tree
+
+    Tree quality degrades if primitives move far from their old neighbours; rebuild the tree in this case.
+    */
+    void Refit(const Box3f* a_boxes);
+
+    void  Clear() { nodes = std::vector<BVHNode>(); primIndices = std::vector<uint32_t>(); }
+    Box3f RootBox() const;
+  };
+
+  /**
+  \brief BVH over triangle mesh; triangles are stored in leaf order in the form that is ready for intersection.
+  */
+  struct TriangleBVH
+  {
+    BVHTree tree;
+
+    std::vector<HydraLiteMath::float4> triData;  ///< 3 per triangle in leaf order: v0, v1-v0, v2-v0; leaf ranges of the tree address this array directly
+    std::vector<uint32_t>              triIndex; ///< original triangle index for each triangle in leaf order
+
+    /**
+    \brief build BVH over indexed triangle mesh.
+    \param a_pos4f   - vertex positions, 4 floats per vertex
+    \param a_indices - 3 indices per triangle
+    \param a_triNum  - triangles number
+
+    */
+    void Build(const float* a_pos4f, const int* a_indices, int a_triNum);
+    void Clear() { tree.Clear(); triData = std::vector<HydraLiteMath::float4>(); triIndex = std::vector<uint32_t>(); }
+  };
+
+};
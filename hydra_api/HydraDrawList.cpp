@@ -0,0 +1,220 @@
+#include "HydraDrawList.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace HydraDrawList
+{
+
+  void DrawListBuilder::Clear()
+  {
+    m_meshes.clear();
+    m_matTextures.clear();
+    m_items.clear();
+    m_matrices.clear();
+    m_instancesTotal  = 0;
+    m_instancesCulled = 0;
+  }
+
+  void DrawListBuilder::SetMeshBox(int32_t a_meshId, const float a_boxMin[3], const float a_boxMax[3])
+  {
+    MeshInfo& mesh = m_meshes[a_meshId];
+    mesh.haveBox   = true;
+    for (int k = 0; k < 3; k++)
+    {
+      mesh.boxMin[k] = a_boxMin[k];
+      mesh.boxMax[k] = a_boxMax[k];
+      if (!std::isfinite(a_boxMin[k]) || !std::isfinite(a_boxMax[k]) || a_boxMin[k] > a_boxMax[k])
+        mesh.haveBox = false;
+    }
+  }
+
+  void DrawListBuilder::SetMeshBatches(int32_t a_meshId, const Batch* a_batches, int32_t a_batchNum)
+  {
+    MeshInfo& mesh = m_meshes[a_meshId];
+    mesh.batches.assign(a_batches, a_batches + std::max(a_batchNum, 0));
+  }
+
+  void DrawListBuilder::SetMaterialTextures(int32_t a_matId, const int32_t* a_texIds, int32_t a_texNum)
+  {
+    std::vector<int32_t> textures(a_texIds, a_texIds + std::max(a_texNum, 0));
+    if (std::all_of(textures.begin(), textures.end(), [](int32_t a_id) { return a_id < 0; }))
+      m_matTextures.erase(a_matId);
+    else
+      m_matTextures[a_matId] = textures;
+  }
+
+  void DrawListBuilder::BeginFrame(const float a_worldViewProj[16], bool a_cullNearFar)
+  {
+    // clip space planes of row major matrix (Gribb and Hartmann): w +- x >= 0, w +- y >= 0, w +- z >= 0
+    //
+    const float* m = a_worldViewProj;
+    m_planesNum    = a_cullNearFar ? 6 : 4;
+    for (int p = 0; p < m_planesNum; p++)
+    {
+      const int   row  = p / 2;
+      const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+      for (int k = 0; k < 4; k++)
+        m_planes[p][k] = m[12 + k] + sign*m[row*4 + k];
+    }
+
+    m_items.clear();
+    m_matrices.clear();
+    m_instancesTotal  = 0;
+    m_instancesCulled = 0;
+  }
+
+  int32_t DrawListBuilder::RemapMaterial(int32_t a_matId, int a_remapId) const
+  {
+    if (a_remapId < 0 || m_pRemapLists == nullptr || a_remapId >= int(m_pRemapLists->size()))
+      return a_matId;
+
+    const auto& remapList = (*m_pRemapLists)[a_remapId];
+    const auto  p         = remapList.find(uint32_t(a_matId));
+    return (p == remapList.end()) ? a_matId : int32_t(p->second);
+  }
+
+  void DrawListBuilder::AddInstances(int32_t a_meshId, const float* a_matrices, int32_t a_instNum, const int* a_remapId)
+  {
+    m_instancesTotal += uint32_t(std::max(a_instNum, 0));
+
+    auto p = m_meshes.find(a_meshId);
+    if (p == m_meshes.end() || p->second.batches.empty())
+      return;
+
+    const MeshInfo& mesh = p->second;
+
+    float center[3], extent[3];
+    for (int k = 0; k < 3; k++)
+    {
+      center[k] = 0.5f*(mesh.boxMin[k] + mesh.boxMax[k]);
+      extent[k] = 0.5f*(mesh.boxMax[k] - mesh.boxMin[k]);
+    }
+
+    for (int32_t i = 0; i < a_instNum; i++)
+    {
+      const float* m = a_matrices + size_t(i)*16;
+
+      if (mesh.haveBox)
+      {
+        // world box of the instance by center and extent, then test it against each plane
+        //
+        float wCenter[3], wExtent[3];
+        for (int row = 0; row < 3; row++)
+        {
+          wCenter[row] = m[row*4 + 0]*center[0] + m[row*4 + 1]*center[1] + m[row*4 + 2]*center[2] + m[row*4 + 3];
+          wExtent[row] = std::fabs(m[row*4 + 0])*extent[0] + std::fabs(m[row*4 + 1])*extent[1] + std::fabs(m[row*4 + 2])*extent[2];
+        }
+
+        bool outside = false;
+        for (int pl = 0; pl < m_planesNum && !outside; pl++)
+        {
+          const float* plane  = m_planes[pl];
+          const float  dist   = plane[0]*wCenter[0] + plane[1]*wCenter[1] + plane[2]*wCenter[2] + plane[3];
+          const float  radius = std::fabs(plane[0])*wExtent[0] + std::fabs(plane[1])*wExtent[1] + std::fabs(plane[2])*wExtent[2];
+          outside             = (dist + radius < 0.0f);
+        }
+
+        if (outside)
+        {
+          m_instancesCulled++;
+          continue;
+        }
+      }
+
+      // store transposed, i.e. column major, as OpenGL expects it
+      //
+      const uint32_t matrixId = uint32_t(m_matrices.size() / 16);
+      for (int col = 0; col < 4; col++)
+      {
+        for (int row = 0; row < 4; row++)
+          m_matrices.push_back(m[row*4 + col]);
+      }
+
+      const int remapId = (a_remapId != nullptr) ? a_remapId[i] : -1;
+      for (size_t batchId = 0; batchId < mesh.batches.size(); batchId++)
+      {
+        Item item;
+        item.stateRank = 0;
+        item.matId     = RemapMaterial(mesh.batches[batchId].matId, remapId);
+        item.meshId    = a_meshId;
+        item.batchId   = int32_t(batchId);
+        item.matrixId  = matrixId;
+        m_items.push_back(item);
+      }
+    }
+  }
+
+  void DrawListBuilder::Build(DrawList* a_pOut)
+  {
+    a_pOut->draws.clear();
+    a_pOut->matrices.clear();
+    a_pOut->instancesTotal  = m_instancesTotal;
+    a_pOut->instancesCulled = m_instancesCulled;
+
+    // rank materials by their textures, so that draws with the same textures are neighbours
+    //
+    std::vector<int32_t> materials;
+    materials.reserve(64);
+    for (const auto& item : m_items)
+      materials.push_back(item.matId);
+    std::sort(materials.begin(), materials.end());
+    materials.erase(std::unique(materials.begin(), materials.end()), materials.end());
+
+    const std::vector<int32_t> noTextures;
+    auto texturesOf = [&](int32_t a_matId) -> const std::vector<int32_t>&
+    {
+      auto p = m_matTextures.find(a_matId);
+      return (p == m_matTextures.end()) ? noTextures : p->second;
+    };
+
+    std::stable_sort(materials.begin(), materials.end(), [&](int32_t a, int32_t b) { return texturesOf(a) < texturesOf(b); });
+
+    std::unordered_map<int32_t, uint32_t> rankOf;
+    for (size_t i = 0; i < materials.size(); i++)
+      rankOf[materials[i]] = uint32_t(i);
+
+    for (auto& item : m_items)
+      item.stateRank = rankOf[item.matId];
+
+    std::sort(m_items.begin(), m_items.end(), [](const Item& a, const Item& b)
+    {
+      if (a.stateRank != b.stateRank) return a.stateRank < b.stateRank;
+      if (a.meshId    != b.meshId)    return a.meshId    < b.meshId;
+      if (a.batchId   != b.batchId)   return a.batchId   < b.batchId;
+      return a.matrixId < b.matrixId;
+    });
+
+    // one draw for each run of the same mesh batch with the same material
+    //
+    a_pOut->matrices.resize(m_items.size() * 16);
+    for (size_t i = 0; i < m_items.size(); i++)
+    {
+      const Item& item = m_items[i];
+      const bool  next = (i == 0) || item.stateRank != m_items[i - 1].stateRank || item.meshId != m_items[i - 1].meshId || item.batchId != m_items[i - 1].batchId;
+      if (next)
+      {
+        const Batch& batch = m_meshes[item.meshId].batches[item.batchId];
+
+        DrawCommand draw;
+        draw.meshId        = item.meshId;
+        draw.batchId       = item.batchId;
+        draw.matId         = item.matId;
+        draw.triBegin      = batch.triBegin;
+        draw.triEnd        = batch.triEnd;
+        draw.firstInstance = uint32_t(i);
+        draw.instanceNum   = 0;
+        a_pOut->draws.push_back(draw);
+      }
+
+      a_pOut->draws.back().instanceNum++;
+      std::copy(m_matrices.begin() + size_t(item.matrixId)*16, m_matrices.begin() + size_t(item.matrixId + 1)*16, a_pOut->matrices.begin() + i*16);
+    }
+
+    m_items.clear();
+    m_matrices.clear();
+    m_instancesTotal  = 0;
+    m_instancesCulled = 0;
+  }
+
+};
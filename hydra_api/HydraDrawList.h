@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+\file
+\brief CPU part of instanced draw submission for OpenGL drivers: frustum culling of mesh instances and sorting of draws by material state.
+       It does not call OpenGL, so it can be tested without GPU.
+
+*/
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace HydraDrawList
+{
+  /**
+  \brief one instanced draw: all instances of one mesh batch with the same material.
+  */
+  struct DrawCommand
+  {
+    int32_t  meshId;
+    int32_t  batchId;       ///< index of batch in the list passed to SetMeshBatches
+    int32_t  matId;         ///< material after remap
+    int32_t  triBegin;
+    int32_t  triEnd;
+    uint32_t firstInstance; ///< first matrix of this draw in DrawList::matrices
+    uint32_t instanceNum;
+  };
+
+  /**
+  \brief result of DrawListBuilder::Build; draws are sorted by texture state, then by material, then by mesh.
+  */
+  struct DrawList
+  {
+    DrawList() : instancesTotal(0), instancesCulled(0) {}
+
+    std::vector<DrawCommand> draws;
+    std::vector<float>       matrices; ///< 16 floats per instance, column major (ready for instanced vertex attributes); instances of a draw are contiguous
+
+    uint32_t instancesTotal;  ///< instances passed to AddInstances
+    uint32_t instancesCulled; ///< instances rejected by frustum culling
+  };
+
+  /**
+  \brief collects instances of a frame, culls them against camera frustum and groups them to instanced draws.
+
+  Typical use: SetMeshBox/SetMeshBatches in UpdateMesh, SetMaterialTextures in UpdateMaterial;
+  BeginFrame in BeginScene, AddInstances in InstanceMeshes and Build when geometry should be drawn.
+  */
+  class DrawListBuilder
+  {
+  public:
+
+    DrawListBuilder() : m_pRemapLists(nullptr), m_planesNum(0), m_instancesTotal(0), m_instancesCulled(0) {}
+
+    struct Batch { int32_t matId, triBegin, triEnd; };
+
+    void Clear();
+
+    void SetMeshBox(int32_t a_meshId, const float a_boxMin[3], const float a_boxMax[3]); ///< object space box; meshes without box are never culled
+    void SetMeshBatches(int32_t a_meshId, const Batch* a_batches, int32_t a_batchNum);
+    void SetMaterialTextures(int32_t a_matId, const int32_t* a_texIds, int32_t a_texNum);   ///< texture ids that material binds; draws with equal textures go together
+    void SetRemapLists(const std::vector< std::unordered_map<uint32_t, uint32_t> >* a_pRemapLists) { m_pRemapLists = a_pRemapLists; }
+
+    /**
+    \brief start new frame.
+    \param a_worldViewProj - row major world to clip space matrix
+    \param a_cullNearFar   - test near and far planes; don't do that if depth clamp is enabled
+    */
+    void BeginFrame(const float a_worldViewProj[16], bool a_cullNearFar = true);
+
+    /**
+    \brief cull and remember instances of a mesh; arguments are the same as in IHRRenderDriver::InstanceMeshes.
+    \param a_matrices - row major matrices, 16 floats per instance
+    \param a_remapId  - remap list index for each instance or -1; may be nullptr
+    */
+    void AddInstances(int32_t a_meshId, const float* a_matrices, int32_t a_instNum, const int* a_remapId);
+
+    bool HaveInstances() const { return !m_items.empty(); }
+
+    /**
+    \brief sort visible instances and group them to draws; clears instances of the frame, so the next Build returns only new instances.
+    */
+    void Build(DrawList* a_pOut);
+
+  protected:
+
+    struct MeshInfo
+    {
+      MeshInfo() : haveBox(false) {}
+
+      float              boxMin[3];
+      float              boxMax[3];
+      bool               haveBox;
+      std::vector<Batch> batches;
+    };
+
+    struct Item
+    {
+      uint32_t stateRank; ///< order of material texture state, assigned in Build
+      int32_t  matId;
+      int32_t  meshId;
+      int32_t  batchId;
+      uint32_t matrixId;  ///< index in m_matrices
+    };
+
+    int32_t RemapMaterial(int32_t a_matId, int a_remapId) const;
+
+    std::unordered_map<int32_t, MeshInfo>             m_meshes;
+    std::unordered_map<int32_t, std::vector<int32_t>> m_matTextures; ///< materials without textures are not stored
+
+    const std::vector< std::unordered_map<uint32_t, uint32_t> >* m_pRemapLists;
+
+    float m_planes[6][4];
+    int   m_planesNum;
+
+    std::vector<Item>  m_items;
+    std::vector<float> m_matrices; ///< visible instance matrices of the frame, column major
+    uint32_t           m_instancesTotal;
+    uint32_t           m_instancesCulled;
+  };
+
+};
@@ -1,4 +1,5 @@
 #include "HydraObjectManager.h"
+#include "HydraXMLHelpers.h"
 #include <unordered_set>
 #include <map>
 
@@ -23,12 +24,20 @@
 
 #include <chrono>
 #include <cassert>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "tiny_obj_loader.h"
 
 extern HRObjectManager g_objManager;
 extern HR_INFO_CALLBACK  g_pInfoCallback;
 
+namespace HydraRender
+{
+  std::unique_ptr<IHRImageTool> CreateImageTool();
+};
+
 using resolution_dict = std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t> >;
 
 void ScanXmlNodeRecursiveAndAppendTexture(pugi::xml_node a_node, std::unordered_set<int32_t>& a_outSet)
@@ -92,48 +101,98 @@ void AddUsedMaterialChildrenRecursive(ChangeList& objects, int32_t matId)
   }
 }
 
-void AddInstanceToDrawSequence(const HRSceneInst::Instance &instance,
-                               std::unordered_map<int32_t, ChangeList::InstancesInfo> &drawSeq, int a_instId)
+void AddMaterialsFromRemapList(const HRSceneInst::Instance &instance, const std::vector< std::vector<int32_t> >& a_remapLists,
+                               std::unordered_set<int32_t>& a_outMats)
+{
+  if(instance.remapListId >= 0 && instance.remapListId < a_remapLists.size() )
+  {
+    const auto& remapList = a_remapLists[instance.remapListId];
+    for(int i=0; i<remapList.size(); i+=2 )                    // [0->1, 2->5, 7->0, ... ] pairs of values ...
+    {
+      if(i+1 < remapList.size())
+        a_outMats.insert(remapList[i+1]);
+    }
+  }
+}
+
+/**
+\brief catch scene tracker up with instances that were added to drawList/drawListLights after the previous commit.
+
+ Only the tail of both lists is visited, so the cost of a commit does not depend on the total number of instances.
+ Instances of meshes that do not exist yet are kept in pending list and added when their mesh appears.
+*/
+void HR_UpdateSceneTracker(HRSceneInst& scn)
 {
+  auto& tracker = scn.m_tracker;
+
+  if (tracker.drawEnd > scn.drawList.size() || tracker.lightsEnd > scn.drawListLights.size()) // lists were cleared without tracker
+    tracker.clear();
 
-  auto p = drawSeq.find(instance.meshId);
-  if (p == drawSeq.end())
+  auto trackInstance = [&](size_t i)
   {
-    drawSeq[instance.meshId].matrices   = std::vector<float>  (instance.m, instance.m + 16);
-    drawSeq[instance.meshId].linstid    = std::vector<int32_t>(&instance.lightInstId, &instance.lightInstId + 1);
-    drawSeq[instance.meshId].remapid    = std::vector<int32_t>(&instance.remapListId, &instance.remapListId + 1);
-    drawSeq[instance.meshId].instIdReal = std::vector<int32_t>(&a_instId, &a_instId + 1);
+    const auto& instance = scn.drawList[i];
+    if (size_t(instance.meshId) >= g_objManager.scnData.meshes.size())
+      return false;
 
-    const int RESERVE_SIZE = 100;
+    tracker.meshUsed.insert(instance.meshId);
 
-    drawSeq[instance.meshId].matrices.reserve(RESERVE_SIZE);
-    drawSeq[instance.meshId].linstid.reserve(RESERVE_SIZE);
-    drawSeq[instance.meshId].remapid.reserve(RESERVE_SIZE);
-    drawSeq[instance.meshId].instIdReal.reserve(RESERVE_SIZE);
+    // form draw sequence for each mesh; only instance ids are kept, matrices stay in drawList
+    //
+    tracker.meshInst[instance.meshId].push_back(int32_t(i));
+    AddMaterialsFromRemapList(instance, scn.m_remapList, tracker.matUsed);
+    return true;
+  };
 
+  if (!tracker.pending.empty())
+  {
+    std::vector<size_t> stillPending;
+    for (size_t i : tracker.pending)
+    {
+      if (!trackInstance(i))
+        stillPending.push_back(i);
+    }
+    tracker.pending.swap(stillPending);
   }
-  else
+
+  for (size_t i = tracker.drawEnd; i < scn.drawList.size(); i++)
   {
-    std::vector<float> data(instance.m, instance.m + 16);
-    p->second.matrices.insert(p->second.matrices.end(), data.begin(), data.end());
-    p->second.linstid.push_back(instance.lightInstId);
-    p->second.remapid.push_back(instance.remapListId);
-    p->second.instIdReal.push_back(a_instId);
+    if (!trackInstance(i))
+      tracker.pending.push_back(i);
   }
 
+  for (size_t i = tracker.lightsEnd; i < scn.drawListLights.size(); i++)
+    tracker.lightUsed.insert(scn.drawListLights[i].lightId);
+
+  tracker.drawEnd   = scn.drawList.size();
+  tracker.lightsEnd = scn.drawListLights.size();
 }
 
-void AddMaterialsFromRemapList(const HRSceneInst::Instance &instance, const std::vector< std::vector<int32_t> >& a_remapLists,
-                               std::unordered_set<int32_t>& a_outMats)
+/**
+\brief pass instances of tracked meshes to driver; per mesh arrays are gathered from drawList by instance ids of scene tracker.
+*/
+void HR_DriverInstanceMeshes(HRSceneInst& scn, IHRRenderDriver* a_pDriver)
 {
-  if(instance.remapListId >= 0 && instance.remapListId < a_remapLists.size() )
+  ChangeList::InstancesInfo seq; // temporary buffers reused for all meshes
+
+  for (const auto& meshAndIds : scn.m_tracker.meshInst)
   {
-    const auto& remapList = a_remapLists[instance.remapListId];
-    for(int i=0; i<remapList.size(); i+=2 )                    // [0->1, 2->5, 7->0, ... ] pairs of values ...
+    const auto& ids = meshAndIds.second;
+    if (ids.empty())
+      continue;
+
+    seq.matrices.resize(ids.size() * 16);
+    seq.linstid.resize(ids.size());
+    seq.remapid.resize(ids.size());
+
+    for (size_t i = 0; i < ids.size(); i++)
     {
-      if(i+1 < remapList.size())
-        a_outMats.insert(remapList[i+1]);
+      const auto& instance = scn.drawList[ids[i]];
+      memcpy(&seq.matrices[i * 16], instance.m, 16 * sizeof(float));
+      seq.linstid[i] = instance.lightInstId;
+      seq.remapid[i] = instance.remapListId;
     }
+
+    a_pDriver->InstanceMeshes(meshAndIds.first, seq.matrices.data(), int32_t(ids.size()), seq.linstid.data(), seq.remapid.data(), ids.data());
   }
 }
 
@@ -141,29 +200,28 @@ void FindNewObjects(ChangeList& objects, HRSceneInst& scn, HRRender* a_pRender)
 {
   assert(a_pRender != nullptr);
 
-  // (1.1) loop through all scene instances to define what meshes used in scene  --> ~ok
+  // (1.1) take unique meshes, remap materials and lights of the scene and select those the render does not have yet
   //
-  for (size_t i = 0; i < scn.drawList.size(); i++)
-  {
-    auto instance = scn.drawList[i];
-    if (instance.meshId >= g_objManager.scnData.meshes.size()) //#TODO: ? add log message if need to debug some thing here
-      continue;
+  HR_UpdateSceneTracker(scn);
 
-    if (a_pRender->m_updated.meshUsed.find(instance.meshId) == a_pRender->m_updated.meshUsed.end())
-      objects.meshUsed.insert(instance.meshId);
-    
-    // form draw sequence for each mesh
-    //
-    AddInstanceToDrawSequence(instance, objects.drawSeq, int(i));
-    AddMaterialsFromRemapList(instance, scn.m_remapList, objects.matUsed);
+  const auto& updated = a_pRender->m_updated;
+
+  for (auto meshId : scn.m_tracker.meshUsed)
+  {
+    if (updated.meshUsed.find(meshId) == updated.meshUsed.end())
+      objects.meshUsed.insert(meshId);
   }
 
-  for (size_t i = 0; i < scn.drawListLights.size(); i++)
+  for (auto matId : scn.m_tracker.matUsed)
   {
-    auto instance = scn.drawListLights[i];
+    if (updated.matUsed.find(matId) == updated.matUsed.end())
+      objects.matUsed.insert(matId);
+  }
 
-    if (a_pRender->m_updated.lightUsed.find(instance.lightId) == a_pRender->m_updated.lightUsed.end())
-      objects.lightUsed.insert(instance.lightId);
+  for (auto lightId : scn.m_tracker.lightUsed)
+  {
+    if (updated.lightUsed.find(lightId) == updated.lightUsed.end())
+      objects.lightUsed.insert(lightId);
   }
 
   // (1.2) loop through needed meshed to define what material used in scene      --> ?
@@ -237,34 +295,73 @@ void FindNewObjects(ChangeList& objects, HRSceneInst& scn, HRRender* a_pRender)
 
 }
 
+/**
+\brief parse 'remap_lists' of scene xml only when hrSceneClose has rewritten them; lists that were already parsed are taken from tracker.
+
+ hrSceneClose only appends new lists (ids are stable until scene is discarded), so list with the same id and size is not parsed again.
+*/
+void HR_UpdateRemapListsCache(HRSceneInst& scn)
+{
+  auto& tracker = scn.m_tracker;
+  if (tracker.remapVersion == scn.m_remapListsVersion)
+    return;
+
+  bool anyChanges = false;
+  size_t listId   = 0;
+  for (auto remapList : scn.xml_node().child(L"remap_lists").children())
+  {
+    const int listSize = remapList.attribute(L"size").as_int();
+
+    if (listId < tracker.remapLists.size() && tracker.remapLists[listId].size() == size_t(listSize))
+    {
+      listId++;
+      continue;
+    }
+
+    std::vector<int32_t> listData(size_t(std::max(listSize, 0)), 0);
+    const int readNum = HydraXMLHelpers::ReadInts(remapList.attribute(L"val").as_string(), listData.data(), listSize);
+    listData.resize(size_t(std::max(readNum, 0)));
+
+    if (listId < tracker.remapLists.size())
+      tracker.remapLists[listId] = std::move(listData);
+    else
+      tracker.remapLists.push_back(std::move(listData));
+
+    anyChanges = true;
+    listId++;
+  }
+
+  if (listId != tracker.remapLists.size())
+  {
+    tracker.remapLists.resize(listId);
+    anyChanges = true;
+  }
+
+  if (anyChanges)
+  {
+    tracker.remapMats.clear();
+    for (const auto& list : tracker.remapLists)
+      tracker.remapMats.insert(list.begin(), list.end());
+  }
+
+  tracker.remapVersion = scn.m_remapListsVersion;
+}
+
 void FindOldObjectsThatWeNeedToUpdate(ChangeList& objects, HRSceneInst& scn, HRRender* a_pRender)
 {
   assert(a_pRender != nullptr);
 
   // AddMaterialsFromSceneRemapList
   //
-  pugi::xml_node scnRemLists = scn.xml_node().child(L"remap_lists");
+  HR_UpdateRemapListsCache(scn);
 
-  for (auto remapList : scnRemLists.children())
+  for (auto matId : scn.m_tracker.remapMats)
   {
-    const wchar_t* inputStr = remapList.attribute(L"val").as_string();
-    const int listSize = remapList.attribute(L"size").as_int();
-    std::wstringstream inStrStream(inputStr);
-
-    for (int i = 0; i < listSize; i++)
+    if (objects.matUsed.find(matId)  == objects.matUsed.end() && // we don't add this object to list yet
+        a_pRender->m_updated.matUsed.find(matId) == a_pRender->m_updated.matUsed.end())  // and it was not added in previous updates
     {
-      if (inStrStream.eof())
-        break;
-
-      int matId = 0;
-      inStrStream >> matId;
-
-      if (objects.matUsed.find(matId)  == objects.matUsed.end() && // we don't add this object to list yet
-          a_pRender->m_updated.matUsed.find(matId) == a_pRender->m_updated.matUsed.end())  // and it was not added in previous updates
-      {
-        objects.matUsed.insert(matId);
-        AddUsedMaterialChildrenRecursive(objects, matId);
-      }
+      objects.matUsed.insert(matId);
+      AddUsedMaterialChildrenRecursive(objects, matId);
     }
   }
 
@@ -356,67 +453,255 @@ ChangeList FindChangedObjects(HRSceneInst& scn, HRRender* a_pRender)
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-
-void UpdateImageFromFileOrChunk(int32_t a_id, HRTextureNode& img, IHRRenderDriver* a_pDriver) // #TODO: debug and test this
+/**
+\brief prepares (reads and decodes) jobs by worker threads while main thread passes previous ones to driver in the same order.
+       No more than 'window' jobs are prepared and not taken yet and their buffers are reused, so memory usage is bounded.
+       Job must have 'std::vector<int> buffer', 'bool ready' and must be movable; it owns everything it has prepared and frees it 
+       in destructor, so jobs that were prepared but never taken are freed together with jobs vector.
+       Each worker thread creates its own Worker and prepares jobs with Worker::operator()(Job&), so Worker may keep objects
+       that are not thread safe (image tool for example). Worker must not touch xml and global state.
+*/
+template<typename Job, typename Worker>
+struct HRPrefetchPipeline
 {
-  pugi::xml_node node = img.xml_node();
+  HRPrefetchPipeline(std::vector<Job>& a_jobs) : m_jobs(a_jobs), m_next(0), m_consumed(0), m_stop(false)
+  {
+    const int threadsNum = std::min(std::max(int(std::thread::hardware_concurrency()), 2), int(a_jobs.size())); // at least 2 to overlap file reading with driver
+    m_window = size_t(threadsNum) * 2;
+    for (int i = 0; i < threadsNum; i++)
+      m_workers.emplace_back(&HRPrefetchPipeline::WorkerLoop, this);
+  }
+
+  ~HRPrefetchPipeline()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cvSpace.notify_all();
+    for (auto& worker : m_workers)
+      worker.join();
+  }
+
+  /**
+  \brief wait until job is prepared and move it to (*a_pJob); this lets workers prepare next one.
+         Previous content of (*a_pJob) is destroyed and its buffer is reused for next jobs.
+  */
+  void TakeJob(size_t a_index, Job* a_pJob)
+  {
+    std::vector<int> oldBuffer = std::move(a_pJob->buffer);
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cvReady.wait(lock, [&]() { return m_jobs[a_index].ready; });
+      (*a_pJob) = std::move(m_jobs[a_index]);
+      if (oldBuffer.capacity() != 0 && oldBuffer.capacity()*sizeof(int) <= TEMP_BUFFER_MAX_SIZE_DONT_FREE)
+        m_bufferPool.push_back(std::move(oldBuffer));
+      m_consumed++;
+    }
+    m_cvSpace.notify_one();
+  }
 
-  bool delayedLoad = (node.attribute(L"dl").as_int() == 1);
+private:
 
-  if (delayedLoad && img.m_loadedFromFile) // load external image from file 
+  void WorkerLoop()
   {
-    const wchar_t* filename = node.attribute(L"path").as_string();
+    Worker worker;
 
-    int width, height, bpp;
-    bool loaded = g_objManager.m_pImgTool->LoadImageFromFile(filename, 
-                                                             width, height, bpp, g_objManager.m_tempBuffer);
+    while (true)
+    {
+      size_t index = 0;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvSpace.wait(lock, [&]() { return m_stop || (m_next < m_jobs.size() && m_next < m_consumed + m_window); });
+        if (m_stop)
+          return;
+        index = m_next++;
+        if (!m_bufferPool.empty())
+        {
+          m_jobs[index].buffer = std::move(m_bufferPool.back());
+          m_bufferPool.pop_back();
+        }
+      }
 
-    if(loaded)
-      a_pDriver->UpdateImage(a_id, width, height, bpp, (char*)g_objManager.m_tempBuffer.data(), node);
-    else
-      a_pDriver->UpdateImage(a_id, 0, 0, 0, nullptr, node);
+      worker(m_jobs[index]);
 
-    if (g_objManager.m_tempBuffer.size() > TEMP_BUFFER_MAX_SIZE_DONT_FREE)
-      g_objManager.m_tempBuffer = g_objManager.EmptyBuffer();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs[index].ready = true;
+      }
+      m_cvReady.notify_all();
+    }
+  }
+
+  std::vector<Job>&             m_jobs;
+  std::vector<std::thread>      m_workers;
+  std::vector<std::vector<int>> m_bufferPool;
+  std::mutex                    m_mutex;
+  std::condition_variable       m_cvReady;
+  std::condition_variable       m_cvSpace;
+  size_t                        m_next;
+  size_t                        m_consumed;
+  size_t                        m_window;
+  bool                          m_stop;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+/**
+\brief everything that is needed to load one image from file or chunk and to pass it to driver, see HRPrefetchPipeline.
+*/
+struct HRTextureUploadJob
+{
+  HRTextureUploadJob() : id(-1), fromImageFile(false), w(0), h(0), bpp(0), sizeInBytes(0), dataOffset(0), data(nullptr), decodeTimeMs(0.0f), ready(false) {}
+
+  // filled on main thread
+  //
+  int32_t      id;
+  std::wstring path;
+  bool         fromImageFile; ///< external image (png, jpg, ...) or our chunk
+  int32_t      w, h, bpp;
+  int64_t      sizeInBytes;
+  uint64_t     dataOffset;
+
+  // filled by HR_PrepareTextureUpload
+  //
+  std::vector<int> buffer;
+  const char*      data;  ///< points to 'buffer'
+  std::wstring     error;
+  float            decodeTimeMs;
+  bool             ready;
+};
+
+static HRTextureUploadJob HR_MakeTextureUploadJob(int32_t a_id, HRTextureNode& img)
+{
+  pugi::xml_node node = img.xml_node();
+
+  HRTextureUploadJob job;
+  job.id            = a_id;
+  job.fromImageFile = (node.attribute(L"dl").as_int() == 1) && img.m_loadedFromFile;
+
+  if (job.fromImageFile) // load external image from file 
+  {
+    job.path = node.attribute(L"path").as_string();
   }
   else // load chunk
   {
-    auto w           = node.attribute(L"width").as_int();
-    auto h           = node.attribute(L"height").as_int();
-    auto sizeInBytes = node.attribute(L"bytesize").as_llong();
+    job.path        = g_objManager.GetLoc(node);
+    job.w           = node.attribute(L"width").as_int();
+    job.h           = node.attribute(L"height").as_int();
+    job.sizeInBytes = node.attribute(L"bytesize").as_llong();
+    job.dataOffset  = node.attribute(L"offset").as_ullong();
+  }
 
-    if(w == 0 || h == 0 || sizeInBytes == 0)
+  return job;
+}
+
+static void HR_DecodeImageFile(HRTextureUploadJob& job, IHRImageTool* a_pImgTool)
+{
+  int width, height, bpp;
+  bool loaded = a_pImgTool->LoadImageFromFile(job.path.c_str(), 
+                                              width, height, bpp, job.buffer);
+  if (loaded)
+  {
+    job.w    = width;
+    job.h    = height;
+    job.bpp  = bpp;
+    job.data = (const char*)job.buffer.data();
+  }
+  else
+    job.error = std::wstring(L"UpdateImageFromFileOrChunk: can't load image from file ") + job.path;
+}
+
+/**
+\brief may run on worker thread, so a_pImgTool must belong to this thread (image tool is not thread safe); job errors are reported by HR_SubmitTextureUpload.
+*/
+static void HR_PrepareTextureUpload(HRTextureUploadJob& job, IHRImageTool* a_pImgTool)
+{
+  auto timeBeg = std::chrono::high_resolution_clock::now();
+
+  if (job.fromImageFile)
+    HR_DecodeImageFile(job, a_pImgTool);
+  else
+  {
+    if(job.w == 0 || job.h == 0 || job.sizeInBytes == 0)
     {
-      HrError(L"UpdateImageFromFileOrChunk: zero or unknown image size/resolution");
+      job.error = L"UpdateImageFromFileOrChunk: zero or unknown image size/resolution";
       return;
     }
 
-    int bpp = int(sizeInBytes / (w*h));
+    job.bpp = int(job.sizeInBytes / (job.w*job.h));
 
-    sizeInBytes += size_t(sizeof(int) * 2);
+    const int64_t sizeInBytes = job.sizeInBytes + int64_t(sizeof(int) * 2);
 
-    g_objManager.m_tempBuffer.resize(sizeInBytes / uint64_t(sizeof(int)) + uint64_t(sizeof(int) * 16));
-    char* data = (char*)&g_objManager.m_tempBuffer[0];
+    job.buffer.resize(sizeInBytes / uint64_t(sizeof(int)) + uint64_t(sizeof(int) * 16));
+    char* data = (char*)&job.buffer[0];
 
-    const std::wstring path = g_objManager.GetLoc(node);
-#if (_POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600)
-    std::wstring s1(path);
-    std::string  s2(s1.begin(), s1.end());
-    std::ifstream fin(s2.c_str(), std::ios::binary);
-#elif defined WIN32
-    std::ifstream fin(path.c_str(), std::ios::binary);
-#endif
+    std::ifstream fin;
+    hr_ifstream_open(fin, job.path.c_str());
     if (fin.is_open())
     {
       fin.read(data, sizeInBytes);
-      uint64_t dataOffset = node.attribute(L"offset").as_ullong();
-      a_pDriver->UpdateImage(a_id, w, h, bpp, data + dataOffset, node);
       fin.close();
+      job.data = data + job.dataOffset;
     }
-    else
-      a_pDriver->UpdateImage(a_id, w, h, bpp, nullptr, node);
   }
 
+  auto timeEnd = std::chrono::high_resolution_clock::now();
+  job.decodeTimeMs = float(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeBeg).count())/1000.0f;
+}
+
+/**
+\brief pass prepared image to driver and report timings through info callback.
+\return upload time in milliseconds
+*/
+static float HR_SubmitTextureUpload(HRTextureUploadJob& job, HRTextureNode& img, IHRRenderDriver* a_pDriver)
+{
+  if (!job.error.empty())
+  {
+    HrError(job.error);
+    if (!job.fromImageFile) // bad chunk, nothing to pass to driver
+      return 0.0f;
+  }
+
+  auto timeBeg = std::chrono::high_resolution_clock::now();
+
+  if (job.data != nullptr)
+    a_pDriver->UpdateImage(job.id, job.w, job.h, job.bpp, job.data, img.xml_node());
+  else if (job.fromImageFile)
+    a_pDriver->UpdateImage(job.id, 0, 0, 0, nullptr, img.xml_node());
+  else
+    a_pDriver->UpdateImage(job.id, job.w, job.h, job.bpp, nullptr, img.xml_node());
+
+  auto timeEnd = std::chrono::high_resolution_clock::now();
+  const float uploadTimeMs = float(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeBeg).count())/1000.0f;
+
+  HrPrint(HR_SEVERITY_DEBUG, L"UpdateImage: id = ", job.id, L", ", job.w, L"x", job.h, L", decode = ", job.decodeTimeMs, L" ms, upload = ", uploadTimeMs, L" ms");
+  return uploadTimeMs;
+}
+
+/**
+\brief worker of texture HRPrefetchPipeline; has its own image tool, so png, jpg and other external formats are decoded in parallel too.
+*/
+struct HRTextureUploadWorker
+{
+  HRTextureUploadWorker() : pImgTool(HydraRender::CreateImageTool()) {}
+  void operator()(HRTextureUploadJob& job) { HR_PrepareTextureUpload(job, pImgTool.get()); }
+
+  std::unique_ptr<IHRImageTool> pImgTool;
+};
+
+void UpdateImageFromFileOrChunk(int32_t a_id, HRTextureNode& img, IHRRenderDriver* a_pDriver) // #TODO: debug and test this
+{
+  HRTextureUploadJob job = HR_MakeTextureUploadJob(a_id, img);
+  job.buffer.swap(g_objManager.m_tempBuffer); // single image reuses common temp buffer as before
+
+  HR_PrepareTextureUpload(job, g_objManager.m_pImgTool.get());
+  HR_SubmitTextureUpload(job, img, a_pDriver);
+
+  job.buffer.swap(g_objManager.m_tempBuffer);
+  if (g_objManager.m_tempBuffer.size() > TEMP_BUFFER_MAX_SIZE_DONT_FREE)
+    g_objManager.m_tempBuffer = g_objManager.EmptyBuffer();
 }
 
 /////
@@ -437,6 +722,22 @@ int32_t HR_DriverUpdateTextures(HRSceneInst& scn, ChangeList& objList, HRRender*
   texturesUsed.assign(objList.texturesUsed.begin(), objList.texturesUsed.end());
   std::sort(texturesUsed.begin(), texturesUsed.end());
 
+  enum TEX_SOURCE { TEX_FROM_VB = 0, TEX_DRIVER_LOADS_EXTERNAL = 1, TEX_DRIVER_LOADS_INTERNAL = 2, TEX_PROCEDURAL = 3, TEX_FROM_FILE_OR_CHUNK = 4 };
+
+  struct TexUpdate
+  {
+    int32_t    id;
+    TEX_SOURCE source;
+    int32_t    w, h, bpp;
+    uint64_t   chunkId;
+  };
+
+  // (1) decide where each texture comes from
+  //
+  std::vector<TexUpdate>          updates;
+  std::vector<HRTextureUploadJob> jobs;
+  updates.reserve(texturesUsed.size());
+
   for (auto texId : texturesUsed)
   {
     if (texId < 0)
@@ -444,60 +745,123 @@ int32_t HR_DriverUpdateTextures(HRSceneInst& scn, ChangeList& objList, HRRender*
 
     HRTextureNode& texNode = g_objManager.scnData.textures[texId];
 
-    int32_t w     = 0;
-    int32_t h     = 0;
-    int32_t bpp   = 4;
-    char* dataPtr = nullptr;
+    TexUpdate upd;
+    upd.id      = texId;
+    upd.w       = 0;
+    upd.h       = 0;
+    upd.bpp     = 4;
+    upd.chunkId = uint64_t(-1);
 
     if (texNode.pImpl != nullptr)
     {
-      w   = texNode.pImpl->width();
-      h   = texNode.pImpl->height();
-      bpp = texNode.pImpl->bpp();
+      upd.w   = texNode.pImpl->width();
+      upd.h   = texNode.pImpl->height();
+      upd.bpp = texNode.pImpl->bpp();
 
       uint64_t chunkId = texNode.pImpl->chunkId();
-      if (chunkId != uint64_t(-1) && chunkId < g_objManager.scnData.m_vbCache.size()) // cache may be inactive, so m_vbCache.size() size may be 0
-      {
-        ChunkPointer chunk = g_objManager.scnData.m_vbCache.chunk_at(chunkId);
-        dataPtr = (char*)chunk.GetMemoryNow();
-      }
+      if (chunkId != uint64_t(-1) && g_objManager.scnData.m_vbCache.ChunkIsAvailable(chunkId)) // cache may be inactive, so m_vbCache.size() size may be 0
+        upd.chunkId = chunkId;                                                                 // don't get pointer here, next textures may evict this chunk
+    }
+
+    pugi::xml_node texNodeXML = texNode.xml_node();
+    bool delayedLoad = (texNodeXML.attribute(L"dl").as_int() == 1);
+    bool isProc      = (texNodeXML.attribute(L"loc").as_string() == std::wstring(L"") && !delayedLoad);
+
+    if (upd.chunkId != uint64_t(-1))
+      upd.source = TEX_FROM_VB;
+    else if (info.supportImageLoadFromExternalFormat && texNode.m_loadedFromFile)
+      upd.source = TEX_DRIVER_LOADS_EXTERNAL;
+    else if (info.supportImageLoadFromInternalFormat && !delayedLoad)
+      upd.source = TEX_DRIVER_LOADS_INTERNAL;
+    else if (isProc)
+      upd.source = TEX_PROCEDURAL;
+    else
+    {
+      upd.source = TEX_FROM_FILE_OR_CHUNK;
+      jobs.push_back(HR_MakeTextureUploadJob(texId, texNode));
     }
 
-    pugi::xml_node texNodeXML  = texNode.xml_node();
-    uint64_t       dataOffset  = texNodeXML.attribute(L"offset").as_ullong(); //#SAFETY: check dataOffset for too big value ?
-    bool           delayedLoad = (texNodeXML.attribute(L"dl").as_int() == 1);
-    bool isProc = (texNodeXML.attribute(L"loc").as_string() == std::wstring(L"") && !delayedLoad);
+    updates.push_back(upd);
+  }
+
+  // (2) images are decoded by worker threads in advance; driver still gets them in id order
+  //
+  std::unique_ptr< HRPrefetchPipeline<HRTextureUploadJob, HRTextureUploadWorker> > pPipeline = nullptr;
+  if (jobs.size() > 1)
+    pPipeline = std::make_unique< HRPrefetchPipeline<HRTextureUploadJob, HRTextureUploadWorker> >(jobs);
+
+  HRTextureUploadJob job; // taken from pipeline, its memory is freed or reused by the next TakeJob
+  size_t jobIndex     = 0;
+  float  decodeTimeMs = 0.0f;
+  float  uploadTimeMs = 0.0f;
+  auto   timeBeg      = std::chrono::high_resolution_clock::now();
+
+  for (const auto& upd : updates)
+  {
+    const int32_t  texId      = upd.id;
+    HRTextureNode& texNode    = g_objManager.scnData.textures[texId];
+    pugi::xml_node texNodeXML = texNode.xml_node();
+    uint64_t       dataOffset = texNodeXML.attribute(L"offset").as_ullong(); //#SAFETY: check dataOffset for too big value ?
 
-    if (dataPtr == nullptr)
+    switch (upd.source)
     {
+    case TEX_DRIVER_LOADS_EXTERNAL:
+      a_pDriver->UpdateImageFromFile(texId, texNodeXML.attribute(L"path").as_string(), texNodeXML);
+      break;
 
-      if (info.supportImageLoadFromExternalFormat && texNode.m_loadedFromFile)
-      {
-        const wchar_t* path = texNodeXML.attribute(L"path").as_string();
-        a_pDriver->UpdateImageFromFile(texId, path, texNodeXML);
-      }
-      else if (info.supportImageLoadFromInternalFormat && !delayedLoad)
+    case TEX_DRIVER_LOADS_INTERNAL:
+      a_pDriver->UpdateImageFromFile(texId, g_objManager.GetLoc(texNodeXML).c_str(), texNodeXML);
+      break;
+
+    case TEX_PROCEDURAL:
+      a_pRender->m_updated.texturesUsed.insert(texId);
+      a_pDriver->UpdateImage(texId, -1, -1, 4, nullptr, texNodeXML);
+      break;
+
+    case TEX_FROM_FILE_OR_CHUNK:
+      if (pPipeline != nullptr)
       {
-        const std::wstring path = g_objManager.GetLoc(texNodeXML);
-        a_pDriver->UpdateImageFromFile(texId, path.c_str(), texNodeXML);
+        pPipeline->TakeJob(jobIndex, &job);
+        assert(job.id == texId);
+        uploadTimeMs += HR_SubmitTextureUpload(job, texNode, a_pDriver);
+        decodeTimeMs += job.decodeTimeMs;
+        jobIndex++;
       }
-      else if(isProc)
+      else
+        UpdateImageFromFileOrChunk(texId, texNode, a_pDriver);
+      break;
+
+    case TEX_FROM_VB:
+    {
+      bool uploaded = false;
+      for (int attempt = 0; attempt < VB_READ_ATTEMPTS && !uploaded; attempt++) // attached process reads chunk in place; owner may move it meanwhile
       {
+        ChunkPin texData(g_objManager.scnData.m_vbCache, upd.chunkId); // may page chunk in
+        const char* dataPtr = (const char*)texData.data();
+        if (dataPtr == nullptr)
+          break;
+
         a_pRender->m_updated.texturesUsed.insert(texId);
-        a_pDriver->UpdateImage(texId, -1, -1, 4, nullptr, texNodeXML);
+        a_pDriver->UpdateImage(texId, upd.w, upd.h, upd.bpp, dataPtr + dataOffset, texNodeXML);
+        uploaded = !texData.IsTorn();
       }
-      else
+
+      if (!uploaded)
         UpdateImageFromFileOrChunk(texId, texNode, a_pDriver);
     }
-    else
-    {
-      a_pRender->m_updated.texturesUsed.insert(texId);
-      a_pDriver->UpdateImage(texId, w, h, bpp, dataPtr + dataOffset, texNodeXML);
+    break;
     }
 
     texturesUpdated++;
   }
 
+  if (pPipeline != nullptr)
+  {
+    auto timeEnd = std::chrono::high_resolution_clock::now();
+    const float totalTimeMs = float(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeBeg).count())/1000.0f;
+    HrPrint(HR_SEVERITY_INFO, L"HR_DriverUpdateTextures: ", jobs.size(), L" images loaded in ", totalTimeMs, L" ms; decode = ", decodeTimeMs, L" ms, upload = ", uploadTimeMs, L" ms (sum over images)");
+  }
+
   a_pDriver->EndTexturesUpdate();
 
   return texturesUpdated;
@@ -655,6 +1019,44 @@ HRMeshDriverInput HR_GetMeshDataPointers(size_t a_meshId)
   return input;
 }
 
+HRMeshDataPin::HRMeshDataPin(size_t a_meshId) : m_chunkId(size_t(-1)), m_sequence(g_objManager.scnData.m_vbCache.BeginRead())
+{
+  HRSceneData& scn = g_objManager.scnData;
+  if (a_meshId >= scn.meshes.size() || scn.meshes[a_meshId].pImpl == nullptr)
+    return;
+
+  const size_t chunkId = size_t(scn.meshes[a_meshId].pImpl->chunkId());
+  if (scn.m_vbCache.PinChunk(chunkId) == nullptr) // can't page mesh in; leave empty input as HR_GetMeshDataPointers does
+    return;
+
+  m_chunkId = chunkId;
+  input     = HR_GetMeshDataPointers(a_meshId);
+}
+
+HRMeshDataPin::~HRMeshDataPin()
+{
+  if (m_chunkId != size_t(-1))
+    g_objManager.scnData.m_vbCache.UnpinChunk(m_chunkId);
+}
+
+bool HRMeshDataPin::IsTorn() const
+{
+  return (m_chunkId != size_t(-1)) && !g_objManager.scnData.m_vbCache.ReadIsValid(m_sequence);
+}
+
+/**
+\brief same condition as 'HR_GetMeshDataPointers(a_meshId).pos4f != nullptr', but does not page mesh chunk in.
+*/
+static bool HR_MeshDataIsAvailable(size_t a_meshId)
+{
+  HRSceneData& scn = g_objManager.scnData;
+  if (a_meshId >= scn.meshes.size() || scn.meshes[a_meshId].pImpl == nullptr)
+    return false;
+
+  const auto chunkId = scn.meshes[a_meshId].pImpl->chunkId();
+  return (chunkId != uint64_t(-1)) && scn.m_vbCache.ChunkIsAvailable(chunkId);
+}
+
 std::vector<HRBatchInfo> FormMatDrawListRLE(const std::vector<uint32_t>& matIndices);
 
 void HR_CopyMeshToInputMeshFromHydraGeomData(const HydraGeomData& data,  HRMesh::InputTriMesh& mesh2)
@@ -684,16 +1086,150 @@ void HR_CopyMeshToInputMeshFromHydraGeomData(const HydraGeomData& data,  HRMesh:
 
 std::string ws2s(const std::wstring& s);
 
-void UpdateMeshFromChunk(int32_t a_id, HRMesh& mesh, std::vector<HRBatchInfo>& a_batches, IHRRenderDriver* a_pDriver, const wchar_t* path, int64_t a_byteSize)
+/**
+\brief everything that is needed to read one mesh chunk from file and to pass it to driver.
+       Prepare stage does not touch xml and global state, so several jobs may be prepared in parallel while driver consumes previous ones.
+*/
+struct HRMeshUploadJob
+{
+  HRMeshUploadJob() : id(-1), byteSize(0), vertNum(0), triNum(0), pFile(nullptr), warnByteSize(false), ready(false) {}
+  ~HRMeshUploadJob() { hr_unmap_file(pFile); }
+
+  HRMeshUploadJob(const HRMeshUploadJob&)            = delete; // owns file mapping
+  HRMeshUploadJob& operator=(const HRMeshUploadJob&) = delete;
+
+  HRMeshUploadJob(HRMeshUploadJob&& a_other) noexcept : pFile(nullptr) { (*this) = std::move(a_other); }
+  HRMeshUploadJob& operator=(HRMeshUploadJob&& a_other) noexcept;
+
+  // filled on main thread
+  //
+  int32_t      id;
+  std::wstring path;
+  int64_t      byteSize;
+  int32_t      vertNum;
+  int32_t      triNum;
+  uint64_t     offsetPos, offsetNorm, offsetTang, offsetTexc, offsetInd, offsetMInd;
+
+  // filled by HR_PrepareMeshUpload
+  //
+  HRMeshDriverInput        input;
+  std::vector<HRBatchInfo> batches;
+  std::vector<int>         buffer;
+  HRMesh::InputTriMesh     mesh2;
+  HRMappedFile*            pFile;
+  std::wstring             error;
+  bool                     warnByteSize;
+  bool                     ready;
+};
+
+HRMeshUploadJob& HRMeshUploadJob::operator=(HRMeshUploadJob&& a_other) noexcept
+{
+  if (this == &a_other)
+    return *this;
+
+  hr_unmap_file(pFile);
+
+  id           = a_other.id;
+  path         = std::move(a_other.path);
+  byteSize     = a_other.byteSize;
+  vertNum      = a_other.vertNum;
+  triNum       = a_other.triNum;
+  offsetPos    = a_other.offsetPos;  offsetNorm = a_other.offsetNorm; offsetTang = a_other.offsetTang;
+  offsetTexc   = a_other.offsetTexc; offsetInd  = a_other.offsetInd;  offsetMInd = a_other.offsetMInd;
+  input        = a_other.input;   // points to 'buffer', 'mesh2' or mapping; all of them are moved without reallocation
+  batches      = std::move(a_other.batches);
+  buffer       = std::move(a_other.buffer);
+  mesh2        = std::move(a_other.mesh2);
+  pFile        = a_other.pFile;
+  error        = std::move(a_other.error);
+  warnByteSize = a_other.warnByteSize;
+  ready        = a_other.ready;
+
+  a_other.pFile = nullptr;
+  a_other.input = HRMeshDriverInput();
+  return *this;
+}
+
+static HRMeshUploadJob HR_MakeMeshUploadJob(int32_t a_id, HRMesh& mesh, const wchar_t* path, int64_t a_byteSize)
 {
   pugi::xml_node nodeXML = mesh.xml_node();
 
+  HRMeshUploadJob job;
+  job.id         = a_id;
+  job.path       = path;
+  job.byteSize   = a_byteSize;
+  job.vertNum    = nodeXML.attribute(L"vertNum").as_int();
+  job.triNum     = nodeXML.attribute(L"triNum").as_int();
+  job.offsetPos  = mesh.pImpl->offset(L"pos");
+  job.offsetNorm = mesh.pImpl->offset(L"norm");
+  job.offsetTang = mesh.pImpl->offset(L"tan");
+  job.offsetTexc = mesh.pImpl->offset(L"texc");
+  job.offsetInd  = mesh.pImpl->offset(L"ind");
+  job.offsetMInd = mesh.pImpl->offset(L"mind");
+  return job;
+}
+
+static void HR_SetPointersFromOffsets(HRMeshUploadJob& job, const char* dataPtr)
+{
+  job.input.vertNum       = job.vertNum;
+  job.input.triNum        = job.triNum;
+
+  job.input.pos4f         = (const float*)(dataPtr + job.offsetPos);
+  job.input.norm4f        = (const float*)(dataPtr + job.offsetNorm);
+  job.input.tan4f         = (const float*)(dataPtr + job.offsetTang);
+  job.input.texcoord2f    = (const float*)(dataPtr + job.offsetTexc);
+  job.input.indices       = (const int*)  (dataPtr + job.offsetInd);
+  job.input.triMatIndices = (const int*)  (dataPtr + job.offsetMInd);
+  job.input.allData       = dataPtr;
+
+  job.batches = FormMatDrawListRLE(std::vector<uint32_t>(job.input.triMatIndices, job.input.triMatIndices + job.input.triNum));
+}
+
+/**
+\brief pass mesh to driver directly from memory mapped '.vsgf' file (HRInitInfo::mapMeshFiles).
+\return false if file can not be used "as is" (can't be mapped, broken, or normals/tangents need to be computed); caller should use common path then.
+*/
+static bool HR_PrepareMeshUploadMapped(HRMeshUploadJob& job)
+{
+  const char* dataPtr  = nullptr;
+  int64_t     fileSize = 0;
+  job.pFile = hr_map_file(job.path.c_str(), &dataPtr, &fileSize);
+
+  if (job.pFile == nullptr)
+    return false;
+
+  HydraGeomData::Header header;
+  if (fileSize >= int64_t(sizeof(header)))
+    memcpy(&header, dataPtr, sizeof(header));
+
+  const bool dontHaveTangents = (header.flags & HydraGeomData::HAS_TANGENT)    == 0;
+  const bool dontHaveNormals  = (header.flags & HydraGeomData::HAS_NO_NORMALS) != 0;
+
+  if (fileSize < int64_t(sizeof(header)) || int64_t(header.fileSizeInBytes) > fileSize || dontHaveTangents || dontHaveNormals)
+  {
+    hr_unmap_file(job.pFile);
+    return false;
+  }
+
+  job.warnByteSize = (int64_t(header.fileSizeInBytes) != job.byteSize);
+
+  HR_SetPointersFromOffsets(job, dataPtr); // driver must not keep input pointers after UpdateMesh, the same as for m_tempBuffer
+  return true;
+}
+
+static void HR_PrepareMeshUpload(HRMeshUploadJob& job)
+{
+  const wchar_t* path = job.path.c_str();
+
+  if (g_objManager.m_mapMeshFiles && str_tail(job.path, 5) == L".vsgf" && HR_PrepareMeshUploadMapped(job))
+    return;
+
   std::ifstream fin;
   hr_ifstream_open(fin, path);
 
   if(!fin.is_open())
   {
-    HrError(L"UpdateMeshFromChunk: Can't open file: ", path);
+    job.error = std::wstring(L"UpdateMeshFromChunk: Can't open file: ") + job.path;
     return;
   }
   
@@ -701,106 +1237,126 @@ void UpdateMeshFromChunk(int32_t a_id, HRMesh& mesh, std::vector<HRBatchInfo>& a
   fin.read((char*)&header, sizeof(header));
   fin.close();
   
-  const std::wstring tail = str_tail(path, 6);
-  if(tail != L".vsgfc" && header.fileSizeInBytes != a_byteSize)
+  const std::wstring tail = str_tail(job.path, 6);
+  if(tail != L".vsgfc" && header.fileSizeInBytes != job.byteSize)
   {
-    HrPrint(HR_SEVERITY_WARNING, L"UpdateMeshFromChunk, different byte size of chunk, may be broken mesh: ", path);
-    a_byteSize = std::max<int64_t>(a_byteSize, header.fileSizeInBytes);
+    job.warnByteSize = true;
+    job.byteSize     = std::max<int64_t>(job.byteSize, header.fileSizeInBytes);
   }
   
-  g_objManager.m_tempBuffer.resize(a_byteSize / sizeof(int) + sizeof(int) * 16);
-  char* dataPtr = (char*)g_objManager.m_tempBuffer.data();
-  
   const bool dontHaveTangents = (header.flags & HydraGeomData::HAS_TANGENT)    == 0;
   const bool dontHaveNormals  = (header.flags & HydraGeomData::HAS_NO_NORMALS) != 0;
-  
-  HRMeshDriverInput    input;
-  HRMesh::InputTriMesh mesh2;
-  HydraGeomData        data;
-
-  ///////////////////////////////////////////////////////////////////////////////////////////////////////////// obj loader
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
-  std::vector<float> verts;
-  std::vector<float> norms;
-  std::vector<float> tex_s;
-  std::vector<int  > indxs;
-  ///////////////////////////////////////////////////////////////////////////////////////////////////////////// obj loader
 
   // decompress '.vsgfc' format
   //
   if(tail == L".obj")
   {
-    HrPrint(HR_SEVERITY_ERROR, L"UpdateMeshFromChunk, obj loader is not implemented here, ", path);
-    return;
+    job.error = std::wstring(L"UpdateMeshFromChunk, obj loader is not implemented here, ") + job.path;
   }
   else if(tail == L".vsgfc")
   {
-    data                = HR_LoadVSGFCompressedData(path, g_objManager.m_tempBuffer, &a_batches);
-
-    input.vertNum       = data.getVerticesNumber();
-    input.triNum        = data.getIndicesNumber()/3;
-
-    input.pos4f         = data.getVertexPositionsFloat4Array();
-    input.norm4f        = data.getVertexNormalsFloat4Array();
-    input.tan4f         = data.getVertexTangentsFloat4Array();
-    input.texcoord2f    = data.getVertexTexcoordFloat2Array();
-    input.indices       = (const int*)data.getTriangleVertexIndicesArray();
-    input.triMatIndices = (const int*)data.getTriangleMaterialIndicesArray();
-    input.allData       = (char*)g_objManager.m_tempBuffer.data();
+    HydraGeomData data      = HR_LoadVSGFCompressedData(path, job.buffer, &job.batches);
+
+    job.input.vertNum       = data.getVerticesNumber();
+    job.input.triNum        = data.getIndicesNumber()/3;
+
+    job.input.pos4f         = data.getVertexPositionsFloat4Array();
+    job.input.norm4f        = data.getVertexNormalsFloat4Array();
+    job.input.tan4f         = data.getVertexTangentsFloat4Array();
+    job.input.texcoord2f    = data.getVertexTexcoordFloat2Array();
+    job.input.indices       = (const int*)data.getTriangleVertexIndicesArray();
+    job.input.triMatIndices = (const int*)data.getTriangleMaterialIndicesArray();
+    job.input.allData       = (char*)job.buffer.data();
   }
   else if(dontHaveTangents || dontHaveNormals)  // (1) process the case when we don't have tangents or normals ...
   {
+    HydraGeomData data;
     data.read(path);
-    HR_CopyMeshToInputMeshFromHydraGeomData(data, mesh2);
+    HR_CopyMeshToInputMeshFromHydraGeomData(data, job.mesh2);
 
-    a_batches           = FormMatDrawListRLE(mesh2.matIndices);
+    job.batches             = FormMatDrawListRLE(job.mesh2.matIndices);
 
-    input.vertNum       = data.getVerticesNumber();
-    input.triNum        = data.getIndicesNumber()/3;
+    job.input.vertNum       = data.getVerticesNumber();
+    job.input.triNum        = data.getIndicesNumber()/3;
   
-    input.pos4f         = mesh2.verticesPos.data();
-    input.norm4f        = mesh2.verticesNorm.data();
-    input.tan4f         = mesh2.verticesTangent.data();
-    input.texcoord2f    = mesh2.verticesTexCoord.data();
-    input.indices       = (const int*)mesh2.triIndices.data();
-    input.triMatIndices = (const int*)mesh2.matIndices.data();
-    input.allData       = nullptr;
+    job.input.pos4f         = job.mesh2.verticesPos.data();
+    job.input.norm4f        = job.mesh2.verticesNorm.data();
+    job.input.tan4f         = job.mesh2.verticesTangent.data();
+    job.input.texcoord2f    = job.mesh2.verticesTexCoord.data();
+    job.input.indices       = (const int*)job.mesh2.triIndices.data();
+    job.input.triMatIndices = (const int*)job.mesh2.matIndices.data();
+    job.input.allData       = nullptr;
   }
   // (3) read it "as is"
   //
   else
   {
+    job.buffer.resize(job.byteSize / sizeof(int) + sizeof(int) * 16);
+    char* dataPtr = (char*)job.buffer.data();
+
     hr_ifstream_open(fin, path);
-    fin.read(dataPtr, a_byteSize);
+    fin.read(dataPtr, job.byteSize);
     fin.close();
   
-    uint64_t offsetPos  = mesh.pImpl->offset(L"pos");
-    uint64_t offsetNorm = mesh.pImpl->offset(L"norm");
-    uint64_t offsetTexc = mesh.pImpl->offset(L"texc");
-    uint64_t offsetTang = mesh.pImpl->offset(L"tan");
-    uint64_t offsetInd  = mesh.pImpl->offset(L"ind");
-    uint64_t offsetMInd = mesh.pImpl->offset(L"mind");
-  
-    input.vertNum       = nodeXML.attribute(L"vertNum").as_int();
-    input.triNum        = nodeXML.attribute(L"triNum").as_int();
-  
-    input.pos4f         = (float*)(dataPtr + offsetPos);
-    input.norm4f        = (float*)(dataPtr + offsetNorm);
-    input.tan4f         = (float*)(dataPtr + offsetTang);
-    input.texcoord2f    = (float*)(dataPtr + offsetTexc);
-    input.indices       = (int*)  (dataPtr + offsetInd);
-    input.triMatIndices = (int*)  (dataPtr + offsetMInd);
-    input.allData       = dataPtr;
+    HR_SetPointersFromOffsets(job, dataPtr);
+  }
+}
 
-    a_batches           = FormMatDrawListRLE(std::vector<uint32_t>(input.triMatIndices, input.triMatIndices + input.triNum));
+/**
+\brief worker of mesh HRPrefetchPipeline; reading mesh files needs no per thread state.
+*/
+struct HRMeshUploadWorker
+{
+  void operator()(HRMeshUploadJob& job) { HR_PrepareMeshUpload(job); }
+};
+
+static void HR_SubmitMeshUpload(HRMeshUploadJob& job, HRMesh& mesh, std::vector<HRBatchInfo>& a_batches, IHRRenderDriver* a_pDriver)
+{
+  if (job.warnByteSize)
+    HrPrint(HR_SEVERITY_WARNING, L"UpdateMeshFromChunk, different byte size of chunk, may be broken mesh: ", job.path);
+
+  if (!job.error.empty())
+  {
+    HrError(job.error);
+    return;
   }
 
+  a_batches = job.batches;
+
   //#TODO: add debug assert/check that all materials from 'a_batches' were updated previously to 'a_pDriver'
 
-  a_pDriver->UpdateMesh(a_id, nodeXML, input, a_batches.data(), int32_t(a_batches.size()));
-  
+  a_pDriver->UpdateMesh(job.id, mesh.xml_node(), job.input, a_batches.data(), int32_t(a_batches.size()));
+}
+
+void UpdateMeshFromChunk(int32_t a_id, HRMesh& mesh, std::vector<HRBatchInfo>& a_batches, IHRRenderDriver* a_pDriver, const wchar_t* path, int64_t a_byteSize)
+{
+  HRMeshUploadJob job = HR_MakeMeshUploadJob(a_id, mesh, path, a_byteSize);
+  job.buffer.swap(g_objManager.m_tempBuffer); // single mesh reuses common temp buffer as before
+
+  HR_PrepareMeshUpload(job);
+  HR_SubmitMeshUpload(job, mesh, a_batches, a_pDriver);
+
+  job.buffer.swap(g_objManager.m_tempBuffer);
+}
+
+/**
+\brief attached process reads mesh in place from shared memory of the owner; if owner moved or evicted chunk while driver was reading it, 
+       mesh is uploaded again from the new chunk address or from file at last.
+*/
+static void UpdateTornMesh(int32_t a_id, HRMesh& mesh, std::vector<HRBatchInfo>& a_batches, IHRRenderDriver* a_pDriver, const wchar_t* path)
+{
+  for (int attempt = 0; attempt < VB_READ_ATTEMPTS; attempt++)
+  {
+    HRMeshDataPin meshData((size_t)a_id);
+    if (meshData.input.pos4f == nullptr)
+      break;
+
+    a_pDriver->UpdateMesh(a_id, mesh.xml_node(), meshData.input, &a_batches[0], int32_t(a_batches.size()));
+    if (!meshData.IsTorn())
+      return;
+  }
+
+  UpdateMeshFromChunk(a_id, mesh, a_batches, a_pDriver, path, mesh.xml_node().attribute(L"bytesize").as_llong());
 }
 
 const std::wstring GetRealFilePathOfDelayedMesh(pugi::xml_node a_node);
@@ -831,11 +1387,35 @@ int32_t HR_DriverUpdateMeshes(HRSceneInst& scn, ChangeList& objList, HRRender* a
   std::copy(objList.meshUsed.begin(), objList.meshUsed.end(), std::back_inserter(idsToUpdate));
   std::sort(idsToUpdate.begin(), idsToUpdate.end());
 
+  // meshes that are not in virtual buffer are read from files by worker threads in advance; driver still gets them in 'idsToUpdate' order
+  //
+  std::vector<HRMeshUploadJob> jobs;
+  if (!info.supportMeshLoadFromInternalFormat)
+  {
+    for (auto id : idsToUpdate)
+    {
+      HRMesh& mesh = g_objManager.scnData.meshes[id];
+      if (mesh.pImpl != nullptr && !HR_MeshDataIsAvailable(id))
+      {
+        pugi::xml_node meshNode        = mesh.xml_node();
+        const std::wstring filePathStr = GetRealFilePathOfDelayedMesh(meshNode);
+        jobs.push_back(HR_MakeMeshUploadJob(int32_t(id), mesh, filePathStr.c_str(), meshNode.attribute(L"bytesize").as_llong()));
+      }
+    }
+  }
+
+  std::unique_ptr< HRPrefetchPipeline<HRMeshUploadJob, HRMeshUploadWorker> > pPipeline = nullptr;
+  if (jobs.size() > 1)
+    pPipeline = std::make_unique< HRPrefetchPipeline<HRMeshUploadJob, HRMeshUploadWorker> >(jobs);
+
+  HRMeshUploadJob job; // taken from pipeline, its file mapping and memory are freed or reused by the next TakeJob
+  size_t jobIndex = 0;
 
   for (auto id : idsToUpdate)
   {
     HRMesh& mesh            = g_objManager.scnData.meshes[id];
-    HRMeshDriverInput input = HR_GetMeshDataPointers(id);
+    HRMeshDataPin meshData(id); // driver may read other chunks while it has pointers to this one
+    const HRMeshDriverInput& input = meshData.input;
     pugi::xml_node meshNode = mesh.xml_node();
 
     const std::wstring filePathStr = GetRealFilePathOfDelayedMesh(meshNode);
@@ -853,6 +1433,13 @@ int32_t HR_DriverUpdateMeshes(HRSceneInst& scn, ChangeList& objList, HRRender* a
         {
           a_pDriver->UpdateMeshFromFile(int32_t(id), meshNode, path);
         }
+        else if (pPipeline != nullptr && jobIndex < jobs.size() && jobs[jobIndex].id == int32_t(id)) // page in from virtual buffer may still fail
+        {
+          pPipeline->TakeJob(jobIndex, &job);
+          assert(job.id == int32_t(id));
+          HR_SubmitMeshUpload(job, mesh, mlist, a_pDriver);
+          jobIndex++;
+        }
         else
         {
           int64_t byteSize = meshNode.attribute(L"bytesize").as_llong();
@@ -863,6 +1450,8 @@ int32_t HR_DriverUpdateMeshes(HRSceneInst& scn, ChangeList& objList, HRRender* a
       {
         a_pRender->m_updated.meshUsed.insert(id);
         a_pDriver->UpdateMesh(int32_t(id), meshNode, input, &mlist[0], int32_t(mlist.size()));
+        if (meshData.IsTorn())
+          UpdateTornMesh(int32_t(id), mesh, mlist, a_pDriver, path);
       }
 
       updatedMeshes++;
@@ -892,7 +1481,8 @@ int32_t _hr_UtilityDriverUpdateMeshes(HRSceneInst& scn, HRRender* a_pRender)
   for(auto p : a_pRender->m_updated.meshUsed)
   {
     HRMesh& mesh            = g_objManager.scnData.meshes[p];
-    HRMeshDriverInput input = HR_GetMeshDataPointers(p);
+    HRMeshDataPin meshData(p);
+    const HRMeshDriverInput& input = meshData.input;
     pugi::xml_node meshNode = mesh.xml_node();
 
     const std::wstring delayedLoad = meshNode.attribute(L"dl").as_string();
@@ -918,6 +1508,8 @@ int32_t _hr_UtilityDriverUpdateMeshes(HRSceneInst& scn, HRRender* a_pRender)
       else
       {
         a_pDriver->UpdateMesh(p, meshNode, input, &mlist[0], int32_t(mlist.size()));
+        if (meshData.IsTorn())
+          UpdateTornMesh(p, mesh, mlist, a_pDriver, path);
       }
       updatedMeshes++;
     }
@@ -1296,9 +1888,8 @@ void HR_DriverUpdate(HRSceneInst& scn, HRRender* a_pRender)
   
   auto timeBeg = std::chrono::system_clock::now();
   
-  if(g_objManager.m_attachMode && g_objManager.m_pVBSysMutex != nullptr)
-    hr_lock_system_mutex(g_objManager.m_pVBSysMutex, VB_LOCK_WAIT_TIME_MS);          // need to lock here because update may load data from virtual buffer
-  
+  // no lock in attach mode: virtual buffer chunks are read with seqlock, see VBChunkTable
+  //
   HR_DriverUpdateCamera(scn, a_pDriver);
   HR_DriverUpdateSettings(scn, a_pDriver);
 
@@ -1316,9 +1907,6 @@ void HR_DriverUpdate(HRSceneInst& scn, HRRender* a_pRender)
 
   HR_CheckCommitErrors    (scn, objList);
   
-  if(g_objManager.m_attachMode && g_objManager.m_pVBSysMutex != nullptr)
-    hr_unlock_system_mutex(g_objManager.m_pVBSysMutex);
-  
   if(g_objManager.m_attachMode && !g_hydraApiDisableSceneLoadInfo)
     HrPrint(HR_SEVERITY_INFO, L"HydraAPI, begin scene ");
   
@@ -1333,11 +1921,7 @@ void HR_DriverUpdate(HRSceneInst& scn, HRRender* a_pRender)
     //
     a_pDriver->BeginScene(scn.xml_node());
 
-    for (auto p1 = objList.drawSeq.begin(); p1 != objList.drawSeq.end(); p1++)
-    {
-      const auto& seq = p1->second;
-      a_pDriver->InstanceMeshes(p1->first, &seq.matrices[0], int32_t(seq.matrices.size() / 16), &seq.linstid[0], &seq.remapid[0], &seq.instIdReal[0]);
-    }
+    HR_DriverInstanceMeshes(scn, a_pDriver);
 
     for (auto& instance : scn.drawListLights) // #NOTE: this loop can be optimized
       a_pDriver->InstanceLights(instance.lightId, instance.m, &instance.node, 1, instance.lightGroupInstId);
@@ -1411,30 +1995,11 @@ void _hr_UtilityDriverUpdate(HRSceneInst& scn, HRRender* a_pRender)
 
   ///////////////////////////////
 
-  std::unordered_map<int32_t, ChangeList::InstancesInfo > drawSeq;
-
-
-  for (size_t i = 0; i < scn.drawList.size(); i++)
-  {
-    auto instance = scn.drawList[i];
-    if (instance.meshId >= g_objManager.scnData.meshes.size())
-      continue;
-
-    // form draw sequence for each mesh
-    //
-    AddInstanceToDrawSequence(instance, drawSeq, int(i));
-  }
+  HR_UpdateSceneTracker(scn);
 
   ////////////////////////
   a_pDriver->BeginScene(scn.xml_node());
-  {
-    // draw/add instances to scene
-    for (auto p = drawSeq.begin(); p != drawSeq.end(); p++)
-    {
-      const auto& seq = p->second;
-      a_pDriver->InstanceMeshes(p->first, &seq.matrices[0], int32_t(seq.matrices.size() / 16), &seq.linstid[0], &seq.remapid[0], &seq.instIdReal[0]);
-    }
-  }
+  HR_DriverInstanceMeshes(scn, a_pDriver); // draw/add instances to scene
   a_pDriver->EndScene();
 
 }
@@ -15,6 +15,7 @@
 #include <unordered_map>
 #include <iostream>
 #include <memory>
+#include <atomic>
 
 #if (_POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600)
 #include <experimental/filesystem>
@@ -213,6 +214,7 @@ enum CHUNK_TYPE { CHUNK_TYPE_UNKNOWN  = 0,
                   CHUNK_TYPE_IMAGE4F  = 6,
                   CHUNK_TYPE_IMAGE4HF = 7,
                   CHUNK_TYPE_VSGF     = 8,
+                  CHUNK_TYPE_INSTANCES = 9,
 };
 
 
@@ -223,13 +225,12 @@ struct VirtualBuffer;
 */
 struct ChunkPointer
 {
-  ChunkPointer()                              : localAddress(-1), sizeInBytes(0), id(0), inUse(true), wasSaved(false), pVB(nullptr), useCounter(0), sysObjectId(-1), type(CHUNK_TYPE_UNKNOWN), saveCompressed(false) {}
-  explicit ChunkPointer(VirtualBuffer* a_pVB) : localAddress(-1), sizeInBytes(0), id(0), inUse(true), wasSaved(false), pVB(a_pVB), useCounter(0), sysObjectId(-1), type(CHUNK_TYPE_UNKNOWN), saveCompressed(false) {}
+  ChunkPointer()                              : localAddress(-1), sizeInBytes(0), id(0), useCounter(0), sysObjectId(-1), lastUse(0), pinCounter(0), type(CHUNK_TYPE_UNKNOWN), inUse(true), wasSaved(false), saveCompressed(false), pVB(nullptr) {}
+  explicit ChunkPointer(VirtualBuffer* a_pVB) : localAddress(-1), sizeInBytes(0), id(0), useCounter(0), sysObjectId(-1), lastUse(0), pinCounter(0), type(CHUNK_TYPE_UNKNOWN), inUse(true), wasSaved(false), saveCompressed(false), pVB(a_pVB) {}
 
-  void* GetMemoryNow();
-  const void* GetMemoryNow() const;
+  void* GetMemoryNow();             ///< pages chunk in from disk if it was evicted; returns nullptr if this is not possible. Paging in may evict or move other unpinned chunks, see ChunkPin
+  const void* GetMemoryNow() const; ///< pages chunk in from disk if it was evicted; returns nullptr if this is not possible. Paging in may evict or move other unpinned chunks, see ChunkPin
   
-  //void SwapToMemory();
   void SwapToDisk();
   bool InMemory() const { return (localAddress != uint64_t(-1)); }
 
@@ -238,6 +239,8 @@ struct ChunkPointer
   uint64_t id;
   uint32_t useCounter;
   uint32_t sysObjectId;
+  uint64_t lastUse;      ///< value of VirtualBuffer use tick at last access; the least recently used chunks are evicted first
+  uint32_t pinCounter;   ///< pinned chunks are never evicted or moved by collector
   
   CHUNK_TYPE type;
   bool       inUse;
@@ -256,17 +259,84 @@ protected:
 #endif
 
 struct HRSystemMutex;
-#define VB_LOCK_WAIT_TIME_MS 60000
 
 /**
-\brief Infinite linear memory space that stored on disk and cached in shmem with some strategy (copying collector currently ... ).
+\brief Chunk table in shared memory, published with seqlock. There is only one writer, the process that owns virtual buffer.
+       'sequence' is odd while writer changes table or moves chunks data; readers never lock, 
+       they read chunk data in place and retry if 'sequence' was changed meanwhile. So readers never block writer and each other.
+*/
+struct VBChunkTable
+{
+  struct Header
+  {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> chunksNum;
+  };
+
+  struct Entry
+  {
+    std::atomic<int64_t> offset; ///< offset of chunk data in shared memory or -1 if chunk is not there
+    std::atomic<int64_t> size;
+  };
+
+  VBChunkTable() : m_header(nullptr), m_entries(nullptr), m_capacity(0) {}
+
+  void   Bind(void* a_memory, size_t a_sizeInBytes, bool a_clear);
+  bool   IsBound()  const { return m_header != nullptr; }
+  size_t Capacity() const { return m_capacity; }
+
+  // writer side
+  //
+  void BeginWrite();
+  void EndWrite();
+  void SetEntry(size_t a_id, int64_t a_offset, int64_t a_size); ///< must be called between BeginWrite and EndWrite
+  void SetChunksNum(size_t a_chunksNum);                        ///< must be called between BeginWrite and EndWrite
+
+  // reader side
+  //
+  uint64_t BeginRead(int a_maxAttempts) const; ///< wait until writer is done; returns odd value if it never was
+  bool     EndRead(uint64_t a_seq) const;      ///< true if nothing was changed or moved since BeginRead returned a_seq
+
+  bool ReadEntries(std::vector<int64_t>& a_offsets, std::vector<int64_t>& a_sizes, int a_maxAttempts) const;
+  bool ReadEntry(size_t a_id, int64_t* a_pOffset, int64_t* a_pSize, int a_maxAttempts) const;
+  bool ChunkIsPublished(size_t a_id) const;
+
+protected:
+
+  Header* m_header;
+  Entry*  m_entries;
+  size_t  m_capacity;
+};
+
+constexpr int VB_READ_ATTEMPTS = 64; ///< reader gives up and loads chunk from file if writer changes virtual buffer all the time
+
+/**
+\brief Virtual buffer cache counters. Hit and miss are counted on each ChunkPointer::GetMemoryNow call.
+*/
+struct VirtualBufferStats
+{
+  VirtualBufferStats() : hits(0), misses(0), pageInFails(0), evictions(0), collections(0), bytesPagedIn(0), bytesEvicted(0) {}
+
+  uint64_t hits;         ///< chunk was in memory
+  uint64_t misses;       ///< chunk was evicted and had to be paged in (or failed to)
+  uint64_t pageInFails;  ///< chunk can not be paged in: it was never saved, saved compressed or is too big for cache
+  uint64_t evictions;
+  uint64_t collections;
+  uint64_t bytesPagedIn;
+  uint64_t bytesEvicted;
+};
+
+/**
+\brief Infinite linear memory space that stored on disk and cached in shmem with LRU strategy.
        The VirtualBuffer is an allocator or a pool. It is infinite and addressed with uint64_t;
+       When memory ends, least recently used chunks are swapped to disk and resident chunks are compacted to the begin of the buffer.
+       Evicted chunks are paged in back by ChunkPointer::GetMemoryNow. Pinned chunks are never evicted or moved.
 
 */
 struct VirtualBuffer
 {
-  VirtualBuffer() : m_data(nullptr), m_chunkTable(nullptr), m_dataHalfCurr(nullptr), m_dataHalfFree(nullptr),
-                    m_currTop(0), m_currSize(0), m_totalSize(0), m_totalSizeAllocated(0), m_pTempBuffer(nullptr), m_owner(false), m_pVBMutex(nullptr)
+  VirtualBuffer() : m_data(nullptr), m_dataCurr(nullptr),
+                    m_currTop(0), m_currSize(0), m_totalSize(0), m_totalSizeAllocated(0), m_useTick(0), m_pTempBuffer(nullptr), m_mappedSize(0), m_owner(false)
   {
   #ifdef WIN32
     m_fileHandle = 0;
@@ -275,7 +345,7 @@ struct VirtualBuffer
   #endif
   }
 
-  bool Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::vector<int>* a_pTempBuffer, HRSystemMutex* a_mutex);
+  bool Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::vector<int>* a_pTempBuffer);
   bool Attach(uint64_t a_sizeInBytes, const char* a_shmemName, std::vector<int>* a_pTempBuffer);
   void RestoreChunks();
   
@@ -285,9 +355,17 @@ struct VirtualBuffer
 
   size_t size() const { return m_allChunks.size(); }
   size_t AllocChunk(uint64_t a_dataSizeInBytes, uint64_t a_objId); ///< 
+  void   FreeChunk(size_t a_id);                                    ///< give cache memory of unpinned chunk back; id stays reserved, saved chunk file is kept for older states
 
   void   ResizeAndAllocEmptyChunks(uint64_t a_ckunksNum);
 
+  void*  PinChunk(size_t a_id);              ///< get chunk memory (page in if needed) and forbid to evict or move it until UnpinChunk
+  void   UnpinChunk(size_t a_id);
+  bool   ChunkIsAvailable(size_t a_id) const; ///< chunk is in memory or can be paged in; does not touch cache state
+  void   UpdateChunksTable();                 ///< write current chunks addresses to shmem table for attached processes
+
+  inline const VirtualBufferStats& Stats() const { return m_stats; }
+
   // 
   //
   inline ChunkPointer  chunk_at(size_t a_id) const { return m_allChunks[a_id]; }
@@ -295,33 +373,42 @@ struct VirtualBuffer
 
   inline uint64_t       SizeInBytes()    const { return m_currSize; }
   
-  inline const int64_t* ChunksTablePtr() const { return m_chunkTable; }
-  inline int64_t*       ChunksTablePtr()       { return m_chunkTable; }
+  inline const VBChunkTable& ChunksTable() const { return m_table; }
+
+  uint64_t BeginRead() const;                ///< attached process reads chunks in place, take sequence before it
+  bool     ReadIsValid(uint64_t a_seq) const; ///< attached process: owner did not move or evict chunks since BeginRead; always true for owner
   
 protected:
 
   friend struct ChunkPointer;
   
-  constexpr static size_t VB_CHUNK_TABLE_SIZE = sizeof(int64_t)*99999;
+  constexpr static size_t VB_CHUNK_TABLE_SIZE = sizeof(VBChunkTable::Header) + sizeof(VBChunkTable::Entry)*99999;
   constexpr static size_t VB_CHUNK_TABLE_OFFS = 1024;
   
   char* AllocInCacheNow(uint64_t a_sizeInBytes);
   void* AllocInCache(uint64_t a_sizeInBytes); ///< Always alloc aligned 16 byte memory;
-  void  RunCopyingCollector();
-  void  RunCollector(int a_divisor);
+  char* ChunkMemory(size_t a_id);
+  char* PageIn(size_t a_id);
+  bool  CanPageIn(const ChunkPointer& a_chunk) const;
+  bool  EvictLeastRecentlyUsed(uint64_t a_sizeInBytes);
+  void  EvictChunk(size_t a_id);
+  void  CompactResidentChunks();
+  void  PublishChunks();          ///< must be called between m_table.BeginWrite and m_table.EndWrite
 
-  inline uint64_t maxAccumulatedSize() const { return m_currSize / 2; }
+  inline uint64_t maxChunkSize() const { return (m_totalSize*7)/8 - 1024; }
 
-  void*    m_data;
-  int64_t* m_chunkTable;
+  void*        m_data;
+  VBChunkTable m_table;
 
-  char* m_dataHalfCurr;
-  char* m_dataHalfFree;
+  char* m_dataCurr;
 
   uint64_t m_currTop;
   uint64_t m_currSize;
   uint64_t m_totalSize;
   uint64_t m_totalSizeAllocated;
+  uint64_t m_useTick;
+
+  VirtualBufferStats m_stats;
 
 #ifdef WIN32
   void* m_fileHandle;
@@ -333,13 +420,51 @@ protected:
   std::vector<ChunkPointer> m_allChunks;
   std::vector<size_t>       m_chunksIdInMemory;
   std::vector<int>*         m_pTempBuffer;
+  uint64_t                  m_mappedSize;
   
   bool m_owner;
-  HRSystemMutex* m_pVBMutex;
+};
+
+/**
+\brief Pins chunk for the lifetime of this object, so raw pointers to its data stay valid while other chunks are paged in.
+       Any GetMemoryNow call may evict or move unpinned chunks, so take a pin if pointer to one chunk is used after access to another.
+*/
+struct ChunkPin
+{
+  ChunkPin(VirtualBuffer& a_vb, size_t a_id) : m_pVB(&a_vb), m_id(a_id), m_sequence(a_vb.BeginRead()), m_data(a_vb.PinChunk(a_id)) {}
+  ~ChunkPin() { if (m_data != nullptr) m_pVB->UnpinChunk(m_id); }
+
+  ChunkPin(const ChunkPin&)            = delete;
+  ChunkPin& operator=(const ChunkPin&) = delete;
+
+  void* data() const { return m_data; } ///< nullptr if chunk can't be paged in
+  bool  IsTorn() const { return !m_pVB->ReadIsValid(m_sequence); } ///< attached process: owner moved chunk meanwhile, data that was read may be broken
+
+protected:
+
+  VirtualBuffer* m_pVB;
+  size_t         m_id;
+  uint64_t       m_sequence;
+  void*          m_data;
 };
 
 std::wstring ChunkName(const ChunkPointer& a_chunk);
 
+/**
+\brief packed mesh instance; an array of these is stored in CHUNK_TYPE_INSTANCES chunk and referenced from scene by 'instance_table' node.
+       Instance ids are implicit: the first one is stored in 'id' attribute of the table node, others follow sequentially.
+*/
+struct HRInstanceRecord
+{
+  int32_t meshId;
+  int32_t remapListId;
+  int32_t sceneId;
+  int32_t sceneSid;
+  float   matrix[16];
+};
+
+static_assert(sizeof(HRInstanceRecord) == 20*sizeof(int32_t), "HRInstanceRecord must be packed, it is stored in file as is");
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -362,6 +487,16 @@ std::wstring ChunkName(const ChunkPointer& a_chunk);
   bool hr_lock_system_mutex(HRSystemMutex* a_mutex, int a_msToWait = 1000);
   void hr_unlock_system_mutex(HRSystemMutex* a_mutex);
 
+  struct HRMappedFile;
+  HRMappedFile* hr_map_file(const wchar_t* a_fileName, const char** a_pData, int64_t* a_pSize); ///< read only mapping of the whole file; nullptr if failed
+  void hr_unmap_file(HRMappedFile*& a_file);
+
+  struct HRSharedLibrary;
+  HRSharedLibrary* hr_load_library(const wchar_t* a_fileName, std::wstring* a_pErrorMsg = nullptr); ///< dlopen/LoadLibrary; nullptr if failed
+  void*            hr_library_symbol(HRSharedLibrary* a_lib, const char* a_symbolName);              ///< nullptr if symbol not found
+  void             hr_free_library(HRSharedLibrary*& a_lib);
+  std::vector<std::wstring> hr_list_libraries(const wchar_t* a_folder);                               ///< full paths of shared libraries (.so or .dll) in folder, sorted by name
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 std::unique_ptr<IHRRenderDriver> CreateRenderFromString(const wchar_t *a_className, const wchar_t *a_options);
@@ -374,7 +509,28 @@ void HR_DriverDraw(HRSceneInst& scn, HRRender* a_pRender);
 std::wstring HR_UtilityDriverStart(const wchar_t* state_path, HRRender* a_pOriginalRender);
 std::wstring SaveFixedStateXML(pugi::xml_document &doc, const std::wstring &oldPath, const std::wstring &suffix);
 
-HRMeshDriverInput HR_GetMeshDataPointers(size_t a_meshId);
+HRMeshDriverInput HR_GetMeshDataPointers(size_t a_meshId); ///< pointers are valid until other chunk is paged in; use HRMeshDataPin to keep them longer
+
+/**
+\brief HR_GetMeshDataPointers result that stays valid for the lifetime of this object; mesh chunk is pinned meanwhile.
+*/
+struct HRMeshDataPin
+{
+  explicit HRMeshDataPin(size_t a_meshId);
+  ~HRMeshDataPin();
+
+  HRMeshDataPin(const HRMeshDataPin&)            = delete;
+  HRMeshDataPin& operator=(const HRMeshDataPin&) = delete;
+
+  bool IsTorn() const; ///< attached process: owner moved mesh chunk meanwhile, data that was read via 'input' may be broken
+
+  HRMeshDriverInput input;
+
+protected:
+
+  size_t   m_chunkId;
+  uint64_t m_sequence;
+};
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
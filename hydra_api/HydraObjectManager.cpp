@@ -1,4 +1,5 @@
 #include "HydraObjectManager.h"
+#include <mutex>
 
 HRObjectManager g_objManager;
 
@@ -24,25 +25,52 @@ std::wstring      g_lastErrorCallerPlace = L"";
 std::wstring      g_lastError      = L"";
 HR_ERROR_CALLBACK g_pErrorCallback = &_Default_ErrorCallBack;
 HR_INFO_CALLBACK  g_pInfoCallback  = &_Default_InfoCallBack;
+static std::mutex g_errorMutex; // library loader and filter graph may report errors from several threads
 
 
 void HrError(std::wstring a_str) 
 { 
-  if (g_pInfoCallback != nullptr)
-    g_pInfoCallback(a_str.c_str(), g_lastErrorCallerPlace.c_str(), HR_SEVERITY_ERROR);
-  else if (g_pErrorCallback != nullptr)
-    g_pErrorCallback(g_lastError.c_str(), g_lastErrorCallerPlace.c_str());
+  std::wstring      callerPlace, lastError;
+  HR_ERROR_CALLBACK pErrorCallback;
+  HR_INFO_CALLBACK  pInfoCallback;
+  {
+    std::lock_guard<std::mutex> lock(g_errorMutex); // callbacks are called without lock; they may report errors themselves
+    callerPlace    = g_lastErrorCallerPlace;
+    lastError      = g_lastError;
+    pErrorCallback = g_pErrorCallback;
+    pInfoCallback  = g_pInfoCallback;
+    g_lastError    = a_str;
+  }
 
-  g_lastError = a_str;
+  if (pInfoCallback != nullptr)
+    pInfoCallback(a_str.c_str(), callerPlace.c_str(), HR_SEVERITY_ERROR);
+  else if (pErrorCallback != nullptr)
+    pErrorCallback(lastError.c_str(), callerPlace.c_str());
 }
 
 void _HrPrint(HR_SEVERITY_LEVEL a_level, const wchar_t* a_str)
 {
-  if (g_pInfoCallback != nullptr)
-    g_pInfoCallback(a_str, g_lastErrorCallerPlace.c_str(), a_level);
+  std::wstring      callerPlace;
+  HR_ERROR_CALLBACK pErrorCallback;
+  HR_INFO_CALLBACK  pInfoCallback;
+  {
+    std::lock_guard<std::mutex> lock(g_errorMutex); // filters of hrFilterGraphApply may print from several threads
+    callerPlace    = g_lastErrorCallerPlace;
+    pErrorCallback = g_pErrorCallback;
+    pInfoCallback  = g_pInfoCallback;
+  }
+
+  if (pInfoCallback != nullptr)
+    pInfoCallback(a_str, callerPlace.c_str(), a_level);
   
-  if (g_pErrorCallback != nullptr && a_level >= HR_SEVERITY_ERROR)
-    g_pErrorCallback(a_str, g_lastErrorCallerPlace.c_str());
+  if (pErrorCallback != nullptr && a_level >= HR_SEVERITY_ERROR)
+    pErrorCallback(a_str, callerPlace.c_str());
+}
+
+void HrSetErrorCallerPlace(const std::wstring& a_place)
+{
+  std::lock_guard<std::mutex> lock(g_errorMutex); // HrError and _HrPrint may read it from other threads at the same time
+  g_lastErrorCallerPlace = a_place;
 }
 
 // std::wstring&     getErrCallerWstrObject() { return g_lastErrorCallerPlace; }
@@ -68,13 +96,11 @@ void HRObjectManager::init(HRInitInfo a_initInfo)
   m_sortTriIndices             = a_initInfo.sortMaterialIndices;
   m_attachMode                 = (a_initInfo.vbSize <= 1024*1024);
   m_computeBBoxes              = a_initInfo.computeMeshBBoxes;
+  m_binaryInstances            = a_initInfo.binaryInstances;
+  m_mapMeshFiles               = a_initInfo.mapMeshFiles;
   
   m_pFactory = new HydraFactoryCommon;
-  if(SharedVirtualBufferIsEnabled())
-    m_pVBSysMutex = hr_create_system_mutex("hydra_virtual_buffer_lock");
-  else
-    m_pVBSysMutex = nullptr;
-  scnData.init(m_attachMode, m_pVBSysMutex, a_initInfo.vbSize);
+  scnData.init(m_attachMode, a_initInfo.vbSize);
 
   m_pImgTool = HydraRender::CreateImageTool();
   _hrInitPostProcess();
@@ -105,8 +131,6 @@ void HRObjectManager::destroy()
 
 	scnData.m_vbCache.Destroy();
 
-  if(m_pVBSysMutex != nullptr)
-    hr_free_system_mutex(m_pVBSysMutex);
   delete m_pFactory; m_pFactory = nullptr;
 }
 
@@ -263,7 +287,7 @@ void clear_node_childs(pugi::xml_node a_xmlNode)
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-void HRSceneData::init(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, size_t a_vbSize)
+void HRSceneData::init(bool a_attachMode, size_t a_vbSize)
 {
   m_texturesLib  = m_xmlDoc.append_child(L"textures_lib");
   m_materialsLib = m_xmlDoc.append_child(L"materials_lib");
@@ -274,13 +298,13 @@ void HRSceneData::init(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, size
   m_sceneNode    = m_xmlDoc.append_child(L"scenes");
   
   if(!a_attachMode)                                       // will do this init later inside HRSceneData::init_existing when open scene
-    init_virtual_buffer(false, a_pVBSysMutexLock, a_vbSize);
+    init_virtual_buffer(false, a_vbSize);
 
   m_changeList.clear();
   m_changeList.reserve(2048);
 }
 
-void HRSceneData::init_existing(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, const size_t a_size)
+void HRSceneData::init_existing(bool a_attachMode, const size_t a_size)
 {
   m_texturesLib  = m_xmlDoc.child(L"textures_lib");
   m_materialsLib = m_xmlDoc.child(L"materials_lib");
@@ -291,13 +315,13 @@ void HRSceneData::init_existing(bool a_attachMode, HRSystemMutex* a_pVBSysMutexL
   m_sceneNode    = m_xmlDoc.child(L"scenes");
 
 
-  init_virtual_buffer(a_attachMode, a_pVBSysMutexLock, a_size);
+  init_virtual_buffer(a_attachMode, a_size);
 
   m_changeList.clear();
   m_changeList.reserve(1024);
 }
 
-void HRSceneData::init_virtual_buffer(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, size_t a_vbSize)
+void HRSceneData::init_virtual_buffer(bool a_attachMode, size_t a_vbSize)
 {
   if (a_attachMode)
   {
@@ -307,13 +331,13 @@ void HRSceneData::init_virtual_buffer(bool a_attachMode, HRSystemMutex* a_pVBSys
       if (attached)
         m_vbCache.RestoreChunks();
       else
-        m_vbCache.Init(4096, "NOSUCHSHMEM", &g_objManager.m_tempBuffer, a_pVBSysMutexLock); // if fail, init single page only, dummy virtual buffer
+        m_vbCache.Init(4096, "NOSUCHSHMEM", &g_objManager.m_tempBuffer); // if fail, init single page only, dummy virtual buffer
     }
     else
-      m_vbCache.Init(4096, "NOSUCHSHMEM", &g_objManager.m_tempBuffer, a_pVBSysMutexLock);
+      m_vbCache.Init(4096, "NOSUCHSHMEM", &g_objManager.m_tempBuffer);
   }
   else
-    m_vbCache.Init(a_vbSize, "HYDRAAPISHMEM2", &g_objManager.m_tempBuffer, a_pVBSysMutexLock);
+    m_vbCache.Init(a_vbSize, "HYDRAAPISHMEM2", &g_objManager.m_tempBuffer);
 }
 
 void HRSceneData::clear()
@@ -332,13 +356,31 @@ void HRSceneData::clear()
   clear_node(m_settingsNode);
   clear_node(m_sceneNode);
 
-  m_commitId = 0;
+  m_commitId  = 0;
+  m_loadTimes = HRLibraryLoadTimes();
   m_vbCache.Clear();
   m_textureCache.clear();
   m_iesCache.clear();
+  m_materialNames.clear();
+  m_lightNames.clear();
+  m_cameraNames.clear();
   
   m_shadowCatchers.clear();
 
   m_changeList.clear();
 }
 
+void HRSceneData::add_name(std::unordered_map<std::wstring, int32_t>& a_index, const std::wstring& a_name, int32_t a_id)
+{
+  a_index.emplace(a_name, a_id); // ids grow, so existing record always has smaller id
+}
+
+int32_t HRSceneData::find_name(const std::unordered_map<std::wstring, int32_t>& a_index, const wchar_t* a_name)
+{
+  if (a_name == nullptr)
+    return -1;
+
+  auto p = a_index.find(a_name);
+  return (p == a_index.end()) ? -1 : p->second;
+}
+
@@ -4,6 +4,7 @@
 #include "HydraInternal.h"
 #include "HydraRenderDriverAPI.h"
 #include "HR_HDRImage.h"
+#include "HydraBVH.h"
 
 using HydraRender::HDRImage4f;
 using HydraRender::LDRImage1i;
@@ -200,6 +201,9 @@ struct HRMesh : public HRObject<IHRMesh>
   int                  m_allMeshMatId;
   bool                 m_empty;
 
+  std::shared_ptr<const HydraBVH::TriangleBVH> m_blas;       ///< built on demand by scene spatial queries (HydraAPI_SceneQueries.cpp)
+  std::weak_ptr<IHRMesh>                       m_blasSource; ///< pImpl that m_blas was built (or tried to be built) from; the mesh was rewritten if it differs
+
   struct MeshGetInfoGlobalData
   {
     std::vector<const wchar_t*> mptrs;
@@ -301,12 +305,10 @@ static inline std::unordered_set<int32_t> _union_them(const std::unordered_set<i
 struct ChangeList
 {
   ChangeList() {}
-  ChangeList(const ChangeList& a_list) : drawSeq(a_list.drawSeq),
-                                   meshUsed(a_list.meshUsed), matUsed(a_list.matUsed),
+  ChangeList(const ChangeList& a_list) : meshUsed(a_list.meshUsed), matUsed(a_list.matUsed),
                                    lightUsed(a_list.lightUsed), texturesUsed(a_list.texturesUsed) { }
 
-  ChangeList(ChangeList&& a_list) : drawSeq(std::move(a_list.drawSeq)),
-                                    meshUsed(std::move(a_list.meshUsed)), matUsed(std::move(a_list.matUsed)),
+  ChangeList(ChangeList&& a_list) : meshUsed(std::move(a_list.meshUsed)), matUsed(std::move(a_list.matUsed)),
                                     lightUsed(std::move(a_list.lightUsed)), texturesUsed(std::move(a_list.texturesUsed)) { }
 
   ChangeList& operator=(ChangeList& a_list)
@@ -315,7 +317,6 @@ struct ChangeList
     matUsed          = a_list.matUsed;
     lightUsed        = a_list.lightUsed;
     texturesUsed     = a_list.texturesUsed;
-    drawSeq          = a_list.drawSeq;
     return *this;
   }
 
@@ -325,7 +326,6 @@ struct ChangeList
     matUsed          = std::move(a_list.matUsed);
     lightUsed        = std::move(a_list.lightUsed);
     texturesUsed     = std::move(a_list.texturesUsed);
-    drawSeq          = std::move(a_list.drawSeq);
     return *this;
   }
 
@@ -342,15 +342,12 @@ struct ChangeList
     std::vector<int32_t>  instIdReal;
   };
 
-  std::unordered_map<int32_t, InstancesInfo> drawSeq;
-
   void clear()
   {
     meshUsed.clear();
     matUsed.clear();
     lightUsed.clear();
     texturesUsed.clear();
-    drawSeq.clear();
   }
 
   void reserve(size_t a_n)
@@ -359,7 +356,6 @@ struct ChangeList
     matUsed.reserve(a_n*4);
     meshUsed.reserve(a_n*4);
     lightUsed.reserve(a_n/4);
-    drawSeq.reserve(a_n*4);
   }
   
   ChangeList intersect_with(const ChangeList& a_rhs)
@@ -379,7 +375,6 @@ struct ChangeList
     res.matUsed      = _union_them(matUsed,      a_rhs.matUsed);
     res.lightUsed    = _union_them(lightUsed,    a_rhs.lightUsed);
     res.texturesUsed = _union_them(texturesUsed, a_rhs.texturesUsed);
-    res.drawSeq      = drawSeq;
     return res;
   }
   
@@ -389,6 +384,20 @@ struct ChangeList
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/**
+\brief time of _hrSceneLibraryLoad phases in milliseconds.
+*/
+struct HRLibraryLoadTimes
+{
+  HRLibraryLoadTimes() : xmlParse(0.0f), virtualBuffer(0.0f), objects(0.0f), instances(0.0f), total(0.0f) {}
+
+  float xmlParse;
+  float virtualBuffer;
+  float objects;
+  float instances;
+  float total;
+};
+
 struct HRSceneData : public HRObject<IHRSceneData>
 {
 
@@ -422,17 +431,55 @@ struct HRSceneData : public HRObject<IHRSceneData>
   std::unordered_map<std::wstring, int32_t>      m_textureCache;
   std::unordered_map<std::wstring, std::wstring> m_iesCache;
 
+  // name --> id indices for hrFind*ByName; if several objects share the same name, the one with smallest id is found
+  //
+  std::unordered_map<std::wstring, int32_t>      m_materialNames;
+  std::unordered_map<std::wstring, int32_t>      m_lightNames;
+  std::unordered_map<std::wstring, int32_t>      m_cameraNames;
+
   // dependency data
   //
   std::unordered_set<int32_t>                    m_shadowCatchers;
 
   ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// 
   
-  void init(bool a_emptyvb, HRSystemMutex* a_pVBSysMutexLock, size_t a_size);
-  void init_existing(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, size_t a_size);
+  void init(bool a_emptyvb, size_t a_size);
+  void init_existing(bool a_attachMode, size_t a_size);
   void clear();
 
+  static void add_name(std::unordered_map<std::wstring, int32_t>& a_index, const std::wstring& a_name, int32_t a_id);
+  static int32_t find_name(const std::unordered_map<std::wstring, int32_t>& a_index, const wchar_t* a_name);
+
+  /**
+  \brief change object name and keep name index valid
+  */
+  template<typename ObjectType>
+  static void rename_object(std::vector<ObjectType>& a_objects, std::unordered_map<std::wstring, int32_t>& a_index, int32_t a_id, const std::wstring& a_newName)
+  {
+    const std::wstring oldName = a_objects[a_id].name;
+    a_objects[a_id].name       = a_newName;
+
+    auto p = a_index.find(oldName);
+    if (p != a_index.end() && p->second == a_id) // other object with the same old name (if exists) should be found now
+    {
+      a_index.erase(p);
+      for (const auto& obj : a_objects)
+      {
+        if (obj.name == oldName)
+        {
+          a_index[oldName] = obj.id;
+          break;
+        }
+      }
+    }
+
+    auto q = a_index.find(a_newName);
+    if (q == a_index.end() || q->second > a_id)
+      a_index[a_newName] = a_id;
+  }
+
   int32_t m_commitId;
+  HRLibraryLoadTimes m_loadTimes;
   std::wstring m_path;
   std::wstring m_pathState;
   std::wstring m_fileState;
@@ -440,7 +487,7 @@ struct HRSceneData : public HRObject<IHRSceneData>
   ChangeList m_changeList;
 
 protected:
-  void init_virtual_buffer(bool a_attachMode, HRSystemMutex* a_pVBSysMutexLock, size_t a_size);
+  void init_virtual_buffer(bool a_attachMode, size_t a_size);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -449,7 +496,7 @@ protected:
 
 struct HRSceneInst : public HRObject<IHRSceneInst>
 {
-  HRSceneInst() : pImpl(nullptr), drawBegin(0), drawBeginLight(0), driverDirtyFlag(true), lightGroupCounter(0), instancedScenesCounter(0) {}
+  HRSceneInst() : pImpl(nullptr), drawBegin(0), drawBeginLight(0), m_drawListVersion(0), m_remapListsVersion(0), driverDirtyFlag(true), lightGroupCounter(0), instancedScenesCounter(0) {}
 
   void update(pugi::xml_node a_newNode)
   {
@@ -468,6 +515,11 @@ struct HRSceneInst : public HRObject<IHRSceneInst>
     lightGroupCounter = 0;
     instancedScenesCounter = 0;
     m_bbox = BBox();
+    m_tracker.clear();
+    m_instanceTables.clear();
+    m_spatial = nullptr;
+    m_drawListVersion++;
+    m_remapListsVersion++;
   }
 
   std::shared_ptr<IHRSceneInst> pImpl;
@@ -506,8 +558,66 @@ struct HRSceneInst : public HRObject<IHRSceneInst>
   std::vector< std::vector<int32_t> >   m_remapList;
   std::unordered_map<uint64_t, int32_t> m_remapCache;
 
+  std::vector<size_t> m_instanceTables; ///< chunks allocated by hrSceneClose for 'instance_table' nodes; freed when scene is discarded
+
   BBox m_bbox;
 
+  /**
+  \brief Scene content accumulated from drawList/drawListLights so far.
+
+   HR_DriverUpdate catches it up from drawList[drawEnd] on each commit instead of rescanning every instance;
+   it is dropped together with the draw lists (hrSceneOpen with HR_WRITE_DISCARD or clear()).
+  */
+  struct ChangeTracker
+  {
+    ChangeTracker() : drawEnd(0), lightsEnd(0), remapVersion(uint64_t(-1)) {}
+
+    std::unordered_map<int32_t, std::vector<int32_t> > meshInst; ///< per mesh indices of drawList[0, drawEnd); matrices are read from drawList
+    std::unordered_set<int32_t> meshUsed;  ///< unique meshes of drawList[0, drawEnd)
+    std::unordered_set<int32_t> matUsed;   ///< unique materials from remap lists of drawList[0, drawEnd)
+    std::unordered_set<int32_t> lightUsed; ///< unique lights of drawListLights[0, lightsEnd)
+    std::vector<size_t>         pending;   ///< drawList[0, drawEnd) instances of meshes that did not exist yet; retried on each commit
+    size_t drawEnd;
+    size_t lightsEnd;
+
+    std::vector< std::vector<int32_t> > remapLists;   ///< parsed 'remap_lists' of scene xml, per list id
+    std::unordered_set<int32_t>         remapMats;    ///< all ids from remapLists
+    uint64_t                            remapVersion; ///< m_remapListsVersion the cache was built for
+
+    void clear()
+    {
+      meshInst.clear();
+      meshUsed.clear();
+      matUsed.clear();
+      lightUsed.clear();
+      pending.clear();
+      drawEnd   = 0;
+      lightsEnd = 0;
+      remapLists.clear();
+      remapMats.clear();
+      remapVersion = uint64_t(-1);
+    }
+
+  } m_tracker;
+
+  /**
+  \brief Two level BVH over drawList for picking and visibility queries (HydraAPI_SceneQueries.cpp).
+
+   Built by the first query; later queries rebuild only if the instanced meshes were changed and refit it if only matrices were changed.
+  */
+  struct SpatialIndex
+  {
+    HydraBVH::BVHTree            tlas;
+    std::vector<HydraBVH::Box3f> instBoxes;  ///< world space box for each drawList[i]
+    std::vector<int32_t>         meshIds;    ///< drawList[i].meshId at the moment of build, to detect topology changes
+    std::vector<int32_t>         usedMeshes; ///< unique mesh ids of drawList
+    uint64_t                     drawListVersion = uint64_t(-1);
+  };
+
+  std::shared_ptr<SpatialIndex> m_spatial;
+  uint64_t                      m_drawListVersion; ///< incremented when drawList may be changed (hrSceneOpen, clear, load from file)
+  uint64_t                      m_remapListsVersion; ///< incremented when 'remap_lists' node of scene xml is rewritten (hrSceneClose)
+
   bool driverDirtyFlag;  // if true, driver need to Update this scene.
   int32_t lightGroupCounter;
   int32_t instancedScenesCounter;
@@ -545,8 +655,8 @@ struct HRRender : public HRObject<IHRRender>
 
 struct HRObjectManager
 {
-  HRObjectManager() : m_pFactory(nullptr), m_pDriver(nullptr), m_pImgTool(nullptr), m_currSceneId(0), m_currRenderId(0), m_currCamId(0), m_pVBSysMutex(nullptr),
-                      m_copyTexFilesToLocalStorage(false), m_useLocalPath(true), m_attachMode(false), m_sortTriIndices(false), m_computeBBoxes(false) {}
+  HRObjectManager() : m_currSceneId(0), m_currRenderId(0), m_currCamId(0), m_appendToChangeFile(false), m_pFactory(nullptr), m_pDriver(nullptr), m_pImgTool(nullptr),
+                      m_copyTexFilesToLocalStorage(false), m_useLocalPath(true), m_sortTriIndices(false), m_attachMode(false), m_computeBBoxes(false), m_binaryInstances(false), m_mapMeshFiles(false) {}
  
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// 
 
@@ -557,7 +667,6 @@ struct HRObjectManager
   int32_t m_currRenderId;
   int32_t m_currCamId;
   
-  HRSystemMutex*           m_pVBSysMutex;
   HRInitInfo               m_lastInitInfo;
   
   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////// 
@@ -580,6 +689,7 @@ struct HRObjectManager
 
   std::vector<int> m_tempBuffer;
   std::wstring     m_tempPathToChangeFile;
+  bool             m_appendToChangeFile; ///< false after hrFlush created new change file path; true after first write to it
   std::vector<int> EmptyBuffer() { return std::vector<int>(); }
 
   IHydraFactory* m_pFactory; // actual Factory
@@ -609,10 +719,13 @@ struct HRObjectManager
   bool m_sortTriIndices;
   bool m_attachMode;
   bool m_computeBBoxes;
+  bool m_binaryInstances;
+  bool m_mapMeshFiles;
 };
 
 void HrError(std::wstring a_str);
 void _HrPrint(HR_SEVERITY_LEVEL a_level, const wchar_t* a_str);
+void HrSetErrorCallerPlace(const std::wstring& a_place);
 
 template <typename HEAD>
 void _HrPrint(std::wstringstream& out, HEAD head)
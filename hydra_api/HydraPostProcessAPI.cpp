@@ -3,9 +3,15 @@
 #include "HydraPostProcessSpecial.h"
 #include "HydraObjectManager.h"
 #include "HR_HDRImageTool.h"
+#include "HydraLegacyUtils.h"
 
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+
+#include <omp.h>
 
 struct FrameBufferImage
 {
@@ -22,81 +28,218 @@ static std::unordered_map<std::wstring, std::shared_ptr<IFilter2D> >        g_co
 static std::unordered_map<std::wstring, std::shared_ptr<IFilter2DSpecial> > g_spetialFilters;
 static std::vector<FrameBufferImage> g_fbImages;
 
-#ifdef WIN32
-static HMODULE g_dllFilterHangle = NULL;
-PCREATEFUN_T  g_createFunc = nullptr;
+/**
+\brief loaded plugin library; exactly one of (createFunc, info) is not null.
+*/
+struct FilterPlugin
+{
+  HRSharedLibrary*          lib;
+  std::wstring              path;
+  PCREATEFUN_T              createFunc; ///< legacy C++ interface; filters are created on demand by name
+  const HRFilterPluginInfo* info;       ///< C ABI; filters are registered by names from info when plugin is loaded
+};
+
+static std::vector<FilterPlugin>     g_filterPlugins;
+static std::unordered_set<std::wstring> g_unknownFilters; ///< names that no legacy plugin could create; they are not asked again until new plugin is loaded
 
-static HMODULE g_dllFilterHangle2 = NULL;
-PCREATEFUN_T  g_createFunc2 = nullptr;
+/**
+\brief IFilter2D adapter for filters that are implemented via C ABI (HRFilterPluginInfo). Passes images to plugin without copy.
+*/
+class FilterPluginC : public IFilter2D
+{
+public:
 
-#endif
+  FilterPluginC(const HRFilterPluginInfo* a_info, const wchar_t* a_name) : m_info(a_info), m_name(a_name) { memset(&m_args, 0, sizeof(m_args)); }
 
-extern HRObjectManager g_objManager;
-bool g_hydraapipostprocessloaddll = true;
+  void Release() override { }
+  bool Eval()    override;
 
-void _hrDestroyPostProcess()
+  void SetInput(Filter2DInput a_input) override { m_args = a_input; }
+
+private:
+
+  const HRFilterPluginInfo* m_info;
+  std::wstring              m_name;
+  Filter2DInput             m_args;
+};
+
+bool FilterPluginC::Eval()
 {
-  g_fbImages.clear();
-  g_spetialFilters.clear();
-  g_commonFilters.clear();
+  HRFilterImageView views[FILTER_MAX_ARGS];
+
+  const int argsNum = std::min(m_args.argsNum, FILTER_MAX_ARGS);
+  for (int i = 0; i < argsNum; i++)
+  {
+    views[i].name   = m_args.names [i];
+    views[i].data   = m_args.datas [i];
+    views[i].width  = m_args.width [i];
+    views[i].height = m_args.height[i];
+    views[i].bpp    = m_args.bpp   [i];
+    views[i].pitch  = m_args.width [i];
+  }
+
+  m_msg[0] = L'\0';
+  const int32_t res = m_info->eval(m_name.c_str(), views, argsNum, m_args.settingsXmlStr, m_msg, ERR_MSG_SIZE);
+  m_msg[ERR_MSG_SIZE - 1] = L'\0';
+
+  m_hasWarning = (res == HR_FILTER_WARNING);
+  return (res == HR_FILTER_OK || res == HR_FILTER_WARNING);
 }
 
-void _hrInitPostProcess()
+static bool FilterNameIsTaken(const std::wstring& a_name)
 {
-  // clwar previous resources
-  //
-  _hrDestroyPostProcess();
+  return g_spetialFilters.find(a_name) != g_spetialFilters.end() || g_commonFilters.find(a_name) != g_commonFilters.end();
+}
 
-  // do init here
-  //
-  std::wstring filtersSpecial[] = { L"resample", L"median", L"median_n", L"NLMPut", L"blur" };
+static bool LoadFilterPlugin(const std::wstring& a_path)
+{
+  for (const auto& plugin : g_filterPlugins)
+  {
+    if (plugin.path == a_path)
+      return false;
+  }
 
-  for(const auto& name : filtersSpecial)
-    g_spetialFilters[name] = CreateSpecialFilter(name.c_str());
+  std::wstring errMsg;
+  HRSharedLibrary* lib = hr_load_library(a_path.c_str(), &errMsg);
+  if (lib == nullptr)
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"[hrFilterLoadPlugins]: can't load plugin ", a_path, L"; ", errMsg);
+    return false;
+  }
 
-  // load dll's
-  //
+  FilterPlugin plugin;
+  plugin.lib        = lib;
+  plugin.path       = a_path;
+  plugin.createFunc = nullptr;
+  plugin.info       = nullptr;
 
-#ifdef WIN32
+  auto getInfo = (PGETFILTERPLUGININFO_T)hr_library_symbol(lib, "hrGetFilterPluginInfo");
 
-  // add filters from example DLL 
-  //
-  if(g_hydraapipostprocessloaddll)
+  if (getInfo != nullptr)
   {
-    g_dllFilterHangle = LoadLibraryW(L"D:/PROG/HydraAPI/hydra_api/x64/Release/PostProcessDLLExample.dll");
+    plugin.info = getInfo();
 
-    if (g_dllFilterHangle != NULL)
-      g_createFunc = (PCREATEFUN_T)GetProcAddress(g_dllFilterHangle, "CreateFilter");
+    if (plugin.info == nullptr || plugin.info->abiVersion != HR_FILTER_PLUGIN_ABI_VERSION || plugin.info->eval == nullptr)
+    {
+      HrPrint(HR_SEVERITY_WARNING, L"[hrFilterLoadPlugins]: unsupported plugin ABI version, plugin = ", a_path);
+      hr_free_library(lib);
+      return false;
+    }
 
-    if (g_createFunc != nullptr)
+    for (int i = 0; i < plugin.info->filtersNum; i++)
     {
-      std::wstring filtersCommon[] = { L"tonemapping_obsolette" };
+      const wchar_t* name = plugin.info->filterNames[i];
+
+      if (name == nullptr)
+        continue;
 
-      for (auto name : filtersCommon)
-        g_commonFilters[name] = std::shared_ptr<IFilter2D>(g_createFunc(name.c_str()));
+      if (FilterNameIsTaken(name))
+      {
+        HrPrint(HR_SEVERITY_WARNING, L"[hrFilterLoadPlugins]: filter already exists, name = ", name, L"; ignored from plugin ", a_path);
+        continue;
+      }
+
+      g_commonFilters[name] = std::make_shared<FilterPluginC>(plugin.info, name);
     }
   }
-
-  // add filters from Hydra private post process dll
-  //
-  if (g_hydraapipostprocessloaddll)
+  else
   {
-    g_dllFilterHangle2 = LoadLibraryW(L"C:/[Hydra]/bin2/PostProcess.dll");
-
-    if (g_dllFilterHangle2 != NULL)
-      g_createFunc2 = (PCREATEFUN_T)GetProcAddress(g_dllFilterHangle2, "CreateFilter");
+    plugin.createFunc = (PCREATEFUN_T)hr_library_symbol(lib, "CreateFilter");
 
-    if (g_createFunc2 != nullptr)
+    if (plugin.createFunc == nullptr)
     {
-      std::wstring filtersCommon[] = { L"post_process_hydra1" };
+      HrPrint(HR_SEVERITY_WARNING, L"[hrFilterLoadPlugins]: neither 'hrGetFilterPluginInfo' nor 'CreateFilter' found in ", a_path);
+      hr_free_library(lib);
+      return false;
+    }
+  }
+
+  g_filterPlugins.push_back(plugin);
+  g_unknownFilters.clear();
+  return true;
+}
+
+/**
+\brief find filter among registered common filters; otherwise ask legacy plugins to create it, once per name.
+*/
+static std::shared_ptr<IFilter2D> FindCommonFilter(const wchar_t* a_name)
+{
+  auto p = g_commonFilters.find(a_name);
+  if (p != g_commonFilters.end())
+    return p->second;
+
+  if (g_unknownFilters.find(a_name) != g_unknownFilters.end())
+    return nullptr;
 
-      for (auto name : filtersCommon)
-        g_commonFilters[name] = std::shared_ptr<IFilter2D>(g_createFunc2(name.c_str()));
+  for (const auto& plugin : g_filterPlugins)
+  {
+    if (plugin.createFunc == nullptr)
+      continue;
+
+    IFilter2D* pFilter = plugin.createFunc(a_name);
+    if (pFilter != nullptr)
+    {
+      auto res = std::shared_ptr<IFilter2D>(pFilter);
+      g_commonFilters[a_name] = res;
+      return res;
     }
   }
 
-#endif // _WIN32
+  g_unknownFilters.insert(a_name);
+  return nullptr;
+}
+
+int hrFilterLoadPlugins(const wchar_t* a_folder)
+{
+  if (a_folder == nullptr)
+    return 0;
 
+  int loaded = 0;
+  for (const auto& path : hr_list_libraries(a_folder))
+  {
+    if (LoadFilterPlugin(path))
+      loaded++;
+  }
+
+  return loaded;
+}
+
+extern HRObjectManager g_objManager;
+bool g_hydraapipostprocessloaddll = true;
+
+void _hrDestroyPostProcess()
+{
+  g_fbImages.clear();
+  g_spetialFilters.clear();
+  g_commonFilters.clear(); // filter objects must die before their plugin code is unloaded
+
+  for (auto& plugin : g_filterPlugins)
+    hr_free_library(plugin.lib);
+  g_filterPlugins.clear();
+  g_unknownFilters.clear();
+}
+
+void _hrInitPostProcess()
+{
+  // clwar previous resources
+  //
+  _hrDestroyPostProcess();
+
+  // do init here
+  //
+  std::wstring filtersSpecial[] = { L"resample", L"median", L"median_n", L"NLMPut", L"blur", L"post_process_hydra1" };
+
+  for(const auto& name : filtersSpecial)
+    g_spetialFilters[name] = CreateSpecialFilter(name.c_str());
+
+  // load plugins
+  //
+  if(g_hydraapipostprocessloaddll)
+  {
+    const char* pluginsFolder = std::getenv("HYDRA_API_FILTER_PLUGINS");
+    if (pluginsFolder != nullptr && pluginsFolder[0] != '\0')
+      hrFilterLoadPlugins(s2ws(pluginsFolder).c_str());
+  }
 
 }
 
@@ -372,6 +515,116 @@ void hrRenderCopyFrameBufferToFBI(HRRenderRef a_render, const wchar_t* a_name, H
 }
 
 
+/**
+\brief filter found by name; exactly one of (special, common) is not null.
+*/
+struct FilterRef
+{
+  std::shared_ptr<IFilter2DSpecial> special;
+  std::shared_ptr<IFilter2D>        common;
+};
+
+struct FilterArg
+{
+  const wchar_t*    name;
+  FrameBufferImage* image;
+};
+
+static bool FindFilter(const wchar_t* a_filterName, FilterRef& a_filter)
+{
+  auto p = g_spetialFilters.find(a_filterName);
+  if (p != g_spetialFilters.end())
+  {
+    a_filter.special = p->second;
+    a_filter.common  = nullptr;
+    return true;
+  }
+
+  a_filter.special = nullptr;
+  a_filter.common  = FindCommonFilter(a_filterName);
+  return (a_filter.common != nullptr);
+}
+
+static bool EvalFilter(const FilterRef& a_filter, pugi::xml_node a_parameters, std::shared_ptr<IHRRenderDriver> a_pDriver,
+                       const FilterArg* a_args, int a_argsNum)
+{
+  if (a_filter.special != nullptr)              // some special implementation like Resample or MedianInPlace
+  {
+    IFilter2DSpecial::ArgArray1 argArrayHDR;
+    IFilter2DSpecial::ArgArray2 argArrayLDR;
+
+    for (int i = 0; i < a_argsNum; i++)
+    {
+      argArrayHDR[a_args[i].name] = a_args[i].image->pHDRImage;
+      argArrayLDR[a_args[i].name] = a_args[i].image->pLDRImage;
+    }
+
+    bool isOk = a_filter.special->Eval(argArrayHDR, argArrayLDR, a_parameters, a_pDriver);
+    if (!isOk)
+      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: filter error = ", a_filter.special->GetLastError());
+    return isOk;
+  }
+  
+  // common filter impl.
+  //
+  auto pFilter = a_filter.common;
+
+  // first, put xml node to string to pass it to DLL plugin
+  //
+  pugi::xml_document doc;
+  doc.append_copy(a_parameters);
+
+  std::wstringstream strOut;
+  doc.save(strOut);
+
+  const std::wstring xmlStr = strOut.str();
+  
+  // then, fill C-style input to pass it to DLL plugin
+  //
+  Filter2DInput input;
+  memset(&input, 0, sizeof(input));
+  
+  input.argsNum        = a_argsNum;
+  input.settingsXmlStr = xmlStr.c_str();
+  
+  for (int i = 0; i < a_argsNum; i++)
+  {
+    input.names[i] = a_args[i].name;
+  
+    const auto& image = *(a_args[i].image);
+  
+    if (image.pHDRImage != nullptr)
+    {
+      input.width [i] = image.pHDRImage->width();
+      input.height[i] = image.pHDRImage->height();
+      input.datas [i] = image.pHDRImage->data();
+      input.bpp   [i] = 16;
+    }
+    else if (image.pLDRImage != nullptr)
+    {
+      input.width [i] = image.pLDRImage->width();
+      input.height[i] = image.pLDRImage->height();
+      input.datas [i] = (float*)image.pLDRImage->data();
+      input.bpp   [i] = 4;
+    }
+  }
+  
+  // finally set input and run filter
+  //
+  pFilter->SetInput(input);
+  if (!pFilter->Eval())
+  {
+    HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: filter error = ", pFilter->GetLastError());
+    return false;
+  }
+  else if (pFilter->HasWarning())
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"[hrFilterApply]: filter warning = ", pFilter->GetLastError());
+  }
+
+  return true;
+}
+
 void hrFilterApply(const wchar_t* a_filterName, pugi::xml_node a_parameters, HRRenderRef a_rendRef,
                    const wchar_t* a_argName1,   HRFBIRef a_arg1,
                    const wchar_t* a_argName2,   HRFBIRef a_arg2,
@@ -426,104 +679,323 @@ void hrFilterApply(const wchar_t* a_filterName, pugi::xml_node a_parameters, HRR
 
   // now we must figure out what API should be used for filter with name a_filterName
   //
-  auto p = g_spetialFilters.find(a_filterName);
-  if (p != g_spetialFilters.end())              // some special implementation like Resample or MedianInPlace
+  FilterRef filter;
+  if (!FindFilter(a_filterName, filter))
   {
-    std::shared_ptr<IFilter2DSpecial> pFilterSpecial = p->second;
+    HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: unknown filter, name  = ", a_filterName);
+    return;
+  }
 
-    IFilter2DSpecial::ArgArray1 argArrayHDR;
-    IFilter2DSpecial::ArgArray2 argArrayLDR;
+  FilterArg filterArgs[FILTER_MAX_ARGS];
+  int       filterArgsNum = 0;
 
-    for (int i = 0; i < imagesNumber; i++)
+  for (int i = 0; i < imagesNumber; i++)
+  {
+    if (images[i].id >= int32_t(g_fbImages.size()) || images[i].id < 0)
     {
-      if (images[i].id >= g_fbImages.size() || images[i].id < 0)
-      {
-        HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: bad image id = ", images[i].id);
-        continue;
-      }
+      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: bad image id = ", images[i].id);
+      continue;
+    }
+
+    filterArgs[filterArgsNum].name  = args[i];
+    filterArgs[filterArgsNum].image = &g_fbImages[images[i].id];
+    filterArgsNum++;
+  }
+
+  EvalFilter(filter, a_parameters, pDriver, filterArgs, filterArgsNum);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace FILTER_GRAPH
+{
+  /**
+  \brief intermediate image of filter graph; its memory is taken from graph image pool only for waves [firstWave, lastWave].
+  */
+  struct TempImage
+  {
+    std::wstring     name;
+    int              width;
+    int              height;
+    int              bpp;
+    int              firstWave;
+    int              lastWave;
+    FrameBufferImage image;
+  };
+
+  struct NodeArg
+  {
+    std::wstring name;
+    int          imageKey; ///< >= 0 for temporary image index, < 0 for frame buffer image with id = (-imageKey-1)
+    bool         isInput;
+    bool         isOutput;
+  };
+
+  struct Node
+  {
+    std::wstring         filterName;
+    pugi::xml_node       settings;
+    std::vector<NodeArg> args;
+    FilterRef            filter;
+    int                  wave;
+  };
+
+  bool ImageFits(const FrameBufferImage& a_image, int a_width, int a_height, int a_bpp)
+  {
+    if (a_bpp == 16)
+      return a_image.pHDRImage != nullptr && a_image.pHDRImage->width() == a_width && a_image.pHDRImage->height() == a_height;
+    else
+      return a_image.pLDRImage != nullptr && a_image.pLDRImage->width() == a_width && a_image.pLDRImage->height() == a_height;
+  }
+};
 
-      auto& image = g_fbImages[images[i].id];
-      argArrayHDR[args[i]] = image.pHDRImage;      
-      argArrayLDR[args[i]] = image.pLDRImage;      
+/**
+\brief take image of suitable size from pool of released intermediate images or create new one.
+*/
+static FrameBufferImage AcquireGraphImage(const FILTER_GRAPH::TempImage& a_temp, std::vector<FrameBufferImage>& a_pool)
+{
+  for (size_t i = 0; i < a_pool.size(); i++)
+  {
+    if (FILTER_GRAPH::ImageFits(a_pool[i], a_temp.width, a_temp.height, a_temp.bpp))
+    {
+      FrameBufferImage res = a_pool[i];
+      a_pool.erase(a_pool.begin() + i);
+      res.name = a_temp.name;
+      return res;
     }
+  }
 
-    bool isOk = pFilterSpecial->Eval(argArrayHDR, argArrayLDR, a_parameters, pDriver);
-    if (!isOk)
+  FrameBufferImage res;
+  res.name = a_temp.name;
+  if (a_temp.bpp == 16)
+    res.pHDRImage = std::make_shared<HDRImage4f>(a_temp.width, a_temp.height);
+  else
+    res.pLDRImage = std::make_shared<LDRImage1i>(a_temp.width, a_temp.height);
+  return res;
+}
+
+bool hrFilterGraphApply(pugi::xml_node a_graph, HRRenderRef a_rendRef)
+{
+  using namespace FILTER_GRAPH;
+
+  HRRender* pRenderObj = g_objManager.PtrById(a_rendRef);
+  auto pDriver         = (pRenderObj == nullptr) ? nullptr : pRenderObj->m_pDriver;
+
+  // (1) read temporary images and filter nodes
+  //
+  std::vector<TempImage>                   temps;
+  std::unordered_map<std::wstring, int>    tempByName;
+
+  for (pugi::xml_node imageNode : a_graph.children(L"image"))
+  {
+    TempImage temp;
+    temp.name      = imageNode.attribute(L"name").as_string();
+    temp.width     = imageNode.attribute(L"width").as_int();
+    temp.height    = imageNode.attribute(L"height").as_int();
+    temp.bpp       = imageNode.attribute(L"bpp").as_int(16);
+    temp.firstWave = std::numeric_limits<int>::max();
+    temp.lastWave  = -1;
+
+    if (temp.name.empty() || temp.width <= 0 || temp.height <= 0 || (temp.bpp != 16 && temp.bpp != 4) || tempByName.find(temp.name) != tempByName.end())
     {
-      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: filter error = ", pFilterSpecial->GetLastError());
-      return;
+      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: bad image declaration, name = ", temp.name);
+      return false;
     }
+
+    tempByName[temp.name] = int(temps.size());
+    temps.push_back(temp);
   }
-  else                                          // common filter impl.
+
+  std::vector<Node> nodes;
+
+  for (pugi::xml_node filterNode : a_graph.children(L"filter"))
   {
-    // first, find filter by name
-    //
-    auto p2 = g_commonFilters.find(a_filterName);
-    if (p2 == g_commonFilters.end())
+    Node node;
+    node.filterName = filterNode.attribute(L"name").as_string();
+    node.settings   = filterNode.child(L"settings");
+    node.wave       = 0;
+
+    if (!FindFilter(node.filterName.c_str(), node.filter))
     {
-      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: unknown filter, name  = ", a_filterName);
-      return;
+      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: unknown filter, name  = ", node.filterName);
+      return false;
     }
 
-    auto pFilter = p2->second;
+    for (pugi::xml_node argNode : filterNode.children(L"arg"))
+    {
+      NodeArg arg;
+      arg.name     = argNode.attribute(L"name").as_string();
+      arg.isInput  = (arg.name.find(L"out_") != 0);  // names without "in_" or "out_" prefix are treated as both
+      arg.isOutput = (arg.name.find(L"in_")  != 0);
 
-    // next, put xml node to string to pass it to DLL plugin
-    //
-    pugi::xml_document doc;
-    doc.append_copy(a_parameters);
+      if (argNode.attribute(L"image") != nullptr)
+      {
+        auto p = tempByName.find(argNode.attribute(L"image").as_string());
+        if (p == tempByName.end())
+        {
+          HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: undeclared image, name = ", argNode.attribute(L"image").as_string());
+          return false;
+        }
+        arg.imageKey = p->second;
+      }
+      else
+      {
+        const int fbiId = argNode.attribute(L"fbi").as_int(-1);
+        if (fbiId < 0 || fbiId >= int(g_fbImages.size()))
+        {
+          HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: bad image id = ", fbiId, L", filter = ", node.filterName);
+          return false;
+        }
+        arg.imageKey = -fbiId - 1;
+      }
 
-    std::wstringstream strOut;
-    doc.save(strOut);
+      node.args.push_back(arg);
+    }
 
-    const std::wstring xmlStr = strOut.str();
-    
-    // then, fill C-style input to pass it to DLL plugin
-    //
-    Filter2DInput input;
-    
-    input.argsNum        = imagesNumber;
-    input.settingsXmlStr = xmlStr.c_str();
-    
-    for (int i = 0; i < imagesNumber; i++)
+    if (node.args.empty() || node.args.size() > FILTER_MAX_ARGS)
     {
-      input.names[i] = args[i];
-    
-      if (images[i].id >= g_fbImages.size() || images[i].id < 0)
+      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: bad arguments number for filter ", node.filterName);
+      return false;
+    }
+
+    nodes.push_back(node);
+  }
+
+  // (2) build DAG from read/write hazards in document order; wave = longest path from graph sources
+  //
+  struct ImageState
+  {
+    int lastWriterWave = -1;
+    int lastReaderWave = -1; ///< latest wave that reads image after last write
+    bool written       = false;
+  };
+
+  std::unordered_map<int, ImageState> states;
+
+  for (auto& node : nodes)
+  {
+    int wave = 0;
+    for (const auto& arg : node.args)
+    {
+      const ImageState& state = states[arg.imageKey];
+
+      if (arg.isInput && arg.imageKey >= 0 && !state.written)
       {
-        HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: bad image id = ", images[i].id);
-        continue;
+        HrPrint(HR_SEVERITY_ERROR, L"[hrFilterGraphApply]: image is read before it is written, name = ", temps[arg.imageKey].name);
+        return false;
       }
-    
-      auto& image = g_fbImages[images[i].id];
-    
-      if (image.pHDRImage != nullptr)
+
+      if (arg.isInput || arg.isOutput)                     // RAW and WAW
+        wave = std::max(wave, state.lastWriterWave + 1);
+      if (arg.isOutput)                                    // WAR
+        wave = std::max(wave, state.lastReaderWave + 1);
+    }
+
+    node.wave = wave;
+
+    for (const auto& arg : node.args)
+    {
+      ImageState& state = states[arg.imageKey];
+      if (arg.isOutput)
       {
-        input.width [i] = image.pHDRImage->width();
-        input.height[i] = image.pHDRImage->height();
-        input.datas [i] = image.pHDRImage->data();
-        input.bpp   [i] = 16;
+        state.lastWriterWave = wave;
+        state.lastReaderWave = -1;
+        state.written        = true;
       }
       else
+        state.lastReaderWave = std::max(state.lastReaderWave, wave);
+
+      if (arg.imageKey >= 0)
       {
-        input.width [i] = image.pLDRImage->width();
-        input.height[i] = image.pLDRImage->height();
-        input.datas [i] = (float*)image.pLDRImage->data();
-        input.bpp   [i] = 4;
+        TempImage& temp = temps[arg.imageKey];
+        temp.firstWave  = std::min(temp.firstWave, wave);
+        temp.lastWave   = std::max(temp.lastWave,  wave);
       }
     }
-    
-    // finally set input and run filter
-    //
-    pFilter->SetInput(input);
-    if (!pFilter->Eval())
+  }
+
+  int wavesNum = 0;
+  for (const auto& node : nodes)
+    wavesNum = std::max(wavesNum, node.wave + 1);
+
+  // (3) run waves; nodes of one wave are independent, but the same filter object can't be used by two threads
+  //
+  bool allOk = true;
+  std::vector<FrameBufferImage> imagePool; // released intermediate images are reused by the next waves; all of them are freed when graph is done
+
+  for (int wave = 0; wave < wavesNum; wave++)
+  {
+    for (auto& temp : temps)
     {
-      HrPrint(HR_SEVERITY_ERROR, L"[hrFilterApply]: filter error = ", pFilter->GetLastError());
+      if (temp.firstWave == wave)
+        temp.image = AcquireGraphImage(temp, imagePool);
     }
-    else if (pFilter->HasWarning())
+
+    std::vector<Node*> waveNodes;
+    for (auto& node : nodes)
     {
-      HrPrint(HR_SEVERITY_WARNING, L"[hrFilterApply]: filter warning = ", pFilter->GetLastError());
+      if (node.wave == wave)
+        waveNodes.push_back(&node);
     }
 
+    while (!waveNodes.empty())
+    {
+      std::vector<Node*> batch, rest;
+      for (auto pNode : waveNodes)
+      {
+        bool filterIsBusy = false;
+        for (auto pOther : batch)
+          filterIsBusy = filterIsBusy || (pOther->filter.special == pNode->filter.special && pOther->filter.common == pNode->filter.common);
+        (filterIsBusy ? rest : batch).push_back(pNode);
+      }
+
+      const int batchSize = int(batch.size());
+      const int procsNum  = omp_get_num_procs();
+      const int outerNum  = std::min(batchSize, procsNum);
+      const int innerNum  = std::max(1, procsNum / outerNum);
+
+      const int oldLevels = omp_get_max_active_levels();
+      if (outerNum > 1)
+        omp_set_max_active_levels(std::max(oldLevels, 2)); // let each branch run parallel loops of its filter with the rest of threads
+
+      int failedNum = 0;
+
+      #pragma omp parallel for num_threads(outerNum) schedule(dynamic) reduction(+:failedNum) if(outerNum > 1)
+      for (int i = 0; i < batchSize; i++)
+      {
+        if (outerNum > 1)
+          omp_set_num_threads(innerNum);
+
+        const Node& node = *batch[i];
+
+        FilterArg args[FILTER_MAX_ARGS];
+        for (size_t argId = 0; argId < node.args.size(); argId++)
+        {
+          const NodeArg& arg = node.args[argId];
+          args[argId].name   = arg.name.c_str();
+          args[argId].image  = (arg.imageKey >= 0) ? &temps[arg.imageKey].image : &g_fbImages[-arg.imageKey - 1];
+        }
+
+        if (!EvalFilter(node.filter, node.settings, pDriver, args, int(node.args.size())))
+          failedNum++;
+      }
+
+      omp_set_max_active_levels(oldLevels);
+
+      allOk     = allOk && (failedNum == 0);
+      waveNodes = rest;
+    }
+
+    for (auto& temp : temps)
+    {
+      if (temp.lastWave == wave)
+      {
+        imagePool.push_back(temp.image);
+        temp.image = FrameBufferImage();
+      }
+    }
   }
 
+  return allOk;
 }
@@ -89,6 +89,20 @@ void hrFBIResize(HRFBIRef a_image, int w, int h);
 */
 void hrRenderCopyFrameBufferToFBI(HRRenderRef a_render, const wchar_t* name, HRFBIRef a_outData);
 
+/**
+\brief Load post processing filter plugins from all shared libraries (.so on Linux, .dll on Windows) in a folder.
+
+\param a_folder - folder to scan; libraries are loaded in alphabetical order
+\return number of successfully loaded plugins
+
+Each plugin must export 'hrGetFilterPluginInfo' (C ABI, see HRFilterPluginInfo in HydraPostProcessCommon.h) or legacy 'CreateFilter'.
+Filters from plugins are called by hrFilterApply by their names. Built-in filters and filters of previously loaded plugins have priority. 
+Plugins are unloaded by hrSceneLibraryOpen, which then loads plugins from the folder specified by 'HYDRA_API_FILTER_PLUGINS' environment variable (if it is set).
+So call this function after hrSceneLibraryOpen.
+
+*/
+int hrFilterLoadPlugins(const wchar_t* a_folder);
+
 /**
 \brief Return reference to some internal render frame buffer image
 
@@ -109,3 +123,33 @@ void hrFilterApply(const wchar_t* a_filterName, pugi::xml_node a_parameters, HRR
                    const wchar_t* a_argName6 = L"", HRFBIRef a_arg6 = HRFBIRef(),
                    const wchar_t* a_argName7 = L"", HRFBIRef a_arg7 = HRFBIRef(),
                    const wchar_t* a_argName8 = L"", HRFBIRef a_arg8 = HRFBIRef());
+
+/**
+\brief Apply a graph (DAG) of filters at once.
+
+\param a_graph   - xml node with graph description (see below)
+\param a_rendRef - render reference (may be "HRRenderRef()" in most cases) if it is needed for filters
+\return true if all filters succeeded
+
+Graph example:
+
+  <graph>
+    <image name="half" width="960" height="540" bpp="16" />   <!-- intermediate image; it is not visible outside of graph -->
+    <filter name="resample">
+      <arg name="in_color"  fbi="0" />                        <!-- frame buffer image with HRFBIRef::id == 0 -->
+      <arg name="out_color" image="half" />
+    </filter>
+    <filter name="post_process_hydra1">
+      <settings exposure="2.0" />                             <!-- passed to filter as a_parameters of hrFilterApply -->
+      <arg name="in_color"  image="half" />
+      <arg name="out_color" fbi="1" />
+    </filter>
+  </graph>
+
+Filters are listed in the order of sequential execution. Dependencies are taken from argument names:
+"in_*" arguments are read, "out_*" arguments are written, other arguments are treated as both.
+Filters that don't depend on each other are run in parallel (if they are different filters).
+Memory for intermediate images is allocated only for the time between their first and last use and is reused from internal pool.
+
+*/
+bool hrFilterGraphApply(pugi::xml_node a_graph, HRRenderRef a_rendRef = HRRenderRef());
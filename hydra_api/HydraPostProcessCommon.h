@@ -62,3 +62,46 @@ private:
 };
 
 typedef IFilter2D* (*PCREATEFUN_T)(const wchar_t* a_name);
+
+/**
+\brief C ABI for post processing plugins; unlike IFilter2D it does not depend on compiler vtable layout or C++ runtime.
+
+A plugin (.so or .dll) exports 'hrGetFilterPluginInfo' returning pointer to static HRFilterPluginInfo (see hrFilterLoadPlugins).
+Plugins that export only the legacy 'CreateFilter' (PCREATEFUN_T) are still supported.
+
+*/
+extern "C"
+{
+  enum { HR_FILTER_PLUGIN_ABI_VERSION = 1 };
+
+  enum HR_FILTER_RESULT { HR_FILTER_OK = 0, HR_FILTER_WARNING = 1, HR_FILTER_ERROR = 2 };
+
+  /**
+  \brief zero-copy view of frame buffer image. 'data' points directly to library owned image memory which stays valid only during eval call.
+  */
+  struct HRFilterImageView
+  {
+    const wchar_t* name;   ///< argument name, "in_*" or "out_*"
+    void*          data;   ///< float4 pixels if bpp == 16, packed int RGBA if bpp == 4
+    int32_t        width;  ///< image width
+    int32_t        height; ///< image height
+    int32_t        bpp;    ///< 16 or 4
+    int32_t        pitch;  ///< distance between rows in pixels; currently always equal to width
+  };
+
+  /**
+  \brief evaluate filter 'a_filterName'. Must return HR_FILTER_RESULT; on warning or error writes zero terminated message to a_msg (a_msgSize wchars).
+  */
+  typedef int32_t (*PFILTEREVAL_T)(const wchar_t* a_filterName, const HRFilterImageView* a_args, int32_t a_argsNum,
+                                   const wchar_t* a_settingsXmlStr, wchar_t* a_msg, int32_t a_msgSize);
+
+  struct HRFilterPluginInfo
+  {
+    int32_t               abiVersion;  ///< must be HR_FILTER_PLUGIN_ABI_VERSION
+    int32_t               filtersNum;  ///< number of filters implemented by plugin
+    const wchar_t* const* filterNames; ///< names of filters; they are registered just like built-in filters
+    PFILTEREVAL_T         eval;        ///< is called from hrFilterApply; may use OpenMP or SIMD internally
+  };
+
+  typedef const HRFilterPluginInfo* (*PGETFILTERPLUGININFO_T)();
+}
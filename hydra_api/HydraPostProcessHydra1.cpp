@@ -0,0 +1,1018 @@
+#include "HydraPostProcessSpecial.h"
+#include "HydraObjectManager.h"
+#include "HydraXMLHelpers.h"
+#include "ssemath.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+#include <omp.h>
+
+using HydraRender::HDRImage4f;
+using HydraLiteMath::float3;
+
+// This is the Linux-native version of "post_process_hydra1" that used to live in PostProcessDLL/PostProcess.cpp (Windows-only DLL).
+// The original made a full image pass per effect; here all pointwise operators (exposure, vignette, chromatic aberration, sharpness,
+// white balance, saturation, compress, contrast) are fused into one tiled pass. Only the global operators (auto white balance, compress
+// threshold, diffraction stars, uniform contrast and normalize histograms) need additional passes, and only when they are enabled.
+
+constexpr int   PP_HISTOGRAM_BINS = 10000;
+constexpr int   PP_TILE_W         = 128;   ///< tile of the fused pass; (PP_TILE_W+2)*(PP_TILE_H+2) float4 stays in L2
+constexpr int   PP_TILE_H         = 32;
+constexpr float PP_STAR_THRESHOLD = 50.0f; ///< pixels brighter than this (in any channel) emit diffraction stars
+constexpr int   PP_CURVE_SIZE     = 4096;  ///< per channel curves are tabulated on [0,1] and linearly interpolated
+
+struct PostProcessHydra1Settings
+{
+  int    numThreads      = 0;
+  float  exposure        = 1.0f;
+  float  compress        = 0.0f;
+  float  contrast        = 1.0f;
+  float  saturation      = 1.0f;
+  float  whiteBalance    = 0.0f;
+  float3 whitePointColor = float3(0.0f, 0.0f, 0.0f);
+  float  uniformContrast = 0.0f;
+  float  normalize       = 0.0f;
+  float  vignette        = 0.0f;
+  float  chromAberr      = 0.0f;
+  float  sharpness       = 0.0f;
+  float  sizeStar        = 0.0f;
+  int    numRay          = 0;
+  int    rotateRay       = 0;
+  float  randomAngle     = 0.0f;
+  float  sprayRay        = 0.0f;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// row-major 3x3 matrices; out = M*in
+//
+static const float SRGB_TO_XYZ[9] = { 0.4124564f,  0.3575761f,  0.1804375f,
+                                      0.2126729f,  0.7151522f,  0.0721750f,
+                                      0.0193339f,  0.1191920f,  0.9503041f };
+
+static const float XYZ_TO_SRGB[9] = { 3.2404542f, -1.5371385f, -0.4985314f,
+                                     -0.9692660f,  1.8760108f,  0.0415560f,
+                                      0.0556434f, -0.2040259f,  1.0572252f };
+
+static const float CAT02[9]       = { 0.7328f,  0.4296f, -0.1624f,
+                                     -0.7036f,  1.6975f,  0.0061f,
+                                      0.0030f,  0.0136f,  0.9834f };
+
+static const float CAT02_INV[9]   = { 1.096124f, -0.278869f, 0.182745f,
+                                      0.454369f,  0.473533f, 0.072098f,
+                                     -0.009628f, -0.005698f, 1.015326f };
+
+static const float XYZ_TO_LMS[9]  = { 0.4002f, 0.7075f, -0.0807f,
+                                     -0.2280f, 1.1500f,  0.0612f,
+                                      0.0f,    0.0f,     0.9184f };
+
+static const float LMS_TO_XYZ[9]  = { 1.8493f, -1.1383f,  0.2381f,
+                                      0.3660f,  0.6444f, -0.010f,
+                                      0.0f,     0.0f,     1.0893f };
+
+static const float LMS_TO_IPT[9]  = { 0.4000f,  0.4000f,  0.2000f,
+                                      4.4550f, -4.8510f,  0.3960f,
+                                      0.8056f,  0.3572f, -1.1628f };
+
+static const float IPT_TO_LMS[9]  = { 0.9999f,  0.0970f,  0.2053f,
+                                      0.9999f, -0.1138f,  0.1332f,
+                                      0.9999f,  0.0325f, -0.6768f };
+
+static void MatMul3(const float a[9], const float b[9], float res[9])
+{
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      res[i * 3 + j] = a[i * 3 + 0] * b[0 * 3 + j] + a[i * 3 + 1] * b[1 * 3 + j] + a[i * 3 + 2] * b[2 * 3 + j];
+}
+
+static float3 MatMul3(const float m[9], float3 v)
+{
+  return float3(m[0] * v.x + m[1] * v.y + m[2] * v.z,
+                m[3] * v.x + m[4] * v.y + m[5] * v.z,
+                m[6] * v.x + m[7] * v.y + m[8] * v.z);
+}
+
+/**
+\brief 3x3 matrix with broadcasted elements for multiplying 4 pixels in SoA form (one channel per register).
+*/
+struct Mat3SSE
+{
+  Mat3SSE() = default;
+  explicit Mat3SSE(const float a_m[9])
+  {
+    for (int k = 0; k < 9; k++)
+      m[k] = _mm_set1_ps(a_m[k]);
+  }
+
+  inline void mul(__m128& x, __m128& y, __m128& z) const
+  {
+    const __m128 x1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)), _mm_mul_ps(m[2], z));
+    const __m128 y1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[3], x), _mm_mul_ps(m[4], y)), _mm_mul_ps(m[5], z));
+    const __m128 z1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[6], x), _mm_mul_ps(m[7], y)), _mm_mul_ps(m[8], z));
+    x = x1;
+    y = y1;
+    z = z1;
+  }
+
+  __m128 m[9];
+};
+
+static inline __m128 SignedPow(const __m128 v, const __m128 p)
+{
+  const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  const __m128 absV     = _mm_andnot_ps(signMask, v);
+  return _mm_or_ps(HydraSSE::powf4p(absV, p), _mm_and_ps(signMask, v));
+}
+
+/**
+\brief per-axis gather taps for chromatic aberration. Source pixel 's' is shifted to 's + (2*s/size - 1)*shift' and splatted bilinearly
+       by the original code. The shift grows monotonically with a step greater than one pixel, so every target pixel receives at most one
+       source with floor(newPos) == t (weight w0) and one with floor(newPos) == t-1 (weight w1); this turns the scatter into a gather.
+
+*/
+struct PPGatherTap
+{
+  int   s0, s1;
+  float w0, w1;
+};
+
+static std::vector<PPGatherTap> MakeAberrationTaps(const int a_size, const float a_shift)
+{
+  std::vector<PPGatherTap> taps(a_size);
+  for (int t = 0; t < a_size; t++)
+    taps[t] = { t, t, 0.0f, 0.0f };
+
+  for (int s = 0; s < a_size; s++)
+  {
+    const float velocity = ((float)s / a_size) * 2.0f - 1.0f; // -1.0f to 1.0f
+    const float newPos   = s + velocity * a_shift;
+    const int   floorPos = (int)floorf(newPos);
+
+    float d = newPos - (int)newPos;
+    if (d < 0.0f) d = 1.0f - fabsf(d);
+
+    if (floorPos < 0 || floorPos >= a_size - 1)
+      continue;
+
+    taps[floorPos    ].s0 = s;
+    taps[floorPos    ].w0 = 1.0f - d;
+    taps[floorPos + 1].s1 = s;
+    taps[floorPos + 1].w1 = d;
+  }
+
+  return taps;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+\brief all per-frame constants of the fused pass, computed once before the tile loop.
+*/
+struct PPFrameConstants
+{
+  int   width, height;
+  float centerX, centerY, radius;
+
+  __m128 exposure;      ///< (e,e,e,1)
+  float  vignette;
+
+  bool   doWhiteBalance;
+  Mat3SSE whiteBalance;  ///< sRGB -> XYZ -> CAT02 -> von Kries scale -> CAT02^-1 -> XYZ -> sRGB, all in one matrix
+
+  bool   doSaturation;
+  bool   doCompress;
+  bool   compressKnee;  ///< compress < 1 also blends with per-channel knee compression
+  std::vector<float> kneeLow;   ///< x / (1 + x^knee)^(1/knee)  for x in [0,1]
+  std::vector<float> kneeHigh;  ///< (1 + u^knee)^(-1/knee)     for u = 1/x in [0,1]
+  Mat3SSE rgbToLms, lmsToIpt, iptToLms, lmsToRgb;
+
+  bool   doContrast;
+  std::vector<float> contrastCurve; ///< for x in [0,1]
+};
+
+static inline float VignetteFactor(const PPFrameConstants& c, const int x, const int y)
+{
+  if (c.vignette <= 0.0f)
+    return 1.0f;
+  const float dx   = (float)x - c.centerX;
+  const float dy   = (float)y - c.centerY;
+  const float dist = sqrtf(dx * dx + dy * dy) / c.radius;
+  return sqrtf(fmaxf(1.0f - dist * c.vignette, 0.0f));
+}
+
+static inline __m128 VignetteFactor4(const PPFrameConstants& c, const int x, const int y)
+{
+  if (c.vignette <= 0.0f)
+    return _mm_set1_ps(1.0f);
+  const __m128 dx   = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)), _mm_set1_ps(c.centerX));
+  const __m128 dy   = _mm_set1_ps((float)y - c.centerY);
+  const __m128 dist = _mm_div_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))), _mm_set1_ps(c.radius));
+  return _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(dist, _mm_set1_ps(c.vignette))), _mm_setzero_ps()));
+}
+
+/**
+\brief exposure, clamp of negative values and vignette; the part of the pipeline that the original applied in its first loop.
+*/
+static inline __m128 ExposureVignette(const PPFrameConstants& c, const float* a_pixel, const int x, const int y)
+{
+  const __m128 v = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(a_pixel), c.exposure), _mm_setzero_ps());
+  return _mm_mul_ps(v, _mm_set1_ps(VignetteFactor(c, x, y)));
+}
+
+static inline float LumForSharp(const float* a_pixel)
+{
+  const float lum = (a_pixel[0] + a_pixel[1] + a_pixel[2]) / 3.0f;
+  return lum / (1.0f + lum);
+}
+
+/**
+\brief tabulates a_func on [0,1]; one extra element makes the interpolation at x == 1 safe.
+*/
+template<typename Func>
+static std::vector<float> TabulateCurve(Func a_func)
+{
+  std::vector<float> curve(PP_CURVE_SIZE + 2);
+  for (int i = 0; i <= PP_CURVE_SIZE; i++)
+    curve[i] = a_func(float(i) / float(PP_CURVE_SIZE));
+  curve[PP_CURVE_SIZE + 1] = curve[PP_CURVE_SIZE];
+  return curve;
+}
+
+static inline __m128 LookupCurve(const std::vector<float>& a_curve, const __m128 x)
+{
+  const __m128  fx = _mm_mul_ps(_mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f)), _mm_set1_ps(float(PP_CURVE_SIZE)));
+  const __m128i ix = _mm_cvttps_epi32(fx);
+  const __m128  t  = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+
+  alignas(16) int idx[4];
+  _mm_store_si128((__m128i*)idx, ix);
+
+  const float* c = a_curve.data();
+  const __m128 a = _mm_set_ps(c[idx[3]],     c[idx[2]],     c[idx[1]],     c[idx[0]]);
+  const __m128 b = _mm_set_ps(c[idx[3] + 1], c[idx[2] + 1], c[idx[1] + 1], c[idx[0] + 1]);
+  return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+/**
+\brief knee compression 'x / (1 + x^knee)^(1/knee)'; above 1 it is tabulated as a function of 1/x, so x^knee never overflows.
+*/
+static inline __m128 KneeCompress(const PPFrameConstants& c, const __m128 v)
+{
+  const __m128 one   = _mm_set1_ps(1.0f);
+  const __m128 above = _mm_cmpgt_ps(v, one);
+  __m128 res = LookupCurve(c.kneeLow, v);
+  if (_mm_movemask_ps(above) != 0)
+    res = _mm_blendv_ps(res, LookupCurve(c.kneeHigh, _mm_div_ps(one, v)), above);
+  return res;
+}
+
+static float ContrastCurve(float x)
+{
+  x = powf(x, 0.4545f);
+  if (x > 0.0f && x < 1.0f)
+  {
+    const float a = x * 1.5707f;
+    x = sinf(a) * sinf(a);
+  }
+  return powf(x, 2.2f);
+}
+
+/**
+\brief 'pow(ContrastField(pow(x, 1/2.2)), 2.2)' blended with x; above 1 ContrastField does nothing, so only two pow() are left there.
+*/
+static inline __m128 Contrast(const PPFrameConstants& c, const __m128 v, const __m128 a_mix)
+{
+  const __m128 above = _mm_cmpgt_ps(v, _mm_set1_ps(1.0f));
+  __m128 cd = LookupCurve(c.contrastCurve, v);
+  if (_mm_movemask_ps(above) != 0)
+    cd = _mm_blendv_ps(cd, HydraSSE::powf4p(HydraSSE::powf4p(v, _mm_set1_ps(0.4545f)), _mm_set1_ps(2.2f)), above);
+  return _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(cd, v), a_mix));
+}
+
+/**
+\brief all pointwise operators that follow the sharpening in the original, in the same order; 4 pixels at once, one channel per register.
+*/
+static inline void PointwiseTail(const PPFrameConstants& c, const PostProcessHydra1Settings& s, __m128& r, __m128& g, __m128& b)
+{
+  const __m128 zero = _mm_setzero_ps();
+
+  // ----- White balance -----
+  if (c.doWhiteBalance)
+  {
+    c.whiteBalance.mul(r, g, b);
+    r = _mm_max_ps(r, zero);
+    g = _mm_max_ps(g, zero);
+    b = _mm_max_ps(b, zero);
+  }
+
+  // ----- Saturation  -----
+  if (c.doSaturation)
+  {
+    const __m128 sat = _mm_set1_ps(s.saturation);
+    const __m128 lum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(0.2126f)), _mm_mul_ps(g, _mm_set1_ps(0.7152f))), _mm_mul_ps(b, _mm_set1_ps(0.0722f)));
+    r = _mm_max_ps(_mm_add_ps(lum, _mm_mul_ps(_mm_sub_ps(r, lum), sat)), zero);
+    g = _mm_max_ps(_mm_add_ps(lum, _mm_mul_ps(_mm_sub_ps(g, lum), sat)), zero);
+    b = _mm_max_ps(_mm_add_ps(lum, _mm_mul_ps(_mm_sub_ps(b, lum), sat)), zero);
+  }
+
+  // ----- Compress -----
+  if (c.doCompress)
+  {
+    const __m128 rComp = c.compressKnee ? KneeCompress(c, r) : r;
+    const __m128 gComp = c.compressKnee ? KneeCompress(c, g) : g;
+    const __m128 bComp = c.compressKnee ? KneeCompress(c, b) : b;
+
+    const __m128 toIpt = _mm_set1_ps(0.43f);
+    const __m128 toLms = _mm_set1_ps(2.3255819f); // 1.0f / 0.43f
+
+    __m128 i = r, p = g, t = b;
+    c.rgbToLms.mul(i, p, t);
+    i = SignedPow(i, toIpt);
+    p = SignedPow(p, toIpt);
+    t = SignedPow(t, toIpt);
+    c.lmsToIpt.mul(i, p, t);
+
+    __m128 i2 = _mm_mul_ps(i, i);
+    i2 = _mm_div_ps(i2, _mm_add_ps(_mm_set1_ps(1.0f), i2));
+    p  = _mm_mul_ps(p, _mm_sub_ps(_mm_set1_ps(1.0f), i2));
+    t  = _mm_mul_ps(t, _mm_sub_ps(_mm_set1_ps(1.0f), i2));
+    i  = _mm_sqrt_ps(i2);
+
+    c.iptToLms.mul(i, p, t);
+    i = SignedPow(i, toLms);
+    p = SignedPow(p, toLms);
+    t = SignedPow(t, toLms);
+    c.lmsToRgb.mul(i, p, t);
+
+    const __m128 mix = _mm_set1_ps(1.0f - s.compress);
+    r = _mm_add_ps(i, _mm_mul_ps(_mm_sub_ps(rComp, i), mix));
+    g = _mm_add_ps(p, _mm_mul_ps(_mm_sub_ps(gComp, p), mix));
+    b = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(bComp, t), mix));
+  }
+
+  // ----- Contrast -----
+  if (c.doContrast)
+  {
+    const __m128 mix = _mm_set1_ps(s.contrast - 1.0f);
+    r = Contrast(c, r, mix);
+    g = Contrast(c, g, mix);
+    b = Contrast(c, b, mix);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void AddBilinear(const float a_color[3], float* a_stars, const float newPosX, const float newPosY, const int a_width, const int a_height)
+{
+  const int floorX = (int)floorf(newPosX);
+  const int floorY = (int)floorf(newPosY);
+
+  if (floorX < 0 || floorY < 0 || floorX >= a_width - 1 || floorY >= a_height - 1)
+    return;
+
+  const float dx = newPosX - (float)floorX;
+  const float dy = newPosY - (float)floorY;
+
+  const float w[4]   = { (1.0f - dx) * (1.0f - dy), dx * (1.0f - dy), dy * (1.0f - dx), dx * dy };
+  const int   idx[4] = { floorY * a_width + floorX, floorY * a_width + floorX + 1, (floorY + 1) * a_width + floorX, (floorY + 1) * a_width + floorX + 1 };
+
+  for (int k = 0; k < 4; k++)
+  {
+    a_stars[idx[k] * 4 + 0] += a_color[0] * w[k];
+    a_stars[idx[k] * 4 + 1] += a_color[1] * w[k];
+    a_stars[idx[k] * 4 + 2] += a_color[2] * w[k];
+  }
+}
+
+/**
+\brief draws rays of one diffraction star into a_stars (float4 per pixel). Uses rand() exactly like the original, so the stars must be
+       drawn sequentially in scan order to get the same picture.
+*/
+static void DrawDiffractionStar(const float a_color[3], const int x, const int y, const PostProcessHydra1Settings& s,
+                                const int a_width, const int a_height, const float a_radiusImage, float* a_stars)
+{
+  const float twoPI       = 6.283185f;
+  const float angle       = twoPI / s.numRay;
+  const float waveLenghtG = 0.000530f;
+
+  float lum = 0.2126f * a_color[0] + 0.7152f * a_color[1] + 0.0722f * a_color[2];
+  lum /= (1.0f + lum);
+
+  for (int numRay = 0; numRay < s.numRay; ++numRay)
+  {
+    const float jitter = (rand() % 100) / 100.0f + 0.5f;
+    float nextAngle    = angle * numRay - s.rotateRay * 0.01745329252f;
+    if ((rand() % 1000) / 1000.0f <= s.randomAngle)
+      nextAngle = (rand() % 628) / 100.0f;
+
+    const float sprayAngle = ((float)(rand() % (int)(angle * 100)) / 100.0f) * s.sprayRay;
+    nextAngle += (sprayAngle - angle / 2.0f);
+
+    const float sizeStar        = s.sizeStar * a_radiusImage / 100.0f;
+    const float sizeStarFromLum = sizeStar * lum * jitter / 5.0f;
+
+    // Aperture big   - dist ray small, wave small
+    // Aperture small - dist ray big, wave big
+    const float diafragma = 1.0f / (sizeStarFromLum * 5.0f * jitter);
+    const float cosAngle  = cosf(nextAngle);
+    const float sinAngle  = sinf(nextAngle);
+
+    for (float sample = 1.0f; sample < sizeStarFromLum; sample += 0.1f)
+    {
+      const float newX = x + cosAngle * sample;
+      const float newY = y + sinAngle * sample;
+
+      if (newX > 0 && newX < a_width && newY > 0 && newY < a_height)
+      {
+        const float multDist = 1.0f - sample / sizeStarFromLum;
+        const float u        = diafragma * sample / waveLenghtG + 0.000001f;
+        const float sinc     = sinf(u) / u;
+        const float I        = sinc * sinc * multDist;
+        const float color[3] = { a_color[0] * I, a_color[1] * I, a_color[2] * I };
+
+        AddBilinear(color, a_stars, newX, newY, a_width, a_height);
+      }
+    }
+  }
+}
+
+/**
+\brief finds min and max non empty bins of a histogram (ignoring bins with less than 0.001% of pixels) of one channel.
+*/
+static void MinMaxHistBin(const uint32_t* a_hist, const int a_sizeImage, float& a_min, float& a_max)
+{
+  const float floor = (float)a_sizeImage * 0.00001f;
+
+  float minBin = 0.0f;
+  float maxBin = (float)PP_HISTOGRAM_BINS;
+
+  for (int i = 0; i < PP_HISTOGRAM_BINS && (float)a_hist[i] <= floor; i++)
+    minBin = (float)i;
+
+  for (int i = PP_HISTOGRAM_BINS - 1; i >= 0 && (float)a_hist[i] <= floor; i--)
+    maxBin = (float)i;
+
+  a_min = minBin / PP_HISTOGRAM_BINS;
+  a_max = maxBin / PP_HISTOGRAM_BINS;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ExecutePostProcessHydra1(const HDRImage4f& a_inImage, HDRImage4f& a_outImage, const PostProcessHydra1Settings& s)
+{
+  const int width     = a_inImage.width();
+  const int height    = a_inImage.height();
+  const int sizeImage = width * height;
+
+  const float* input  = a_inImage.data();
+  float*       output = a_outImage.data();
+
+  const int maxThreads = std::max(omp_get_max_threads(), 1);
+  const int numThreads = (s.numThreads > 0 && s.numThreads < maxThreads) ? s.numThreads : maxThreads;
+
+  PPFrameConstants c;
+  c.width    = width;
+  c.height   = height;
+  c.centerX  = width  / 2.0f;
+  c.centerY  = height / 2.0f;
+  c.radius   = sqrtf(float(width) * float(width) + float(height) * float(height)) / 2.0f;
+  c.exposure = _mm_set_ps(1.0f, s.exposure, s.exposure, s.exposure);
+  c.vignette = s.vignette;
+
+  const bool autoWhiteBalance = (s.whiteBalance > 0.0f) && !(s.whitePointColor.x > 0.0f || s.whitePointColor.y > 0.0f || s.whitePointColor.z > 0.0f);
+  const bool drawStars        = (s.sizeStar > 0.0f) && (s.numRay > 0);
+  const bool useTiles         = (s.chromAberr > 0.0f) || (s.sharpness > 0.0f);
+
+  // (1) global analysis: max of source for compress, white point for auto white balance, bright pixels for stars
+  //
+  float  maxRgbSource = 0.0f;
+  double summRgb[3]   = { 0.0, 0.0, 0.0 };
+  std::vector<int> brightPixels;
+
+  if (s.compress > 0.0f || autoWhiteBalance || drawStars)
+  {
+    const int bandsNum = (height + PP_TILE_H - 1) / PP_TILE_H;
+    std::vector<float>             bandMax(bandsNum, 0.0f);
+    std::vector<double>            bandSum(bandsNum * 3, 0.0);
+    std::vector< std::vector<int> > bandBright(bandsNum);
+
+    #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    for (int band = 0; band < bandsNum; band++)
+    {
+      __m128 maxV = _mm_setzero_ps();
+      const int yEnd = std::min(height, (band + 1) * PP_TILE_H);
+
+      for (int y = band * PP_TILE_H; y < yEnd; y++)
+      {
+        __m128 rowSum = _mm_setzero_ps();
+
+        for (int x = 0; x < width; x++)
+        {
+          const int    i = y * width + x;
+          const __m128 v = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i * 4), c.exposure), _mm_setzero_ps());
+
+          maxV = _mm_max_ps(maxV, v);
+
+          if (autoWhiteBalance && (_mm_movemask_ps(_mm_cmplt_ps(v, _mm_set1_ps(1.0f))) & 7) == 7)
+            rowSum = _mm_add_ps(rowSum, v);
+
+          if (drawStars)
+          {
+            const __m128 vig = _mm_mul_ps(v, _mm_set1_ps(VignetteFactor(c, x, y)));
+            if (_mm_movemask_ps(_mm_cmpgt_ps(vig, _mm_set1_ps(PP_STAR_THRESHOLD))) & 7)
+              bandBright[band].push_back(i);
+          }
+        }
+
+        float sum[4];
+        _mm_storeu_ps(sum, rowSum);
+        for (int k = 0; k < 3; k++)
+          bandSum[band * 3 + k] += sum[k];
+      }
+
+      float maxArr[4];
+      _mm_storeu_ps(maxArr, maxV);
+      bandMax[band] = std::max(maxArr[0], std::max(maxArr[1], maxArr[2]));
+    }
+
+    for (int band = 0; band < bandsNum; band++)
+    {
+      maxRgbSource = std::max(maxRgbSource, bandMax[band]);
+      for (int k = 0; k < 3; k++)
+        summRgb[k] += bandSum[band * 3 + k];
+      brightPixels.insert(brightPixels.end(), bandBright[band].begin(), bandBright[band].end());
+    }
+  }
+
+  // (2) diffraction stars; sequential because of rand()
+  //
+  std::vector<float> stars;
+  if (drawStars && !brightPixels.empty())
+  {
+    stars.resize(size_t(sizeImage) * 4, 0.0f);
+    for (const int i : brightPixels)
+    {
+      const int x = i % width;
+      const int y = i / width;
+      float color[4];
+      _mm_storeu_ps(color, ExposureVignette(c, input + i * 4, x, y));
+      DrawDiffractionStar(color, x, y, s, width, height, c.radius, stars.data());
+    }
+  }
+
+  // (3) per-frame constants of the fused pass
+  //
+  c.doWhiteBalance = (s.whiteBalance > 0.0f);
+  if (c.doWhiteBalance)
+  {
+    float3 whitePoint = s.whitePointColor;
+    if (autoWhiteBalance)
+      whitePoint = float3(float(summRgb[0] / sizeImage), float(summRgb[1] / sizeImage), float(summRgb[2] / sizeImage));
+
+    whitePoint = MatMul3(CAT02, MatMul3(SRGB_TO_XYZ, whitePoint));
+    const float lum = 0.2126f * whitePoint.x + 0.7152f * whitePoint.y + 0.0722f * whitePoint.z;
+    if (lum > 0.0f)
+      whitePoint = whitePoint / lum;
+
+    const float3 d65 = MatMul3(CAT02, float3(0.9505f, 1.0f, 1.0888f)); // in XYZ
+    const float  D   = s.whiteBalance;
+
+    const float vonKries[9] = { d65.x * D / (whitePoint.x + 0.0000001f) + 1.0f - D, 0.0f, 0.0f,
+                                0.0f, d65.y * D / (whitePoint.y + 0.0000001f) + 1.0f - D, 0.0f,
+                                0.0f, 0.0f, d65.z * D / (whitePoint.z + 0.0000001f) + 1.0f - D };
+    float m1[9], m2[9], m3[9], m4[9];
+    MatMul3(CAT02, SRGB_TO_XYZ, m1);
+    MatMul3(vonKries, m1, m2);
+    MatMul3(CAT02_INV, m2, m3);
+    MatMul3(XYZ_TO_SRGB, m3, m4);
+    c.whiteBalance = Mat3SSE(m4);
+  }
+
+  c.doSaturation = (s.saturation != 1.0f);
+  c.doCompress   = (s.compress > 0.0f && maxRgbSource > 1.01f);
+  c.compressKnee = (s.compress < 1.0f);
+  if (c.doCompress && c.compressKnee)
+  {
+    const float knee     = 10.0f + (1.0f - 10.0f) * powf(s.compress, 0.175f); // lower = softer
+    const float antiKnee = 1.0f / knee;
+    c.kneeLow  = TabulateCurve([=](float x) { return x / powf(1.0f + powf(x, knee), antiKnee); });
+    c.kneeHigh = TabulateCurve([=](float u) { return 1.0f / powf(1.0f + powf(u, knee), antiKnee); });
+  }
+  {
+    float m1[9], m2[9];
+    MatMul3(XYZ_TO_LMS, SRGB_TO_XYZ, m1);
+    MatMul3(XYZ_TO_SRGB, LMS_TO_XYZ, m2);
+    c.rgbToLms = Mat3SSE(m1);
+    c.lmsToIpt = Mat3SSE(LMS_TO_IPT);
+    c.iptToLms = Mat3SSE(IPT_TO_LMS);
+    c.lmsToRgb = Mat3SSE(m2);
+  }
+  c.doContrast = (s.contrast > 1.0f);
+  if (c.doContrast)
+    c.contrastCurve = TabulateCurve(ContrastCurve);
+
+  std::vector<PPGatherTap> tapsRX, tapsRY, tapsGX, tapsGY;
+  if (s.chromAberr > 0.0f)
+  {
+    tapsRX = MakeAberrationTaps(width,  s.chromAberr);
+    tapsRY = MakeAberrationTaps(height, s.chromAberr);
+    tapsGX = MakeAberrationTaps(width,  0.5f * s.chromAberr);
+    tapsGY = MakeAberrationTaps(height, 0.5f * s.chromAberr);
+  }
+
+  // histogram of the fused pass output; uniform contrast uses one histogram for all channels, normalize uses one per channel
+  //
+  const bool histUniform   = (s.uniformContrast > 0.0f);
+  const bool histNormalize = (s.normalize > 0.0f) && !histUniform;
+  const int  histSize      = histUniform ? PP_HISTOGRAM_BINS : PP_HISTOGRAM_BINS * 3;
+  std::vector<uint32_t> threadHist;
+  if (histUniform || histNormalize)
+    threadHist.resize(size_t(numThreads) * histSize, 0);
+
+  // (4) fused pass: exposure, vignette, chromatic aberration, sharpness, stars, white balance, saturation, compress, contrast
+  //
+  const int tilesX   = (width  + PP_TILE_W - 1) / PP_TILE_W;
+  const int tilesY   = (height + PP_TILE_H - 1) / PP_TILE_H;
+  const int bufWidth = PP_TILE_W + 2;
+  const int edgeX    = std::min(1, width  - 1); // the original sharpness filter reads row/column 1 instead of -1
+  const int edgeY    = std::min(1, height - 1);
+
+  #pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<float> tileColor(useTiles ? bufWidth * (PP_TILE_H + 2) * 4 : 0);
+    std::vector<float> tileLum  (useTiles ? bufWidth * (PP_TILE_H + 2)     : 0);
+    uint32_t* hist = threadHist.empty() ? nullptr : threadHist.data() + size_t(omp_get_thread_num()) * histSize;
+
+    #pragma omp for schedule(dynamic)
+    for (int tile = 0; tile < tilesX * tilesY; tile++)
+    {
+      const int x0 = (tile % tilesX) * PP_TILE_W;
+      const int y0 = (tile / tilesX) * PP_TILE_H;
+      const int x1 = std::min(width,  x0 + PP_TILE_W);
+      const int y1 = std::min(height, y0 + PP_TILE_H);
+
+      // tile with one pixel border: exposed color for chromatic aberration, source luminance for sharpness
+      //
+      if (useTiles)
+      {
+        for (int ty = y0 - 1; ty <= y1; ty++)
+        {
+          const int yColor = std::max(0, std::min(height - 1, ty));
+          const int yLum   = (ty < 0) ? edgeY : std::min(height - 1, ty);
+          float* colorRow  = tileColor.data() + (ty - y0 + 1) * bufWidth * 4;
+          float* lumRow    = tileLum.data()   + (ty - y0 + 1) * bufWidth;
+
+          for (int tx = x0 - 1; tx <= x1; tx++)
+          {
+            const int xColor = std::max(0, std::min(width - 1, tx));
+            const int xLum   = (tx < 0) ? edgeX : std::min(width - 1, tx);
+            _mm_storeu_ps(colorRow + (tx - x0 + 1) * 4, ExposureVignette(c, input + (yColor * width + xColor) * 4, xColor, yColor));
+            lumRow[tx - x0 + 1] = LumForSharp(input + (yLum * width + xLum) * 4);
+          }
+        }
+      }
+
+      for (int y = y0; y < y1; y++)
+      {
+        for (int xg = x0; xg < x1; xg += 4)
+        {
+          // per pixel part of the pipeline; the last pixel is repeated when the row ends inside a group
+          //
+          const int n = std::min(4, x1 - xg);
+
+          float vignette[4];
+          _mm_storeu_ps(vignette, VignetteFactor4(c, xg, y));
+
+          __m128 v[4];
+          for (int k = 0; k < 4; k++)
+          {
+            const int x = xg + std::min(k, n - 1);
+            const int i = y * width + x;
+
+            if (useTiles)
+              v[k] = _mm_loadu_ps(tileColor.data() + ((y - y0 + 1) * bufWidth + (x - x0 + 1)) * 4);
+            else
+              v[k] = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i * 4), c.exposure), _mm_setzero_ps()), _mm_set1_ps(vignette[k]));
+
+            // ----- Chromatic aberration -----
+            if (s.chromAberr > 0.0f)
+            {
+              auto gather = [&](const PPGatherTap& tx, const PPGatherTap& ty)
+              {
+                const float* row0 = tileColor.data() + (ty.s0 - y0 + 1) * bufWidth * 4;
+                const float* row1 = tileColor.data() + (ty.s1 - y0 + 1) * bufWidth * 4;
+                const int    c0   = (tx.s0 - x0 + 1) * 4;
+                const int    c1   = (tx.s1 - x0 + 1) * 4;
+                const __m128 r0   = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row0 + c0), _mm_set1_ps(tx.w0)), _mm_mul_ps(_mm_loadu_ps(row0 + c1), _mm_set1_ps(tx.w1)));
+                const __m128 r1   = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(row1 + c0), _mm_set1_ps(tx.w0)), _mm_mul_ps(_mm_loadu_ps(row1 + c1), _mm_set1_ps(tx.w1)));
+                return _mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(ty.w0)), _mm_mul_ps(r1, _mm_set1_ps(ty.w1)));
+              };
+
+              v[k] = _mm_blend_ps(v[k], gather(tapsRX[x], tapsRY[y]), 1);
+              v[k] = _mm_blend_ps(v[k], gather(tapsGX[x], tapsGY[y]), 2);
+            }
+
+            // ----- Sharpness -----
+            if (s.sharpness > 0.0f)
+            {
+              const float* lumRows[3] = { tileLum.data() + (y - y0) * bufWidth, tileLum.data() + (y - y0 + 1) * bufWidth, tileLum.data() + (y - y0 + 2) * bufWidth };
+              const int    lx         = x - x0;
+
+              float mean = 0.0f;
+              for (int r = 0; r < 3; r++)
+                mean += lumRows[r][lx] + lumRows[r][lx + 1] + lumRows[r][lx + 2];
+              mean /= 9.0f;
+
+              float dispers = 0.0f;
+              for (int r = 0; r < 3; r++)
+                dispers += fabsf(lumRows[r][lx] - mean) + fabsf(lumRows[r][lx + 1] - mean) + fabsf(lumRows[r][lx + 2] - mean);
+              dispers /= (1.0f + dispers);
+
+              float hiPass = (lumRows[1][lx + 1] - mean) * 5.0f + 1.0f;
+              hiPass *= hiPass;
+
+              const float sharp = 1.0f + (hiPass - 1.0f) * (s.sharpness * (1.0f - dispers));
+              v[k] = _mm_mul_ps(v[k], _mm_set1_ps(sharp));
+            }
+
+            // ----- Diffraction stars -----
+            if (!stars.empty())
+              v[k] = _mm_add_ps(v[k], _mm_loadu_ps(stars.data() + size_t(i) * 4));
+          }
+
+          // the rest of the pipeline runs on 4 pixels at once
+          //
+          _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+          PointwiseTail(c, s, v[0], v[1], v[2]);
+          _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+
+          for (int k = 0; k < n; k++)
+          {
+            const int i = y * width + xg + k;
+            _mm_storeu_ps(output + i * 4, _mm_blend_ps(v[k], _mm_loadu_ps(input + i * 4), 8)); // keep source alpha
+
+            if (hist != nullptr)
+            {
+              float rgb[4];
+              _mm_storeu_ps(rgb, v[k]);
+              for (int ch = 0; ch < 3; ch++)
+              {
+                if (rgb[ch] > 1.0f)
+                  continue;
+                const int bin = histUniform ? (int)roundf(rgb[ch] * float(PP_HISTOGRAM_BINS - 1)) : (int)((rgb[ch] * float(PP_HISTOGRAM_BINS - 1)) + 0.5f);
+                if (bin >= 0 && bin < PP_HISTOGRAM_BINS)
+                  hist[histUniform ? bin : ch * PP_HISTOGRAM_BINS + bin]++;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // sum per thread histograms
+  //
+  std::vector<uint32_t> histogram(histSize, 0);
+  for (int t = 0; t < numThreads && !threadHist.empty(); t++)
+    for (int k = 0; k < histSize; k++)
+      histogram[k] += threadHist[size_t(t) * histSize + k];
+
+  const int bandsNum = (height + PP_TILE_H - 1) / PP_TILE_H;
+
+  // (5) uniform contrast: equalize by cumulative histogram of all channels; also collects the histogram for normalize
+  //
+  if (histUniform)
+  {
+    std::vector<float> cumulative(PP_HISTOGRAM_BINS);
+    const float iterrHistogramBin = 1.0f / (float)(sizeImage * 3);
+    float       sum               = 0.0f;
+    for (int k = 0; k < PP_HISTOGRAM_BINS; k++)
+    {
+      sum += float(histogram[k]) * iterrHistogramBin;
+      cumulative[k] = sum;
+    }
+
+    float histMin = 9999999.9f;
+    float histMax = 0.0f;
+    for (int k = 0; k < PP_HISTOGRAM_BINS; k++)
+    {
+      if (cumulative[k] < histMin && cumulative[k] != 0.0f) histMin = cumulative[k];
+      if (cumulative[k] > histMax)                          histMax = cumulative[k];
+    }
+
+    std::vector<float> lut(PP_HISTOGRAM_BINS);
+    for (int k = 0; k < PP_HISTOGRAM_BINS; k++)
+      lut[k] = powf(std::max((cumulative[k] - histMin) / (histMax - histMin), 0.0f), 2.2f);
+
+    const bool collectNormalize = (s.normalize > 0.0f);
+    std::fill(threadHist.begin(), threadHist.end(), 0);
+    if (collectNormalize)
+      threadHist.resize(size_t(numThreads) * PP_HISTOGRAM_BINS * 3, 0);
+
+    const float uc = s.uniformContrast;
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+      uint32_t* histNorm = collectNormalize ? threadHist.data() + size_t(omp_get_thread_num()) * PP_HISTOGRAM_BINS * 3 : nullptr;
+
+      #pragma omp for schedule(dynamic)
+      for (int band = 0; band < bandsNum; band++)
+      {
+        const int iEnd = std::min(height, (band + 1) * PP_TILE_H) * width;
+        for (int i = band * PP_TILE_H * width; i < iEnd; i++)
+        {
+          float* pixel = output + i * 4;
+
+          float equalized[3];
+          for (int k = 0; k < 3; k++)
+          {
+            equalized[k] = pixel[k];
+            if (pixel[k] <= 1.0f)
+            {
+              const int bin = (int)roundf(pixel[k] * float(PP_HISTOGRAM_BINS - 1));
+              equalized[k]  = (bin >= 0 && bin < PP_HISTOGRAM_BINS) ? lut[bin] : 0.0f;
+            }
+          }
+
+          const float meanRGBsource = (pixel[0] + pixel[1] + pixel[2]) / 3.0f;
+          const float meanRGB_UC    = (equalized[0] + equalized[1] + equalized[2]) / 3.0f;
+          const float diff          = meanRGB_UC / (meanRGBsource + 0.0001f);
+
+          for (int k = 0; k < 3; k++)
+          {
+            const float rgbDiff = pixel[k] + (pixel[k] * diff - pixel[k]) * uc;
+            const float rgbUC   = pixel[k] + (equalized[k] - pixel[k]) * uc;
+            pixel[k] = rgbUC + (rgbDiff - rgbUC) * 0.5f;
+
+            if (histNorm != nullptr && pixel[k] <= 1.0f)
+            {
+              const int bin = (int)((pixel[k] * float(PP_HISTOGRAM_BINS - 1)) + 0.5f);
+              if (bin >= 0 && bin < PP_HISTOGRAM_BINS)
+                histNorm[k * PP_HISTOGRAM_BINS + bin]++;
+            }
+          }
+        }
+      }
+    }
+
+    if (collectNormalize)
+    {
+      histogram.assign(PP_HISTOGRAM_BINS * 3, 0);
+      for (int t = 0; t < numThreads; t++)
+        for (int k = 0; k < PP_HISTOGRAM_BINS * 3; k++)
+          histogram[k] += threadHist[size_t(t) * PP_HISTOGRAM_BINS * 3 + k];
+    }
+  }
+
+  // (6) normalize: stretch [min, max] of the histograms to [0, 1]
+  //
+  if (s.normalize > 0.0f)
+  {
+    float minBin = 1.0f, maxBin = 0.0f;
+    for (int k = 0; k < 3; k++)
+    {
+      float mn, mx;
+      MinMaxHistBin(histogram.data() + k * PP_HISTOGRAM_BINS, sizeImage, mn, mx);
+      minBin = std::min(minBin, mn);
+      maxBin = std::max(maxBin, mx);
+    }
+
+    if (maxBin > minBin)
+    {
+      const __m128 vMin   = _mm_set1_ps(minBin);
+      const __m128 vScale = _mm_set1_ps(1.0f / (maxBin - minBin));
+      const __m128 vMix   = _mm_set1_ps(s.normalize);
+
+      #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+      for (int band = 0; band < bandsNum; band++)
+      {
+        const int iEnd = std::min(height, (band + 1) * PP_TILE_H) * width;
+        for (int i = band * PP_TILE_H * width; i < iEnd; i++)
+        {
+          const __m128 v    = _mm_loadu_ps(output + i * 4);
+          const __m128 norm = _mm_mul_ps(_mm_sub_ps(v, vMin), vScale);
+          const __m128 res  = _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(norm, v), vMix));
+          _mm_storeu_ps(output + i * 4, _mm_blend_ps(res, v, 8));
+        }
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class PostProcessHydra1 : public IFilter2DSpecial
+{
+public:
+  PostProcessHydra1()  = default;
+  ~PostProcessHydra1() = default;
+
+  bool Eval(ArgArray1& argsHDR, ArgArray2& argsLDR, pugi::xml_node settings, std::shared_ptr<IHRRenderDriver> a_pDriver) override;
+};
+
+template<typename T>
+static void LimitSetting(T& a_value, const T a_min, const T a_max, const wchar_t* a_msg)
+{
+  if (a_value < a_min || a_value > a_max)
+  {
+    HrPrint(HR_SEVERITY_WARNING, L"post_process_hydra1; ", a_msg);
+    a_value = std::max(a_min, std::min(a_max, a_value));
+  }
+}
+
+bool PostProcessHydra1::Eval(ArgArray1& argsHDR, ArgArray2& /*argsLDR*/, pugi::xml_node settings, std::shared_ptr<IHRRenderDriver> /*a_pDriver*/)
+{
+  auto inImagePtr  = argsHDR[L"in_color"];
+  auto outImagePtr = argsHDR[L"out_color"];
+
+  if (inImagePtr == nullptr)
+  {
+    m_err = L"post_process_hydra1; argument not found: 'in_color'";
+    return false;
+  }
+
+  if (outImagePtr == nullptr)
+  {
+    m_err = L"post_process_hydra1; argument not found: 'out_color'";
+    return false;
+  }
+
+  if (inImagePtr->width() != outImagePtr->width() || inImagePtr->height() != outImagePtr->height() || inImagePtr->width() <= 0 || inImagePtr->height() <= 0)
+  {
+    m_err = L"post_process_hydra1; bad input size";
+    return false;
+  }
+
+  // read settings; absent attributes take the defaults of the 3ds max plugin instead of zero
+  //
+  PostProcessHydra1Settings s;
+  s.numThreads      = settings.attribute(L"numThreads").as_int(0);
+  s.exposure        = settings.attribute(L"exposure").as_float(1.0f);
+  s.compress        = settings.attribute(L"compress").as_float(0.0f);
+  s.contrast        = settings.attribute(L"contrast").as_float(1.0f);
+  s.saturation      = settings.attribute(L"saturation").as_float(1.0f);
+  s.whiteBalance    = settings.attribute(L"whiteBalance").as_float(0.0f);
+  s.whitePointColor = HydraXMLHelpers::ReadFloat3(settings.attribute(L"whitePointColor"));
+  s.uniformContrast = settings.attribute(L"uniformContrast").as_float(0.0f);
+  s.normalize       = settings.attribute(L"normalize").as_float(0.0f);
+  s.vignette        = settings.attribute(L"vignette").as_float(0.0f);
+  s.chromAberr      = settings.attribute(L"chromAberr").as_float(0.0f);
+  s.sharpness       = settings.attribute(L"sharpness").as_float(0.0f);
+
+  s.sizeStar        = settings.attribute(L"diffStars_sizeStar").as_float(0.0f);   // 0-100
+  s.numRay          = settings.attribute(L"diffStars_numRay").as_int(0);          // 0-16
+  s.rotateRay       = settings.attribute(L"diffStars_rotateRay").as_int(0);       // 0-360
+  s.randomAngle     = settings.attribute(L"diffStars_randomAngle").as_float(0.0f); // 0-1
+  s.sprayRay        = settings.attribute(L"diffStars_sprayRay").as_float(0.0f);    // 0-1
+
+  if (s.exposure < 0.0f || s.compress < 0.0f || s.contrast < 0.0f || s.saturation < 0.0f || s.whiteBalance < 0.0f ||
+      s.whitePointColor.x < 0.0f || s.whitePointColor.y < 0.0f || s.whitePointColor.z < 0.0f || s.uniformContrast < 0.0f ||
+      s.normalize < 0.0f || s.vignette < 0.0f || s.chromAberr < 0.0f || s.sharpness < 0.0f || s.sizeStar < 0.0f ||
+      s.numRay < 0 || s.rotateRay < 0 || s.randomAngle < 0.0f || s.sprayRay < 0.0f)
+  {
+    m_err = L"post_process_hydra1; Arguments must be greater than zero.";
+    return false;
+  }
+
+  LimitSetting(s.exposure,        0.0f, 10.0f,  L"exposure should be in the range 0 - 10. Default 1. This will be limited to 10.");
+  LimitSetting(s.compress,        0.0f, 1.0f,   L"compress should be in the range 0 - 1. Default 0. This will be limited to 1.");
+  LimitSetting(s.contrast,        1.0f, 2.0f,   L"contrast should be in the range 1 - 2. Default 1. This will be limited to 1 - 2.");
+  LimitSetting(s.saturation,      0.0f, 2.0f,   L"saturation should be in the range 0 - 2. Default 1. This will be limited to 2.");
+  LimitSetting(s.whiteBalance,    0.0f, 1.0f,   L"whiteBalance should be in the range 0 - 1. Default 0. This will be limited to 1.");
+  LimitSetting(s.uniformContrast, 0.0f, 1.0f,   L"uniformContrast should be in the range 0 - 1. Default 0. This will be limited to 1.");
+  LimitSetting(s.normalize,       0.0f, 1.0f,   L"normalize should be in the range 0 - 1. Default 0. This will be limited to 1.");
+  LimitSetting(s.vignette,        0.0f, 1.0f,   L"vignette should be in the range 0 - 1. Default 0. This will be limited to 1.");
+  LimitSetting(s.chromAberr,      0.0f, 1.0f,   L"chromAberr should be in the range 0 - 1. This will be limited to 1.");
+  LimitSetting(s.sharpness,       0.0f, 1.0f,   L"sharpness should be in the range 0 - 1. This will be limited to 1.");
+  LimitSetting(s.sizeStar,        0.0f, 100.0f, L"sizeStar should be in the range 0 - 100. This will be limited to 100.");
+  LimitSetting(s.numRay,          0,    16,     L"numRay should be in the range 0 - 16. This will be limited to 16.");
+  LimitSetting(s.rotateRay,       0,    360,    L"rotateRay should be in the range 0 - 360. This will be limited to 360.");
+  LimitSetting(s.randomAngle,     0.0f, 1.0f,   L"randomAngle should be in the range 0 - 1. This will be limited to 1.");
+  LimitSetting(s.sprayRay,        0.0f, 1.0f,   L"sprayRay should be in the range 0 - 1. This will be limited to 1.");
+
+  // the fused pass reads a pixel border around each tile, so it can not run in place
+  //
+  if (inImagePtr == outImagePtr)
+  {
+    const HDRImage4f inCopy = *inImagePtr;
+    ExecutePostProcessHydra1(inCopy, *outImagePtr, s);
+  }
+  else
+    ExecutePostProcessHydra1(*inImagePtr, *outImagePtr, s);
+
+  return true;
+}
+
+std::shared_ptr<IFilter2DSpecial> CreatePostProcessHydra1Filter()
+{
+  return std::make_shared<PostProcessHydra1>();
+}
@@ -188,6 +188,11 @@ using HydraRender::HDRImage4f;
 void NonLocalMeansGuidedTexNormDepthFilter(const HDRImage4f& inImage, const HDRImage4f& inTexColor, const HDRImage4f& inNormDepth,
                                            HDRImage4f& outImage, int a_windowRadius, int a_blockRadius, float a_noiseLevel);
 
+void NonLocalMeansGuidedTexNormDepthFilterFast(const HDRImage4f& inImage, const HDRImage4f& inTexColor, const HDRImage4f& inNormDepth,
+                                               HDRImage4f& outImage, int a_windowRadius, int a_blockRadius, float a_noiseLevel);
+
+std::shared_ptr<IFilter2DSpecial> CreatePostProcessHydra1Filter();
+
 #include <iostream>
 
 bool NLMDenoiserPut::Eval(ArgArray1& argsHDR, ArgArray2& argsLDR, pugi::xml_node setiings, std::shared_ptr<IHRRenderDriver> a_pDriver)
@@ -213,9 +218,6 @@ bool NLMDenoiserPut::Eval(ArgArray1& argsHDR, ArgArray2& argsLDR, pugi::xml_node
   float* normdIn  = normdImage.data();
   float* texcolIn = texColor.data();
   
-  std::vector<float> colorLine(w*4);
-  std::vector<HRGBufferPixel> gbuffLine(w);
-  
   const float gammaInv = 1.0f/2.2f;
   const float gamma    = 2.2f;
 
@@ -223,6 +225,9 @@ bool NLMDenoiserPut::Eval(ArgArray1& argsHDR, ArgArray2& argsLDR, pugi::xml_node
   for(int j=0;j<h;j++)
   {
     const int offset = j*w*4;
+
+    std::vector<float> colorLine(w*4);          // per line, lines are read from different threads
+    std::vector<HRGBufferPixel> gbuffLine(w);
     
     a_pDriver->GetFrameBufferLineHDR(0, w, j, colorLine.data(), L"color");
     a_pDriver->GetGBufferLine(j, gbuffLine.data(), 0, w, std::unordered_set<int32_t>());
@@ -250,8 +255,12 @@ bool NLMDenoiserPut::Eval(ArgArray1& argsHDR, ArgArray2& argsLDR, pugi::xml_node
   {
     HDRImage4f colorImage2(w,h);
     std::cout << "begin NLM" << std::endl;
-    NonLocalMeansGuidedTexNormDepthFilter(colorImage, texColor, normdImage,
-                                          colorImage2, 5, 1, 0.10f);
+    if (std::wstring(setiings.attribute(L"mode").as_string()) == L"reference")
+      NonLocalMeansGuidedTexNormDepthFilter(colorImage, texColor, normdImage,
+                                            colorImage2, 5, 1, 0.10f);
+    else
+      NonLocalMeansGuidedTexNormDepthFilterFast(colorImage, texColor, normdImage,
+                                                colorImage2, 5, 1, 0.10f);
     
     colorIn = colorImage2.data();
     std::cout << "end   NLM" << std::endl;
@@ -307,6 +316,8 @@ std::shared_ptr<IFilter2DSpecial> CreateSpecialFilter(const wchar_t* a_filterNam
     return std::make_shared<GaussBlur2D>();
   else if (inName == L"NLMPut")
     return std::make_shared<NLMDenoiserPut>();
+  else if (inName == L"post_process_hydra1")
+    return CreatePostProcessHydra1Filter();
   else
     return nullptr;
 }
\ No newline at end of file
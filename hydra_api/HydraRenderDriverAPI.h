@@ -303,6 +303,13 @@ struct IHRRenderDriver
 
   virtual void    GetGBufferLine(int32_t a_lineNumber, HRGBufferPixel* a_lineData, int32_t a_startX, int32_t a_endX, const std::unordered_set<int32_t>& a_shadowCatchers) = 0; ///< get single gbuffer line (because the whole gbuffer is quite big!)
 
+  /**
+  \brief unpack the whole gbuffer (a_width*a_height) to not null planes of a_planes.
+         Default implementation calls GetGBufferLine line by line from the calling thread and scatters the requested fields;
+         override it to skip unpacking of layers that were not requested or to read lines in parallel if the driver allows it.
+  */
+  virtual void    GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers);
+
   // info and devices
   //
   virtual HRDriverInfo           Info() = 0;                                            ///< return render driver info
@@ -344,6 +351,56 @@ protected:
   HR_INFO_CALLBACK m_pInfoCallBack;
 };
 
+/**
+\brief write requested fields of a_pixel to element a_index of not null planes; helper for GetGBuffer implementations.
+*/
+static inline void StoreGBufferPixel(const HRGBufferPlanes& a_planes, size_t a_index, const HRGBufferPixel& a_pixel)
+{
+  if (a_planes.depth    != nullptr) a_planes.depth[a_index]    = a_pixel.depth;
+  if (a_planes.shadow   != nullptr) a_planes.shadow[a_index]   = a_pixel.shadow;
+  if (a_planes.coverage != nullptr) a_planes.coverage[a_index] = a_pixel.coverage;
+  if (a_planes.matId    != nullptr) a_planes.matId[a_index]    = a_pixel.matId;
+  if (a_planes.objId    != nullptr) a_planes.objId[a_index]    = a_pixel.objId;
+  if (a_planes.instId   != nullptr) a_planes.instId[a_index]   = a_pixel.instId;
+
+  for (int k = 0; k < 3; k++)
+    if (a_planes.norm[k] != nullptr) a_planes.norm[k][a_index] = a_pixel.norm[k];
+  for (int k = 0; k < 2; k++)
+    if (a_planes.texc[k] != nullptr) a_planes.texc[k][a_index] = a_pixel.texc[k];
+  for (int k = 0; k < 4; k++)
+    if (a_planes.rgba[k] != nullptr) a_planes.rgba[k][a_index] = a_pixel.rgba[k];
+}
+
+/**
+\brief write requested fields of a_line[0 ... a_size-1] to not null planes starting from a_offset.
+       Planes are written one after another, because writing many planes per pixel thrashes cache when planes have the same alignment.
+*/
+static inline void StoreGBufferLine(const HRGBufferPlanes& a_planes, size_t a_offset, const HRGBufferPixel* a_line, int a_size)
+{
+  if (a_planes.depth != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.depth[a_offset + x] = a_line[x].depth;
+  if (a_planes.shadow != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.shadow[a_offset + x] = a_line[x].shadow;
+  if (a_planes.coverage != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.coverage[a_offset + x] = a_line[x].coverage;
+  if (a_planes.matId != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.matId[a_offset + x] = a_line[x].matId;
+  if (a_planes.objId != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.objId[a_offset + x] = a_line[x].objId;
+  if (a_planes.instId != nullptr)
+    for (int x = 0; x < a_size; x++) a_planes.instId[a_offset + x] = a_line[x].instId;
+
+  for (int k = 0; k < 3; k++)
+    if (a_planes.norm[k] != nullptr)
+      for (int x = 0; x < a_size; x++) a_planes.norm[k][a_offset + x] = a_line[x].norm[k];
+  for (int k = 0; k < 2; k++)
+    if (a_planes.texc[k] != nullptr)
+      for (int x = 0; x < a_size; x++) a_planes.texc[k][a_offset + x] = a_line[x].texc[k];
+  for (int k = 0; k < 4; k++)
+    if (a_planes.rgba[k] != nullptr)
+      for (int x = 0; x < a_size; x++) a_planes.rgba[k][a_offset + x] = a_line[x].rgba[k];
+}
+
 IHRRenderDriver* CreateOpenGL1_RenderDriver();
 IHRRenderDriver* CreateOpenGL1Debug_RenderDriver();
 IHRRenderDriver* CreateOpenGL1_DelayedLoad_RenderDriver(bool a_canLoadMeshes);
@@ -353,6 +410,8 @@ IHRRenderDriver* CreateOpenGL32Deferred_RenderDriver();
 
 IHRRenderDriver* CreateOpenGL3_Utilty_RenderDriver();
 
+IHRRenderDriver* CreateCPURayCast_RenderDriver(); ///< multithreaded CPU ray casting preview; does not need OpenGL context
+
 static constexpr uint32_t MAX_TEXTURE_RESOLUTION = 16384;
 
 /**
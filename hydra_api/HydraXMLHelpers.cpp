@@ -41,10 +41,7 @@ namespace HydraXMLHelpers
         const wchar_t* listStr = node.attribute(L"val").as_string();
         if(listStr != nullptr)
         {
-          std::wstringstream inputStream(listStr);
-          for(auto& elem : list)
-            inputStream >> elem;
-
+          ReadInts(listStr, list.data(), list_size);
           remap_lists.emplace_back(list);
         }
       }
@@ -2,6 +2,11 @@
 
 #include <sstream>
 #include <iomanip>
+#include <cmath>
+#include <cwchar>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
 #include "pugixml.hpp"
 #include "LiteMath.h"
 #include "HydraAPI.h"
@@ -10,83 +15,450 @@
 namespace HydraXMLHelpers
 {
 
-  static inline float ReadFloat(pugi::xml_node a_node)
+  static inline double Pow10d(int a_exp)
   {
-    const wchar_t* camPosStr = a_node.text().as_string();
-    std::wstringstream inputStream(camPosStr);
-    float val = 0.0f;
-    inputStream >> val;
-    return val;
+    static const double pow10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    double res = 1.0;
+    while (a_exp > 22)  { res *= 1e22; a_exp -= 22; }
+    while (a_exp < -22) { res /= 1e22; a_exp += 22; }
+    return (a_exp >= 0) ? res*pow10[a_exp] : res/pow10[-a_exp];
   }
 
-  static inline HydraLiteMath::float3 ReadFloat3(pugi::xml_node a_node)
+  /**
+  \brief correctly rounded a_mantissa*10^a_exp10 by strtof.
+  */
+  static inline float MakeFloatSlow(uint64_t a_mantissa, int a_exp10)
+  {
+    char str[48];
+    snprintf(str, sizeof(str), "%llue%d", (unsigned long long)a_mantissa, a_exp10);
+    return strtof(str, nullptr); // there is no decimal point in 'str', so it does not depend on locale
+  }
+
+  /**
+  \brief make float from decimal mantissa and exponent: a_mantissa*10^a_exp10, correctly rounded as strtof does. 
+   Shared by parser and formatter, so every string produced by FormatFloat is read back to exactly the same float.
+  */
+  static inline float MakeFloat(uint64_t a_mantissa, int a_exp10)
   {
-    HydraLiteMath::float3 res(0,0,0);
-    const wchar_t* camPosStr = a_node.text().as_string();
-    if (camPosStr != nullptr)
+    if (a_mantissa == 0)
+      return 0.0f;
+    if (a_exp10 > 60)
+      return HUGE_VALF;
+    if (a_exp10 < -90)
+      return 0.0f;
+
+    double val = double(a_mantissa);
+    int  exp10 = a_exp10;
+    if (exp10 > 22)       // keep the error of the double path far below float precision
+    {
+      val  *= Pow10d(exp10 - 22);
+      exp10 = 22;
+    }
+    else if (exp10 < -22)
     {
-      std::wstringstream inputStream(camPosStr);
-      inputStream >> res.x >> res.y >> res.z;
+      val  /= Pow10d(-22 - exp10);
+      exp10 = -22;
     }
+    val = (exp10 >= 0) ? val*Pow10d(exp10) : val/Pow10d(-exp10);
+
+    // 'double -> float' rounds the second time; it gives wrong float only if 'val' is so close to the middle between two floats 
+    // that the error of the double path (a few double ulps) may put it on the other side. Such values, denormals and overflow go to strtof.
+    //
+    const float res = float(val);
+    if (!(res >= FLT_MIN && res <= FLT_MAX))
+      return MakeFloatSlow(a_mantissa, a_exp10);
+
+    const double eps    = val*1e-14;
+    const double midLow = 0.5*(double(res) + double(std::nextafter(res, 0.0f)));
+    const double midUp  = 0.5*(double(res) + double(std::nextafter(res, HUGE_VALF)));
+    if (std::fabs(val - midLow) <= eps || std::fabs(val - midUp) <= eps)
+      return MakeFloatSlow(a_mantissa, a_exp10);
+
     return res;
   }
 
-  static inline HydraLiteMath::float3 ReadFloat3(pugi::xml_attribute a_attr)
+  /**
+  \brief correctly rounded float from a number that has more significant digits than uint64_t mantissa holds: 
+   the middle between two floats may need more than 100 digits, so all of them are passed to strtof.
+  \param a_str     - digits with optional decimal point; sign and exponent are already read by caller
+  \param a_expPart - value of exponent after 'e'
+  */
+  static inline float MakeLongFloat(const wchar_t* a_str, int a_expPart)
   {
-    HydraLiteMath::float3 res(0, 0, 0);
-    const wchar_t* camPosStr = a_attr.as_string();
-    if (camPosStr != nullptr)
+    const int LONG_FLOAT_DIGITS = 150; // exact middle between two floats never has more significant digits
+    char str[LONG_FLOAT_DIGITS + 32];
+    int  len     = 0;
+    int  exp10   = a_expPart;
+    bool point   = false;
+    bool dropped = false;
+
+    for (; (*a_str >= L'0' && *a_str <= L'9') || (*a_str == L'.' && !point); a_str++)
     {
-      std::wstringstream inputStream(camPosStr);
-      inputStream >> res.x >> res.y >> res.z;
+      if (*a_str == L'.')
+        point = true;
+      else if (len == 0 && *a_str == L'0')     // leading zeros
+        exp10 -= point ? 1 : 0;
+      else if (len < LONG_FLOAT_DIGITS)
+      {
+        str[len++] = char(*a_str);
+        exp10     -= point ? 1 : 0;
+      }
+      else
+      {
+        dropped = dropped || (*a_str != L'0');
+        exp10  += point ? 0 : 1;
+      }
     }
-    return res;
+
+    if (dropped) // any non zero digit keeps the value above truncated one and below the next one
+    {
+      str[len++] = '1';
+      exp10--;
+    }
+
+    snprintf(str + len, sizeof(str) - size_t(len), "e%d", exp10);
+    return strtof(str, nullptr); // there is no decimal point in 'str', so it does not depend on locale
   }
 
-  static inline void ReadFloat3(pugi::xml_node a_node, float a_outData[3])
+  static inline bool IsSpace(wchar_t a_c) { return a_c == L' ' || a_c == L'\t' || a_c == L'\n' || a_c == L'\r'; }
+
+  /**
+  \brief read up to a_num floats separated by white spaces; does not depend on locale and does not allocate memory. 
+   Returns the number of values that were read.
+  */
+  static inline int ReadFloats(const wchar_t* a_str, float* a_outData, int a_num)
   {
-    const wchar_t* camPosStr = a_node.text().as_string();
-    if (camPosStr != nullptr)
+    if (a_str == nullptr)
+      return 0;
+
+    int count = 0;
+    while (count < a_num)
     {
-      std::wstringstream inputStream(camPosStr);
-      inputStream >> a_outData[0] >> a_outData[1] >> a_outData[2];
+      while (IsSpace(*a_str))
+        a_str++;
+
+      const bool negative = (*a_str == L'-');
+      if (*a_str == L'-' || *a_str == L'+')
+        a_str++;
+
+      if (*a_str == L'n' || *a_str == L'i')    // "nan", "inf", "infinity" as written by FormatFloat and printf
+      {
+        if (a_str[0] == L'n' && a_str[1] == L'a' && a_str[2] == L'n')
+        {
+          a_outData[count++] = negative ? -NAN : NAN;
+          a_str += 3;
+          continue;
+        }
+        else if (a_str[0] == L'i' && a_str[1] == L'n' && a_str[2] == L'f')
+        {
+          a_outData[count++] = negative ? -HUGE_VALF : HUGE_VALF;
+          a_str += (wcsncmp(a_str, L"infinity", 8) == 0) ? 8 : 3;
+          continue;
+        }
+        break;
+      }
+
+      const wchar_t* numBegin = a_str;
+
+      uint64_t mantissa  = 0;
+      int      digits    = 0;
+      int      exp10     = 0;
+      bool     haveNum   = false;
+      bool     truncated = false; // non zero digits after the first 19 ones were dropped
+
+      for (; *a_str >= L'0' && *a_str <= L'9'; a_str++)
+      {
+        haveNum = true;
+        if (digits < 19)
+        {
+          mantissa = mantissa*10 + uint64_t(*a_str - L'0');
+          digits  += (mantissa != 0) ? 1 : 0;
+        }
+        else
+        {
+          truncated = truncated || (*a_str != L'0');
+          exp10++;
+        }
+      }
+
+      if (*a_str == L'.')
+      {
+        for (a_str++; *a_str >= L'0' && *a_str <= L'9'; a_str++)
+        {
+          haveNum = true;
+          if (digits < 19)
+          {
+            mantissa = mantissa*10 + uint64_t(*a_str - L'0');
+            digits  += (mantissa != 0) ? 1 : 0;
+            exp10--;
+          }
+          else
+            truncated = truncated || (*a_str != L'0');
+        }
+      }
+
+      if (!haveNum)
+        break;
+
+      int expPart = 0;
+      if (*a_str == L'e' || *a_str == L'E')
+      {
+        const wchar_t* expBegin = a_str;
+        a_str++;
+        const bool negExp = (*a_str == L'-');
+        if (*a_str == L'-' || *a_str == L'+')
+          a_str++;
+
+        if (*a_str >= L'0' && *a_str <= L'9')
+        {
+          int expVal = 0;
+          for (; *a_str >= L'0' && *a_str <= L'9'; a_str++)
+            expVal = (expVal < 10000) ? expVal*10 + int(*a_str - L'0') : expVal;
+          expPart = negExp ? -expVal : expVal;
+        }
+        else
+          a_str = expBegin; // not an exponent, leave 'e' for the next read
+      }
+
+      const float val    = truncated ? MakeLongFloat(numBegin, expPart) : MakeFloat(mantissa, exp10 + expPart);
+      a_outData[count++] = negative ? -val : val;
     }
-    else
+
+    return count;
+  }
+
+  /**
+  \brief read up to a_num integers separated by white spaces; does not allocate memory. Returns the number of values that were read.
+  */
+  static inline int ReadInts(const wchar_t* a_str, int32_t* a_outData, int a_num)
+  {
+    if (a_str == nullptr)
+      return 0;
+
+    int count = 0;
+    while (count < a_num)
     {
-      a_outData[0] = 0.0f;
-      a_outData[1] = 0.0f;
-      a_outData[2] = 0.0f;
+      while (IsSpace(*a_str))
+        a_str++;
+
+      const bool negative = (*a_str == L'-');
+      if (*a_str == L'-' || *a_str == L'+')
+        a_str++;
+
+      if (*a_str < L'0' || *a_str > L'9')
+        break;
+
+      int64_t val = 0;
+      for (; *a_str >= L'0' && *a_str <= L'9'; a_str++)
+        val = val*10 + int64_t(*a_str - L'0');
+
+      a_outData[count++] = int32_t(negative ? -val : val);
     }
+
+    return count;
   }
 
-  static inline void ReadFloat3(pugi::xml_attribute a_attr, float a_outData[3])
+  static const int FLOAT_STR_MAX = 16; ///< max length of FormatFloat output including terminating zero
+  static const int INT_STR_MAX   = 22; ///< max length of FormatInt output including terminating zero
+
+  static inline int FormatUInt(uint64_t a_val, wchar_t* a_out)
   {
-    const wchar_t* camPosStr = a_attr.as_string();
-    if (camPosStr != nullptr)
+    wchar_t tmp[INT_STR_MAX];
+    int len = 0;
+    do
+    {
+      tmp[len++] = wchar_t(L'0' + (a_val % 10));
+      a_val /= 10;
+    } while (a_val != 0);
+
+    for (int i = 0; i < len; i++)
+      a_out[i] = tmp[len - i - 1];
+    a_out[len] = 0;
+    return len;
+  }
+
+  static inline int FormatInt(int64_t a_val, wchar_t* a_out)
+  {
+    if (a_val >= 0)
+      return FormatUInt(uint64_t(a_val), a_out);
+    a_out[0] = L'-';
+    return 1 + FormatUInt(uint64_t(0) - uint64_t(a_val), a_out + 1);
+  }
+
+  /**
+  \brief write the shortest decimal string that is read back (by ReadFloats or strtof) to exactly a_val; locale independent.
+   Uses fixed notation for 1e-4 <= |a_val| < 1e9 and "d.ddde+XX" otherwise. a_out must hold FLOAT_STR_MAX symbols. Returns the length.
+  */
+  static inline int FormatFloat(float a_val, wchar_t* a_out)
+  {
+    static const uint64_t pow10u[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+                                       100000000ULL, 1000000000ULL, 10000000000ULL };
+    int len = 0;
+    if (std::isnan(a_val))
+    {
+      a_out[0] = L'n'; a_out[1] = L'a'; a_out[2] = L'n'; a_out[3] = 0;
+      return 3;
+    }
+
+    if (std::signbit(a_val))
+      a_out[len++] = L'-';
+
+    const float absVal = std::fabs(a_val);
+    if (absVal == 0.0f || std::isinf(absVal))
+    {
+      const wchar_t* word = (absVal == 0.0f) ? L"0" : L"inf";
+      for (; *word != 0; word++)
+        a_out[len++] = *word;
+      a_out[len] = 0;
+      return len;
+    }
+
+    // (1) decimal exponent of the first significant digit
+    //
+    int e2 = 0;
+    std::frexp(absVal, &e2);
+    int exp10 = int(std::floor(double(e2 - 1)*0.30102999566398119521));
+    if (double(absVal) >= Pow10d(exp10 + 1))
+      exp10++;
+    else if (double(absVal) < Pow10d(exp10))
+      exp10--;
+
+    // (2) find the shortest mantissa that reads back to the same value; 9 digits are always enough for float
+    //
+    uint64_t mantissa = 0;
+    int      scale    = 0;
+    for (int prec = 1; prec <= 9; prec++)
+    {
+      scale = exp10 - prec + 1;
+      const double q = (scale >= 0) ? double(absVal)/Pow10d(scale) : double(absVal)*Pow10d(-scale);
+      mantissa = uint64_t(q + 0.5);
+      if (mantissa >= pow10u[prec])
+      {
+        mantissa /= 10;
+        scale++;
+      }
+
+      if (MakeFloat(mantissa, scale) == absVal)
+        break;
+
+      if (prec == 9)
+      {
+        if (MakeFloat(mantissa + 1, scale) == absVal)
+          mantissa++;
+        else if (MakeFloat(mantissa - 1, scale) == absVal)
+          mantissa--;
+      }
+    }
+
+    while (mantissa % 10 == 0)
+    {
+      mantissa /= 10;
+      scale++;
+    }
+
+    // (3) print digits
+    //
+    wchar_t digits[INT_STR_MAX];
+    const int numDigits = FormatUInt(mantissa, digits);
+    const int firstExp  = scale + numDigits - 1;
+
+    if (firstExp >= 0 && firstExp < 9)
     {
-      std::wstringstream inputStream(camPosStr);
-      inputStream >> a_outData[0] >> a_outData[1] >> a_outData[2];
+      for (int i = 0; i < numDigits || i <= firstExp; i++)
+      {
+        if (i == firstExp + 1)
+          a_out[len++] = L'.';
+        a_out[len++] = (i < numDigits) ? digits[i] : L'0';
+      }
+    }
+    else if (firstExp < 0 && firstExp >= -4)
+    {
+      a_out[len++] = L'0';
+      a_out[len++] = L'.';
+      for (int i = firstExp + 1; i < 0; i++)
+        a_out[len++] = L'0';
+      for (int i = 0; i < numDigits; i++)
+        a_out[len++] = digits[i];
     }
     else
     {
-      a_outData[0] = 0.0f;
-      a_outData[1] = 0.0f;
-      a_outData[2] = 0.0f;
+      a_out[len++] = digits[0];
+      if (numDigits > 1)
+      {
+        a_out[len++] = L'.';
+        for (int i = 1; i < numDigits; i++)
+          a_out[len++] = digits[i];
+      }
+      a_out[len++] = L'e';
+      a_out[len++] = (firstExp < 0) ? L'-' : L'+';
+      const int absExp = (firstExp < 0) ? -firstExp : firstExp;
+      if (absExp < 10)
+        a_out[len++] = L'0';
+      len += FormatUInt(uint64_t(absExp), a_out + len);
+    }
+
+    a_out[len] = 0;
+    return len;
+  }
+
+  /**
+  \brief write a_num floats separated by single spaces. a_out must hold a_num*FLOAT_STR_MAX symbols. Returns the length.
+  */
+  static inline int FormatFloats(const float* a_data, int a_num, wchar_t* a_out)
+  {
+    int len = 0;
+    for (int i = 0; i < a_num; i++)
+    {
+      if (i != 0)
+        a_out[len++] = L' ';
+      len += FormatFloat(a_data[i], a_out + len);
     }
+    a_out[len] = 0;
+    return len;
+  }
+
+  static inline float ReadFloat(pugi::xml_node a_node)
+  {
+    float val = 0.0f;
+    ReadFloats(a_node.text().as_string(), &val, 1);
+    return val;
+  }
+
+  static inline HydraLiteMath::float3 ReadFloat3(pugi::xml_node a_node)
+  {
+    float res[3] = {0.0f, 0.0f, 0.0f};
+    ReadFloats(a_node.text().as_string(), res, 3);
+    return HydraLiteMath::float3(res[0], res[1], res[2]);
+  }
+
+  static inline HydraLiteMath::float3 ReadFloat3(pugi::xml_attribute a_attr)
+  {
+    float res[3] = {0.0f, 0.0f, 0.0f};
+    ReadFloats(a_attr.as_string(), res, 3);
+    return HydraLiteMath::float3(res[0], res[1], res[2]);
+  }
+
+  static inline void ReadFloat3(pugi::xml_node a_node, float a_outData[3])
+  {
+    a_outData[0] = 0.0f;
+    a_outData[1] = 0.0f;
+    a_outData[2] = 0.0f;
+    ReadFloats(a_node.text().as_string(), a_outData, 3);
+  }
+
+  static inline void ReadFloat3(pugi::xml_attribute a_attr, float a_outData[3])
+  {
+    a_outData[0] = 0.0f;
+    a_outData[1] = 0.0f;
+    a_outData[2] = 0.0f;
+    ReadFloats(a_attr.as_string(), a_outData, 3);
   }
 
   static inline void ReadMatrix4x4(pugi::xml_node a_node, const wchar_t* a_attrib_name, float a_outData[16])
   {
     const wchar_t* matrixStr = a_node.attribute(a_attrib_name).value();
-    if(matrixStr != nullptr)
-    { 
-      std::wstringstream inputStream(matrixStr);
-      inputStream >> a_outData[0]  >> a_outData[1]  >> a_outData[2]  >> a_outData[3]
-                  >> a_outData[4]  >> a_outData[5]  >> a_outData[6]  >> a_outData[7]
-                  >> a_outData[8]  >> a_outData[9]  >> a_outData[10] >> a_outData[11]
-                  >> a_outData[12] >> a_outData[13] >> a_outData[14] >> a_outData[15];
-    }
-    else
+    if(ReadFloats(matrixStr, a_outData, 16) != 16)
     {
       a_outData[0]  = 1.0f; a_outData[1]  = 0.0f; a_outData[2]  = 0.0f; a_outData[3]  = 0.0f;
       a_outData[4]  = 0.0f; a_outData[5]  = 1.0f; a_outData[6]  = 0.0f; a_outData[7]  = 0.0f;
@@ -99,15 +471,7 @@ namespace HydraXMLHelpers
   {
     float tmp[16];
     const wchar_t* matrixStr = a_node.attribute(a_attrib_name).value();
-    if(matrixStr != nullptr)
-    {
-      std::wstringstream inputStream(matrixStr);
-      inputStream >> tmp[0]  >> tmp[1]  >> tmp[2]  >> tmp[3]
-                  >> tmp[4]  >> tmp[5]  >> tmp[6]  >> tmp[7]
-                  >> tmp[8]  >> tmp[9]  >> tmp[10] >> tmp[11]
-                  >> tmp[12] >> tmp[13] >> tmp[14] >> tmp[15];
-    }
-    else
+    if(ReadFloats(matrixStr, tmp, 16) != 16)
     {
       tmp[0]  = 1.0f; tmp[1]  = 0.0f; tmp[2]  = 0.0f; tmp[3]  = 0.0f;
       tmp[4]  = 0.0f; tmp[5]  = 1.0f; tmp[6]  = 0.0f; tmp[7]  = 0.0f;
@@ -123,13 +487,12 @@ namespace HydraXMLHelpers
 
   static inline void ReadBBox(pugi::xml_node a_node, BBox &a_bbox)
   {
-    const wchar_t* bboxStr = a_node.attribute(L"bbox").as_string();
-    if(bboxStr != nullptr)
+    float data[6];
+    if(ReadFloats(a_node.attribute(L"bbox").as_string(), data, 6) == 6)
     {
-      std::wstringstream inputStream(bboxStr);
-      inputStream >> a_bbox.x_min >> a_bbox.x_max
-                  >> a_bbox.y_min >> a_bbox.y_max
-                  >> a_bbox.z_min >> a_bbox.z_max;
+      a_bbox.x_min = data[0]; a_bbox.x_max = data[1];
+      a_bbox.y_min = data[2]; a_bbox.y_max = data[3];
+      a_bbox.z_min = data[4]; a_bbox.z_max = data[5];
     }
     else
     {
@@ -139,60 +502,54 @@ namespace HydraXMLHelpers
 
   static inline void WriteFloat(pugi::xml_node a_node, float a_value)
   {
-    std::wstringstream outStream;
-    outStream << a_value;
-    a_node.text() = outStream.str().c_str();
+    wchar_t outStr[FLOAT_STR_MAX];
+    FormatFloat(a_value, outStr);
+    a_node.text() = outStr;
   }
 
   static inline void WriteFloat3(pugi::xml_node a_node, HydraLiteMath::float3 a_value)
   {
-    std::wstringstream outStream;
-    outStream << a_value.x << L" " << a_value.y << L" " << a_value.z;
-    a_node.text() = outStream.str().c_str();
+    const float data[3] = { a_value.x, a_value.y, a_value.z };
+    wchar_t outStr[3*FLOAT_STR_MAX];
+    FormatFloats(data, 3, outStr);
+    a_node.text() = outStr;
   }
 
   static inline void WriteFloat3(pugi::xml_attribute a_attr, HydraLiteMath::float3 a_value)
   {
-    std::wstringstream outStream;
-    outStream << a_value.x << L" " << a_value.y << L" " << a_value.z;
-    a_attr.set_value(outStream.str().c_str());
+    const float data[3] = { a_value.x, a_value.y, a_value.z };
+    wchar_t outStr[3*FLOAT_STR_MAX];
+    FormatFloats(data, 3, outStr);
+    a_attr.set_value(outStr);
   }
 
   static inline void WriteFloat3(pugi::xml_node a_node, float a_value[3])
   {
-    std::wstringstream outStream;
-    outStream << a_value[0] << L" " << a_value[1] << L" " << a_value[2];
-    a_node.text() = outStream.str().c_str();
+    wchar_t outStr[3*FLOAT_STR_MAX];
+    FormatFloats(a_value, 3, outStr);
+    a_node.text() = outStr;
   }
 
   static inline void WriteFloat3(pugi::xml_attribute a_attr, float a_value[3])
   {
-    std::wstringstream outStream;
-    outStream << a_value[0] << L" " << a_value[1] << L" " << a_value[2];
-    a_attr.set_value(outStream.str().c_str());
+    wchar_t outStr[3*FLOAT_STR_MAX];
+    FormatFloats(a_value, 3, outStr);
+    a_attr.set_value(outStr);
   }
 
   static inline void WriteMatrix4x4(pugi::xml_node a_node, const wchar_t* a_attrib_name, float a_value[16])
   {
-    std::wstringstream outStream;
-    outStream << a_value[0]  << L" " << a_value[1]  << L" " << a_value[2]  << L" " << a_value[3]  << L" "
-              << a_value[4]  << L" " << a_value[5]  << L" " << a_value[6]  << L" " << a_value[7]  << L" "
-              << a_value[8]  << L" " << a_value[9]  << L" " << a_value[10] << L" " << a_value[11] << L" "
-              << a_value[12] << L" " << a_value[13] << L" " << a_value[14] << L" " << a_value[15];
-
-    a_node.attribute(a_attrib_name).set_value(outStream.str().c_str());
+    wchar_t outStr[16*FLOAT_STR_MAX];
+    FormatFloats(a_value, 16, outStr);
+    a_node.attribute(a_attrib_name).set_value(outStr);
   }
 
   static inline void WriteBBox(pugi::xml_node a_node, const BBox &a_bbox)
   {
-    std::wstringstream outStream;
-    outStream << std::setw(6)
-              << a_bbox.x_min << L" " << a_bbox.x_max << L" "
-              << a_bbox.y_min << L" " << a_bbox.y_max << L" "
-              << a_bbox.z_min << L" " << a_bbox.z_max;
-
-    a_node.force_attribute(L"bbox").set_value(outStream.str().c_str());
-
+    const float data[6] = { a_bbox.x_min, a_bbox.x_max, a_bbox.y_min, a_bbox.y_max, a_bbox.z_min, a_bbox.z_max };
+    wchar_t outStr[6*FLOAT_STR_MAX];
+    FormatFloats(data, 6, outStr);
+    a_node.force_attribute(L"bbox").set_value(outStr);
   }
 
   //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
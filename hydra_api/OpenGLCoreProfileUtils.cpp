@@ -5,6 +5,7 @@
 #include <iostream>
 #include <random>
 #include "OpenGLCoreProfileUtils.h"
+#include "HydraXMLHelpers.h"
 
 namespace oldies
 {
@@ -753,6 +754,39 @@ namespace GL_RENDER_DRIVER_UTILS
     glBindBuffer(GL_TEXTURE_BUFFER, 0);
   }
 
+  void ReadMeshBox(pugi::xml_node a_meshNode, const HRMeshDriverInput &a_input, float a_boxMin[3], float a_boxMax[3])
+  {
+    BBox bbox;
+    HydraXMLHelpers::ReadBBox(a_meshNode, bbox);
+
+    if (bbox.x_min > bbox.x_max && a_input.pos4f != nullptr)
+    {
+      for (int i = 0; i < a_input.vertNum; i++)
+      {
+        const float* v = a_input.pos4f + i * 4;
+        bbox.x_min = std::min(bbox.x_min, v[0]); bbox.x_max = std::max(bbox.x_max, v[0]);
+        bbox.y_min = std::min(bbox.y_min, v[1]); bbox.y_max = std::max(bbox.y_max, v[1]);
+        bbox.z_min = std::min(bbox.z_min, v[2]); bbox.z_max = std::max(bbox.z_max, v[2]);
+      }
+    }
+
+    a_boxMin[0] = bbox.x_min; a_boxMin[1] = bbox.y_min; a_boxMin[2] = bbox.z_min;
+    a_boxMax[0] = bbox.x_max; a_boxMax[1] = bbox.y_max; a_boxMax[2] = bbox.z_max;
+  }
+
+  void BindInstanceMatrices(GLuint a_instanceVBO, GLuint a_location, size_t a_firstInstance)
+  {
+    const size_t matrixSize = 16 * sizeof(GLfloat);
+
+    glBindBuffer(GL_ARRAY_BUFFER, a_instanceVBO);
+    for (GLuint col = 0; col < 4; col++)
+    {
+      glEnableVertexAttribArray(a_location + col);
+      glVertexAttribPointer(a_location + col, 4, GL_FLOAT, GL_FALSE, GLsizei(matrixSize), (GLvoid*)(a_firstInstance * matrixSize + col * 4 * sizeof(GLfloat)));
+      glVertexAttribDivisor(a_location + col, 1);
+    }
+  }
+
   void CreateGeometryFromBatch(const HRBatchInfo &batch, const HRMeshDriverInput &a_input, std::vector<float> &a_pos,
                                std::vector<float> &a_norm, std::vector<float> &a_batchTangent, std::vector<float> &a_texcoords,
                                std::vector<int> &a_indices)
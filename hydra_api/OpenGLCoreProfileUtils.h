@@ -362,6 +362,10 @@ namespace GL_RENDER_DRIVER_UTILS {
                                std::vector<float> &a_norm, std::vector<float> &a_batchTangent, std::vector<float> &a_texcoords,
                                std::vector<int> &a_indices);
 
+  void ReadMeshBox(pugi::xml_node a_meshNode, const HRMeshDriverInput &a_input, float a_boxMin[3], float a_boxMax[3]); ///< bbox from mesh xml or from vertices if xml does not have it
+
+  void BindInstanceMatrices(GLuint a_instanceVBO, GLuint a_location, size_t a_firstInstance); ///< mat4 instance attribute at a_location ... a_location+3 of the bound VAO; matrices are column major, 16 floats each
+
   void CreateRandomLights(int num, std::vector<float3> &pos, std::vector<float3> &color);
 
   void AssignRandomIESFiles(int num, std::vector<GLuint> &iesTextures);
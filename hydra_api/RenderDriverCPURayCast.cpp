@@ -0,0 +1,1395 @@
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+
+#include "HydraRenderDriverAPI.h"
+#include "HydraXMLHelpers.h"
+#include "HydraBVH.h"
+#include "LiteMath.h"
+#include "ssemath.h"
+
+using namespace HydraLiteMath;
+using HydraBVH::BVHNode;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  constexpr int   RC_TILE_SIZE   = 16;     ///< tile is rendered by single thread as 2x2 pixel packets
+  constexpr int   RC_STACK_SIZE  = 128;    ///< enough for HydraBVH trees, their depth is bounded
+  constexpr float RC_MISS_DEPTH  = 1e10f;
+  constexpr float RC_INV_PI      = 0.318309886183790671538f;
+
+  /**
+  \brief 4 rays in SoA form; dir is not normalized in object space of instances.
+  */
+  struct RayPacket
+  {
+    __m128 ox, oy, oz;
+    __m128 dx, dy, dz;
+    __m128 rdx, rdy, rdz;
+  };
+
+  struct HitPacket
+  {
+    __m128  t, u, v;
+    __m128i inst, tri;
+  };
+
+  static inline __m128 SafeRcp(__m128 a_val) // 1/x with |x| clamped from zero, so slab test never sees inf*0
+  {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 absVal   = _mm_max_ps(_mm_andnot_ps(signMask, a_val), _mm_set1_ps(1e-20f));
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(absVal, _mm_and_ps(signMask, a_val)));
+  }
+
+  static inline void InitRcp(RayPacket& a_ray)
+  {
+    a_ray.rdx = SafeRcp(a_ray.dx);
+    a_ray.rdy = SafeRcp(a_ray.dy);
+    a_ray.rdz = SafeRcp(a_ray.dz);
+  }
+
+  static inline __m128 IntersectBox(const RayPacket& a_ray, const BVHNode& a_node, __m128 a_tmax)
+  {
+    const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMin[0]), a_ray.ox), a_ray.rdx);
+    const __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMax[0]), a_ray.ox), a_ray.rdx);
+    const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMin[1]), a_ray.oy), a_ray.rdy);
+    const __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMax[1]), a_ray.oy), a_ray.rdy);
+    const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMin[2]), a_ray.oz), a_ray.rdz);
+    const __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(a_node.boxMax[2]), a_ray.oz), a_ray.rdz);
+
+    const __m128 tnear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), _mm_setzero_ps()));
+    const __m128 tfar  = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), a_tmax));
+
+    return _mm_cmple_ps(tnear, tfar);
+  }
+
+  /**
+  \brief Moller-Trumbore test of 4 rays against single triangle (two sided); returns mask of rays where t in (0, a_tmax).
+  */
+  static inline __m128 IntersectTriangle(const RayPacket& a_ray, const float4* a_tri, __m128 a_tmax, __m128* a_pT, __m128* a_pU, __m128* a_pV)
+  {
+    const __m128 e1x = _mm_set1_ps(a_tri[1].x), e1y = _mm_set1_ps(a_tri[1].y), e1z = _mm_set1_ps(a_tri[1].z);
+    const __m128 e2x = _mm_set1_ps(a_tri[2].x), e2y = _mm_set1_ps(a_tri[2].y), e2z = _mm_set1_ps(a_tri[2].z);
+
+    const __m128 px = _mm_sub_ps(_mm_mul_ps(a_ray.dy, e2z), _mm_mul_ps(a_ray.dz, e2y));
+    const __m128 py = _mm_sub_ps(_mm_mul_ps(a_ray.dz, e2x), _mm_mul_ps(a_ray.dx, e2z));
+    const __m128 pz = _mm_sub_ps(_mm_mul_ps(a_ray.dx, e2y), _mm_mul_ps(a_ray.dy, e2x));
+
+    const __m128 det    = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+    const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    const __m128 sx = _mm_sub_ps(a_ray.ox, _mm_set1_ps(a_tri[0].x));
+    const __m128 sy = _mm_sub_ps(a_ray.oy, _mm_set1_ps(a_tri[0].y));
+    const __m128 sz = _mm_sub_ps(a_ray.oz, _mm_set1_ps(a_tri[0].z));
+
+    const __m128 u  = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+    const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+
+    const __m128 v  = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a_ray.dx, qx), _mm_mul_ps(a_ray.dy, qy)), _mm_mul_ps(a_ray.dz, qz)), invDet);
+    const __m128 t  = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+    const __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpneq_ps(det, zero);
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, a_tmax));
+
+    *a_pT = t;
+    *a_pU = u;
+    *a_pV = v;
+    return mask;
+  }
+
+  static inline __m128 Select(__m128 a_mask, __m128 a_true, __m128 a_false) { return _mm_blendv_ps(a_false, a_true, a_mask); }
+
+  /**
+  \brief visit BVH nodes that are hit by at least one active ray of the packet.
+  \param a_tmax   - current ray lengths; leaf function may shorten them
+  \param a_active - active rays; leaf function may disable rays (any hit queries)
+  \param a_leaf   - void(uint32_t first, uint32_t num)
+
+  Children are visited near-first along the direction of the first active ray.
+  */
+  template<typename LeafFunc>
+  static inline void TraversePacket(const BVHNode* a_nodes, const RayPacket& a_ray, const __m128& a_tmax, const __m128& a_active, LeafFunc a_leaf)
+  {
+    alignas(16) float dir[3][4];
+    _mm_store_ps(dir[0], a_ray.dx);
+    _mm_store_ps(dir[1], a_ray.dy);
+    _mm_store_ps(dir[2], a_ray.dz);
+    const int activeMask = _mm_movemask_ps(a_active);
+    int lane = 0;
+    while (lane < 3 && (activeMask & (1 << lane)) == 0)
+      lane++;
+    const float dirX = dir[0][lane], dirY = dir[1][lane], dirZ = dir[2][lane];
+
+    uint32_t stack[RC_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+      const BVHNode& node = a_nodes[stack[--top]];
+
+      if (_mm_movemask_ps(_mm_and_ps(IntersectBox(a_ray, node, a_tmax), a_active)) == 0)
+        continue;
+
+      if (node.primsNum == 0)
+      {
+        const BVHNode& left  = a_nodes[node.leftOrFirst + 0];
+        const BVHNode& right = a_nodes[node.leftOrFirst + 1];
+
+        const float centerDiff = dirX*(right.boxMin[0] + right.boxMax[0] - left.boxMin[0] - left.boxMax[0]) +
+                                 dirY*(right.boxMin[1] + right.boxMax[1] - left.boxMin[1] - left.boxMax[1]) +
+                                 dirZ*(right.boxMin[2] + right.boxMax[2] - left.boxMin[2] - left.boxMax[2]);
+
+        if (centerDiff >= 0.0f) // right child is further along the ray, push it first
+        {
+          stack[top++] = node.leftOrFirst + 1;
+          stack[top++] = node.leftOrFirst + 0;
+        }
+        else
+        {
+          stack[top++] = node.leftOrFirst + 0;
+          stack[top++] = node.leftOrFirst + 1;
+        }
+      }
+      else
+      {
+        a_leaf(node.leftOrFirst, node.primsNum);
+        if (_mm_movemask_ps(a_active) == 0)
+          return;
+      }
+    }
+  }
+
+  static inline float SmoothStep(float a_edge0, float a_edge1, float a_x)
+  {
+    const float t = clamp((a_x - a_edge0) / std::max(a_edge1 - a_edge0, 1e-6f), 0.0f, 1.0f);
+    return t*t*(3.0f - 2.0f*t);
+  }
+}
+
+struct RD_CPU_RayCast : public IHRRenderDriver
+{
+  RD_CPU_RayCast()
+  {
+    m_width        = 1024;
+    m_height       = 1024;
+    m_tlasDirty    = true;
+    m_haveSky      = false;
+    m_camFov       = 45.0f;
+    m_camNearPlane = 0.1f;
+    m_camFarPlane  = 1000.0f;
+    m_camPos       = float3(0.0f, 0.0f, 0.0f);
+    m_camLookAt    = float3(0.0f, 0.0f, -1.0f);
+    m_camUp        = float3(0.0f, 1.0f, 0.0f);
+    m_camUseMatrices = false;
+    m_pColor         = std::make_shared<HydraRender::HDRImage4f>(m_width, m_height);
+  }
+
+  void              ClearAll() override;
+  HRDriverAllocInfo AllocAll(HRDriverAllocInfo a_info) override;
+
+  bool UpdateImage(int32_t a_texId, int32_t w, int32_t h, int32_t bpp, const void* a_data, pugi::xml_node a_texNode) override;
+  bool UpdateMaterial(int32_t a_matId, pugi::xml_node a_materialNode) override;
+  bool UpdateLight(int32_t a_lightIdId, pugi::xml_node a_lightNode) override;
+  bool UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode, const HRMeshDriverInput& a_input, const HRBatchInfo* a_batchList, int32_t listSize) override;
+
+  bool UpdateImageFromFile(int32_t /*a_texId*/, const wchar_t* /*a_fileName*/, pugi::xml_node /*a_texNode*/) override { return false; }
+  bool UpdateMeshFromFile(int32_t /*a_meshId*/, pugi::xml_node /*a_meshNode*/, const wchar_t* /*a_fileName*/) override { return false; }
+
+  bool UpdateCamera(pugi::xml_node a_camNode) override;
+  bool UpdateSettings(pugi::xml_node a_settingsNode) override;
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void BeginScene(pugi::xml_node a_sceneNode) override;
+  void EndScene() override;
+  void InstanceMeshes(int32_t a_mesh_id, const float* a_matrices, int32_t a_instNum, const int* a_lightInstId, const int* a_remapId, const int* a_realInstId) override;
+  void InstanceLights(int32_t a_light_id, const float* a_matrix, pugi::xml_node* a_custAttrArray, int32_t a_instNum, int32_t a_lightGroupId) override;
+
+  void Draw() override;
+
+  HRRenderUpdateInfo HaveUpdateNow(int a_maxRaysPerPixel) override;
+
+  void GetFrameBufferHDR(int32_t w, int32_t h, float*   a_out, const wchar_t* a_layerName) override;
+  void GetFrameBufferLDR(int32_t w, int32_t h, int32_t* a_out) override;
+
+  void GetFrameBufferLineHDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, float* a_out, const wchar_t* a_layerName) override;
+  void GetFrameBufferLineLDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, int32_t* a_out) override;
+
+  void GetGBufferLine(int32_t a_lineNumber, HRGBufferPixel* a_lineData, int32_t a_startX, int32_t a_endX, const std::unordered_set<int32_t>& a_shadowCatchers) override;
+  void GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers) override;
+
+  HRDriverInfo Info() override;
+  HRDriverDependencyInfo DependencyInfo() override;
+  const HRRenderDeviceInfoListElem* DeviceList() const override { return nullptr; }
+  bool EnableDevice(int32_t /*id*/, bool /*a_enable*/) override { return true; }
+
+  std::shared_ptr<HydraRender::HDRImage4f> GetFrameBufferImage(const wchar_t* a_imageName) override;
+
+protected:
+
+  struct Mesh
+  {
+    std::vector<float> pos4f;
+    std::vector<float> norm4f;
+    std::vector<float> texcoord2f;
+    std::vector<int>   indices;
+    std::vector<int>   matIndices;
+
+    HydraBVH::TriangleBVH bvh;
+    bool                  bvhDirty = false;
+  };
+
+  struct Instance
+  {
+    int32_t  meshId;
+    int32_t  remapId;
+    int32_t  realInstId;
+    bool     isLightGeom;    ///< light geometry does not cast shadows for any light, it would occlude its own one
+    float4x4 matrix;         ///< object to world
+    float4x4 invMatrix;      ///< world to object
+    float4x4 normalMatrix;   ///< transpose(inverse(matrix))
+  };
+
+  struct Material
+  {
+    Material() : diffuse(0.5f, 0.5f, 0.5f), emission(0.0f, 0.0f, 0.0f), diffTexId(-1) { texMatrix[0] = 1.0f; texMatrix[1] = 0.0f; texMatrix[2] = 0.0f; texMatrix[3] = 0.0f; texMatrix[4] = 1.0f; texMatrix[5] = 0.0f; }
+    float3 diffuse;
+    float3 emission;
+    int    diffTexId;
+    float  texMatrix[6];    ///< 2x3 texture coordinates transform
+  };
+
+  struct Texture
+  {
+    int                  w = 0, h = 0, bpp = 0;
+    std::vector<uint8_t> data;
+  };
+
+  enum LIGHT_KIND { LIGHT_POINT = 0, LIGHT_DIRECT = 1, LIGHT_SKY = 2 };
+
+  struct Light
+  {
+    LIGHT_KIND kind      = LIGHT_POINT;
+    float3     intensity = float3(0.0f, 0.0f, 0.0f); ///< already multiplied by area for shaped lights
+    bool       oneSided  = false;                    ///< emits to -Y hemisphere of light space (rect and disk lights)
+    bool       spot      = false;
+    float      cosInner  = 1.0f;
+    float      cosOuter  = 0.0f;
+    bool       valid     = false;
+  };
+
+  struct LightInstance
+  {
+    int32_t lightId;
+    float3  pos;
+    float3  dir; ///< main direction of emission
+  };
+
+  struct HitRecord
+  {
+    float   t;
+    int32_t inst;
+    int32_t tri;
+    float   u, v;
+  };
+
+  struct Surface
+  {
+    float3 pos;
+    float3 norm;
+    float2 texc;
+    float3 albedo;
+    float3 emission;
+    int32_t matId;
+  };
+
+  void     BuildAccelStructs();
+  void     RenderTile(int a_tileX, int a_tileY);
+  void     MakePrimaryRay(float a_x, float a_y, float3* a_pOrigin, float3* a_pDir) const;
+  void     TraceClosest(const RayPacket& a_ray, __m128 a_active, HitPacket& a_hit) const;
+  __m128   TraceShadow (const RayPacket& a_ray, __m128 a_active, __m128 a_tmax) const;
+  Surface  GetSurface(const HitRecord& a_hit, float3 a_rayDir) const;
+  float3   SampleTexture(int a_texId, float2 a_texc) const;
+  int32_t  RemapMaterial(int32_t a_matId, int32_t a_remapId) const;
+
+  std::vector<Mesh>          m_meshes;
+  std::vector<Material>      m_materials;
+  std::vector<Texture>       m_textures;
+  std::vector<Light>         m_lights;
+
+  std::vector<Instance>      m_instances;
+  std::vector<LightInstance> m_lightInstances;
+  std::vector< std::unordered_map<int32_t, int32_t> > m_remapLists;
+
+  HydraBVH::BVHTree          m_tlas;
+  std::vector<int32_t>       m_tlasMeshIds; ///< mesh of each instance at the moment of TLAS build
+  bool                       m_tlasDirty;
+  bool                       m_haveSky;
+  float3                     m_skyColor;
+  float                      m_srgbToLinear[256];
+
+  // camera; both kinds of camera are reduced to inverse view-projection matrix
+  //
+  float3   m_camPos, m_camLookAt, m_camUp;
+  float    m_camFov, m_camNearPlane, m_camFarPlane;
+  bool     m_camUseMatrices;
+  float4x4 m_camWorldView, m_camProj;
+  float4x4 m_invViewProj;
+  float3   m_camEye;
+  bool     m_camPerspective;
+
+  int m_width;
+  int m_height;
+
+  std::shared_ptr<HydraRender::HDRImage4f> m_pColor;
+  std::vector<HitRecord>                   m_hits;    ///< gbuffer is restored from hit records on demand
+  std::vector<float>                       m_shadow;  ///< fraction of direct light that is blocked, 0 is fully lit
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RD_CPU_RayCast::ClearAll()
+{
+  m_meshes         = std::vector<Mesh>();
+  m_materials      = std::vector<Material>();
+  m_textures       = std::vector<Texture>();
+  m_lights         = std::vector<Light>();
+  m_instances      = std::vector<Instance>();
+  m_lightInstances = std::vector<LightInstance>();
+  m_remapLists.clear();
+  m_tlas.Clear();
+  m_tlasMeshIds.clear();
+  m_tlasDirty = true;
+}
+
+HRDriverAllocInfo RD_CPU_RayCast::AllocAll(HRDriverAllocInfo a_info)
+{
+  m_meshes.resize(std::max(a_info.geomNum, 0));
+  m_materials.resize(std::max(a_info.matNum, 0));
+  m_textures.resize(std::max(a_info.imgNum, 0));
+  m_lights.resize(std::max(a_info.lightNum, 0));
+
+  for (int i = 0; i < 256; i++)
+    m_srgbToLinear[i] = powf(float(i) / 255.0f, 2.2f);
+
+  return a_info;
+}
+
+HRDriverInfo RD_CPU_RayCast::Info()
+{
+  HRDriverInfo info;
+
+  info.supportHDRFrameBuffer        = true;
+  info.supportHDRTextures           = true;
+  info.supportMultiMaterialInstance = true;
+  info.supportGetFrameBufferLine    = true;
+  info.supportLighting              = true;
+
+  info.supportImageLoadFromInternalFormat = false;
+  info.supportImageLoadFromExternalFormat = false;
+  info.supportMeshLoadFromInternalFormat  = false;
+  info.createsLightGeometryItself         = false;
+
+  info.memTotal = int64_t(8) * int64_t(1024 * 1024 * 1024);
+
+  return info;
+}
+
+HRDriverDependencyInfo RD_CPU_RayCast::DependencyInfo()
+{
+  HRDriverDependencyInfo info;
+  info.meshDependsOfMaterial       = false; // materials are read during shading
+  info.needRedrawWhenCameraChanges = false; // instances are kept between frames, camera is applied in Draw()
+  return info;
+}
+
+bool RD_CPU_RayCast::UpdateImage(int32_t a_texId, int32_t w, int32_t h, int32_t bpp, const void* a_data, pugi::xml_node /*a_texNode*/)
+{
+  if (a_data == nullptr || a_texId < 0 || w <= 0 || h <= 0 || (bpp != 4 && bpp != 16))
+    return false;
+
+  if (a_texId >= int32_t(m_textures.size()))
+    m_textures.resize(a_texId + 1);
+
+  Texture& tex = m_textures[a_texId];
+  tex.w   = w;
+  tex.h   = h;
+  tex.bpp = bpp;
+  tex.data.assign((const uint8_t*)a_data, (const uint8_t*)a_data + size_t(w)*size_t(h)*size_t(bpp));
+  return true;
+}
+
+bool RD_CPU_RayCast::UpdateMaterial(int32_t a_matId, pugi::xml_node a_materialNode)
+{
+  if (a_matId < 0)
+    return false;
+
+  if (a_matId >= int32_t(m_materials.size()))
+    m_materials.resize(a_matId + 1);
+
+  Material mat;
+
+  const pugi::xml_node diffColor = a_materialNode.child(L"diffuse").child(L"color");
+  const pugi::xml_node emisColor = a_materialNode.child(L"emission").child(L"color");
+
+  if (diffColor != nullptr)
+  {
+    mat.diffuse = (diffColor.attribute(L"val") != nullptr) ? HydraXMLHelpers::ReadFloat3(diffColor.attribute(L"val")) : HydraXMLHelpers::ReadFloat3(diffColor);
+
+    pugi::xml_node texNode = diffColor.child(L"texture");
+    if (texNode == nullptr)
+      texNode = a_materialNode.child(L"diffuse").child(L"texture"); // old format
+
+    if (texNode != nullptr)
+    {
+      float texMatrix[16];
+      HydraXMLHelpers::ReadMatrix4x4(texNode, L"matrix", texMatrix);
+      mat.diffTexId    = texNode.attribute(L"id").as_int();
+      mat.texMatrix[0] = texMatrix[0]; mat.texMatrix[1] = texMatrix[1]; mat.texMatrix[2] = texMatrix[3];
+      mat.texMatrix[3] = texMatrix[4]; mat.texMatrix[4] = texMatrix[5]; mat.texMatrix[5] = texMatrix[7];
+    }
+  }
+
+  if (emisColor != nullptr)
+  {
+    mat.emission = (emisColor.attribute(L"val") != nullptr) ? HydraXMLHelpers::ReadFloat3(emisColor.attribute(L"val")) : HydraXMLHelpers::ReadFloat3(emisColor);
+    if (a_materialNode.child(L"emission").child(L"multiplier") != nullptr)
+      mat.emission = mat.emission*a_materialNode.child(L"emission").child(L"multiplier").attribute(L"val").as_float();
+    if (diffColor == nullptr)
+      mat.diffuse = float3(0.0f, 0.0f, 0.0f);
+  }
+
+  m_materials[a_matId] = mat;
+  return true;
+}
+
+bool RD_CPU_RayCast::UpdateLight(int32_t a_lightId, pugi::xml_node a_lightNode)
+{
+  if (a_lightId < 0)
+    return false;
+
+  if (a_lightId >= int32_t(m_lights.size()))
+    m_lights.resize(a_lightId + 1);
+
+  const std::wstring ltype  = a_lightNode.attribute(L"type").as_string();
+  const std::wstring lshape = a_lightNode.attribute(L"shape").as_string();
+  const std::wstring ldistr = a_lightNode.attribute(L"distribution").as_string();
+  const pugi::xml_node size = a_lightNode.child(L"size");
+
+  Light light;
+  light.intensity = HydraXMLHelpers::ReadLightIntensity(a_lightNode);
+  light.valid     = true;
+
+  // shaped lights are reduced to points with intensity = radiance*area;
+  // this is the preview, so soft shadows are not needed
+  //
+  if (ltype == L"sky")
+    light.kind = LIGHT_SKY;
+  else if (ltype == L"directional")
+    light.kind = LIGHT_DIRECT;
+  else if (lshape == L"rect")
+  {
+    light.intensity = light.intensity*(4.0f*size.attribute(L"half_length").as_float()*size.attribute(L"half_width").as_float());
+    light.oneSided  = true;
+  }
+  else if (lshape == L"disk")
+  {
+    const float radius = size.attribute(L"radius").as_float();
+    light.intensity = light.intensity*(3.14159265358979323846f*radius*radius);
+    light.oneSided  = true;
+  }
+  else if (lshape == L"sphere")
+  {
+    const float radius = size.attribute(L"radius").as_float();
+    light.intensity = light.intensity*(3.14159265358979323846f*radius*radius);
+  }
+
+  if (ldistr == L"spot")
+  {
+    const float angle1 = a_lightNode.child(L"falloff_angle").attribute(L"val").as_float();
+    const float angle2 = a_lightNode.child(L"falloff_angle2").attribute(L"val").as_float();
+    const float outer  = std::max(angle1, angle2)*0.5f*3.14159265358979323846f/180.0f;
+    const float inner  = std::min(angle1, angle2)*0.5f*3.14159265358979323846f/180.0f;
+    light.spot     = true;
+    light.cosOuter = cosf(outer);
+    light.cosInner = cosf(inner);
+  }
+
+  m_lights[a_lightId] = light;
+  return true;
+}
+
+bool RD_CPU_RayCast::UpdateMesh(int32_t a_meshId, pugi::xml_node /*a_meshNode*/, const HRMeshDriverInput& a_input, const HRBatchInfo* /*a_batchList*/, int32_t /*a_listSize*/)
+{
+  if (a_meshId < 0)
+    return false;
+
+  if (a_meshId >= int32_t(m_meshes.size()))
+    m_meshes.resize(a_meshId + 1);
+
+  Mesh& mesh = m_meshes[a_meshId];
+
+  m_hits.clear();   // hit records may refer to triangles of the old mesh
+  m_shadow.clear();
+
+  const size_t vertNum = size_t(std::max(a_input.vertNum, 0));
+  const size_t triNum  = size_t(std::max(a_input.triNum,  0));
+
+  // check indices here, so that traversal and shading can read without checks
+  //
+  for (size_t i = 0; i < triNum*3; i++)
+  {
+    if (a_input.indices[i] < 0 || size_t(a_input.indices[i]) >= vertNum)
+    {
+      if (m_pInfoCallBack != nullptr)
+        m_pInfoCallBack(L"bad vertex index in mesh", L"RD_CPU_RayCast::UpdateMesh", HR_SEVERITY_WARNING);
+      mesh = Mesh();
+      return false;
+    }
+  }
+
+  mesh.pos4f.assign(a_input.pos4f, a_input.pos4f + vertNum*4);
+  mesh.indices.assign(a_input.indices, a_input.indices + triNum*3);
+
+  if (a_input.norm4f != nullptr)
+    mesh.norm4f.assign(a_input.norm4f, a_input.norm4f + vertNum*4);
+  else
+    mesh.norm4f.clear();
+
+  if (a_input.texcoord2f != nullptr)
+    mesh.texcoord2f.assign(a_input.texcoord2f, a_input.texcoord2f + vertNum*2);
+  else
+    mesh.texcoord2f.assign(vertNum*2, 0.0f);
+
+  if (a_input.triMatIndices != nullptr)
+    mesh.matIndices.assign(a_input.triMatIndices, a_input.triMatIndices + triNum);
+  else
+    mesh.matIndices.assign(triNum, 0);
+
+  mesh.bvh.Clear();
+  mesh.bvhDirty = true;  // built in EndScene for all updated meshes in parallel
+  m_tlasDirty   = true;
+  return true;
+}
+
+bool RD_CPU_RayCast::UpdateCamera(pugi::xml_node a_camNode)
+{
+  if (a_camNode == nullptr)
+    return true;
+
+  m_camUseMatrices = false;
+
+  if (std::wstring(a_camNode.attribute(L"type").as_string()) == L"two_matrices")
+  {
+    float mWorldView[16];
+    float mProj[16];
+
+    HydraXMLHelpers::ReadFloats(a_camNode.child(L"mWorldView").text().as_string(), mWorldView, 16);
+    HydraXMLHelpers::ReadFloats(a_camNode.child(L"mProj").text().as_string(),      mProj,      16);
+
+    m_camWorldView   = float4x4(mWorldView);
+    m_camProj        = float4x4(mProj);
+    m_camUseMatrices = true;
+    return true;
+  }
+
+  if (!a_camNode.child(L"fov").text().empty())
+    m_camFov = a_camNode.child(L"fov").text().as_float();
+
+  if (!a_camNode.child(L"nearClipPlane").text().empty())
+    m_camNearPlane = a_camNode.child(L"nearClipPlane").text().as_float();
+
+  if (!a_camNode.child(L"farClipPlane").text().empty())
+    m_camFarPlane = a_camNode.child(L"farClipPlane").text().as_float();
+
+  if (!a_camNode.child(L"position").text().empty())
+    m_camPos = HydraXMLHelpers::ReadFloat3(a_camNode.child(L"position"));
+
+  if (!a_camNode.child(L"look_at").text().empty())
+    m_camLookAt = HydraXMLHelpers::ReadFloat3(a_camNode.child(L"look_at"));
+
+  if (!a_camNode.child(L"up").text().empty())
+    m_camUp = HydraXMLHelpers::ReadFloat3(a_camNode.child(L"up"));
+
+  return true;
+}
+
+bool RD_CPU_RayCast::UpdateSettings(pugi::xml_node a_settingsNode)
+{
+  if (a_settingsNode.child(L"width") != nullptr)
+    m_width = a_settingsNode.child(L"width").text().as_int();
+
+  if (a_settingsNode.child(L"height") != nullptr)
+    m_height = a_settingsNode.child(L"height").text().as_int();
+
+  if (m_width <= 0 || m_height <= 0)
+  {
+    if (m_pInfoCallBack != nullptr)
+      m_pInfoCallBack(L"bad input resolution", L"RD_CPU_RayCast::UpdateSettings", HR_SEVERITY_ERROR);
+    return false;
+  }
+
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RD_CPU_RayCast::BeginScene(pugi::xml_node a_sceneNode)
+{
+  m_instances.clear();
+  m_lightInstances.clear();
+  m_remapLists.clear();
+  m_hits.clear();   // hit records refer to old instances; gbuffer is empty until next Draw
+  m_shadow.clear();
+  m_tlasDirty = true;
+  m_haveSky   = false;
+
+  for (pugi::xml_node listNode = a_sceneNode.child(L"remap_lists").first_child(); listNode != nullptr; listNode = listNode.next_sibling())
+  {
+    const int listSize = listNode.attribute(L"size").as_int();
+    std::vector<int32_t> listData(std::max(listSize, 0));
+    const int readNum = HydraXMLHelpers::ReadInts(listNode.attribute(L"val").as_string(), listData.data(), listSize);
+
+    std::unordered_map<int32_t, int32_t> remapList;
+    for (int i = 0; i + 1 < readNum; i += 2)
+      remapList[listData[i]] = listData[i + 1];
+    m_remapLists.push_back(std::move(remapList));
+  }
+}
+
+void RD_CPU_RayCast::InstanceMeshes(int32_t a_mesh_id, const float* a_matrices, int32_t a_instNum, const int* a_lightInstId, const int* a_remapId, const int* a_realInstId)
+{
+  if (a_mesh_id < 0 || a_mesh_id >= int32_t(m_meshes.size()))
+    return;
+
+  for (int32_t i = 0; i < a_instNum; i++)
+  {
+    Instance inst;
+    inst.meshId       = a_mesh_id;
+    inst.remapId      = (a_remapId    != nullptr) ? a_remapId[i]    : -1;
+    inst.realInstId   = (a_realInstId != nullptr) ? a_realInstId[i] : int32_t(m_instances.size());
+    inst.isLightGeom  = (a_lightInstId != nullptr) && (a_lightInstId[i] >= 0);
+    inst.matrix       = float4x4(a_matrices + i*16);
+    inst.invMatrix    = inverse4x4(inst.matrix);
+    inst.normalMatrix = transpose(inst.invMatrix);
+    m_instances.push_back(inst);
+  }
+}
+
+void RD_CPU_RayCast::InstanceLights(int32_t a_light_id, const float* a_matrix, pugi::xml_node* /*a_custAttrArray*/, int32_t a_instNum, int32_t /*a_lightGroupId*/)
+{
+  if (a_light_id < 0 || a_light_id >= int32_t(m_lights.size()) || !m_lights[a_light_id].valid)
+    return;
+
+  for (int32_t i = 0; i < a_instNum; i++)
+  {
+    const float4x4 mat(a_matrix + i*16);
+    const Light& light = m_lights[a_light_id];
+
+    if (light.kind == LIGHT_SKY)
+    {
+      m_haveSky  = true;
+      m_skyColor = light.intensity;
+      continue;
+    }
+
+    LightInstance linst;
+    linst.lightId = a_light_id;
+    linst.pos     = mul(mat, float3(0.0f, 0.0f, 0.0f));
+    linst.dir     = normalize(mul3x3(mat, float3(0.0f, -1.0f, 0.0f)));
+    m_lightInstances.push_back(linst);
+  }
+}
+
+void RD_CPU_RayCast::EndScene()
+{
+  BuildAccelStructs();
+}
+
+void RD_CPU_RayCast::BuildAccelStructs()
+{
+  std::vector<int32_t> dirtyMeshes;
+  for (size_t i = 0; i < m_meshes.size(); i++)
+  {
+    if (m_meshes[i].bvhDirty)
+      dirtyMeshes.push_back(int32_t(i));
+  }
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < int(dirtyMeshes.size()); i++)
+  {
+    Mesh& mesh = m_meshes[dirtyMeshes[i]];
+    mesh.bvh.Build(mesh.pos4f.data(), mesh.indices.data(), int(mesh.indices.size() / 3));
+    mesh.bvhDirty = false;
+  }
+
+  if (!m_tlasDirty && dirtyMeshes.empty())
+    return;
+
+  std::vector<HydraBVH::Box3f> instBoxes(m_instances.size());
+  bool sameMeshes = dirtyMeshes.empty() && (m_tlasMeshIds.size() == m_instances.size());
+  int  validNum   = 0;
+
+  #pragma omp parallel for reduction(+:validNum)
+  for (int i = 0; i < int(m_instances.size()); i++)
+  {
+    const Instance& inst = m_instances[i];
+    const HydraBVH::Box3f meshBox = m_meshes[inst.meshId].bvh.tree.RootBox();
+    if (meshBox.empty())
+      continue;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+      const float3 p((corner & 1) ? meshBox.boxMax[0] : meshBox.boxMin[0],
+                     (corner & 2) ? meshBox.boxMax[1] : meshBox.boxMin[1],
+                     (corner & 4) ? meshBox.boxMax[2] : meshBox.boxMin[2]);
+      const float3 pw = mul(inst.matrix, p);
+      const float  pt[3] = { pw.x, pw.y, pw.z };
+      instBoxes[i].include(pt);
+    }
+    validNum++;
+  }
+
+  for (size_t i = 0; i < m_instances.size() && sameMeshes; i++)
+    sameMeshes = (m_tlasMeshIds[i] == m_instances[i].meshId);
+
+  // when only matrices were changed (animation, editor dragging) refit is enough
+  //
+  if (sameMeshes && size_t(validNum) == m_tlas.primIndices.size())
+    m_tlas.Refit(instBoxes.data());
+  else
+  {
+    m_tlas.Build(instBoxes.data(), uint32_t(instBoxes.size()), 1);
+    m_tlasMeshIds.resize(m_instances.size());
+    for (size_t i = 0; i < m_instances.size(); i++)
+      m_tlasMeshIds[i] = m_instances[i].meshId;
+  }
+  m_tlasDirty = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline RayPacket TransformPacket(const RayPacket& a_ray, const float4x4& a_m)
+{
+  RayPacket res;
+  const float4* row = a_m.row;
+
+  res.ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0].x), a_ray.ox), _mm_mul_ps(_mm_set1_ps(row[0].y), a_ray.oy)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0].z), a_ray.oz), _mm_set1_ps(row[0].w)));
+  res.oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[1].x), a_ray.ox), _mm_mul_ps(_mm_set1_ps(row[1].y), a_ray.oy)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[1].z), a_ray.oz), _mm_set1_ps(row[1].w)));
+  res.oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[2].x), a_ray.ox), _mm_mul_ps(_mm_set1_ps(row[2].y), a_ray.oy)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[2].z), a_ray.oz), _mm_set1_ps(row[2].w)));
+
+  res.dx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0].x), a_ray.dx), _mm_mul_ps(_mm_set1_ps(row[0].y), a_ray.dy)), _mm_mul_ps(_mm_set1_ps(row[0].z), a_ray.dz));
+  res.dy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[1].x), a_ray.dx), _mm_mul_ps(_mm_set1_ps(row[1].y), a_ray.dy)), _mm_mul_ps(_mm_set1_ps(row[1].z), a_ray.dz));
+  res.dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[2].x), a_ray.dx), _mm_mul_ps(_mm_set1_ps(row[2].y), a_ray.dy)), _mm_mul_ps(_mm_set1_ps(row[2].z), a_ray.dz));
+
+  InitRcp(res);
+  return res;
+}
+
+void RD_CPU_RayCast::TraceClosest(const RayPacket& a_ray, __m128 a_active, HitPacket& a_hit) const
+{
+  if (m_tlas.nodes.empty())
+    return;
+
+  TraversePacket(m_tlas.nodes.data(), a_ray, a_hit.t, a_active, [&](uint32_t a_first, uint32_t a_num)
+  {
+    for (uint32_t i = a_first; i < a_first + a_num; i++)
+    {
+      const uint32_t instId = m_tlas.primIndices[i];
+      const Instance& inst  = m_instances[instId];
+      const HydraBVH::TriangleBVH& bvh = m_meshes[inst.meshId].bvh;
+
+      const RayPacket localRay = TransformPacket(a_ray, inst.invMatrix); // t is the same in both spaces, dir is not normalized
+      const __m128i   instVec  = _mm_set1_epi32(int32_t(instId));
+
+      TraversePacket(bvh.tree.nodes.data(), localRay, a_hit.t, a_active, [&](uint32_t a_firstTri, uint32_t a_numTri)
+      {
+        for (uint32_t j = a_firstTri; j < a_firstTri + a_numTri; j++)
+        {
+          __m128 t, u, v;
+          const __m128 mask = _mm_and_ps(IntersectTriangle(localRay, &bvh.triData[j * 3], a_hit.t, &t, &u, &v), a_active);
+          if (_mm_movemask_ps(mask) == 0)
+            continue;
+
+          a_hit.t    = Select(mask, t, a_hit.t);
+          a_hit.u    = Select(mask, u, a_hit.u);
+          a_hit.v    = Select(mask, v, a_hit.v);
+          a_hit.inst = _mm_castps_si128(Select(mask, _mm_castsi128_ps(instVec), _mm_castsi128_ps(a_hit.inst)));
+          a_hit.tri  = _mm_castps_si128(Select(mask, _mm_castsi128_ps(_mm_set1_epi32(int32_t(bvh.triIndex[j]))), _mm_castsi128_ps(a_hit.tri)));
+        }
+      });
+    }
+  });
+}
+
+__m128 RD_CPU_RayCast::TraceShadow(const RayPacket& a_ray, __m128 a_active, __m128 a_tmax) const
+{
+  if (m_tlas.nodes.empty())
+    return _mm_setzero_ps();
+
+  __m128 unoccluded = a_active;
+
+  TraversePacket(m_tlas.nodes.data(), a_ray, a_tmax, unoccluded, [&](uint32_t a_first, uint32_t a_num)
+  {
+    for (uint32_t i = a_first; i < a_first + a_num && _mm_movemask_ps(unoccluded) != 0; i++)
+    {
+      const Instance& inst = m_instances[m_tlas.primIndices[i]];
+      if (inst.isLightGeom)
+        continue;
+
+      const HydraBVH::TriangleBVH& bvh = m_meshes[inst.meshId].bvh;
+      const RayPacket localRay = TransformPacket(a_ray, inst.invMatrix);
+
+      TraversePacket(bvh.tree.nodes.data(), localRay, a_tmax, unoccluded, [&](uint32_t a_firstTri, uint32_t a_numTri)
+      {
+        for (uint32_t j = a_firstTri; j < a_firstTri + a_numTri; j++)
+        {
+          __m128 t, u, v;
+          const __m128 mask = _mm_and_ps(IntersectTriangle(localRay, &bvh.triData[j * 3], a_tmax, &t, &u, &v), unoccluded);
+          unoccluded = _mm_andnot_ps(mask, unoccluded);
+          if (_mm_movemask_ps(unoccluded) == 0)
+            return;
+        }
+      });
+    }
+  });
+
+  return _mm_andnot_ps(unoccluded, a_active);
+}
+
+int32_t RD_CPU_RayCast::RemapMaterial(int32_t a_matId, int32_t a_remapId) const
+{
+  if (a_remapId < 0 || a_remapId >= int32_t(m_remapLists.size()))
+    return a_matId;
+  const auto& remapList = m_remapLists[a_remapId];
+  const auto p = remapList.find(a_matId);
+  return (p == remapList.end()) ? a_matId : p->second;
+}
+
+float3 RD_CPU_RayCast::SampleTexture(int a_texId, float2 a_texc) const
+{
+  if (a_texId < 0 || a_texId >= int(m_textures.size()) || m_textures[a_texId].data.empty())
+    return float3(1.0f, 1.0f, 1.0f);
+
+  const Texture& tex = m_textures[a_texId];
+
+  // bilinear with wrap
+  //
+  const float fx = (a_texc.x - floorf(a_texc.x))*float(tex.w) - 0.5f;
+  const float fy = (a_texc.y - floorf(a_texc.y))*float(tex.h) - 0.5f;
+  const float x0 = floorf(fx), y0 = floorf(fy);
+  const float wx = fx - x0, wy = fy - y0;
+
+  float3 res(0.0f, 0.0f, 0.0f);
+  for (int k = 0; k < 4; k++)
+  {
+    int x = int(x0) + (k & 1);
+    int y = int(y0) + (k >> 1);
+    x = (x < 0) ? x + tex.w : ((x >= tex.w) ? x - tex.w : x);
+    y = (y < 0) ? y + tex.h : ((y >= tex.h) ? y - tex.h : y);
+
+    const float  weight = ((k & 1) ? wx : 1.0f - wx)*((k >> 1) ? wy : 1.0f - wy);
+    const size_t offset = size_t(y)*size_t(tex.w) + size_t(x);
+
+    float3 texel;
+    if (tex.bpp == 4)
+    {
+      const uint8_t* pixel = tex.data.data() + offset*4;
+      texel = float3(m_srgbToLinear[pixel[0]], m_srgbToLinear[pixel[1]], m_srgbToLinear[pixel[2]]);
+    }
+    else
+    {
+      const float* pixel = (const float*)tex.data.data() + offset*4;
+      texel = float3(pixel[0], pixel[1], pixel[2]);
+    }
+    res = res + texel*weight;
+  }
+
+  return res;
+}
+
+RD_CPU_RayCast::Surface RD_CPU_RayCast::GetSurface(const HitRecord& a_hit, float3 a_rayDir) const
+{
+  const Instance& inst = m_instances[a_hit.inst];
+  const Mesh&     mesh = m_meshes[inst.meshId];
+
+  const int i0 = mesh.indices[a_hit.tri * 3 + 0];
+  const int i1 = mesh.indices[a_hit.tri * 3 + 1];
+  const int i2 = mesh.indices[a_hit.tri * 3 + 2];
+
+  const float w0 = 1.0f - a_hit.u - a_hit.v;
+  const float w1 = a_hit.u;
+  const float w2 = a_hit.v;
+
+  const float3 A(&mesh.pos4f[i0 * 4]), B(&mesh.pos4f[i1 * 4]), C(&mesh.pos4f[i2 * 4]);
+
+  float3 normObj = cross(B - A, C - A);
+  if (!mesh.norm4f.empty())
+  {
+    const float3 nA(&mesh.norm4f[i0 * 4]), nB(&mesh.norm4f[i1 * 4]), nC(&mesh.norm4f[i2 * 4]);
+    const float3 nInterp = nA*w0 + nB*w1 + nC*w2;
+    if (dot(nInterp, nInterp) > 1e-20f)
+      normObj = nInterp;
+  }
+
+  Surface surf;
+  surf.pos  = mul(inst.matrix, A*w0 + B*w1 + C*w2);
+  surf.norm = normalize(mul3x3(inst.normalMatrix, normObj));
+  if (dot(surf.norm, a_rayDir) > 0.0f) // two sided shading
+    surf.norm = surf.norm*(-1.0f);
+
+  surf.texc = float2(mesh.texcoord2f[i0 * 2 + 0]*w0 + mesh.texcoord2f[i1 * 2 + 0]*w1 + mesh.texcoord2f[i2 * 2 + 0]*w2,
+                     mesh.texcoord2f[i0 * 2 + 1]*w0 + mesh.texcoord2f[i1 * 2 + 1]*w1 + mesh.texcoord2f[i2 * 2 + 1]*w2);
+
+  surf.matId    = RemapMaterial(mesh.matIndices[a_hit.tri], inst.remapId);
+  surf.albedo   = float3(0.5f, 0.5f, 0.5f);
+  surf.emission = float3(0.0f, 0.0f, 0.0f);
+
+  if (surf.matId >= 0 && surf.matId < int32_t(m_materials.size()))
+  {
+    const Material& mat = m_materials[surf.matId];
+    surf.albedo   = mat.diffuse;
+    surf.emission = mat.emission;
+    if (mat.diffTexId >= 0)
+    {
+      const float2 texc(mat.texMatrix[0]*surf.texc.x + mat.texMatrix[1]*surf.texc.y + mat.texMatrix[2],
+                        mat.texMatrix[3]*surf.texc.x + mat.texMatrix[4]*surf.texc.y + mat.texMatrix[5]);
+      surf.albedo = surf.albedo*SampleTexture(mat.diffTexId, texc);
+    }
+  }
+
+  return surf;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RD_CPU_RayCast::MakePrimaryRay(float a_x, float a_y, float3* a_pOrigin, float3* a_pDir) const
+{
+  const float ndcX = 2.0f*a_x / float(m_width)  - 1.0f;
+  const float ndcY = 2.0f*a_y / float(m_height) - 1.0f; // y == 0 is the bottom line as in OpenGL drivers
+
+  const float4 pNear = mul(m_invViewProj, float4(ndcX, ndcY, -1.0f, 1.0f));
+  const float4 pFar  = mul(m_invViewProj, float4(ndcX, ndcY,  1.0f, 1.0f));
+
+  const float3 posNear = float3(pNear.x, pNear.y, pNear.z) / pNear.w;
+  const float3 posFar  = float3(pFar.x,  pFar.y,  pFar.z)  / pFar.w;
+
+  *a_pOrigin = m_camPerspective ? m_camEye : posNear;
+  *a_pDir    = normalize(posFar - *a_pOrigin);
+}
+
+void RD_CPU_RayCast::RenderTile(int a_tileX, int a_tileY)
+{
+  const int xBegin = a_tileX*RC_TILE_SIZE, xEnd = std::min(xBegin + RC_TILE_SIZE, m_width);
+  const int yBegin = a_tileY*RC_TILE_SIZE, yEnd = std::min(yBegin + RC_TILE_SIZE, m_height);
+
+  float* color = m_pColor->data();
+
+  for (int y = yBegin; y < yEnd; y += 2)
+  {
+    for (int x = xBegin; x < xEnd; x += 2)
+    {
+      // 2x2 pixels packet
+      //
+      alignas(16) float ox[4], oy[4], oz[4], dx[4], dy[4], dz[4];
+      alignas(16) int32_t activeI[4];
+      int px[4], py[4];
+
+      for (int k = 0; k < 4; k++)
+      {
+        px[k] = x + (k & 1);
+        py[k] = y + (k >> 1);
+        activeI[k] = (px[k] < xEnd && py[k] < yEnd) ? -1 : 0;
+
+        float3 origin, dir;
+        MakePrimaryRay(float(std::min(px[k], xEnd - 1)) + 0.5f, float(std::min(py[k], yEnd - 1)) + 0.5f, &origin, &dir);
+        ox[k] = origin.x; oy[k] = origin.y; oz[k] = origin.z;
+        dx[k] = dir.x;    dy[k] = dir.y;    dz[k] = dir.z;
+      }
+
+      RayPacket ray;
+      ray.ox = _mm_load_ps(ox); ray.oy = _mm_load_ps(oy); ray.oz = _mm_load_ps(oz);
+      ray.dx = _mm_load_ps(dx); ray.dy = _mm_load_ps(dy); ray.dz = _mm_load_ps(dz);
+      InitRcp(ray);
+
+      const __m128 active = _mm_castsi128_ps(_mm_load_si128((const __m128i*)activeI));
+
+      HitPacket hit;
+      hit.t    = _mm_set1_ps(1e30f);
+      hit.u    = _mm_setzero_ps();
+      hit.v    = _mm_setzero_ps();
+      hit.inst = _mm_set1_epi32(-1);
+      hit.tri  = _mm_set1_epi32(-1);
+
+      TraceClosest(ray, active, hit);
+
+      alignas(16) float   hitT[4], hitU[4], hitV[4];
+      alignas(16) int32_t hitInst[4], hitTri[4];
+      _mm_store_ps(hitT, hit.t);
+      _mm_store_ps(hitU, hit.u);
+      _mm_store_ps(hitV, hit.v);
+      _mm_store_si128((__m128i*)hitInst, hit.inst);
+      _mm_store_si128((__m128i*)hitTri,  hit.tri);
+
+      Surface surf[4];
+      float3  direct[4], unshadowed[4];
+      bool    haveSurf[4];
+
+      for (int k = 0; k < 4; k++)
+      {
+        haveSurf[k]   = (activeI[k] != 0) && (hitInst[k] >= 0);
+        direct[k]     = float3(0.0f, 0.0f, 0.0f);
+        unshadowed[k] = float3(0.0f, 0.0f, 0.0f);
+        if (haveSurf[k])
+        {
+          const HitRecord rec = { hitT[k], hitInst[k], hitTri[k], hitU[k], hitV[k] };
+          surf[k] = GetSurface(rec, float3(dx[k], dy[k], dz[k]));
+        }
+      }
+
+      // direct light with shadow ray packets, one packet per light instance
+      //
+      for (const auto& linst : m_lightInstances)
+      {
+        const Light& light = m_lights[linst.lightId];
+
+        alignas(16) float   sox[4], soy[4], soz[4], sdx[4], sdy[4], sdz[4], stmax[4];
+        alignas(16) int32_t sactive[4];
+        float3 irradiance[4];
+
+        for (int k = 0; k < 4; k++)
+        {
+          sactive[k] = 0;
+          sox[k] = soy[k] = soz[k] = 0.0f;
+          sdx[k] = sdy[k] = 0.0f; sdz[k] = 1.0f;
+          stmax[k] = 0.0f;
+          if (!haveSurf[k])
+            continue;
+
+          const float  eps    = 1e-4f*std::max(1.0f, std::max(fabsf(surf[k].pos.x), std::max(fabsf(surf[k].pos.y), fabsf(surf[k].pos.z))));
+          const float3 origin = surf[k].pos + surf[k].norm*eps;
+
+          float3 toLight;
+          float  tmax, scale;
+          if (light.kind == LIGHT_DIRECT)
+          {
+            toLight = linst.dir*(-1.0f);
+            tmax    = 1e30f;
+            scale   = 1.0f;
+          }
+          else
+          {
+            toLight = linst.pos - origin;
+            const float dist2 = std::max(dot(toLight, toLight), 1e-10f);
+            toLight = toLight / sqrtf(dist2);
+            tmax    = sqrtf(dist2)*(1.0f - 1e-3f);
+            scale   = 1.0f / dist2;
+
+            const float cosLight = -dot(toLight, linst.dir);
+            if (light.oneSided)
+              scale *= std::max(cosLight, 0.0f);
+            if (light.spot)
+              scale *= SmoothStep(light.cosOuter, light.cosInner, cosLight);
+          }
+
+          const float cosSurf = dot(toLight, surf[k].norm);
+          if (cosSurf <= 0.0f || scale <= 0.0f)
+            continue;
+
+          irradiance[k]  = light.intensity*(cosSurf*scale);
+          unshadowed[k]  = unshadowed[k] + irradiance[k];
+          sactive[k]     = -1;
+          sox[k] = origin.x;  soy[k] = origin.y;  soz[k] = origin.z;
+          sdx[k] = toLight.x; sdy[k] = toLight.y; sdz[k] = toLight.z;
+          stmax[k] = tmax;
+        }
+
+        const __m128 shadowActive = _mm_castsi128_ps(_mm_load_si128((const __m128i*)sactive));
+        if (_mm_movemask_ps(shadowActive) == 0)
+          continue;
+
+        RayPacket shadowRay;
+        shadowRay.ox = _mm_load_ps(sox); shadowRay.oy = _mm_load_ps(soy); shadowRay.oz = _mm_load_ps(soz);
+        shadowRay.dx = _mm_load_ps(sdx); shadowRay.dy = _mm_load_ps(sdy); shadowRay.dz = _mm_load_ps(sdz);
+        InitRcp(shadowRay);
+
+        const int occluded = _mm_movemask_ps(TraceShadow(shadowRay, shadowActive, _mm_load_ps(stmax)));
+
+        for (int k = 0; k < 4; k++)
+        {
+          if (sactive[k] != 0 && (occluded & (1 << k)) == 0)
+            direct[k] = direct[k] + irradiance[k];
+        }
+      }
+
+      for (int k = 0; k < 4; k++)
+      {
+        if (activeI[k] == 0)
+          continue;
+
+        const size_t pixelId = size_t(py[k])*size_t(m_width) + size_t(px[k]);
+        float3 res;
+        float  alpha;
+
+        if (haveSurf[k])
+        {
+          const float3 albedo = surf[k].albedo;
+          res = surf[k].emission + albedo*direct[k]*RC_INV_PI;
+          if (m_haveSky)
+            res = res + albedo*m_skyColor;
+          if (m_lightInstances.empty() && !m_haveSky) // no lights at all, use head light to see something
+            res = res + albedo*fabsf(dot(surf[k].norm, float3(dx[k], dy[k], dz[k])));
+
+          const float total = unshadowed[k].x + unshadowed[k].y + unshadowed[k].z;
+          const float lit   = direct[k].x + direct[k].y + direct[k].z;
+          m_shadow[pixelId] = (total > 0.0f) ? 1.0f - lit/total : 0.0f;
+
+          m_hits[pixelId]   = { hitT[k], hitInst[k], hitTri[k], hitU[k], hitV[k] };
+          alpha             = 1.0f;
+        }
+        else
+        {
+          res               = m_haveSky ? m_skyColor : float3(0.0f, 0.0f, 0.0f);
+          m_shadow[pixelId] = 0.0f;
+          m_hits[pixelId]   = { RC_MISS_DEPTH, -1, -1, 0.0f, 0.0f };
+          alpha             = 0.0f;
+        }
+
+        color[pixelId * 4 + 0] = res.x;
+        color[pixelId * 4 + 1] = res.y;
+        color[pixelId * 4 + 2] = res.z;
+        color[pixelId * 4 + 3] = alpha;
+      }
+    }
+  }
+}
+
+void RD_CPU_RayCast::Draw()
+{
+  if (m_width <= 0 || m_height <= 0)
+    return;
+
+  if (m_tlasDirty)
+    BuildAccelStructs();
+
+  // reduce both camera kinds to inverse view-projection
+  //
+  float4x4 view, proj;
+  if (m_camUseMatrices)
+  {
+    view = m_camWorldView;
+    proj = m_camProj;
+  }
+  else
+  {
+    const float aspect = float(m_width) / float(m_height);
+    view = transpose(lookAtTransposed(m_camPos, m_camLookAt, m_camUp));
+    proj = transpose(projectionMatrixTransposed(m_camFov, aspect, m_camNearPlane, m_camFarPlane));
+  }
+
+  m_invViewProj    = inverse4x4(mul(proj, view));
+  const float4 eye = mul(inverse4x4(view), float4(0.0f, 0.0f, 0.0f, 1.0f));
+  m_camEye         = float3(eye.x, eye.y, eye.z) / eye.w;
+  m_camPerspective = (fabsf(proj.row[3].w) < 1e-6f);
+
+  if (m_pColor->width() != m_width || m_pColor->height() != m_height)
+    m_pColor = std::make_shared<HydraRender::HDRImage4f>(m_width, m_height);
+
+  m_hits.resize(size_t(m_width)*size_t(m_height));
+  m_shadow.resize(size_t(m_width)*size_t(m_height));
+
+  const int tilesX = (m_width  + RC_TILE_SIZE - 1) / RC_TILE_SIZE;
+  const int tilesY = (m_height + RC_TILE_SIZE - 1) / RC_TILE_SIZE;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int tile = 0; tile < tilesX*tilesY; tile++)
+    RenderTile(tile % tilesX, tile / tilesX);
+}
+
+HRRenderUpdateInfo RD_CPU_RayCast::HaveUpdateNow(int /*a_maxRaysPerPixel*/)
+{
+  HRRenderUpdateInfo res;
+  res.finalUpdate  = true;
+  res.haveUpdateFB = true;
+  res.progress     = 100.0f;
+  return res;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void RD_CPU_RayCast::GetFrameBufferHDR(int32_t w, int32_t h, float* a_out, const wchar_t* a_layerName)
+{
+  if (w != m_pColor->width() || h != m_pColor->height() || a_out == nullptr)
+    return;
+
+  if (a_layerName != nullptr && std::wstring(a_layerName) != L"color")
+    return;
+
+  memcpy(a_out, m_pColor->data(), size_t(w)*size_t(h)*4*sizeof(float));
+}
+
+void RD_CPU_RayCast::GetFrameBufferLDR(int32_t w, int32_t h, int32_t* a_out)
+{
+  if (w != m_pColor->width() || h != m_pColor->height() || a_out == nullptr)
+    return;
+
+  #pragma omp parallel for
+  for (int y = 0; y < h; y++)
+    HydraSSE::ConvertLineToLDR(m_pColor->data() + size_t(y)*size_t(w)*4, w, 1.0f, 1.0f/2.2f, a_out + size_t(y)*size_t(w));
+}
+
+void RD_CPU_RayCast::GetFrameBufferLineHDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, float* a_out, const wchar_t* a_layerName)
+{
+  if (y < 0 || y >= m_pColor->height() || a_xBegin < 0 || a_xEnd > m_pColor->width() || a_xBegin >= a_xEnd)
+    return;
+
+  if (a_layerName != nullptr && std::wstring(a_layerName) != L"color")
+    return;
+
+  memcpy(a_out, m_pColor->data() + (size_t(y)*size_t(m_pColor->width()) + a_xBegin)*4, size_t(a_xEnd - a_xBegin)*4*sizeof(float));
+}
+
+void RD_CPU_RayCast::GetFrameBufferLineLDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, int32_t* a_out)
+{
+  if (y < 0 || y >= m_pColor->height() || a_xBegin < 0 || a_xEnd > m_pColor->width() || a_xBegin >= a_xEnd)
+    return;
+
+  HydraSSE::ConvertLineToLDR(m_pColor->data() + (size_t(y)*size_t(m_pColor->width()) + a_xBegin)*4, a_xEnd - a_xBegin, 1.0f, 1.0f/2.2f, a_out);
+}
+
+void RD_CPU_RayCast::GetGBufferLine(int32_t a_lineNumber, HRGBufferPixel* a_lineData, int32_t a_startX, int32_t a_endX, const std::unordered_set<int32_t>& /*a_shadowCatchers*/)
+{
+  const int width = m_pColor->width();
+  if (a_lineNumber < 0 || a_lineNumber >= m_pColor->height() || m_hits.size() != size_t(width)*size_t(m_pColor->height()))
+    return;
+
+  a_startX = std::max(a_startX, 0);
+  a_endX   = std::min(a_endX, width);
+
+  for (int32_t x = a_startX; x < a_endX; x++)
+  {
+    const size_t     pixelId = size_t(a_lineNumber)*size_t(width) + size_t(x);
+    const HitRecord& hit     = m_hits[pixelId];
+    HRGBufferPixel&  res     = a_lineData[x - a_startX];
+
+    res.shadow   = m_shadow[pixelId];
+    res.coverage = (hit.inst >= 0) ? 1.0f : 0.0f;
+    res.depth    = hit.t;
+
+    if (hit.inst < 0)
+    {
+      res.norm[0] = res.norm[1] = res.norm[2] = 0.0f;
+      res.texc[0] = res.texc[1] = 0.0f;
+      res.rgba[0] = res.rgba[1] = res.rgba[2] = res.rgba[3] = 0.0f;
+      res.matId   = -1;
+      res.objId   = -1;
+      res.instId  = -1;
+      continue;
+    }
+
+    float3 origin, dir;
+    MakePrimaryRay(float(x) + 0.5f, float(a_lineNumber) + 0.5f, &origin, &dir);
+    const Surface surf = GetSurface(hit, dir);
+
+    res.norm[0] = surf.norm.x;
+    res.norm[1] = surf.norm.y;
+    res.norm[2] = surf.norm.z;
+    res.texc[0] = surf.texc.x;
+    res.texc[1] = surf.texc.y;
+    res.rgba[0] = surf.albedo.x;
+    res.rgba[1] = surf.albedo.y;
+    res.rgba[2] = surf.albedo.z;
+    res.rgba[3] = 1.0f;
+    res.matId   = surf.matId;
+    res.objId   = m_instances[hit.inst].meshId;
+    res.instId  = m_instances[hit.inst].realInstId;
+  }
+}
+
+void RD_CPU_RayCast::GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers)
+{
+  const int width  = m_pColor->width();
+  const int height = m_pColor->height();
+  if (m_hits.size() != size_t(width)*size_t(height))
+    return;
+
+  // surface reconstruction is the expensive part; if only hit record layers are requested, take them directly from hits
+  //
+  const bool needSurface = a_planes.matId != nullptr ||
+                           a_planes.norm[0] != nullptr || a_planes.norm[1] != nullptr || a_planes.norm[2] != nullptr ||
+                           a_planes.texc[0] != nullptr || a_planes.texc[1] != nullptr ||
+                           a_planes.rgba[0] != nullptr || a_planes.rgba[1] != nullptr || a_planes.rgba[2] != nullptr || a_planes.rgba[3] != nullptr;
+
+  const int lineSize  = std::min(a_width,  width);
+  const int linesNum  = std::min(a_height, height);
+
+  #pragma omp parallel
+  {
+    std::vector<HRGBufferPixel> gbufferLine(needSurface ? lineSize : 0);
+
+    #pragma omp for
+    for (int y = 0; y < linesNum; y++)
+    {
+      const size_t outOffset = size_t(y)*size_t(a_width);
+
+      if (needSurface)
+      {
+        GetGBufferLine(y, gbufferLine.data(), 0, lineSize, a_shadowCatchers);
+        StoreGBufferLine(a_planes, outOffset, gbufferLine.data(), lineSize);
+        continue;
+      }
+
+      const HitRecord* hits   = m_hits.data()   + size_t(y)*size_t(width);
+      const float*     shadow = m_shadow.data() + size_t(y)*size_t(width);
+
+      if (a_planes.depth != nullptr)
+        for (int x = 0; x < lineSize; x++) a_planes.depth[outOffset + x] = hits[x].t;
+      if (a_planes.shadow != nullptr)
+        memcpy(a_planes.shadow + outOffset, shadow, size_t(lineSize)*sizeof(float));
+      if (a_planes.coverage != nullptr)
+        for (int x = 0; x < lineSize; x++) a_planes.coverage[outOffset + x] = (hits[x].inst >= 0) ? 1.0f : 0.0f;
+      if (a_planes.objId != nullptr)
+        for (int x = 0; x < lineSize; x++) a_planes.objId[outOffset + x] = (hits[x].inst >= 0) ? m_instances[hits[x].inst].meshId : -1;
+      if (a_planes.instId != nullptr)
+        for (int x = 0; x < lineSize; x++) a_planes.instId[outOffset + x] = (hits[x].inst >= 0) ? m_instances[hits[x].inst].realInstId : -1;
+    }
+  }
+}
+
+std::shared_ptr<HydraRender::HDRImage4f> RD_CPU_RayCast::GetFrameBufferImage(const wchar_t* a_imageName)
+{
+  if (a_imageName == nullptr || std::wstring(a_imageName) == L"color")
+    return m_pColor;
+  return nullptr;
+}
+
+IHRRenderDriver* CreateCPURayCast_RenderDriver()
+{
+  return new RD_CPU_RayCast;
+}
@@ -90,6 +90,7 @@ struct RD_HydraConnection : public IHRRenderDriver
   void GetFrameBufferLineLDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, int32_t* a_out)                           override;
 
   void GetGBufferLine(int32_t a_lineNumber, HRGBufferPixel* a_lineData, int32_t a_startX, int32_t a_endX, const std::unordered_set<int32_t>& a_shadowCatchers) override;
+  void GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers) override;
   
   void    LockFrameBufferUpdate()   override;
   void    UnlockFrameBufferUpdate() override;
@@ -1049,25 +1050,6 @@ void RD_HydraConnection::GetFrameBufferLineHDR(int32_t a_xBegin, int32_t a_xEnd,
 
 }
 
-static inline float clamp(float u, float a, float b) { float r = fmax(a, u); return fmin(r, b); }
-static inline int   clamp(int u, int a, int b) { int r = (a > u) ? a : u; return (r < b) ? r : b; }
-
-static inline int RealColorToUint32(const float real_color[4])
-{
-  float  r = clamp(real_color[0] * 255.0f, 0.0f, 255.0f);
-  float  g = clamp(real_color[1] * 255.0f, 0.0f, 255.0f);
-  float  b = clamp(real_color[2] * 255.0f, 0.0f, 255.0f);
-  float  a = clamp(real_color[3] * 255.0f, 0.0f, 255.0f);
-
-  unsigned char red   = (unsigned char)r;
-  unsigned char green = (unsigned char)g;
-  unsigned char blue  = (unsigned char)b;
-  unsigned char alpha = (unsigned char)a;
-
-  return red | (green << 8) | (blue << 16) | (alpha << 24);
-}
-
-
 void RD_HydraConnection::GetFrameBufferLineLDR(int32_t a_xBegin, int32_t a_xEnd, int32_t y, int32_t* a_out)
 {
   if (m_pSharedImage == nullptr)
@@ -1083,37 +1065,11 @@ void RD_HydraConnection::GetFrameBufferLineLDR(int32_t a_xBegin, int32_t a_xEnd,
     return;
 
   data = data + y * m_width * 4;
-  typedef HydraLiteMath::float4 float4;
-
-  const float4* dataHDR = (const float4*)data;
 
   const float invGamma  = 1.0f / 2.2f;
   const float normConst = m_enableMLT ? 1.0f : 1.0f / m_pSharedImage->Header()->spp;
 
-  // not sse version
-  //
-  if (!HydraSSE::g_useSSE)
-  {
-    for (int i = a_xBegin; i < a_xEnd; i++)  // #TODO: use sse and fast pow
-    {
-      const float4 color = dataHDR[i];
-      float color2[4];
-      color2[0] = powf(color.x*normConst, invGamma);
-      color2[1] = powf(color.y*normConst, invGamma);
-      color2[2] = powf(color.z*normConst, invGamma);
-      color2[3] = 1.0f;
-      a_out[i - a_xBegin] = RealColorToUint32(color2);
-    }
-  }
-  else // sse version
-  {
-    const __m128 powerf4 = _mm_set_ps1(invGamma);
-    const __m128 normc   = _mm_set_ps1(normConst);
-
-    for (int i = a_xBegin; i < a_xEnd; i++)  
-      a_out[i - a_xBegin] = HydraSSE::gammaCorr((const float*)(dataHDR + i), normc, powerf4);
-  }
-
+  HydraSSE::ConvertLineToLDR(data + a_xBegin*4, a_xEnd - a_xBegin, normConst, invGamma, a_out);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1235,6 +1191,175 @@ void RD_HydraConnection::GetGBufferLine(int32_t a_lineNumber, HRGBufferPixel* a_
 
 }
 
+/**
+\brief unpack 4 pixels of gbuffer to not null planes; inputs are 4 float4 per pixel (AoS), they are transposed and decoded with SSE.
+*/
+static inline void UnpackGBuffer4(const float* a_color, const float* a_data1, const float* a_data2, const __m128 a_normC,
+                                  const HRGBufferPlanes& a_planes, const size_t a_index,
+                                  const bool a_needData1, const bool a_needData2)
+{
+  const __m128  inv255  = _mm_set1_ps(1.0f / 255.0f);
+  const __m128i byteMsk = _mm_set1_epi32(0x000000FF);
+
+  if (a_needData1)
+  {
+    __m128 depth = _mm_loadu_ps(a_data1 + 0);
+    __m128 norm  = _mm_loadu_ps(a_data1 + 4);
+    __m128 mcov  = _mm_loadu_ps(a_data1 + 8);
+    __m128 rgba  = _mm_loadu_ps(a_data1 + 12);
+    _MM_TRANSPOSE4_PS(depth, norm, mcov, rgba);
+
+    if (a_planes.depth != nullptr)
+      _mm_storeu_ps(a_planes.depth + a_index, depth);
+
+    if (a_planes.norm[0] != nullptr || a_planes.norm[1] != nullptr || a_planes.norm[2] != nullptr)
+    {
+      // same as decodeNormal: x and y are 16 bit signed with the lowest bit of x as the sign of z
+      //
+      const __m128i enc    = _mm_castps_si128(norm);
+      const __m128i hiMask = _mm_set1_epi32(int(0xFFFE0000));
+      const __m128  divInv = _mm_set1_ps(1.0f / 32767.0f);
+      const __m128  nx     = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_and_si128(_mm_slli_epi32(enc, 16), hiMask), 16)), divInv);
+      const __m128  ny     = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_and_si128(enc, hiMask), 16)), divInv);
+      const __m128  zz     = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny))), _mm_setzero_ps());
+      const __m128i signZ  = _mm_slli_epi32(_mm_and_si128(enc, _mm_set1_epi32(1)), 31);
+      const __m128  nz     = _mm_xor_ps(_mm_sqrt_ps(zz), _mm_castsi128_ps(signZ));
+
+      if (a_planes.norm[0] != nullptr) _mm_storeu_ps(a_planes.norm[0] + a_index, nx);
+      if (a_planes.norm[1] != nullptr) _mm_storeu_ps(a_planes.norm[1] + a_index, ny);
+      if (a_planes.norm[2] != nullptr) _mm_storeu_ps(a_planes.norm[2] + a_index, nz);
+    }
+
+    const __m128i matCov = _mm_castps_si128(mcov);
+    if (a_planes.matId != nullptr)
+      _mm_storeu_si128((__m128i*)(a_planes.matId + a_index), _mm_and_si128(matCov, _mm_set1_epi32(0x00FFFFFF)));
+    if (a_planes.coverage != nullptr)
+      _mm_storeu_ps(a_planes.coverage + a_index, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(matCov, 24)), inv255));
+
+    const __m128i packed = _mm_castps_si128(rgba);
+    for (int k = 0; k < 4; k++)
+    {
+      if (a_planes.rgba[k] == nullptr)
+        continue;
+      const __m128i channel = _mm_and_si128(_mm_srl_epi32(packed, _mm_cvtsi32_si128(k * 8)), byteMsk);
+      _mm_storeu_ps(a_planes.rgba[k] + a_index, _mm_mul_ps(_mm_cvtepi32_ps(channel), inv255));
+    }
+  }
+
+  if (a_needData2)
+  {
+    __m128 texcU  = _mm_loadu_ps(a_data2 + 0);
+    __m128 texcV  = _mm_loadu_ps(a_data2 + 4);
+    __m128 objId  = _mm_loadu_ps(a_data2 + 8);
+    __m128 instId = _mm_loadu_ps(a_data2 + 12);
+    _MM_TRANSPOSE4_PS(texcU, texcV, objId, instId);
+
+    if (a_planes.texc[0] != nullptr) _mm_storeu_ps(a_planes.texc[0] + a_index, texcU);
+    if (a_planes.texc[1] != nullptr) _mm_storeu_ps(a_planes.texc[1] + a_index, texcV);
+    if (a_planes.objId   != nullptr) _mm_storeu_si128((__m128i*)(a_planes.objId  + a_index), _mm_castps_si128(objId));
+    if (a_planes.instId  != nullptr) _mm_storeu_si128((__m128i*)(a_planes.instId + a_index), _mm_castps_si128(instId));
+  }
+
+  if (a_planes.shadow != nullptr)
+  {
+    const __m128 shadow = _mm_set_ps(a_color[15], a_color[11], a_color[7], a_color[3]);
+    _mm_storeu_ps(a_planes.shadow + a_index, _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(shadow, a_normC)));
+  }
+}
+
+void RD_HydraConnection::GetGBuffer(int32_t a_width, int32_t a_height, const HRGBufferPlanes& a_planes, const std::unordered_set<int32_t>& a_shadowCatchers)
+{
+  if (m_pSharedImage == nullptr)
+    return;
+
+  const float* data0 = m_pSharedImage->ImageData(0);
+  const float* data1 = nullptr;
+  const float* data2 = nullptr;
+  if (m_pSharedImage->Header()->depth == 4) // same layers as in GetGBufferLine
+  {
+    data1 = m_pSharedImage->ImageData(2);
+    data2 = m_pSharedImage->ImageData(3);
+  }
+  else if (m_pSharedImage->Header()->depth == 3)
+  {
+    data1 = m_pSharedImage->ImageData(1);
+    data2 = m_pSharedImage->ImageData(2);
+  }
+  else
+    return;
+
+  const int32_t width  = std::min(a_width,  m_width);
+  const int32_t height = std::min(a_height, m_height);
+
+  const bool needData1 = a_planes.depth != nullptr || a_planes.matId != nullptr || a_planes.coverage != nullptr ||
+                         a_planes.norm[0] != nullptr || a_planes.norm[1] != nullptr || a_planes.norm[2] != nullptr ||
+                         a_planes.rgba[0] != nullptr || a_planes.rgba[1] != nullptr || a_planes.rgba[2] != nullptr || a_planes.rgba[3] != nullptr;
+  const bool needData2 = a_planes.texc[0] != nullptr || a_planes.texc[1] != nullptr || a_planes.objId != nullptr || a_planes.instId != nullptr;
+
+  const float  normC  = 1.0f / m_pSharedImage->Header()->spp;
+  const __m128 normC4 = _mm_set1_ps(normC);
+
+  // each line is unpacked to small per thread planes and then copied plane by plane;
+  // writing all big planes per pixel thrashes cache because they usually have the same alignment
+  //
+  #pragma omp parallel
+  {
+    std::vector<float>   lineFloats(12 * size_t(width) + 4);
+    std::vector<int32_t> lineInts(3 * size_t(width) + 4);
+
+    HRGBufferPlanes linePlanes;
+    auto floatPlane = [&](const float* a_dst, int a_index)   { return (a_dst == nullptr) ? nullptr : lineFloats.data() + a_index*width; };
+    auto intPlane   = [&](const int32_t* a_dst, int a_index) { return (a_dst == nullptr) ? nullptr : lineInts.data()   + a_index*width; };
+
+    linePlanes.depth    = floatPlane(a_planes.depth,    0);
+    linePlanes.shadow   = floatPlane(a_planes.shadow,   1);
+    linePlanes.coverage = floatPlane(a_planes.coverage, 2);
+    for (int k = 0; k < 3; k++) linePlanes.norm[k] = floatPlane(a_planes.norm[k], 3 + k);
+    for (int k = 0; k < 2; k++) linePlanes.texc[k] = floatPlane(a_planes.texc[k], 6 + k);
+    for (int k = 0; k < 4; k++) linePlanes.rgba[k] = floatPlane(a_planes.rgba[k], 8 + k);
+    linePlanes.matId    = intPlane(a_planes.matId,  0);
+    linePlanes.objId    = intPlane(a_planes.objId,  1);
+    linePlanes.instId   = intPlane(a_planes.instId, 2);
+
+    #pragma omp for
+    for (int32_t y = 0; y < height; y++)
+    {
+      const size_t inOffset = size_t(y)*size_t(m_width);
+
+      int32_t x = 0;
+      for (; x + 4 <= width; x += 4)
+      {
+        const size_t i = inOffset + x;
+        UnpackGBuffer4(data0 + i*4, data1 + i*4, data2 + i*4, normC4, linePlanes, x, needData1, needData2);
+      }
+
+      for (; x < width; x++)
+      {
+        const size_t   i   = inOffset + x;
+        HRGBufferPixel res = UnpackGBuffer(data1 + i*4, data2 + i*4);
+        res.shadow         = 1.0f - data0[i*4 + 3]*normC;
+        StoreGBufferPixel(linePlanes, x, res);
+      }
+
+      const size_t outOffset = size_t(y)*size_t(a_width);
+      const size_t lineBytes = size_t(width)*sizeof(float); // int32_t and float have the same size
+
+      if (a_planes.depth    != nullptr) memcpy(a_planes.depth    + outOffset, linePlanes.depth,    lineBytes);
+      if (a_planes.shadow   != nullptr) memcpy(a_planes.shadow   + outOffset, linePlanes.shadow,   lineBytes);
+      if (a_planes.coverage != nullptr) memcpy(a_planes.coverage + outOffset, linePlanes.coverage, lineBytes);
+      if (a_planes.matId    != nullptr) memcpy(a_planes.matId    + outOffset, linePlanes.matId,    lineBytes);
+      if (a_planes.objId    != nullptr) memcpy(a_planes.objId    + outOffset, linePlanes.objId,    lineBytes);
+      if (a_planes.instId   != nullptr) memcpy(a_planes.instId   + outOffset, linePlanes.instId,   lineBytes);
+      for (int k = 0; k < 3; k++)
+        if (a_planes.norm[k] != nullptr) memcpy(a_planes.norm[k] + outOffset, linePlanes.norm[k], lineBytes);
+      for (int k = 0; k < 2; k++)
+        if (a_planes.texc[k] != nullptr) memcpy(a_planes.texc[k] + outOffset, linePlanes.texc[k], lineBytes);
+      for (int k = 0; k < 4; k++)
+        if (a_planes.rgba[k] != nullptr) memcpy(a_planes.rgba[k] + outOffset, linePlanes.rgba[k], lineBytes);
+    }
+  }
+}
+
 void RD_HydraConnection::ExecuteCommand(const wchar_t* a_cmd, wchar_t* a_out)
 {
   std::string inputA = ws2s(a_cmd);
@@ -32,6 +32,8 @@ RD_OGL32_Deferred::RD_OGL32_Deferred()
   m_matricesUBOBindingPoint = 0;
   m_materialUBOBindingPoint = 1;
   m_lightUBOBindingPoint    = 2;
+
+  m_instanceMatricesVBO = 0;
 }
 
 
@@ -49,6 +51,12 @@ void RD_OGL32_Deferred::ClearAll()
   }
   m_allVBOs.clear();
 
+  if(m_instanceMatricesVBO != 0)
+    glDeleteBuffers(1, &m_instanceMatricesVBO);
+  m_instanceMatricesVBO = 0;
+
+  m_drawListBuilder.Clear();
+
   for(auto& obj : m_objects)
   {
     glDeleteVertexArrays(1, &obj.second.first);
@@ -137,6 +145,9 @@ HRDriverAllocInfo RD_OGL32_Deferred::AllocAll(HRDriverAllocInfo a_info)
   CreateMaterialsUBO(a_info.matNum);
   CreateMatricesUBO();
   CreateLightSettingsUBO();
+
+  glGenBuffers(1, &m_instanceMatricesVBO);
+  m_drawListBuilder.SetRemapLists(&m_remapLists);
   //Temporary random lights
   /*numLights = 128;
   CreateRandomLights(numLights, m_lightPos, m_lightColor);
@@ -236,6 +247,9 @@ bool RD_OGL32_Deferred::UpdateMaterial(int32_t a_matId, pugi::xml_node a_materia
   else
     m_normalTexId[a_matId] = -1;
 
+  const int32_t textures[3] = { m_diffTexId[a_matId], m_reflTexId[a_matId], m_normalTexId[a_matId] };
+  m_drawListBuilder.SetMaterialTextures(a_matId, textures, 3);
+
   struct mat
   {
     float3 diffuseColor;//16 0
@@ -300,9 +314,9 @@ bool RD_OGL32_Deferred::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode,
 {
   if (a_input.triNum == 0)
   {
+    m_drawListBuilder.SetMeshBatches(a_meshId, nullptr, 0);
     return true;
   }
-  //TODO: maybe try MultiDrawIndirect
 
   GLuint vertexPosBufferObject;
   GLuint vertexNormBufferObject;
@@ -350,9 +364,7 @@ bool RD_OGL32_Deferred::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode,
   glEnableVertexAttribArray(2);
   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-//     glBindBuffer(GL_ARRAY_BUFFER, matIDBufferObject);
-//     glEnableVertexAttribArray(4);
-//     glVertexAttribPointer(4, 1, GL_INT, GL_FALSE, 0, nullptr);
+  BindInstanceMatrices(m_instanceMatricesVBO, 4, 0);
 
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObject);
@@ -372,6 +384,15 @@ bool RD_OGL32_Deferred::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode,
 
   m_objects[a_meshId] = batchMeshData;
 
+  std::vector<HydraDrawList::DrawListBuilder::Batch> batches;
+  for (const auto& batch : batchMeshData.second)
+    batches.push_back({ batch.first, batch.second.first, batch.second.second });
+
+  float boxMin[3], boxMax[3];
+  ReadMeshBox(a_meshNode, a_input, boxMin, boxMax);
+  m_drawListBuilder.SetMeshBox(a_meshId, boxMin, boxMax);
+  m_drawListBuilder.SetMeshBatches(a_meshId, batches.data(), int32_t(batches.size()));
+
   return true;
 }
 
@@ -452,6 +473,7 @@ void RD_OGL32_Deferred::BeginScene(pugi::xml_node a_sceneNode)
 {
  // std::cout << "BeginScene" <<std::endl;
 
+  m_remapLists.clear();
   if(a_sceneNode.child(L"remap_lists") != nullptr)
   {
     for(auto listNode = a_sceneNode.child(L"remap_lists").first_child(); listNode != nullptr; listNode = listNode.next_sibling())
@@ -507,6 +529,11 @@ void RD_OGL32_Deferred::BeginScene(pugi::xml_node a_sceneNode)
   //glBufferData(GL_UNIFORM_BUFFER, 32 * sizeof(GLfloat), &matrices[0], GL_STATIC_DRAW);
   glBufferSubData(GL_UNIFORM_BUFFER, 0, 32 * sizeof(GLfloat), &matrices[0]);
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  // both matrices are transposed for OpenGL; near and far planes are not culled because of depth clamp
+  //
+  const float4x4 worldViewProj = mul(transpose4x4(projection), transpose4x4(lookAt));
+  m_drawListBuilder.BeginFrame(worldViewProj.L(), false);
 }
 
 float RD_OGL32_Deferred::DrawOneLight(int i, float4x4 &&sphModel)
@@ -646,6 +673,7 @@ void RD_OGL32_Deferred::SSAOPass() const
 
 void RD_OGL32_Deferred::EndScene()
 {
+  DrawInstances();
  
  // std::cout << "EndScene" <<std::endl;
   //SSAOPass();
@@ -692,60 +720,65 @@ void RD_OGL32_Deferred::EndScene()
 void RD_OGL32_Deferred::InstanceMeshes(int32_t a_mesh_id, const float *a_matrices, int32_t a_instNum,
                                       const int *a_lightInstId, const int* a_remapId, const int* a_realInstId)
 {
- // std::cout << "InstanceMeshes" <<std::endl;
-  auto batchMeshData = m_objects[a_mesh_id];
-  glBindVertexArray(batchMeshData.first);
-  for (int32_t i = 0; i < a_instNum; i++)
-  {
-    float modelM[16];
-    mat4x4_transpose(modelM, (float*)(a_matrices + i*16));
+  // instances are only culled and remembered here; they are drawn all at once by DrawInstances
+  //
+  m_drawListBuilder.AddInstances(a_mesh_id, a_matrices, a_instNum, a_remapId);
+}
 
-    int remapId = *(a_remapId + i);
+void RD_OGL32_Deferred::DrawInstances()
+{
+  if (!m_drawListBuilder.HaveInstances())
+    return;
 
-    m_gBufferProgram.SetUniform("model", float4x4(modelM));
-    for(auto batch : batchMeshData.second)
-    {
-      int matId = batch.first;
+  m_drawListBuilder.Build(&m_drawList);
 
-      if(remapId != -1)
-        matId = m_remapLists.at(remapId)[matId];
+  glBindBuffer(GL_ARRAY_BUFFER, m_instanceMatricesVBO);
+  glBufferData(GL_ARRAY_BUFFER, m_drawList.matrices.size() * sizeof(GLfloat), m_drawList.matrices.data(), GL_STREAM_DRAW);
 
-      if (m_diffTexId[matId] >= 0)
-      {
-        int texId = m_diffTexId[matId];
-        bindTexture(m_gBufferProgram, 0, "diffuseTex", m_texturesList[texId]);
-      }
-      else
-      {
-        bindTexture(m_gBufferProgram, 0, "diffuseTex", m_whiteTex);
-      }
+  m_gBufferProgram.SetUniform("diffuseTex", 0);
+  m_gBufferProgram.SetUniform("reflectTex", 1);
+  m_gBufferProgram.SetUniform("normalTex",  2);
+  m_gBufferProgram.SetUniform("invertNormals", true); //TODO: find a way to check meshes?
 
-      if (m_reflTexId[matId] >= 0)
-      {
-        int texId = m_reflTexId[matId];
-        bindTexture(m_gBufferProgram, 1, "reflectTex", m_texturesList[texId]);
-      }
-      else
-      {
-        bindTexture(m_gBufferProgram, 1, "reflectTex", m_whiteTex);
-      }
+  // draws are sorted by textures and material, so state is changed only when it differs from previous draw
+  //
+  GLuint  boundTex[3] = { 0, 0, 0 };
+  int32_t currMatId   = -1;
+  int32_t currMeshId  = -1;
 
-      if (m_normalTexId[matId] >= 0)
+  for (const auto& draw : m_drawList.draws)
+  {
+    if (draw.matId != currMatId)
+    {
+      const int texIds[3] = { m_diffTexId[draw.matId], m_reflTexId[draw.matId], m_normalTexId[draw.matId] };
+      for (int unit = 0; unit < 3; unit++)
       {
-        int texId = m_normalTexId[matId];
-        bindTexture(m_gBufferProgram, 2, "normalTex", m_texturesList[texId]);
+        const GLuint tex = (texIds[unit] >= 0) ? m_texturesList[texIds[unit]] : m_whiteTex;
+        if (tex != boundTex[unit])
+        {
+          glActiveTexture(GL_TEXTURE0 + unit);
+          glBindTexture(GL_TEXTURE_2D, tex);
+          boundTex[unit] = tex;
+        }
       }
+      m_gBufferProgram.SetUniform("matID", draw.matId);
+      currMatId = draw.matId;
+    }
 
-      m_gBufferProgram.SetUniform("matID", matId); 
-      m_gBufferProgram.SetUniform("invertNormals", true); //TODO: find a way to check meshes?
+    if (draw.meshId != currMeshId)
+    {
+      glBindVertexArray(m_objects[draw.meshId].first);
+      currMeshId = draw.meshId;
+    }
 
-      auto triBegin = batch.second.first;
-      auto triEnd   = batch.second.second;
-      auto indices  = 3 * int(triEnd - triBegin);
-      glDrawElements(GL_TRIANGLES, indices, GL_UNSIGNED_INT, (void*)(3 * triBegin * sizeof(GLuint)));
+    // GL 3.2 does not have base instance, so the instance attribute is moved to the first matrix of this draw
+    //
+    BindInstanceMatrices(m_instanceMatricesVBO, 4, draw.firstInstance);
 
-    }
+    const auto indices = 3 * int(draw.triEnd - draw.triBegin);
+    glDrawElementsInstanced(GL_TRIANGLES, indices, GL_UNSIGNED_INT, (void*)(3 * size_t(draw.triBegin) * sizeof(GLuint)), GLsizei(draw.instanceNum));
   }
+
   glBindVertexArray(0);
 }
 
@@ -753,6 +786,8 @@ void RD_OGL32_Deferred::InstanceMeshes(int32_t a_mesh_id, const float *a_matrice
 void RD_OGL32_Deferred::InstanceLights(int32_t a_light_id, const float *a_matrix, pugi::xml_node* a_custAttrArray,
                                        int32_t a_instNum, int32_t a_lightGroupId)
 {
+  DrawInstances(); // geometry pass must be finished before lights
+
   //m_gBufferProgram.StopUseShader();
  
   if(m_enableSSAO && m_doSSAOPass)
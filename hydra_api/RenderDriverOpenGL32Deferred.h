@@ -6,6 +6,7 @@
 
 #include "RenderDriverOpenGL32Forward.h"
 #include "OpenGLCoreProfileUtils.h"    
+#include "HydraDrawList.h"
 
 using namespace GL_RENDER_DRIVER_UTILS;
 
@@ -70,6 +71,8 @@ protected:
 
   void SSAOPass() const;
 
+  void DrawInstances();
+
   void CreateMaterialsUBO(int numMat);
   void CreateMatricesUBO();
   void CreateLightSettingsUBO();
@@ -81,6 +84,10 @@ protected:
   std::unordered_map<int32_t, meshData> m_objects; //meshId -> vao, {matId -> triBegin, triEnd}
   std::vector<GLuint> m_allVBOs;
 
+  HydraDrawList::DrawListBuilder m_drawListBuilder;    ///< culls instances and groups them to instanced draws sorted by material
+  HydraDrawList::DrawList        m_drawList;
+  GLuint                         m_instanceMatricesVBO; ///< matrices of all draws of the frame, attached to each mesh VAO with divisor 1
+
   ShaderProgram m_gBufferProgram;
   ShaderProgram m_lightPassProgram;
   ShaderProgram m_stencilProgram;
@@ -21,6 +21,8 @@ RD_OGL32_Forward::RD_OGL32_Forward()
 
   m_quad = std::make_unique<FullScreenQuad>();
   m_fullScreenTexture = std::make_unique<RenderTexture2D>(GL_RGBA, GL_RGBA32F, m_width, m_height);
+
+  m_instanceMatricesVBO = 0;
 }
 
 
@@ -31,6 +33,12 @@ void RD_OGL32_Forward::ClearAll()
   m_programs.clear();
   m_objects.clear();
 
+  if(m_instanceMatricesVBO != 0)
+    glDeleteBuffers(1, &m_instanceMatricesVBO);
+  m_instanceMatricesVBO = 0;
+
+  m_drawListBuilder.Clear();
+
 }
 
 HRDriverAllocInfo RD_OGL32_Forward::AllocAll(HRDriverAllocInfo a_info)
@@ -71,6 +79,8 @@ HRDriverAllocInfo RD_OGL32_Forward::AllocAll(HRDriverAllocInfo a_info)
 
   CreatePlaceholderWhiteTexture(m_whiteTex);
 
+  glGenBuffers(1, &m_instanceMatricesVBO);
+
   return a_info;
 }
 
@@ -140,6 +150,9 @@ bool RD_OGL32_Forward::UpdateMaterial(int32_t a_matId, pugi::xml_node a_material
   else
     m_reflTexId[a_matId] = -1;
 
+  const int32_t textures[2] = { m_diffTexId[a_matId], m_reflTexId[a_matId] };
+  m_drawListBuilder.SetMaterialTextures(a_matId, textures, 2);
+
   return true;
 }
 
@@ -154,9 +167,9 @@ bool RD_OGL32_Forward::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode, c
 
   if (a_input.triNum == 0)
   {
+    m_drawListBuilder.SetMeshBatches(a_meshId, nullptr, 0);
     return true;
   }
-  //TODO: maybe try MultiDrawIndirect
 
 
   GLuint programId = m_matProgram.GetProgram();
@@ -227,6 +240,7 @@ bool RD_OGL32_Forward::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode, c
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, 0);
 
+    BindInstanceMatrices(m_instanceMatricesVBO, 4, 0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferObject);
 
@@ -241,6 +255,17 @@ bool RD_OGL32_Forward::UpdateMesh(int32_t a_meshId, pugi::xml_node a_meshNode, c
 
   m_objects[a_meshId] = batchMeshData;
 
+  // each batch has its own index buffer, so all batch triangles start from zero
+  //
+  std::vector<HydraDrawList::DrawListBuilder::Batch> batches;
+  for (const auto& batch : batchMeshData)
+    batches.push_back({ batch.first, 0, batch.second.second / 3 });
+
+  float boxMin[3], boxMax[3];
+  ReadMeshBox(a_meshNode, a_input, boxMin, boxMax);
+  m_drawListBuilder.SetMeshBox(a_meshId, boxMin, boxMax);
+  m_drawListBuilder.SetMeshBatches(a_meshId, batches.data(), int32_t(batches.size()));
+
   return true;
 }
 
@@ -327,6 +352,9 @@ void RD_OGL32_Forward::BeginScene(pugi::xml_node a_sceneNode)
   m_matProgram.SetUniform("viewPos", eye);
   m_fullScreenTexture->StartRendering();
 
+  const float4x4 worldViewProj = mul(transpose4x4(projMatrixInv), transpose4x4(lookAtMatrix));
+  m_drawListBuilder.BeginFrame(worldViewProj.L(), true);
+
 //////Temporary hard-coded point lights
   float3 lightPos(0.0f, 10.0f, -4.0f);
   float3 lightPos2(8.0f, 10.0f, 0.0f);
@@ -351,6 +379,8 @@ void RD_OGL32_Forward::BeginScene(pugi::xml_node a_sceneNode)
 
 void RD_OGL32_Forward::EndScene()
 {
+  DrawInstances();
+
   m_matProgram.StopUseShader();
 
   m_fullScreenTexture->EndRendering();
@@ -368,50 +398,60 @@ void RD_OGL32_Forward::EndScene()
 void RD_OGL32_Forward::InstanceMeshes(int32_t a_mesh_id, const float *a_matrices, int32_t a_instNum,
                                       const int *a_lightInstId, const int* a_remapId, const int* a_realInstId)
 {
-  for (int32_t i = 0; i < a_instNum; i++)
-  {
-    float modelM[16];
-    mat4x4_transpose(modelM, (float*)(a_matrices + i*16));
+  // instances are only culled and remembered here; they are drawn all at once in EndScene
+  //
+  m_drawListBuilder.AddInstances(a_mesh_id, a_matrices, a_instNum, a_remapId);
+}
+
+void RD_OGL32_Forward::DrawInstances()
+{
+  if (!m_drawListBuilder.HaveInstances())
+    return;
 
-    m_matProgram.SetUniform("model", float4x4(modelM));
+  m_drawListBuilder.Build(&m_drawList);
 
-    for(auto batch : m_objects[a_mesh_id])
+  glBindBuffer(GL_ARRAY_BUFFER, m_instanceMatricesVBO);
+  glBufferData(GL_ARRAY_BUFFER, m_drawList.matrices.size() * sizeof(GLfloat), m_drawList.matrices.data(), GL_STREAM_DRAW);
+
+  // draws are sorted by textures and material, so state is changed only when it differs from previous draw
+  //
+  GLuint  boundTex[2] = { 0, 0 };
+  int32_t currMatId   = -1;
+
+  for (const auto& draw : m_drawList.draws)
+  {
+    if (draw.matId != currMatId)
     {
-      int matId = batch.first;
-      if (m_diffTexId[matId] >= 0)
+      const int texIds[2] = { m_diffTexId[draw.matId], m_reflTexId[draw.matId] };
+      for (int unit = 0; unit < 2; unit++)
       {
-        int texId = m_diffTexId[matId];
-        glActiveTexture(GL_TEXTURE0 + 0);
-        glBindTexture(GL_TEXTURE_2D, m_texturesList[texId]);
-      }
-      else
-      {
-        glActiveTexture(GL_TEXTURE0 + 0);
-        glBindTexture(GL_TEXTURE_2D, m_whiteTex);
+        const GLuint tex = (texIds[unit] >= 0) ? m_texturesList[texIds[unit]] : m_whiteTex;
+        if (tex != boundTex[unit])
+        {
+          glActiveTexture(GL_TEXTURE0 + unit);
+          glBindTexture(GL_TEXTURE_2D, tex);
+          boundTex[unit] = tex;
+        }
       }
 
-      if (m_diffTexId[matId] >= 0)
-      {
-        int texId = m_reflTexId[matId];
-        glActiveTexture(GL_TEXTURE0 + 1);
-        glBindTexture(GL_TEXTURE_2D, m_texturesList[texId]);
-      }
-      else
-      {
-        glActiveTexture(GL_TEXTURE0 + 1);
-        glBindTexture(GL_TEXTURE_2D, m_whiteTex);
-      }
+      m_matProgram.SetUniform("material.diffuse", m_diffColors[draw.matId]);
+      m_matProgram.SetUniform("material.reflect", m_reflColors[draw.matId]);
+      m_matProgram.SetUniform("material.shininess", m_reflGloss[draw.matId]);
+      currMatId = draw.matId;
+    }
 
-      m_matProgram.SetUniform("material.diffuse", m_diffColors[matId]);
-      m_matProgram.SetUniform("material.reflect", m_reflColors[matId]);
-      m_matProgram.SetUniform("material.shininess", m_reflGloss[matId]);
+    // this driver does not use remap lists, so draw material is always the batch material
+    //
+    glBindVertexArray(m_objects[draw.meshId][draw.matId].first);
 
-      glBindVertexArray(batch.second.first);
-      glDrawElements(GL_TRIANGLES, batch.second.second, GL_UNSIGNED_INT, nullptr);
-      glBindVertexArray(0);
-    }
+    // GL 3.2 does not have base instance, so the instance attribute is moved to the first matrix of this draw
+    //
+    BindInstanceMatrices(m_instanceMatricesVBO, 4, draw.firstInstance);
 
+    glDrawElementsInstanced(GL_TRIANGLES, 3 * (draw.triEnd - draw.triBegin), GL_UNSIGNED_INT, nullptr, GLsizei(draw.instanceNum));
   }
+
+  glBindVertexArray(0);
 }
 
 void RD_OGL32_Forward::InstanceLights(int32_t a_light_id, const float *a_matrix, pugi::xml_node* a_custAttrArray, int32_t a_instNum, int32_t a_lightGroupId)
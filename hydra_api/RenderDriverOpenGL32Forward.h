@@ -7,6 +7,7 @@
 
 #include "HydraRenderDriverAPI.h"
 #include "OpenGLCoreProfileUtils.h"
+#include "HydraDrawList.h"
 
 
 using namespace HydraLiteMath;
@@ -53,12 +54,18 @@ struct RD_OGL32_Forward : public IHRRenderDriver
 
 protected:
 
+    void DrawInstances();
+
     std::wstring m_libPath;
     std::wstring m_msg;
 
     using meshData = std::unordered_map<int, std::pair<GLuint, int>>;
 
     std::unordered_map<int32_t, meshData> m_objects; //meshId -> {matId -> vao, indicesNum}
+
+    HydraDrawList::DrawListBuilder m_drawListBuilder;
+    HydraDrawList::DrawList        m_drawList;
+    GLuint                         m_instanceMatricesVBO; ///< matrices of all draws of the frame, attached to each batch VAO with divisor 1
     std::unordered_map<std::string, ShaderProgram> m_programs;
     ShaderProgram m_quadProgram;
     ShaderProgram m_matProgram;
@@ -18,8 +18,10 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <dlfcn.h>
 
 #include <map>
+#include <algorithm>
 #include <experimental/filesystem>
 #include <iostream>
 
@@ -179,4 +181,117 @@ void hr_ofstream_open(std::ofstream& a_stream, const wchar_t* a_fileName)
   std::wstring s1(a_fileName);
   std::string  s2(s1.begin(), s1.end());
   a_stream.open(s2.c_str(), std::ios::binary);
-}
\ No newline at end of file
+}
+
+struct HRMappedFile
+{
+  HRMappedFile() : data(nullptr), size(0) {}
+  void*   data;
+  int64_t size;
+};
+
+HRMappedFile* hr_map_file(const wchar_t* a_fileName, const char** a_pData, int64_t* a_pSize)
+{
+  std::wstring s1(a_fileName);
+  std::string  s2(s1.begin(), s1.end());
+
+  const int fd = open(s2.c_str(), O_RDONLY);
+  if (fd == -1)
+    return nullptr;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0)
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // mapping holds its own reference to the file
+  if (data == MAP_FAILED)
+    return nullptr;
+
+  madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+
+  HRMappedFile* pFile = new HRMappedFile;
+  pFile->data = data;
+  pFile->size = int64_t(st.st_size);
+
+  (*a_pData) = (const char*)data;
+  (*a_pSize) = pFile->size;
+  return pFile;
+}
+
+void hr_unmap_file(HRMappedFile*& a_file)
+{
+  if (a_file == nullptr)
+    return;
+
+  munmap(a_file->data, size_t(a_file->size));
+
+  delete a_file;
+  a_file = nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::string  ws2s(const std::wstring& s);
+std::wstring s2ws(const std::string& s);
+
+struct HRSharedLibrary
+{
+  HRSharedLibrary() : handle(nullptr) {}
+  void* handle;
+};
+
+HRSharedLibrary* hr_load_library(const wchar_t* a_fileName, std::wstring* a_pErrorMsg)
+{
+  const std::string fileName = ws2s(a_fileName);
+
+  void* handle = dlopen(fileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (handle == nullptr)
+  {
+    const char* msg = dlerror();
+    if (a_pErrorMsg != nullptr)
+      (*a_pErrorMsg) = s2ws(msg == nullptr ? "unknown dlopen error" : msg);
+    return nullptr;
+  }
+
+  HRSharedLibrary* pLib = new HRSharedLibrary;
+  pLib->handle = handle;
+  return pLib;
+}
+
+void* hr_library_symbol(HRSharedLibrary* a_lib, const char* a_symbolName)
+{
+  if (a_lib == nullptr)
+    return nullptr;
+
+  return dlsym(a_lib->handle, a_symbolName);
+}
+
+void hr_free_library(HRSharedLibrary*& a_lib)
+{
+  if (a_lib == nullptr)
+    return;
+
+  dlclose(a_lib->handle);
+
+  delete a_lib;
+  a_lib = nullptr;
+}
+
+std::vector<std::wstring> hr_list_libraries(const wchar_t* a_folder)
+{
+  std::vector<std::wstring> result;
+
+  for (const auto& fileName : hr_listfiles(ws2s(a_folder)))
+  {
+    const auto dotPos = fileName.rfind(".so");
+    if (dotPos != std::string::npos && dotPos + 3 == fileName.size())
+      result.push_back(s2ws(fileName));
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
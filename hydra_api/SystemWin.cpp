@@ -7,6 +7,7 @@
 #include <sstream>
 
 #include <map>
+#include <algorithm>
 
 #ifdef WIN32
   #include <direct.h>
@@ -135,4 +136,120 @@ void hr_ifstream_open(std::ifstream& a_stream, const wchar_t* a_fileName)
 void hr_ofstream_open(std::ofstream& a_stream, const wchar_t* a_fileName)
 {
   a_stream.open(a_fileName, std::ios::binary);
-}
\ No newline at end of file
+}
+
+struct HRMappedFile
+{
+  HANDLE  file;
+  HANDLE  mapping;
+  void*   data;
+  int64_t size;
+};
+
+HRMappedFile* hr_map_file(const wchar_t* a_fileName, const char** a_pData, int64_t* a_pSize)
+{
+  HANDLE file = CreateFileW(a_fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+  {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL)
+  {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HRMappedFile* pFile = new HRMappedFile;
+  pFile->file    = file;
+  pFile->mapping = mapping;
+  pFile->data    = data;
+  pFile->size    = int64_t(fileSize.QuadPart);
+
+  (*a_pData) = (const char*)data;
+  (*a_pSize) = pFile->size;
+  return pFile;
+}
+
+void hr_unmap_file(HRMappedFile*& a_file)
+{
+  if (a_file == nullptr)
+    return;
+
+  UnmapViewOfFile(a_file->data);
+  CloseHandle(a_file->mapping);
+  CloseHandle(a_file->file);
+
+  delete a_file;
+  a_file = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct HRSharedLibrary
+{
+  HMODULE module;
+};
+
+HRSharedLibrary* hr_load_library(const wchar_t* a_fileName, std::wstring* a_pErrorMsg)
+{
+  HMODULE module = LoadLibraryW(a_fileName);
+  if (module == NULL)
+  {
+    if (a_pErrorMsg != nullptr)
+      (*a_pErrorMsg) = L"LoadLibraryW failed, GetLastError() = " + std::to_wstring(GetLastError());
+    return nullptr;
+  }
+
+  HRSharedLibrary* pLib = new HRSharedLibrary;
+  pLib->module = module;
+  return pLib;
+}
+
+void* hr_library_symbol(HRSharedLibrary* a_lib, const char* a_symbolName)
+{
+  if (a_lib == nullptr)
+    return nullptr;
+
+  return (void*)GetProcAddress(a_lib->module, a_symbolName);
+}
+
+void hr_free_library(HRSharedLibrary*& a_lib)
+{
+  if (a_lib == nullptr)
+    return;
+
+  FreeLibrary(a_lib->module);
+
+  delete a_lib;
+  a_lib = nullptr;
+}
+
+std::vector<std::wstring> hr_list_libraries(const wchar_t* a_folder)
+{
+  std::vector<std::wstring> result;
+
+  for (const auto& fileName : hr_listfiles(a_folder))
+  {
+    const auto dotPos = fileName.rfind(L".dll");
+    if (dotPos != std::wstring::npos && dotPos + 4 == fileName.size())
+      result.push_back(fileName);
+  }
+
+  std::sort(result.begin(), result.end());
+  return result;
+}
@@ -16,9 +16,14 @@
 #endif
 
 #include <cmath>
+#include <thread>
 
-static constexpr bool gDebugMode     = true;
-static constexpr bool gCopyCollector = false;
+#ifdef WIN32
+static constexpr bool gDebugMode        = true;
+#else
+static constexpr bool gDebugMode        = false; // buffer is placed in POSIX shared memory, render processes attach to it and read chunks in place
+#endif
+static constexpr int  gCollectorFreeDiv = 4;     // collector frees at least 1/4 of the buffer, so it does not run on each next allocation
 
 bool SharedVirtualBufferIsEnabled() { return (gDebugMode == false); }
 
@@ -44,11 +49,134 @@ inline uint64_t roundBlocks(uint64_t elems, int threadsPerBlock)
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void VBChunkTable::Bind(void* a_memory, size_t a_sizeInBytes, bool a_clear)
+{
+  if (a_clear)
+    memset(a_memory, 0, a_sizeInBytes); // zero bytes is a valid state for lock free atomics
 
-bool VirtualBuffer::Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::vector<int>* a_pTempBuffer, HRSystemMutex* a_mutex)
+  m_header   = (Header*)a_memory;
+  m_entries  = (Entry*)(((char*)a_memory) + sizeof(Header));
+  m_capacity = (a_sizeInBytes - sizeof(Header)) / sizeof(Entry);
+}
+
+void VBChunkTable::BeginWrite()
+{
+  if (m_header == nullptr)
+    return;
+  const uint64_t seq = m_header->sequence.load(std::memory_order_relaxed);
+  m_header->sequence.store(seq + 1, std::memory_order_relaxed); // odd, readers will retry
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void VBChunkTable::EndWrite()
+{
+  if (m_header == nullptr)
+    return;
+  const uint64_t seq = m_header->sequence.load(std::memory_order_relaxed);
+  m_header->sequence.store(seq + 1, std::memory_order_release); // even, all data written before is visible to readers
+}
+
+void VBChunkTable::SetEntry(size_t a_id, int64_t a_offset, int64_t a_size)
+{
+  if (m_header == nullptr || a_id >= m_capacity)
+    return;
+  m_entries[a_id].offset.store(a_offset, std::memory_order_relaxed);
+  m_entries[a_id].size.store(a_size, std::memory_order_relaxed);
+}
+
+void VBChunkTable::SetChunksNum(size_t a_chunksNum)
+{
+  if (m_header == nullptr)
+    return;
+  m_header->chunksNum.store(std::min(a_chunksNum, m_capacity), std::memory_order_relaxed);
+}
+
+uint64_t VBChunkTable::BeginRead(int a_maxAttempts) const
+{
+  uint64_t seq = 1;
+  for (int attempt = 0; attempt < a_maxAttempts && m_header != nullptr; attempt++)
+  {
+    seq = m_header->sequence.load(std::memory_order_acquire);
+    if (seq % 2 == 0)
+      break;
+    std::this_thread::yield(); // writer is working now
+  }
+  return seq;
+}
+
+bool VBChunkTable::EndRead(uint64_t a_seq) const
+{
+  if (m_header == nullptr || a_seq % 2 == 1)
+    return false;
+  std::atomic_thread_fence(std::memory_order_acquire); // chunk data reads must not be moved after sequence check
+  return m_header->sequence.load(std::memory_order_relaxed) == a_seq;
+}
+
+bool VBChunkTable::ReadEntries(std::vector<int64_t>& a_offsets, std::vector<int64_t>& a_sizes, int a_maxAttempts) const
+{
+  for (int attempt = 0; attempt < a_maxAttempts && m_header != nullptr; attempt++)
+  {
+    const uint64_t seq = m_header->sequence.load(std::memory_order_acquire);
+    if (seq % 2 == 1) // writer is working now
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    const size_t chunksNum = std::min(size_t(m_header->chunksNum.load(std::memory_order_relaxed)), m_capacity);
+    a_offsets.resize(chunksNum);
+    a_sizes.resize(chunksNum);
+    for (size_t i = 0; i < chunksNum; i++)
+    {
+      a_offsets[i] = m_entries[i].offset.load(std::memory_order_relaxed);
+      a_sizes[i]   = m_entries[i].size.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_header->sequence.load(std::memory_order_relaxed) == seq)
+      return true;
+  }
+
+  return false;
+}
+
+bool VBChunkTable::ReadEntry(size_t a_id, int64_t* a_pOffset, int64_t* a_pSize, int a_maxAttempts) const
+{
+  for (int attempt = 0; attempt < a_maxAttempts && m_header != nullptr; attempt++)
+  {
+    const uint64_t seq = m_header->sequence.load(std::memory_order_acquire);
+    if (seq % 2 == 1) // writer is working now
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    if (a_id >= std::min(size_t(m_header->chunksNum.load(std::memory_order_relaxed)), m_capacity))
+      return false;
+
+    (*a_pOffset) = m_entries[a_id].offset.load(std::memory_order_relaxed);
+    (*a_pSize)   = m_entries[a_id].size.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_header->sequence.load(std::memory_order_relaxed) == seq)
+      return true;
+  }
+
+  return false;
+}
+
+bool VBChunkTable::ChunkIsPublished(size_t a_id) const
+{
+  if (m_header == nullptr || a_id >= std::min(size_t(m_header->chunksNum.load(std::memory_order_acquire)), m_capacity))
+    return false;
+  return m_entries[a_id].offset.load(std::memory_order_relaxed) >= 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool VirtualBuffer::Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::vector<int>* a_pTempBuffer)
 {
-  m_pVBMutex = a_mutex;
-  
   if (a_sizeInBytes % 1024 != 0)
   {
     HrError(L"VirtualBuffer::FATAL ERROR: bad virtual buffer size");
@@ -109,6 +237,11 @@ bool VirtualBuffer::Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::v
   else
   {
     m_fileDescriptor = shm_open(a_shmemName, O_CREAT | O_RDWR | O_TRUNC, 0777);
+    if(m_fileDescriptor == -1)
+    {
+      HrError(L"VirtualBuffer::FATAL ERROR: shmem file can not be created (shm_open)");
+      return false;
+    }
     if(ftruncate(m_fileDescriptor, a_sizeInBytes) == -1)
       HrError(L"VirtualBuffer::FATAL ERROR: shmem file can not be resized (ftruncate error)");
 
@@ -127,13 +260,12 @@ bool VirtualBuffer::Init(uint64_t a_sizeInBytes, const char* a_shmemName, std::v
   }
 #endif
   
+  m_table = VBChunkTable();
   if(a_sizeInBytes > 4096) // don't init table if single page was allocated only, dummy virtual buffer.
-  {
-    m_chunkTable = (int64_t *) (((char *) m_data) + m_totalSize + VB_CHUNK_TABLE_OFFS);
-    memset(m_chunkTable, 0, VB_CHUNK_TABLE_SIZE);
-  }
+    m_table.Bind(((char*)m_data) + m_totalSize + VB_CHUNK_TABLE_OFFS, VB_CHUNK_TABLE_SIZE, true);
   
   Clear();
+  m_mappedSize  = a_sizeInBytes;
   m_pTempBuffer = a_pTempBuffer;
   m_owner       = true;
   return true;
@@ -200,60 +332,40 @@ bool VirtualBuffer::Attach(uint64_t a_sizeInBytes, const char* a_shmemName, std:
   
 #endif
   
+  m_table = VBChunkTable();
   if(a_sizeInBytes > 4096) // don't init table if single page was allocated only, dummy virtual buffer.
-  {
-    m_chunkTable = (int64_t *) (((char *) m_data) + m_totalSize + VB_CHUNK_TABLE_OFFS);
-  }
+    m_table.Bind(((char*)m_data) + m_totalSize + VB_CHUNK_TABLE_OFFS, VB_CHUNK_TABLE_SIZE, false);
   
+  m_owner       = false; // Clear must not touch table of the owner process
   Clear();
+  m_mappedSize  = a_sizeInBytes;
   m_pTempBuffer = a_pTempBuffer;
-  m_owner       = false;
   return true;
 }
 
 void VirtualBuffer::RestoreChunks()
 {
-  const int64_t* table = ChunksTablePtr();
-  if(table == nullptr)
+  if(!m_table.IsBound())
     return;
 
-  // (1) scan table to find last chunk
+  // take consistent snapshot of chunk table; chunks that are evicted later are detected in ChunkMemory
   //
-  const auto maxChunks = (VB_CHUNK_TABLE_SIZE)/sizeof(int64_t) - 2;
-
-  int chunksNum = 0;
-  int64_t chunkOffset = 1;
-  do 
+  std::vector<int64_t> offsets, sizes;
+  if(!m_table.ReadEntries(offsets, sizes, VB_READ_ATTEMPTS))
   {
-    chunksNum++;
-    chunkOffset = table[chunksNum];
-  } while(chunksNum < maxChunks && chunkOffset != 0);
+    HrPrint(HR_SEVERITY_WARNING, L"VirtualBuffer::RestoreChunks, chunk table is changed all the time, chunks will be loaded from files");
+    return;
+  }
 
-  // (2) restore chunk pointers (their localAddresses)
-  //
-  m_allChunks.resize(chunksNum);
+  m_allChunks.resize(offsets.size());
   
-  for(size_t j=0;j<m_allChunks.size()-1;j++)
+  for(size_t j=0;j<m_allChunks.size();j++)
   {
     m_allChunks[j].id           = j;
-    m_allChunks[j].localAddress = uint64_t(table[j]);
-    m_allChunks[j].sizeInBytes  = table[j+1] - table[j];
-    
-    if(m_allChunks[j].localAddress == uint64_t(-1))
-      m_allChunks[j].pVB = nullptr;
-    else
-      m_allChunks[j].pVB = this;
+    m_allChunks[j].localAddress = uint64_t(offsets[j]);
+    m_allChunks[j].sizeInBytes  = uint64_t(sizes[j]);
+    m_allChunks[j].pVB          = this;
   }
-
-  auto last = m_allChunks.size()-1;
-  
-  m_allChunks[last].id           = last;
-  m_allChunks[last].localAddress = uint64_t(table[last]);
-  m_allChunks[last].sizeInBytes  = 0;
-  if(m_allChunks[last].localAddress == uint64_t(-1))
-    m_allChunks[last].pVB = nullptr;
-  else
-    m_allChunks[last].pVB = this;
 }
 
 void VirtualBuffer::Destroy()
@@ -273,32 +385,42 @@ void VirtualBuffer::Destroy()
 #else
   if (!gDebugMode)
   {
-    munmap(m_data, m_totalSizeAllocated);
-    //if(m_owner)
-    shm_unlink(shmemName.c_str());
+    munmap(m_data, m_mappedSize);
+    if(m_owner) // attached process must not remove shmem of the owner
+      shm_unlink(shmemName.c_str());
     close(m_fileDescriptor);
   }
 #endif
 
-  m_data = nullptr;
+  m_data       = nullptr;
+  m_mappedSize = 0;
+  m_table      = VBChunkTable();
 }
 
 void VirtualBuffer::Clear()
 {
-  m_dataHalfCurr = (char*)m_data;
-  m_dataHalfFree = m_dataHalfCurr + m_totalSize/2;
+  m_dataCurr = (char*)m_data;
 
   m_currTop  = 0;
-  m_currSize = m_totalSize / 2;
+  m_currSize = m_totalSize;
   m_totalSizeAllocated = 0;
+  m_useTick  = 0;
+  m_stats    = VirtualBufferStats();
 
   m_allChunks.clear();
   m_chunksIdInMemory.clear();
+
+  if (m_owner && m_table.IsBound())
+  {
+    m_table.BeginWrite();
+    m_table.SetChunksNum(0);
+    m_table.EndWrite();
+  }
 }
 
 char* VirtualBuffer::AllocInCacheNow(uint64_t a_sizeInBytes)
 {
-  char* objectMem = m_dataHalfCurr + m_currTop;
+  char* objectMem = m_dataCurr + m_currTop;
   m_currTop            += a_sizeInBytes;
   m_totalSizeAllocated += a_sizeInBytes;
   return objectMem;
@@ -306,73 +428,26 @@ char* VirtualBuffer::AllocInCacheNow(uint64_t a_sizeInBytes)
 
 void* VirtualBuffer::AllocInCache(uint64_t a_sizeInBytes)
 {
-  const uint64_t freeSize = gCopyCollector ? (m_currSize - m_currTop) : (m_totalSize - m_currTop);
-
-  if (a_sizeInBytes < freeSize) // alloc 
-  {
+  if (a_sizeInBytes < m_totalSize - m_currTop) // alloc 
     return AllocInCacheNow(a_sizeInBytes);
-  }
-  else if (gCopyCollector)
-  {
-    const uint64_t maxAllowedSize = m_currSize - maxAccumulatedSize();
-    
-    if (a_sizeInBytes < maxAllowedSize) // swap old objects to disc and put a new object to free memory 
-    {
-      if(m_pVBMutex!=nullptr)
-        hr_lock_system_mutex(m_pVBMutex, VB_LOCK_WAIT_TIME_MS);
-      
-      RunCopyingCollector();
-      
-      int64_t* chunkTable = ChunksTablePtr(); // we need to clear table right after collector works, because old data is invalid!
-      if(chunkTable != nullptr)               // we can do better of cource here, but clearing should be enought to work corretcly
-      {
-        for(size_t i=0;i<size();i++)
-          chunkTable[i] = int64_t(-1);
-      }
-
-      if(m_pVBMutex!=nullptr)
-        hr_unlock_system_mutex(m_pVBMutex);
-      return AllocInCacheNow(a_sizeInBytes);
-    }
-    else // this object is too big. We can not allocate memory here. Need to store it on disk.
-    {
-      std::cerr << "VirtualBuffer::AllocInCache : the object is too big! gCopyCollector = " << int(gCopyCollector) << std::endl;
-      return nullptr;
-    }
-  }
-  else
-  { 
-    constexpr int div = 8;
-    const uint64_t maxAllowedSize = (m_totalSize*(div-1))/div - 1024;
-    
-    if (a_sizeInBytes < maxAllowedSize) // swap old objects to disc and put a new object to free memory 
-    {
-      if(m_pVBMutex!=nullptr)
-        hr_lock_system_mutex(m_pVBMutex, VB_LOCK_WAIT_TIME_MS);
-      
-      RunCollector(div);
   
-      int64_t* chunkTable = ChunksTablePtr(); // we need to clear table right after collector works, because old data is invalid!
-      if(chunkTable != nullptr)               // we can do better of cource here, but clearing should be enought to work corretcly
-      {
-        for(size_t i=0;i<size();i++)
-          chunkTable[i] = int64_t(-1);
-      }
-      
-      if(m_pVBMutex!=nullptr)
-        hr_unlock_system_mutex(m_pVBMutex);
-
-      return AllocInCacheNow(a_sizeInBytes);
-    }
-    else // this object is too big. We can not allocate memory here. Need to store it on disk.
-    {
-      std::cerr << "VirtualBuffer::AllocInCache : the object is too big! gCopyCollector = " << int(gCopyCollector) << std::endl;
-      return nullptr;
-    }
-    
+  if (a_sizeInBytes >= maxChunkSize()) // this object is too big. We can not allocate memory here. Need to store it on disk.
+  {
+    std::cerr << "VirtualBuffer::AllocInCache : the object is too big!" << std::endl;
+    return nullptr;
   }
 
+  // swap least recently used objects to disc and put a new object to free memory;
+  // attached processes are not locked, they see that table sequence was changed and re-read chunks
+  //
+  const bool fit = EvictLeastRecentlyUsed(a_sizeInBytes);
+  if (!fit)
+  {
+    std::cerr << "VirtualBuffer::AllocInCache : can not free memory, too many pinned chunks" << std::endl;
+    return nullptr;
+  }
 
+  return AllocInCacheNow(a_sizeInBytes);
 }
 
 void VirtualBuffer::ResizeAndAllocEmptyChunks(uint64_t a_ckunksNum)
@@ -403,11 +478,10 @@ size_t VirtualBuffer::AllocChunk(uint64_t a_dataSizeInBytes, uint64_t a_objId)
     return size_t(-1);
   }
 
-  float startCounter   = fmaxf(100.0f/fmax(log(float(a_dataSizeInBytes)), 1.0f), 0.0f); // we want small objects to be mostly in cache
-
-  result.localAddress  = ((char*)memory) - m_dataHalfCurr;
+  result.localAddress  = ((char*)memory) - m_dataCurr;
   result.sizeInBytes   = a_dataSizeInBytes;
-  result.useCounter    = (uint32_t)(startCounter*100.0f);
+  result.useCounter    = 0;
+  result.lastUse       = ++m_useTick;
   result.inUse         = true;
 
   m_chunksIdInMemory.push_back(result.id);
@@ -416,129 +490,265 @@ size_t VirtualBuffer::AllocChunk(uint64_t a_dataSizeInBytes, uint64_t a_objId)
   return result.id;
 }
 
-void VirtualBuffer::RunCopyingCollector()
+void VirtualBuffer::FreeChunk(size_t a_id)
 {
-  // (1)  we must decide wich objects we can handle in memory
-  // sort currChunksInMemory by m_allChunks[i].useCounter
-  //
-  struct CompareIds
+  if (!m_owner || a_id >= m_allChunks.size())
+    return;
+
+  ChunkPointer& chunk = m_allChunks[a_id];
+  if (!chunk.inUse || chunk.pinCounter != 0)
+    return;
+
+  if (chunk.InMemory())
   {
-    CompareIds(VirtualBuffer* a_pVB) : pVB(a_pVB) { }
-    bool operator()(size_t a, size_t b) const { return pVB->chunk_at(a).useCounter > pVB->chunk_at(b).useCounter; }
-    VirtualBuffer* pVB;
-  };
+    auto p = std::find(m_chunksIdInMemory.begin(), m_chunksIdInMemory.end(), a_id);
+    if (p != m_chunksIdInMemory.end())
+      m_chunksIdInMemory.erase(p);
 
-  std::sort(m_chunksIdInMemory.begin(), m_chunksIdInMemory.end(), CompareIds(this));
+    if (chunk.localAddress + chunk.sizeInBytes == m_currTop) // the last allocated chunk, free space right now; otherwise it is taken back by next compaction
+      m_currTop = chunk.localAddress;
+    m_totalSizeAllocated -= chunk.sizeInBytes;
+  }
 
-  std::vector<size_t> currChunksInMemory = m_chunksIdInMemory;
-  m_chunksIdInMemory.clear();
+  chunk.localAddress = uint64_t(-1);
+  chunk.inUse        = false;
 
-  // (2) sweep throught currChunksInMemory to copy half of them (i.e. half of memory they used) to secondary location
-  //
+  m_table.BeginWrite();
+  m_table.SetEntry(a_id, -1, 0);
+  m_table.EndWrite();
+}
 
-  size_t top = 0;
-  size_t curAccumulatedMemory = 0;
-  size_t maxAccumulatedMemory = maxAccumulatedSize()/2; // half of buffer size div by 4
+void VirtualBuffer::EvictChunk(size_t a_id)
+{
+  ChunkPointer& chunk = m_allChunks[a_id];
+  chunk.SwapToDisk();
+  chunk.localAddress = uint64_t(-1);
 
-  size_t i = 0;
-  for (; i < currChunksInMemory.size(); i++)
-  {
-    size_t id = currChunksInMemory[i];
-    uint64_t totalSizeInBytes = m_allChunks[id].sizeInBytes;
+  m_stats.evictions++;
+  m_stats.bytesEvicted += chunk.sizeInBytes;
+}
 
-    curAccumulatedMemory += totalSizeInBytes;
-     
-    if (curAccumulatedMemory > maxAccumulatedMemory)
-      break;
+bool VirtualBuffer::EvictLeastRecentlyUsed(uint64_t a_sizeInBytes)
+{
+  m_stats.collections++;
 
-    memcpy(m_dataHalfFree + top, 
-           m_dataHalfCurr + m_allChunks[id].localAddress, totalSizeInBytes);  // copy chunk from m_dataHalfCurr to m_dataHalfFree
+  // (1) sort chunks in memory from least to most recently used
+  //
+  std::sort(m_chunksIdInMemory.begin(), m_chunksIdInMemory.end(), 
+            [this](size_t a, size_t b) { return m_allChunks[a].lastUse < m_allChunks[b].lastUse; });
 
-    m_allChunks[id].localAddress = top;                                       // alternate it's address because now this chunk is in different location;
-    m_chunksIdInMemory.push_back(id);
-    top += totalSizeInBytes;
-  }
+  uint64_t residentSize = 0;
+  for (size_t id : m_chunksIdInMemory)
+    residentSize += m_allChunks[id].sizeInBytes;
 
-  // (3) swap other chunks to disk
+  // (2) evict unpinned chunks until new object and some free space fit
   //
-  for (; i < currChunksInMemory.size(); i++)
+  const uint64_t maxResidentSize = (m_totalSize*(gCollectorFreeDiv-1))/gCollectorFreeDiv;
+
+  std::vector<size_t> currChunksInMemory = m_chunksIdInMemory;
+  m_chunksIdInMemory.clear();
+
+  for (size_t id : currChunksInMemory)
   {
-    size_t id = currChunksInMemory[i];
-    m_allChunks[id].SwapToDisk();
-    m_allChunks[id].localAddress = uint64_t(-1);
+    if (residentSize + a_sizeInBytes > maxResidentSize && m_allChunks[id].pinCounter == 0)
+    {
+      residentSize -= m_allChunks[id].sizeInBytes;
+      EvictChunk(id);
+    }
+    else
+      m_chunksIdInMemory.push_back(id);
   }
 
+  CompactResidentChunks();
+  if (a_sizeInBytes < m_totalSize - m_currTop)
+    return true;
 
-  // (4) swap pointers
+  // (3) pinned chunks fragment the buffer too much; evict all unpinned chunks and try again
   //
-  char* temp     = m_dataHalfCurr;
-  m_dataHalfCurr = m_dataHalfFree;
-  m_dataHalfFree = temp;
-  m_currTop      = top;
+  currChunksInMemory = m_chunksIdInMemory;
+  m_chunksIdInMemory.clear();
+
+  for (size_t id : currChunksInMemory)
+  {
+    if (m_allChunks[id].pinCounter == 0)
+      EvictChunk(id);
+    else
+      m_chunksIdInMemory.push_back(id);
+  }
+
+  CompactResidentChunks();
+  return (a_sizeInBytes < m_totalSize - m_currTop);
 }
 
-void VirtualBuffer::RunCollector(int a_divisor)
+void VirtualBuffer::CompactResidentChunks()
 {
-  // (1)  we must decide wich objects we can handle in memory
-  // sort currChunksInMemory by m_allChunks[i].useCounter
+  // move chunks to the begin of the buffer in address order, so memmove never overwrites data not moved yet;
+  // pinned chunks stay at their places and next chunks are packed right after them.
   //
-  struct CompareIds
+  std::sort(m_chunksIdInMemory.begin(), m_chunksIdInMemory.end(), 
+            [this](size_t a, size_t b) { return m_allChunks[a].localAddress < m_allChunks[b].localAddress; });
+
+  m_table.BeginWrite(); // attached processes that read chunks during compaction will retry
+
+  uint64_t top = 0;
+  for (size_t id : m_chunksIdInMemory)
   {
-    CompareIds(VirtualBuffer* a_pVB) : pVB(a_pVB) { }
-    bool operator()(size_t a, size_t b) const { return pVB->chunk_at(a).useCounter > pVB->chunk_at(b).useCounter; }
-    VirtualBuffer* pVB;
-  };
+    ChunkPointer& chunk = m_allChunks[id];
+    if (chunk.pinCounter == 0 && chunk.localAddress != top)
+    {
+      memmove(m_dataCurr + top, m_dataCurr + chunk.localAddress, chunk.sizeInBytes);
+      chunk.localAddress = top;
+    }
+    top = chunk.localAddress + chunk.sizeInBytes;
+  }
 
-  std::sort(m_chunksIdInMemory.begin(), m_chunksIdInMemory.end(), CompareIds(this));
+  m_currTop = top;
 
-  std::vector<size_t> currChunksInMemory = m_chunksIdInMemory;
-  m_chunksIdInMemory.clear();
+  PublishChunks();
+  m_table.EndWrite();
+}
 
-  // (2) sweep throught currChunksInMemory to copy 1/8 of the buffer size to tempBuffer
-  //
-  size_t top = 0;
-  size_t curAccumulatedMemory = 0;
-  size_t maxAccumulatedMemory = m_totalSize / a_divisor;
+bool VirtualBuffer::CanPageIn(const ChunkPointer& a_chunk) const
+{
+  const bool compressed = (a_chunk.saveCompressed && a_chunk.type == CHUNK_TYPE_VSGF); // '.vsgfc' is lossy, it can't restore chunk data exactly
+  return m_owner && a_chunk.inUse && a_chunk.wasSaved && !compressed && a_chunk.sizeInBytes != 0 && a_chunk.sizeInBytes < maxChunkSize();
+}
 
-  if (m_pTempBuffer->size() < maxAccumulatedMemory)
-    m_pTempBuffer->resize( maxAccumulatedMemory/sizeof(int) + 1);
+bool VirtualBuffer::ChunkIsAvailable(size_t a_id) const
+{
+  if (a_id >= m_allChunks.size())
+    return false;
+
+  if (!m_owner)
+    return m_table.IsBound() && m_table.ChunkIsPublished(a_id);
 
-  char* dataTemp = (char*)m_pTempBuffer->data();
+  const ChunkPointer& chunk = m_allChunks[a_id];
+  return chunk.InMemory() || CanPageIn(chunk);
+}
 
-  size_t i = 0;
-  for (; i < currChunksInMemory.size(); i++)
+char* VirtualBuffer::PageIn(size_t a_id)
+{
+  ChunkPointer& chunk = m_allChunks[a_id];
+
+  if (!CanPageIn(chunk))
   {
-    size_t id = currChunksInMemory[i];
-    uint64_t totalSizeInBytes = m_allChunks[id].sizeInBytes;
+    m_stats.pageInFails++;
+    return nullptr;
+  }
 
-    curAccumulatedMemory += totalSizeInBytes; 
-    if (curAccumulatedMemory > maxAccumulatedMemory)
-      break;
-    
-    memcpy(dataTemp + top, m_dataHalfCurr + m_allChunks[id].localAddress, totalSizeInBytes);  // copy chunk from m_dataHalfCurr to m_dataHalfFree
-    
-    m_allChunks[id].localAddress = top; // alternate it's address because now this chunk is in different location;
-    m_chunksIdInMemory.push_back(id);
-    top += totalSizeInBytes;
+  const std::wstring name = ChunkName(chunk);
+  std::ifstream fin;
+  hr_ifstream_open(fin, name.c_str());
+
+  char* memory = fin.is_open() ? (char*)AllocInCache(chunk.sizeInBytes) : nullptr;
+  if (memory == nullptr)
+  {
+    m_stats.pageInFails++;
+    return nullptr;
   }
 
-  // (3) swap other chunks to disk
-  //
-  for (; i < currChunksInMemory.size(); i++)
+  fin.read(memory, chunk.sizeInBytes);
+  if (uint64_t(fin.gcount()) != chunk.sizeInBytes)
   {
-    size_t id = currChunksInMemory[i];
-    m_allChunks[id].SwapToDisk();
-    m_allChunks[id].localAddress = uint64_t(-1);
+    m_currTop            -= chunk.sizeInBytes; // memory was just taken from the top, give it back
+    m_totalSizeAllocated -= chunk.sizeInBytes;
+    m_stats.pageInFails++;
+    HrPrint(HR_SEVERITY_WARNING, L"VirtualBuffer::PageIn, can't read chunk file ", name);
+    return nullptr;
   }
 
-  // (4) copy chunks from tempBuffer to 
-  //
-  memcpy(m_dataHalfCurr, dataTemp, top);
+  chunk.localAddress = uint64_t(memory - m_dataCurr);
+  m_chunksIdInMemory.push_back(a_id);
 
-  if (m_pTempBuffer->size() > maxAccumulatedMemory) // free unneccesary memory of tempBuffer it it was allocated previously too much
-    (*m_pTempBuffer) = std::vector<int>();
+  m_table.BeginWrite(); // new data is placed at the top, other chunks are not damaged; publish single entry only
+  m_table.SetEntry(a_id, int64_t(chunk.localAddress), int64_t(chunk.sizeInBytes));
+  m_table.EndWrite();
 
-  m_currTop = top;
+  m_stats.bytesPagedIn += chunk.sizeInBytes;
+  return memory;
+}
+
+char* VirtualBuffer::ChunkMemory(size_t a_id)
+{
+  if (a_id >= m_allChunks.size())
+    return nullptr;
+
+  if (!m_owner) // attached process; owner may move or evict chunk at any moment, so data is read in place and checked with ReadIsValid after use
+  {
+    int64_t offset = -1, size = 0;
+    if (m_table.IsBound() && m_table.ReadEntry(a_id, &offset, &size, VB_READ_ATTEMPTS) && offset >= 0 && size > 0 && uint64_t(offset + size) <= m_totalSize)
+    {
+      m_stats.hits++;
+      return m_dataCurr + offset;
+    }
+    m_stats.misses++;
+    m_stats.pageInFails++;
+    return nullptr;
+  }
+
+  ChunkPointer& chunk = m_allChunks[a_id];
+  chunk.lastUse = ++m_useTick;
+  chunk.useCounter++;
+
+  if (chunk.InMemory())
+  {
+    m_stats.hits++;
+    return m_dataCurr + chunk.localAddress;
+  }
+
+  m_stats.misses++;
+  return PageIn(a_id);
+}
+
+void* VirtualBuffer::PinChunk(size_t a_id)
+{
+  char* memory = ChunkMemory(a_id);
+  if (memory != nullptr)
+    m_allChunks[a_id].pinCounter++;
+  return memory;
+}
+
+uint64_t VirtualBuffer::BeginRead() const
+{
+  return m_owner ? 0 : m_table.BeginRead(VB_READ_ATTEMPTS);
+}
+
+bool VirtualBuffer::ReadIsValid(uint64_t a_seq) const
+{
+  return m_owner || m_table.EndRead(a_seq);
+}
+
+void VirtualBuffer::UnpinChunk(size_t a_id)
+{
+  if (a_id < m_allChunks.size() && m_allChunks[a_id].pinCounter > 0)
+    m_allChunks[a_id].pinCounter--;
+}
+
+void VirtualBuffer::PublishChunks()
+{
+  if (!m_table.IsBound() || !m_owner)
+    return;
+
+  const size_t chunksNum = std::min(m_allChunks.size(), m_table.Capacity());
+  for (size_t i = 0; i < chunksNum; i++)
+  {
+    const auto& chunk = m_allChunks[i];
+    if (chunk.InMemory())
+      m_table.SetEntry(i, int64_t(chunk.localAddress), int64_t(chunk.sizeInBytes));
+    else
+      m_table.SetEntry(i, -1, 0);
+  }
+  m_table.SetChunksNum(chunksNum);
+}
+
+void VirtualBuffer::UpdateChunksTable()
+{
+  if (!m_owner)
+    return;
+
+  m_table.BeginWrite();
+  PublishChunks();
+  m_table.EndWrite();
 }
 
 void VirtualBuffer::FlushToDisc()
@@ -553,26 +763,16 @@ void VirtualBuffer::FlushToDisc()
 
 void* ChunkPointer::GetMemoryNow()
 {
-  if (InMemory())
-  {
-    return pVB->m_dataHalfCurr + localAddress;
-  }
-  else
-  {
-    return nullptr; // #TODO: Swap chunk to memory (m_tempBuffer) and get fucking pointer
-  }
+  if (pVB == nullptr)
+    return nullptr;
+  return pVB->ChunkMemory(size_t(id));
 }
 
 const void* ChunkPointer::GetMemoryNow() const
 {
-  if (InMemory())
-  {
-    return pVB->m_dataHalfCurr + localAddress;
-  }
-  else
-  {
-    return nullptr; // #TODO: Swap chunk to memory (m_tempBuffer) and get fucking pointer
-  }
+  if (pVB == nullptr)
+    return nullptr;
+  return pVB->ChunkMemory(size_t(id));
 }
 
 extern HRObjectManager g_objManager;
@@ -598,6 +798,7 @@ std::wstring ChunkName(const ChunkPointer& a_chunk)
   case CHUNK_TYPE_IMAGE4F:   namestream << L".image4f";  break;
   case CHUNK_TYPE_IMAGE4HF:  namestream << L".image4hf"; break;
   case CHUNK_TYPE_VSGF:      namestream << L".vsgf";     break;
+  case CHUNK_TYPE_INSTANCES: namestream << L".instances"; break;
   default:                   namestream << L".bin";      break;
   };
 
@@ -620,6 +821,7 @@ void ChunkPointer::SwapToDisk()
     return;
   
   const std::wstring name = ChunkName(*this);
+  bool saved = true;
   
   if(saveCompressed && type == CHUNK_TYPE_VSGF)
   {
@@ -637,17 +839,18 @@ void ChunkPointer::SwapToDisk()
     }
     std::string matnames = strOut.str();
     
-    HR_SaveVSGFCompressed(pVB->m_dataHalfCurr + localAddress, sizeInBytes, name2.c_str(), matnames.c_str(), matnames.size(), placeToOrigin);
+    HR_SaveVSGFCompressed(pVB->m_dataCurr + localAddress, sizeInBytes, name2.c_str(), matnames.c_str(), matnames.size(), placeToOrigin);
   }
   else
   {
     std::ofstream fout;
     hr_ofstream_open(fout, name.c_str());
-    fout.write(pVB->m_dataHalfCurr + localAddress, sizeInBytes);
+    fout.write(pVB->m_dataCurr + localAddress, sizeInBytes);
+    saved = !fout.fail(); // chunk which was not saved can't be paged in later
     fout.close();
   }
   
-  wasSaved = true;
+  wasSaved = saved;
 }
 
 
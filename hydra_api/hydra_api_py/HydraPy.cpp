@@ -246,13 +246,13 @@ std::vector<HRGBufferPixelPy> hrRenderGetGBufferLinePy(HRRenderRef a_pRender, in
 }
 
 std::vector<float> getRandomPointsOnMeshPy(HRMeshRef mesh_ref, uint32_t n_points,
-                                           bool tri_area_weighted = true, uint32_t seed = 0u)
+                                           bool tri_area_weighted = true, uint32_t seed = 0u, bool use_qmc = false)
 {
   std::vector<float> output;
   if(n_points > 0)
   {
     output.resize(n_points * 3);
-    HRUtils::getRandomPointsOnMesh(mesh_ref, output.data(), n_points, tri_area_weighted, seed);
+    HRUtils::getRandomPointsOnMesh(mesh_ref, output.data(), n_points, tri_area_weighted, seed, use_qmc);
 
   }
 
@@ -542,7 +542,7 @@ PYBIND11_MODULE(hydraPy, m)
   m.def("MergeOneTextureIntoLibrary", &HRUtils::MergeOneTextureIntoLibrary, py::arg("a_libPath"), py::arg("a_texName"), py::arg("a_texId") = -1);
 
   m.def("getRandomPointsOnMesh", &getRandomPointsOnMeshPy, py::arg("mesh_ref"), py::arg("n_points") = 1,
-        py::arg("tri_area_weighted") = false, py::arg("seed") = 0u);
+        py::arg("tri_area_weighted") = false, py::arg("seed") = 0u, py::arg("use_qmc") = false);
 
   m.def("GetMeshBBox", &HRUtils::GetMeshBBox);
 
@@ -1,5 +1,16 @@
 #include "ssemath.h"
 
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+  #define HR_TARGET_AVX2
+#else
+  #define HR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
 //// (powf4, exp2f4, log2f4): http://jrfonseca.blogspot.ru/2008/09/fast-sse2-pow-tables-or-polynomials.html 
 
 void HydraSSE::exp2_init(void)
@@ -63,3 +74,231 @@ __m128 HydraSSE::log2f4(__m128 x)
 
   return _mm_add_ps(p.m, e);
 }
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// pow(x, g) for x in [0,1] as exp2(g*log2(x)) with short polynomials; relative error is about 2e-5, 
+// that is less than 0.01 of 8 bit LDR step. log2(1+t) = t*P(t) and exp2(f) = Q(f) on [0,1) are Chebyshev interpolants.
+//
+#define LDR_LOG2_P0  1.442603894e+00f
+#define LDR_LOG2_P1 -7.167146632e-01f
+#define LDR_LOG2_P2  4.405990330e-01f
+#define LDR_LOG2_P3 -2.251030255e-01f
+#define LDR_LOG2_P4  5.866493972e-02f
+
+#define LDR_EXP2_Q0  1.000003493e+00f
+#define LDR_EXP2_Q1  6.929729222e-01f
+#define LDR_EXP2_Q2  2.416043573e-01f
+#define LDR_EXP2_Q3  5.174499776e-02f
+#define LDR_EXP2_Q4  1.367030945e-02f
+
+static inline __m128 powLDR4(__m128 x, __m128 g)
+{
+  const __m128 one      = _mm_set1_ps(1.0f);
+  const __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+
+  x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000))); // min normal float
+
+  const __m128i xi = _mm_castps_si128(x);
+  const __m128  e  = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(xi, 23), _mm_set1_epi32(127)));
+  const __m128  t  = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, _mm_set1_epi32(0x007FFFFF)), _mm_castps_si128(one))), one);
+
+  __m128 p = _mm_set1_ps(LDR_LOG2_P4);
+  p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LDR_LOG2_P3));
+  p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LDR_LOG2_P2));
+  p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LDR_LOG2_P1));
+  p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(LDR_LOG2_P0));
+
+  const __m128 y = _mm_max_ps(_mm_mul_ps(_mm_add_ps(e, _mm_mul_ps(p, t)), g), _mm_set1_ps(-126.0f));
+  const __m128 n = _mm_floor_ps(y);
+  const __m128 f = _mm_sub_ps(y, n);
+
+  __m128 q = _mm_set1_ps(LDR_EXP2_Q4);
+  q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(LDR_EXP2_Q3));
+  q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(LDR_EXP2_Q2));
+  q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(LDR_EXP2_Q1));
+  q = _mm_add_ps(_mm_mul_ps(q, f), _mm_set1_ps(LDR_EXP2_Q0));
+
+  const __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23);
+  return _mm_and_ps(positive, _mm_mul_ps(q, _mm_castsi128_ps(pow2n)));
+}
+
+static inline __m128i channelLDR4(__m128 c, __m128 normc, __m128 gamma)
+{
+  const __m128 c255 = _mm_set1_ps(255.0f);
+  c = _mm_min_ps(_mm_max_ps(_mm_mul_ps(c, normc), _mm_setzero_ps()), _mm_set1_ps(1.0f)); // NaN goes to 0
+  return _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(powLDR4(c, gamma), c255), c255));
+}
+
+void HydraSSE::ConvertLineToLDR_SSE(const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out)
+{
+  const __m128  normc = _mm_set1_ps(a_normConst);
+  const __m128  gamma = _mm_set1_ps(a_invGamma);
+  const __m128i alpha = _mm_set1_epi32(int32_t(0xFF000000));
+
+  float   tailIn [16];
+  int32_t tailOut[4];
+
+  for (int i = 0; i < a_size; i += 4)
+  {
+    const int    n  = std::min(a_size - i, 4);
+    const float* in = a_rgba + size_t(i)*4;
+    if (n < 4)
+    {
+      memset(tailIn, 0, sizeof(tailIn));
+      memcpy(tailIn, in, size_t(n)*4*sizeof(float));
+      in = tailIn;
+    }
+
+    __m128 r = _mm_loadu_ps(in + 0);
+    __m128 g = _mm_loadu_ps(in + 4);
+    __m128 b = _mm_loadu_ps(in + 8);
+    __m128 a = _mm_loadu_ps(in + 12);
+    _MM_TRANSPOSE4_PS(r, g, b, a);
+
+    const __m128i ri = channelLDR4(r, normc, gamma);
+    const __m128i gi = channelLDR4(g, normc, gamma);
+    const __m128i bi = channelLDR4(b, normc, gamma);
+    const __m128i res = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), alpha));
+
+    if (n == 4)
+      _mm_storeu_si128((__m128i*)(a_out + i), res);
+    else
+    {
+      _mm_storeu_si128((__m128i*)tailOut, res);
+      memcpy(a_out + i, tailOut, size_t(n)*sizeof(int32_t));
+    }
+  }
+}
+
+static inline HR_TARGET_AVX2 __m256 powLDR8(__m256 x, __m256 g)
+{
+  const __m256 one      = _mm256_set1_ps(1.0f);
+  const __m256 positive = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+  x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000))); // min normal float
+
+  const __m256i xi = _mm256_castps_si256(x);
+  const __m256  e  = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(xi, 23), _mm256_set1_epi32(127)));
+  const __m256  t  = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(xi, _mm256_set1_epi32(0x007FFFFF)), _mm256_castps_si256(one))), one);
+
+  __m256 p = _mm256_set1_ps(LDR_LOG2_P4);
+  p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LDR_LOG2_P3));
+  p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LDR_LOG2_P2));
+  p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LDR_LOG2_P1));
+  p = _mm256_fmadd_ps(p, t, _mm256_set1_ps(LDR_LOG2_P0));
+
+  const __m256 y = _mm256_max_ps(_mm256_mul_ps(_mm256_fmadd_ps(p, t, e), g), _mm256_set1_ps(-126.0f));
+  const __m256 n = _mm256_floor_ps(y);
+  const __m256 f = _mm256_sub_ps(y, n);
+
+  __m256 q = _mm256_set1_ps(LDR_EXP2_Q4);
+  q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(LDR_EXP2_Q3));
+  q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(LDR_EXP2_Q2));
+  q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(LDR_EXP2_Q1));
+  q = _mm256_fmadd_ps(q, f, _mm256_set1_ps(LDR_EXP2_Q0));
+
+  const __m256i pow2n = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_and_ps(positive, _mm256_mul_ps(q, _mm256_castsi256_ps(pow2n)));
+}
+
+static inline HR_TARGET_AVX2 __m256i channelLDR8(__m256 c, __m256 normc, __m256 gamma)
+{
+  const __m256 c255 = _mm256_set1_ps(255.0f);
+  c = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(c, normc), _mm256_setzero_ps()), _mm256_set1_ps(1.0f)); // NaN goes to 0
+  return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_mul_ps(powLDR8(c, gamma), c255), c255));
+}
+
+HR_TARGET_AVX2 void HydraSSE::ConvertLineToLDR_AVX2(const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out)
+{
+  const __m256  normc = _mm256_set1_ps(a_normConst);
+  const __m256  gamma = _mm256_set1_ps(a_invGamma);
+  const __m256i alpha = _mm256_set1_epi32(int32_t(0xFF000000));
+
+  float   tailIn [32];
+  int32_t tailOut[8];
+
+  for (int i = 0; i < a_size; i += 8)
+  {
+    const int    n  = std::min(a_size - i, 8);
+    const float* in = a_rgba + size_t(i)*4;
+    if (n < 8)
+    {
+      memset(tailIn, 0, sizeof(tailIn));
+      memcpy(tailIn, in, size_t(n)*4*sizeof(float));
+      in = tailIn;
+    }
+
+    // pixels (k, k+4) in 128 bit lanes of vk, so in-lane transpose gives pixels in order
+    //
+    const __m256 v0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 0)),  _mm_loadu_ps(in + 16), 1);
+    const __m256 v1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 4)),  _mm_loadu_ps(in + 20), 1);
+    const __m256 v2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 8)),  _mm_loadu_ps(in + 24), 1);
+    const __m256 v3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(in + 12)), _mm_loadu_ps(in + 28), 1);
+
+    const __m256 t0 = _mm256_unpacklo_ps(v0, v1); // r0 r1 g0 g1
+    const __m256 t1 = _mm256_unpacklo_ps(v2, v3); // r2 r3 g2 g3
+    const __m256 t2 = _mm256_unpackhi_ps(v0, v1); // b0 b1 a0 a1
+    const __m256 t3 = _mm256_unpackhi_ps(v2, v3); // b2 b3 a2 a3
+
+    const __m256 r  = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 g  = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 b  = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+
+    const __m256i ri  = channelLDR8(r, normc, gamma);
+    const __m256i gi  = channelLDR8(g, normc, gamma);
+    const __m256i bi  = channelLDR8(b, normc, gamma);
+    const __m256i res = _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 8)), _mm256_or_si256(_mm256_slli_epi32(bi, 16), alpha));
+
+    if (n == 8)
+      _mm256_storeu_si256((__m256i*)(a_out + i), res);
+    else
+    {
+      _mm256_storeu_si256((__m256i*)tailOut, res);
+      memcpy(a_out + i, tailOut, size_t(n)*sizeof(int32_t));
+    }
+  }
+}
+
+void HydraSSE::ConvertLineToLDRScalar(const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out)
+{
+  for (int i = 0; i < a_size; i++)
+  {
+    uint32_t res = 0xFF000000;
+    for (int c = 0; c < 3; c++)
+    {
+      const float v = fminf(fmaxf(a_rgba[i*4 + c]*a_normConst, 0.0f), 1.0f);
+      res |= uint32_t(powf(v, a_invGamma)*255.0f + 0.5f) << (8*c);
+    }
+    a_out[i] = int32_t(res);
+  }
+}
+
+bool HydraSSE::CPUHasAVX2()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  __cpuid(info, 1);
+  const bool osUsesXSave = (info[2] & (1 << 27)) != 0;
+  const bool hasFMA      = (info[2] & (1 << 12)) != 0;
+  if (!osUsesXSave || !hasFMA || (_xgetbv(0) & 6) != 6) // OS saves xmm and ymm registers
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+void HydraSSE::ConvertLineToLDR(const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out)
+{
+  typedef void (*PCONVERTLDR_T)(const float*, int, float, float, int32_t*);
+  static const PCONVERTLDR_T convert = CPUHasAVX2() ? &ConvertLineToLDR_AVX2 : &ConvertLineToLDR_SSE;
+  convert(a_rgba, a_size, a_normConst, a_invGamma, a_out);
+}
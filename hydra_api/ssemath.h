@@ -20,8 +20,6 @@
 
 namespace HydraSSE
 {
-  constexpr bool g_useSSE = true;
-
   /* 2 ^ x, for x in [-1.0, 1.0) */
   static float exp2_table[2 * EXP2_TABLE_SIZE];
   /* log2(x), for x in [1.0, 2.0) */
@@ -50,12 +48,113 @@ namespace HydraSSE
   __m128 exp2f4(__m128 x);
   __m128 log2f4(__m128 x);
 
+  /**
+  \brief polynomial approximation to exp(x) (cephes expf); does not need exp2_init(); relative error is about 2e-7.
+  Inputs below -87 flush to zero.
+  */
+  static inline __m128 expf4(__m128 x)
+  {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tooSmall = _mm_cmplt_ps(x, _mm_set1_ps(-87.0f));
+
+    x = _mm_min_ps(x, _mm_set1_ps( 88.3762626647949f));
+    x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+
+    /* x = n*ln(2) + r, |r| <= ln(2)/2 */
+    const __m128 n = _mm_floor_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(-2.12194440e-4f)));
+
+    __m128 y = _mm_set1_ps(1.9875691500E-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507E-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073E-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894E-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(x, x)), _mm_add_ps(x, one));
+
+    /* y *= 2^n */
+    const __m128i pow2n = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+    y = _mm_mul_ps(y, _mm_castsi128_ps(pow2n));
+
+    return _mm_andnot_ps(tooSmall, y);
+  }
+
+  /**
+  \brief polynomial approximation to natural log(x) (cephes logf); relative error is about 2e-7. x must be positive.
+  */
+  static inline __m128 logf4(__m128 x)
+  {
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000))); // min normal float
+
+    /* x = m*2^e, m in [0.5, 1) */
+    const __m128i emm0 = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(x), 23), _mm_set1_epi32(0x7f));
+    x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+    x = _mm_or_ps (x, _mm_set1_ps(0.5f));
+
+    __m128 e = _mm_add_ps(_mm_cvtepi32_ps(emm0), one);
+
+    const __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+    const __m128 tmp  = _mm_and_ps(x, mask);
+    x = _mm_sub_ps(x, one);
+    e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+    x = _mm_add_ps(x, tmp);
+
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(7.0376836292E-2f);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps( 1.1676998740E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps( 1.4249322787E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps( 2.0000714765E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993E-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps( 3.3333331174E-1f));
+    y = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    x = _mm_add_ps(x, y);
+    return _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+  }
+
+  /**
+  \brief pow(x,y) = exp(y*log(x)) via expf4/logf4; unlike powf4 it does not need lookup tables. Returns 0 where x <= 0.
+  */
+  static inline __m128 powf4p(__m128 x, __m128 y)
+  {
+    const __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+    return _mm_and_ps(positive, expf4(_mm_mul_ps(y, logf4(x))));
+  }
+
 
   static inline __m128 powf4(__m128 x, __m128 y)
   {
     return exp2f4(_mm_mul_ps(log2f4(x),y));
   }
 
+  /**
+  \brief convert line of float4 pixels to packed RGBA8 (red in low byte), the format of IHRRenderDriver::GetFrameBufferLDR.
+  \param a_rgba      - input pixels, a_size*4 floats, alignment is not required
+  \param a_size      - pixels number
+  \param a_normConst - normalisation constant; will be multiplied with read color
+  \param a_invGamma  - inverse gamma (usually 1.0f/2.2f), must be positive
+  \param a_out       - output pixels
+
+  channel = round(255*pow(clamp(color*a_normConst, 0, 1), a_invGamma)); alpha is always 255.
+  Uses AVX2 kernel (8 pixels per iteration) if CPU supports it and SSE4.1 kernel (4 pixels per iteration) otherwise.
+  Both differ from ConvertLineToLDRScalar (powf) by at most 1 for values close to rounding boundary.
+  */
+  void ConvertLineToLDR      (const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out);
+  void ConvertLineToLDRScalar(const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out);
+  void ConvertLineToLDR_SSE  (const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out);
+  void ConvertLineToLDR_AVX2 (const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out); ///< call only if CPUHasAVX2()
+
+  bool CPUHasAVX2(); ///< runtime check for AVX2 and FMA support by both CPU and OS
+
   // those are is self-implemented
   //
   static const __m128 const_255 = {255.0f,255.0f,255.0f,255.0f};
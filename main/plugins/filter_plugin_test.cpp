@@ -0,0 +1,71 @@
+// minimal post processing plugin for test_525 (see hrFilterLoadPlugins);
+// the same source is built 3 times: valid plugin, plugin with unsupported ABI version (TEST_PLUGIN_BAD_ABI) and library without entry points (TEST_PLUGIN_NO_ENTRY)
+//
+#include "../../hydra_api/HydraPostProcessCommon.h"
+
+#include <cwchar>
+
+#ifdef WIN32
+  #define TEST_PLUGIN_EXPORT __declspec(dllexport)
+#else
+  #define TEST_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifndef TEST_PLUGIN_NO_ENTRY
+
+static const HRFilterImageView* FindArg(const wchar_t* a_name, const HRFilterImageView* a_args, int32_t a_argsNum)
+{
+  for (int32_t i = 0; i < a_argsNum; i++)
+  {
+    if (a_args[i].name != nullptr && std::wcscmp(a_args[i].name, a_name) == 0)
+      return a_args + i;
+  }
+  return nullptr;
+}
+
+/**
+\brief "test_plugin_invert": out_color = 1 - in_color, both images must be HDR and have the same size.
+*/
+static int32_t TestPluginEval(const wchar_t* a_filterName, const HRFilterImageView* a_args, int32_t a_argsNum,
+                              const wchar_t* a_settingsXmlStr, wchar_t* a_msg, int32_t a_msgSize)
+{
+  const HRFilterImageView* pIn  = FindArg(L"in_color",  a_args, a_argsNum);
+  const HRFilterImageView* pOut = FindArg(L"out_color", a_args, a_argsNum);
+
+  if (std::wcscmp(a_filterName, L"test_plugin_invert") != 0 || pIn == nullptr || pOut == nullptr || pIn->bpp != 16 || pOut->bpp != 16 ||
+      pIn->width != pOut->width || pIn->height != pOut->height)
+  {
+    std::swprintf(a_msg, size_t(a_msgSize), L"test_plugin_invert: bad arguments");
+    return HR_FILTER_ERROR;
+  }
+
+  const float* in  = (const float*)pIn->data;
+  float*       out = (float*)pOut->data;
+
+  for (int32_t y = 0; y < pIn->height; y++)
+  {
+    for (int32_t x = 0; x < pIn->width*4; x++)
+      out[y*pOut->pitch*4 + x] = 1.0f - in[y*pIn->pitch*4 + x];
+  }
+
+  return HR_FILTER_OK;
+}
+
+static const wchar_t* const g_filterNames[] = { L"test_plugin_invert" };
+
+#ifdef TEST_PLUGIN_BAD_ABI
+static const HRFilterPluginInfo g_pluginInfo = { HR_FILTER_PLUGIN_ABI_VERSION + 1000, 1, g_filterNames, &TestPluginEval };
+#else
+static const HRFilterPluginInfo g_pluginInfo = { HR_FILTER_PLUGIN_ABI_VERSION,        1, g_filterNames, &TestPluginEval };
+#endif
+
+extern "C" TEST_PLUGIN_EXPORT const HRFilterPluginInfo* hrGetFilterPluginInfo()
+{
+  return &g_pluginInfo;
+}
+
+#else
+
+extern "C" TEST_PLUGIN_EXPORT int hrTestPluginDummy() { return 0; }
+
+#endif
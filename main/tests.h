@@ -402,6 +402,35 @@ namespace ALGR_TESTS
   bool test_406_env_glass_ball_caustic();
 }
 
+namespace PERF_TESTS
+{
+  bool test_501_commit_latency_vs_instances();
+  bool test_502_binary_instance_table();
+  bool test_503_weld_vertices();
+  bool test_504_mapped_mesh_files();
+  bool test_505_mesh_upload_pipeline();
+  bool test_506_texture_upload_pipeline();
+  bool test_507_virtual_buffer_lru_cache();
+  bool test_508_chunk_table_seqlock();
+  bool test_509_find_by_name_index();
+  bool test_510_streaming_change_log();
+  bool test_511_parallel_library_load();
+  bool test_512_numeric_parse_format();
+  bool test_513_displacement_dedup();
+  bool test_514_subdivision_adjacency();
+  bool test_515_nlm_fast();
+  bool test_516_image_filters_mt();
+  bool test_517_post_process_hydra1();
+  bool test_518_filter_graph();
+  bool test_519_ldr_conversion();
+  bool test_520_mesh_sampling();
+  bool test_521_cpu_raycast_driver();
+  bool test_522_scene_spatial_queries();
+  bool test_523_gbuffer_planes();
+  bool test_524_draw_list_cull_sort();
+  bool test_525_filter_plugins();
+}
+
 //These tests need some scene library to exist in their respective folders
 bool test1000_loadlibrary_and_edit();
 bool test1001_loadlibrary_and_add_textures();
@@ -440,6 +469,7 @@ void run_all_mtl_tests(int a_start = 0);
 void run_all_lgt_tests(int a_start = 0);
 void run_all_alg_tests(int a_start = 0);
 void run_all_ipp_tests(int a_start = 0);
+void run_all_perf_tests(int a_start = 0);
 void terminate_opengl();
 
 static const int CURR_RENDER_DEVICE = 0;
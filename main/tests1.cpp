@@ -2051,6 +2051,67 @@ void run_all_alg_tests(int a_start)
   
 }
 
+void run_all_perf_tests(int a_start)
+{
+  using namespace PERF_TESTS;
+  TestFunc tests[] = { &test_501_commit_latency_vs_instances,
+                       &test_502_binary_instance_table,
+                       &test_503_weld_vertices,
+                       &test_504_mapped_mesh_files,
+                       &test_505_mesh_upload_pipeline,
+                       &test_506_texture_upload_pipeline,
+                       &test_507_virtual_buffer_lru_cache,
+                       &test_508_chunk_table_seqlock,
+                       &test_509_find_by_name_index,
+                       &test_510_streaming_change_log,
+                       &test_511_parallel_library_load,
+                       &test_512_numeric_parse_format,
+                       &test_513_displacement_dedup,
+                       &test_514_subdivision_adjacency,
+                       &test_515_nlm_fast,
+                       &test_516_image_filters_mt,
+                       &test_517_post_process_hydra1,
+                       &test_518_filter_graph,
+                       &test_519_ldr_conversion,
+                       &test_520_mesh_sampling,
+                       &test_521_cpu_raycast_driver,
+                       &test_522_scene_spatial_queries,
+                       &test_523_gbuffer_planes,
+                       &test_524_draw_list_cull_sort,
+                       &test_525_filter_plugins,
+  };
+
+  std::ofstream fout("z_test_perf.txt");
+
+  const int testNum = sizeof(tests) / sizeof(TestFunc);
+
+  for (int i = a_start; i < testNum; i++)
+  {
+    bool res = tests[i]();
+    if (res)
+    {
+      std::cout          << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tPASSED!\t\n";
+      fout << std::fixed << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tPASSED!\t\n";
+    }
+    else if (g_testWasIgnored)
+    {
+      std::cout          << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tSKIPPED!\t\n";
+      fout << std::fixed << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tSKIPPED!\t\n";
+    }
+    else
+    {
+      std::cout          << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tFAILED!\t\n";
+      fout << std::fixed << "perf_test_" << std::setfill('0') << std::setw(3) << 500 + i + 1 << "\tFAILED!\t\n";
+    }
+
+    fout.flush();
+
+    g_testWasIgnored = false;
+  }
+
+  fout.close();
+}
+
 void run_all_mictofacet()
 {
   using namespace LGHT_TESTS;
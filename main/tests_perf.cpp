@@ -0,0 +1,3422 @@
+#include "tests.h"
+#include <iomanip>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "mesh_utils.h"
+
+#include "../hydra_api/HydraRenderDriverAPI.h"
+#include "../hydra_api/HydraInternal.h"
+#include "../hydra_api/HydraXMLHelpers.h"
+#include "../hydra_api/HR_HDRImage.h"
+#include "../hydra_api/HydraPostProcessAPI.h"
+#include "../hydra_api/ssemath.h"
+#include "../hydra_api/HydraDrawList.h"
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#pragma warning(disable:4996)
+#pragma warning(disable:4244)
+
+using namespace TEST_UTILS;
+
+extern bool g_testWasIgnored;
+
+// NLM denoiser entry points (hydra_api/NonLocalMeans.cpp)
+//
+void NonLocalMeansGuidedTexNormDepthFilter(const HydraRender::HDRImage4f& inImage, const HydraRender::HDRImage4f& inTexColor, const HydraRender::HDRImage4f& inNormDepth,
+                                           HydraRender::HDRImage4f& outImage, int a_windowRadius, int a_blockRadius, float a_noiseLevel);
+
+void NonLocalMeansGuidedTexNormDepthFilterFast(const HydraRender::HDRImage4f& inImage, const HydraRender::HDRImage4f& inTexColor, const HydraRender::HDRImage4f& inNormDepth,
+                                               HydraRender::HDRImage4f& outImage, int a_windowRadius, int a_blockRadius, float a_noiseLevel);
+
+namespace PERF_TESTS
+{
+  /**
+  \brief render driver that does nothing except counting instances; it allows to measure the cost of HydraAPI itself.
+  */
+  struct RD_NullCounter : public IHRRenderDriver
+  {
+    RD_NullCounter() : instancesNum(0), meshInstanceCalls(0), matricesSum(0.0), meshDataSum(0.0), imageDataSum(0.0) {}
+
+    void              ClearAll() override {}
+    HRDriverAllocInfo AllocAll(HRDriverAllocInfo a_info) override { return a_info; }
+
+    bool UpdateImage(int32_t a_texId, int32_t w, int32_t h, int32_t bpp, const void* a_data, pugi::xml_node /*a_texNode*/) override
+    {
+      const int32_t* data = (const int32_t*)a_data;
+      if (data != nullptr && w > 0 && h > 0)
+      {
+        for (int64_t i = 0; i < int64_t(w)*int64_t(h)*int64_t(bpp/4); i++)
+          imageDataSum += double(data[i]);
+      }
+      imageIds.push_back(a_texId);
+      return true;
+    }
+    bool UpdateMaterial(int32_t /*a_matId*/, pugi::xml_node /*a_materialNode*/) override { return true; }
+    bool UpdateLight(int32_t /*a_lightId*/, pugi::xml_node /*a_lightNode*/) override { return true; }
+    bool UpdateMesh(int32_t a_meshId, pugi::xml_node /*a_meshNode*/, const HRMeshDriverInput& a_input, const HRBatchInfo* /*a_batchList*/, int32_t /*listSize*/) override
+    {
+      double posSum = 0.0;
+      for (int32_t i = 0; i < a_input.vertNum*4; i++)
+        posSum += double(a_input.pos4f[i]);
+      for (int32_t i = 0; i < a_input.triNum*3; i++)
+        meshDataSum += double(a_input.indices[i]);
+      meshDataSum += posSum;
+
+      meshIds.push_back(a_meshId);
+      meshInfo.push_back(float3(float(a_input.vertNum), float(a_input.triNum), float(posSum)));
+      return true;
+    }
+
+    bool UpdateImageFromFile(int32_t /*a_texId*/, const wchar_t* /*a_fileName*/, pugi::xml_node /*a_texNode*/) override { return false; }
+    bool UpdateMeshFromFile(int32_t /*a_meshId*/, pugi::xml_node /*a_meshNode*/, const wchar_t* /*a_fileName*/) override { return false; }
+
+    bool UpdateCamera(pugi::xml_node /*a_camNode*/) override { return true; }
+    bool UpdateSettings(pugi::xml_node /*a_settingsNode*/) override { return true; }
+
+    void BeginScene(pugi::xml_node /*a_sceneNode*/) override { instancesNum = 0; matricesSum = 0.0; }
+    void EndScene() override {}
+    void InstanceMeshes(int32_t /*a_mesh_id*/, const float* a_matrices, int32_t a_instNum, const int* /*a_lightInstId*/, const int* /*a_remapId*/, const int* /*a_realInstId*/) override
+    {
+      instancesNum += a_instNum;
+      meshInstanceCalls++;
+      for (int32_t i = 0; i < a_instNum*16; i++)
+        matricesSum += double(a_matrices[i]);
+    }
+    void InstanceLights(int32_t /*a_light_id*/, const float* /*a_matrix*/, pugi::xml_node* /*a_custAttrArray*/, int32_t /*a_instNum*/, int32_t /*a_lightGroupId*/) override {}
+
+    void Draw() override {}
+
+    HRRenderUpdateInfo HaveUpdateNow(int /*a_maxRaysPerPixel*/) override { HRRenderUpdateInfo res; res.haveUpdateFB = true; res.progress = 100.0f; return res; }
+
+    void GetFrameBufferHDR(int32_t /*w*/, int32_t /*h*/, float*   /*a_out*/, const wchar_t* /*a_layerName*/) override {}
+    void GetFrameBufferLDR(int32_t /*w*/, int32_t /*h*/, int32_t* /*a_out*/) override {}
+
+    void GetGBufferLine(int32_t /*a_lineNumber*/, HRGBufferPixel* /*a_lineData*/, int32_t /*a_startX*/, int32_t /*a_endX*/, const std::unordered_set<int32_t>& /*a_shadowCatchers*/) override {}
+
+    HRDriverInfo Info() override { HRDriverInfo info; info.memTotal = int64_t(8) * int64_t(1024 * 1024 * 1024); return info; }
+    const HRRenderDeviceInfoListElem* DeviceList() const override { return nullptr; }
+    bool EnableDevice(int32_t /*id*/, bool /*a_enable*/) override { return true; }
+
+    int64_t instancesNum;
+    int64_t meshInstanceCalls;
+    double  matricesSum;
+    double  meshDataSum;
+    std::vector<int32_t> meshIds;  ///< in order of UpdateMesh calls
+    std::vector<float3>  meshInfo; ///< (vertNum, triNum, sum of positions) for each UpdateMesh call
+    double               imageDataSum;
+    std::vector<int32_t> imageIds; ///< in order of UpdateImage calls
+  };
+
+  static float ElapsedMs(std::chrono::high_resolution_clock::time_point a_timeBeg)
+  {
+    auto timeEnd = std::chrono::high_resolution_clock::now();
+    return float(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - a_timeBeg).count())/1000.0f;
+  }
+
+  static float CommitTimeMs(HRSceneInstRef a_scn, HRRenderRef a_render, HRCameraRef a_cam)
+  {
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    hrCommit(a_scn, a_render, a_cam);
+    return ElapsedMs(timeBeg);
+  }
+
+  static float FlushTimeMs(HRSceneInstRef a_scn, HRRenderRef a_render, HRCameraRef a_cam)
+  {
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    hrFlush(a_scn, a_render, a_cam);
+    return ElapsedMs(timeBeg);
+  }
+
+  static void InstanceGrid(HRSceneInstRef a_scn, HRMeshRef a_mesh, int a_instNum)
+  {
+    const int side = int(sqrtf(float(a_instNum))) + 1;
+
+    for (int i = 0; i < a_instNum; i++)
+    {
+      float4x4 mTranslate = translate4x4(float3(float(i % side), 0.0f, float(i / side)));
+      hrMeshInstance(a_scn, a_mesh, mTranslate.L());
+    }
+  }
+
+  static void CreateSimpleObjects(HRMeshRef& a_cube, HRLightRef& a_light, HRCameraRef& a_cam)
+  {
+    HRMaterialRef mat0 = hrMaterialCreate(L"mat0");
+    hrMaterialOpen(mat0, HR_WRITE_DISCARD);
+    {
+      auto diff = hrMaterialParamNode(mat0).append_child(L"diffuse");
+      diff.append_attribute(L"brdf_type").set_value(L"lambert");
+      diff.append_child(L"color").append_attribute(L"val").set_value(L"0.5 0.5 0.5");
+    }
+    hrMaterialClose(mat0);
+
+    a_cube = HRMeshFromSimpleMesh(L"my_cube", CreateCube(0.25f), mat0.id);
+
+    a_light = hrLightCreate(L"my_point_light"); // point light has no geometry, so instance counts are exact
+    hrLightOpen(a_light, HR_WRITE_DISCARD);
+    {
+      auto lightNode = hrLightParamNode(a_light);
+      lightNode.attribute(L"type").set_value(L"point");
+      lightNode.attribute(L"shape").set_value(L"point");
+      lightNode.attribute(L"distribution").set_value(L"uniform");
+
+      auto intensityNode = lightNode.append_child(L"intensity");
+      intensityNode.append_child(L"color").append_attribute(L"val")      = L"1 1 1";
+      intensityNode.append_child(L"multiplier").append_attribute(L"val") = 8.0f;
+    }
+    hrLightClose(a_light);
+
+    a_cam = hrCameraCreate(L"my camera");
+    hrCameraOpen(a_cam, HR_WRITE_DISCARD);
+    {
+      auto camNode = hrCameraParamNode(a_cam);
+      camNode.append_child(L"fov").text().set(L"45");
+      camNode.append_child(L"nearClipPlane").text().set(L"0.01");
+      camNode.append_child(L"farClipPlane").text().set(L"100.0");
+      camNode.append_child(L"up").text().set(L"0 1 0");
+      camNode.append_child(L"position").text().set(L"0 10 15");
+      camNode.append_child(L"look_at").text().set(L"0 0 0");
+    }
+    hrCameraClose(a_cam);
+  }
+
+  /**
+  \brief common start of perf tests: objects from CreateSimpleObjects, render with null driver and empty scene "my scene".
+         New library is opened at a_libPath; if a_libPath is nullptr, objects are added to the library that is already open.
+  */
+  struct NullDriverScene
+  {
+    explicit NullDriverScene(const wchar_t* a_libPath, const HRInitInfo& a_initInfo = HRInitInfo(),
+                             std::shared_ptr<RD_NullCounter> a_pDriver = std::make_shared<RD_NullCounter>()) : pDriver(a_pDriver)
+    {
+      if (a_libPath != nullptr)
+        hrSceneLibraryOpen(a_libPath, HR_WRITE_DISCARD, a_initInfo);
+
+      CreateSimpleObjects(cube, light, cam);
+      render = hrRenderCreateFromExistingDriver(L"NullCounter", pDriver);
+      scn    = hrSceneCreate(L"my scene");
+    }
+
+    HRMeshRef      cube;
+    HRLightRef     light;
+    HRCameraRef    cam;
+    std::shared_ptr<RD_NullCounter> pDriver;
+    HRRenderRef    render;
+    HRSceneInstRef scn;
+  };
+
+  /**
+  \brief open existing library and commit its first scene with first camera to a new null driver, as application that only loads the library does.
+  \param a_pTimeCommit - if not null, hrCommit time in ms is written here
+  \param a_pTimeOpen   - if not null, hrSceneLibraryOpen time in ms is written here
+  */
+  static std::shared_ptr<RD_NullCounter> CommitExistingLibrary(const wchar_t* a_libPath, const HRInitInfo& a_initInfo, float* a_pTimeCommit = nullptr, float* a_pTimeOpen = nullptr)
+  {
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    hrSceneLibraryOpen(a_libPath, HR_OPEN_EXISTING, a_initInfo);
+    if (a_pTimeOpen != nullptr)
+      (*a_pTimeOpen) = ElapsedMs(timeBeg);
+
+    auto pDriver = std::make_shared<RD_NullCounter>();
+    HRRenderRef renderRef = hrRenderCreateFromExistingDriver(L"NullCounter", pDriver);
+
+    HRSceneInstRef scnRef;
+    HRCameraRef    camRef;
+    scnRef.id = 0;
+    camRef.id = 0;
+
+    const float timeCommit = CommitTimeMs(scnRef, renderRef, camRef);
+    if (a_pTimeCommit != nullptr)
+      (*a_pTimeCommit) = timeCommit;
+
+    return pDriver;
+  }
+
+  /**
+  \brief create spheres "sphere_i" of radius 1 + 0.001*i, so data of each mesh is different; with a_compressOdd every second mesh is stored in '.vsgfc'.
+  */
+  static std::vector<HRMeshRef> CreateSphereMeshes(int a_meshNum, bool a_compressOdd = false)
+  {
+    std::vector<HRMeshRef> meshes(a_meshNum);
+    for (int i = 0; i < a_meshNum; i++)
+    {
+      SimpleMesh sphere = CreateSphere(1.0f + 0.001f*float(i), 64);
+
+      std::wstringstream nameOut;
+      nameOut << L"sphere_" << i;
+      const std::wstring name = nameOut.str();
+
+      meshes[i] = hrMeshCreate(name.c_str());
+      hrMeshOpen(meshes[i], HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
+      hrMeshVertexAttribPointer4f(meshes[i], L"pos",      sphere.vPos.data());
+      hrMeshVertexAttribPointer4f(meshes[i], L"norm",     sphere.vNorm.data());
+      hrMeshVertexAttribPointer2f(meshes[i], L"texcoord", sphere.vTexCoord.data());
+      hrMeshMaterialId(meshes[i], 0);
+      hrMeshAppendTriangles3(meshes[i], int(sphere.triIndices.size()), sphere.triIndices.data());
+      hrMeshClose(meshes[i], a_compressOdd && (i % 2 == 1));
+    }
+    return meshes;
+  }
+
+  /**
+  \brief measure hrCommit latency against instance count: nothing changed, one light changed and the whole scene rebuilt.
+  */
+  bool test_501_commit_latency_vs_instances()
+  {
+    hrErrorCallerPlace(L"test_501");
+
+    const int instCount[] = { 10000, 100000, 1000000 };
+
+    bool allInstancesPassed = true;
+
+    std::cout << std::endl;
+    std::cout << "[test_501]: instances | no changes (ms) | light changed (ms) | scene rebuilt (ms)" << std::endl;
+
+    for (int instNum : instCount)
+    {
+      NullDriverScene scene(L"tests/test_501");
+
+      float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+      hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+      {
+        InstanceGrid(scene.scn, scene.cube, instNum);
+        hrLightInstance(scene.scn, scene.light, mLight.L());
+      }
+      hrSceneClose(scene.scn);
+
+      hrFlush(scene.scn, scene.render, scene.cam);
+      const int64_t firstInstNum = scene.pDriver->instancesNum;
+
+      // (1) commit without any changes; the first one (hrFlush) is not measured because it also writes the whole library to disk
+      //
+      const float timeEmpty = CommitTimeMs(scene.scn, scene.render, scene.cam);
+
+      // (2) change one light, all instances are the same
+      //
+      hrLightOpen(scene.light, HR_OPEN_EXISTING);
+      {
+        auto lightNode = hrLightParamNode(scene.light);
+        lightNode.child(L"intensity").child(L"multiplier").attribute(L"val") = 16.0f;
+      }
+      hrLightClose(scene.light);
+      const float timeLight = CommitTimeMs(scene.scn, scene.render, scene.cam);
+      const int64_t lightInstNum = scene.pDriver->instancesNum;
+
+      // (3) rebuild the whole scene
+      //
+      hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+      {
+        InstanceGrid(scene.scn, scene.cube, instNum);
+        hrLightInstance(scene.scn, scene.light, mLight.L());
+      }
+      hrSceneClose(scene.scn);
+      const float timeRebuild = CommitTimeMs(scene.scn, scene.render, scene.cam);
+      const int64_t rebuildInstNum = scene.pDriver->instancesNum;
+
+      // matrices are gathered from drawList on each commit, so driver must get exactly the grid; sum of each matrix is 4 + x + z
+      //
+      const int side = int(sqrtf(float(instNum))) + 1;
+      double gridSum = 0.0;
+      for (int i = 0; i < instNum; i++)
+        gridSum += 4.0 + double(i % side) + double(i / side);
+
+      std::cout << "[test_501]: " << std::setw(9) << instNum << " | " << std::fixed << std::setprecision(2)
+                << std::setw(15) << timeEmpty << " | " << std::setw(18) << timeLight << " | " << std::setw(18) << timeRebuild << std::endl;
+
+      allInstancesPassed = allInstancesPassed && (firstInstNum == instNum) && (lightInstNum == instNum) && (rebuildInstNum == instNum) &&
+                           (fabs(scene.pDriver->matricesSum - gridSum) < 1e-6*gridSum);
+    }
+
+    return allInstancesPassed;
+  }
+
+  static int64_t FileSize(const char* a_fileName)
+  {
+    std::ifstream fin(a_fileName, std::ios::binary | std::ios::ate);
+    if (!fin.is_open())
+      return 0;
+    return int64_t(fin.tellg());
+  }
+
+  /**
+  \brief compare hrSceneClose time, state file size and library load time for xml instances and HRInitInfo::binaryInstances.
+  */
+  bool test_502_binary_instance_table()
+  {
+    hrErrorCallerPlace(L"test_502");
+
+    const int instNum = 1000000;
+
+    float   timeClose[2];
+    float   timeLoad[2];
+    int64_t stateSize[2];
+    int64_t loadedNum[2];
+    double  loadedSum[2];
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+      HRInitInfo initInfo;
+      initInfo.binaryInstances = (mode == 1);
+
+      NullDriverScene scene(L"tests/test_502", initInfo);
+
+      float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+      hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+      InstanceGrid(scene.scn, scene.cube, instNum);
+      hrLightInstance(scene.scn, scene.light, mLight.L());
+
+      auto timeBeg = std::chrono::high_resolution_clock::now();
+      hrSceneClose(scene.scn);
+      timeClose[mode] = ElapsedMs(timeBeg);
+
+      hrFlush(scene.scn, scene.render, scene.cam);
+      stateSize[mode] = FileSize("tests/test_502/statex_00001.xml");
+
+      // load library back and check that all instances are the same
+      //
+      auto pLoaded = CommitExistingLibrary(L"tests/test_502", initInfo, nullptr, &timeLoad[mode]);
+      loadedNum[mode] = pLoaded->instancesNum;
+      loadedSum[mode] = pLoaded->matricesSum;
+    }
+
+    // rewrite binary scene many times in small virtual buffer: previous tables must be freed, so nothing is evicted
+    //
+    HRInitInfo initInfo;
+    initInfo.binaryInstances = true;
+    initInfo.vbSize          = int64_t(32) * int64_t(1024 * 1024);
+    NullDriverScene rewritten(L"tests/test_502", initInfo);
+    for (int i = 0; i < 20; i++) // 20 tables of 8 MB
+    {
+      hrSceneOpen(rewritten.scn, HR_WRITE_DISCARD);
+      InstanceGrid(rewritten.scn, rewritten.cube, 100000);
+      hrSceneClose(rewritten.scn);
+    }
+
+    const int64_t rewriteEvictions = hrSceneLibraryInfo().vbCacheEvictions;
+
+    std::cout << std::endl;
+    std::cout << "[test_502]: instances = " << instNum << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_502]: xml    : hrSceneClose = " << std::setw(9) << timeClose[0] << " ms, statex = " << std::setw(10) << stateSize[0] / 1024 << " KB, load = " << std::setw(9) << timeLoad[0] << " ms" << std::endl;
+    std::cout << "[test_502]: binary : hrSceneClose = " << std::setw(9) << timeClose[1] << " ms, statex = " << std::setw(10) << stateSize[1] / 1024 << " KB, load = " << std::setw(9) << timeLoad[1] << " ms" << std::endl;
+    std::cout << "[test_502]: evictions after 20 scene rewrites = " << rewriteEvictions << std::endl;
+
+    return (loadedNum[0] == instNum) && (loadedNum[1] == instNum) && (loadedSum[0] == loadedSum[1]) && (rewriteEvictions == 0);
+  }
+
+  /**
+  \brief a copy of the old single thread hrMeshWeldVertices (std::unordered_map of vertex_cache); reference for test_503.
+  */
+  struct WeldRefVertex
+  {
+    float pos[3];
+    float norm[3];
+    float uv[2];
+    float tang[4];
+  };
+
+  struct WeldRefHash
+  {
+    std::size_t operator()(const WeldRefVertex& v) const
+    {
+      return ((std::hash<int>()(int(v.pos[0] * 73856093))) ^
+              (std::hash<int>()(int(v.pos[1] * 19349663))) ^
+              (std::hash<int>()(int(v.pos[2] * 83492791))) ^
+              (std::hash<int>()(int(v.norm[0] * 12929173))) ^
+              (std::hash<int>()(int(v.norm[1] * 15484457))) ^
+              (std::hash<int>()(int(v.norm[2] * 26430499))) ^
+              (std::hash<int>()(int(v.uv[0] * 30025883))) ^
+              (std::hash<int>()(int(v.uv[1] * 41855327))) ^
+              (std::hash<int>()(int(v.tang[0] * 50040937))) ^
+              (std::hash<int>()(int(v.tang[1] * 57208453))) ^
+              (std::hash<int>()(int(v.tang[2] * 60352007))) ^
+              (std::hash<int>()(int(v.tang[3] * 67432663))) );
+    }
+  };
+
+  struct WeldRefEq
+  {
+    bool operator()(const WeldRefVertex& u, const WeldRefVertex& v) const
+    {
+      return (fabsf(u.pos[0] - v.pos[0]) < 1e-6) && (fabsf(u.pos[1] - v.pos[1]) < 1e-6) && (fabsf(u.pos[2] - v.pos[2]) < 1e-6) &&
+             (fabsf(u.norm[0] - v.norm[0]) < 1e-3) && (fabsf(u.norm[1] - v.norm[1]) < 1e-3) && (fabsf(u.norm[2] - v.norm[2]) < 1e-3) &&
+             (fabsf(u.uv[0] - v.uv[0]) < 1e-5) && (fabsf(u.uv[1] - v.uv[1]) < 1e-5) &&
+             (fabsf(u.tang[0] - v.tang[0]) < 1e-3) && (fabsf(u.tang[1] - v.tang[1]) < 1e-3) && (fabsf(u.tang[2] - v.tang[2]) < 1e-3) &&
+             (fabsf(u.tang[3] - v.tang[3]) < 1e-1);
+    }
+  };
+
+  static void WeldReference(const SimpleMesh& a_mesh, const std::vector<float>& a_tang,
+                            std::vector<float>& a_outPos, std::vector<int>& a_outInd, std::vector<int>& a_outMat)
+  {
+    std::unordered_map<WeldRefVertex, uint32_t, WeldRefHash, WeldRefEq> vertexHash;
+
+    a_outPos.clear();
+    a_outInd.clear();
+    a_outMat.clear();
+
+    for (size_t i = 0; i < a_mesh.triIndices.size(); i += 3)
+    {
+      const int* tri = a_mesh.triIndices.data() + i;
+      if (tri[0] == tri[1] || tri[0] == tri[2] || tri[1] == tri[2])
+        continue;
+
+      a_outMat.push_back(a_mesh.matIndices[i / 3]);
+
+      for (int j = 0; j < 3; j++)
+      {
+        const int v = tri[j];
+        WeldRefVertex key;
+        for (int k = 0; k < 3; k++) key.pos[k]  = a_mesh.vPos[v * 4 + k];
+        for (int k = 0; k < 3; k++) key.norm[k] = a_mesh.vNorm[v * 4 + k];
+        for (int k = 0; k < 2; k++) key.uv[k]   = a_mesh.vTexCoord[v * 2 + k];
+        for (int k = 0; k < 4; k++) key.tang[k] = a_tang[v * 4 + k];
+
+        auto p = vertexHash.find(key);
+        if (p != vertexHash.end())
+          a_outInd.push_back(int(p->second));
+        else
+        {
+          const uint32_t index = uint32_t(vertexHash.size());
+          vertexHash[key] = index;
+          a_outInd.push_back(int(index));
+          a_outPos.insert(a_outPos.end(), { key.pos[0], key.pos[1], key.pos[2], 1.0f });
+        }
+      }
+    }
+  }
+
+  /**
+  \brief measure hrMeshAppendTriangles3 with vertex welding on a big "triangle soup" mesh; the result must be the same as with the old welder.
+  */
+  bool test_503_weld_vertices()
+  {
+    hrErrorCallerPlace(L"test_503");
+
+    const int quadsX = 1000;
+    const int quadsY = 1000;
+
+    // every triangle has its own vertices as it happens with CAD exporters; each 97-th triangle is degenerate
+    //
+    SimpleMesh soup;
+    std::vector<float> tang; // tangent 'w' is not taken from input, hrMeshAppendTriangles3 sets it to 0
+
+    auto surface = [&](int x, int y)
+    {
+      const float fx = float(x) / float(quadsX);
+      const float fy = float(y) / float(quadsY);
+      const float h  = 0.1f * sinf(20.0f * fx) * cosf(15.0f * fy);
+      const float dx = 2.0f * cosf(20.0f * fx) * cosf(15.0f * fy);
+      const float dy = -1.5f * sinf(20.0f * fx) * sinf(15.0f * fy);
+      const float3 n = normalize(float3(-dx, 1.0f, -dy));
+      const float3 t = normalize(float3(1.0f, dx, 0.0f));
+
+      soup.vPos.insert(soup.vPos.end(), { fx, h, fy, 1.0f });
+      soup.vNorm.insert(soup.vNorm.end(), { n.x, n.y, n.z, 0.0f });
+      soup.vTexCoord.insert(soup.vTexCoord.end(), { fx, fy });
+      tang.insert(tang.end(), { t.x, t.y, t.z, 0.0f });
+    };
+
+    const int cornersX[6] = { 0, 1, 1, 0, 1, 0 };
+    const int cornersY[6] = { 0, 0, 1, 0, 1, 1 };
+
+    for (int y = 0; y < quadsY; y++)
+    {
+      for (int x = 0; x < quadsX; x++)
+      {
+        for (int c = 0; c < 6; c++)
+          surface(x + cornersX[c], y + cornersY[c]);
+
+        for (int t = 0; t < 2; t++)
+        {
+          const int base   = int(soup.triIndices.size());
+          const bool degen = ((base / 3) % 97 == 0);
+          soup.triIndices.push_back(base + 0);
+          soup.triIndices.push_back(degen ? base + 0 : base + 1);
+          soup.triIndices.push_back(base + 2);
+          soup.matIndices.push_back((x / 100 + y / 100) % 4);
+        }
+      }
+    }
+
+    const int vertNum = int(soup.vPos.size() / 4);
+    const int indNum  = int(soup.triIndices.size());
+
+    // the old welder
+    //
+    std::vector<float> refPos;
+    std::vector<int>   refInd, refMat;
+
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    WeldReference(soup, tang, refPos, refInd, refMat);
+    const float timeOld = ElapsedMs(timeBeg);
+
+    // hrMeshWeldVertices through hrMeshAppendTriangles3
+    //
+    hrSceneLibraryOpen(L"tests/test_503", HR_WRITE_DISCARD);
+
+    // the same mesh without welding gives the cost of hrMeshAppendTriangles3 itself
+    //
+    float timeAppend[2];
+    bool  sameData = false;
+    bool  sameSize = false;
+
+    for (int weld = 0; weld < 2; weld++)
+    {
+      HRMeshRef meshRef = hrMeshCreate(weld ? L"soup_welded" : L"soup");
+      hrMeshOpen(meshRef, HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
+      hrMeshVertexAttribPointer4f(meshRef, L"pos",      soup.vPos.data());
+      hrMeshVertexAttribPointer4f(meshRef, L"norm",     soup.vNorm.data());
+      hrMeshVertexAttribPointer2f(meshRef, L"texcoord", soup.vTexCoord.data());
+      hrMeshVertexAttribPointer4f(meshRef, L"tang",     tang.data());
+      hrMeshPrimitiveAttribPointer1i(meshRef, L"mind",  soup.matIndices.data());
+
+      timeBeg = std::chrono::high_resolution_clock::now();
+      hrMeshAppendTriangles3(meshRef, indNum, soup.triIndices.data(), (weld == 1));
+      timeAppend[weld] = ElapsedMs(timeBeg);
+
+      if (weld == 1)
+      {
+        const float* pos = (const float*)hrMeshGetAttribPointer(meshRef, L"pos");
+        const int*   ind = (const int*)hrMeshGetPrimitiveAttribPointer(meshRef, L"tind");
+        const int*   mat = (const int*)hrMeshGetPrimitiveAttribPointer(meshRef, L"mind");
+
+        sameData = (pos != nullptr && ind != nullptr && mat != nullptr) &&
+                   std::equal(refPos.begin(), refPos.end(), pos) &&
+                   std::equal(refInd.begin(), refInd.end(), ind) &&
+                   std::equal(refMat.begin(), refMat.end(), mat);
+      }
+
+      hrMeshClose(meshRef);
+
+      if (weld == 1)
+      {
+        const HRMeshInfo info = hrMeshGetInfo(meshRef);
+        sameSize = (info.vertNum == int(refPos.size() / 4)) && (info.indicesNum == int(refInd.size()));
+      }
+    }
+
+    std::cout << std::endl;
+    std::cout << "[test_503]: triangles = " << indNum / 3 << ", vertices = " << vertNum << " -> " << refPos.size() / 4 << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_503]: old welder (reference copy) = " << std::setw(9) << timeOld << " ms" << std::endl;
+    std::cout << "[test_503]: hrMeshAppendTriangles3      = " << std::setw(9) << timeAppend[0] << " ms without welding, " << timeAppend[1] << " ms with welding" << std::endl;
+    std::cout << "[test_503]: hrMeshWeldVertices         ~= " << std::setw(9) << timeAppend[1] - timeAppend[0] << " ms" << std::endl;
+
+    return sameData && sameSize;
+  }
+
+  /**
+  \brief compare loading of a big mesh from existing library: reading '.vsgf' to temporary buffer and HRInitInfo::mapMeshFiles.
+  */
+  bool test_504_mapped_mesh_files()
+  {
+    hrErrorCallerPlace(L"test_504");
+
+    float  timeCommit[2];
+    double meshSum[2];
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+      HRInitInfo initInfo;
+      initInfo.mapMeshFiles = (mode == 1);
+
+      if (mode == 0)
+      {
+        NullDriverScene scene(L"tests/test_504", initInfo);
+
+        HRMeshRef sphereRef = HRMeshFromSimpleMesh(L"big_sphere", CreateSphere(1.0f, 2000), 0);
+
+        float4x4 mIdentity;
+        float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+        hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+        hrMeshInstance(scene.scn, sphereRef, mIdentity.L());
+        hrLightInstance(scene.scn, scene.light, mLight.L());
+        hrSceneClose(scene.scn);
+
+        hrFlush(scene.scn, scene.render, scene.cam);
+      }
+
+      auto pDriver2 = CommitExistingLibrary(L"tests/test_504", initInfo, &timeCommit[mode]);
+      meshSum[mode]    = pDriver2->meshDataSum;
+    }
+
+    std::cout << std::endl;
+    std::cout << "[test_504]: " << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_504]: read to temp buffer : hrCommit = " << std::setw(9) << timeCommit[0] << " ms" << std::endl;
+    std::cout << "[test_504]: mapped file         : hrCommit = " << std::setw(9) << timeCommit[1] << " ms" << std::endl;
+
+    return (meshSum[0] == meshSum[1]) && (meshSum[0] != 0.0);
+  }
+
+  /**
+  \brief load many plain and compressed meshes from existing library; driver must get the same data in sorted id order.
+  */
+  bool test_505_mesh_upload_pipeline()
+  {
+    hrErrorCallerPlace(L"test_505");
+
+    const int meshNum = 2000;
+
+    NullDriverScene scene(L"tests/test_505");
+
+    const std::vector<HRMeshRef> meshes = CreateSphereMeshes(meshNum, true); // every second mesh is stored in compressed '.vsgfc'
+
+    float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    for (int i = 0; i < meshNum; i++)
+    {
+      float4x4 mTranslate = translate4x4(float3(float(i % 50) * 3.0f, 0.0f, float(i / 50) * 3.0f));
+      hrMeshInstance(scene.scn, meshes[i], mTranslate.L());
+    }
+    hrLightInstance(scene.scn, scene.light, mLight.L());
+    hrSceneClose(scene.scn);
+
+    hrFlush(scene.scn, scene.render, scene.cam);
+
+    // load library back; meshes are not in memory now and are read from files
+    //
+    float timeCommit = 0.0f;
+    auto pDriver2 = CommitExistingLibrary(L"tests/test_505", HRInitInfo(), &timeCommit);
+
+    const bool sameOrder = (pDriver2->meshIds == scene.pDriver->meshIds) && std::is_sorted(pDriver2->meshIds.begin(), pDriver2->meshIds.end());
+
+    // compressed meshes are quantized, so compare sums of positions with tolerance for them
+    //
+    bool sameData = (pDriver2->meshInfo.size() == scene.pDriver->meshInfo.size());
+    for (size_t i = 0; sameData && i < scene.pDriver->meshInfo.size(); i++)
+    {
+      const float3 a = scene.pDriver->meshInfo[i];
+      const float3 b = pDriver2->meshInfo[i];
+      const float maxDiff = (i % 2 == 1) ? 1e-3f*fabs(a.z) : 0.0f;
+      sameData = (a.x == b.x) && (a.y == b.y) && (fabs(a.z - b.z) <= maxDiff);
+    }
+
+    std::cout << std::endl;
+    std::cout << "[test_505]: meshes = " << pDriver2->meshIds.size() << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_505]: hrCommit after library load = " << std::setw(9) << timeCommit << " ms" << std::endl;
+
+    return sameOrder && sameData && (pDriver2->meshIds.size() == size_t(meshNum));
+  }
+
+  static void InstanceTexturedCube(HRSceneInstRef a_scn, HRTextureNodeRef a_tex, int a_index)
+  {
+    std::wstringstream nameOut;
+    nameOut << L"mat_tex_" << a_index;
+    const std::wstring name = nameOut.str();
+
+    HRMaterialRef mat = hrMaterialCreate(name.c_str());
+    hrMaterialOpen(mat, HR_WRITE_DISCARD);
+    {
+      auto diff = hrMaterialParamNode(mat).append_child(L"diffuse");
+      diff.append_attribute(L"brdf_type").set_value(L"lambert");
+      auto color = diff.append_child(L"color");
+      color.append_attribute(L"val").set_value(L"1 1 1");
+      hrTextureBind(a_tex, color);
+    }
+    hrMaterialClose(mat);
+
+    HRMeshRef cube = HRMeshFromSimpleMesh((name + L"_cube").c_str(), CreateCube(0.25f), mat.id);
+
+    float4x4 mTranslate = translate4x4(float3(float(a_index % 16), 0.0f, float(a_index / 16)));
+    hrMeshInstance(a_scn, cube, mTranslate.L());
+  }
+
+  static int g_test506PipelineImages = 0;
+
+  static void InfoCallBack506(const wchar_t* message, const wchar_t* callerPlace, HR_SEVERITY_LEVEL a_level)
+  {
+    const std::wstring msg(message);
+    const std::wstring prefix(L"HR_DriverUpdateTextures: "); // printed only when images were decoded by pipeline workers
+    if (msg.compare(0, prefix.size(), prefix) == 0)
+      g_test506PipelineImages = std::stoi(msg.substr(prefix.size()));
+    InfoCallBack(message, callerPlace, a_level);
+  }
+
+  /**
+  \brief images are read by worker threads and passed to driver in id order; png and jpg files with delayed load are decoded by workers too.
+  */
+  bool test_506_texture_upload_pipeline()
+  {
+    hrErrorCallerPlace(L"test_506");
+
+    const int texNum  = 128;
+    const int texSize = 512;
+
+    // (1) images from memory, stored in chunks
+    //
+    NullDriverScene scene(L"tests/test_506");
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+
+    std::vector<int32_t> pixels(texSize*texSize);
+    for (int i = 0; i < texNum; i++)
+    {
+      for (int j = 0; j < texSize*texSize; j++)
+        pixels[j] = (j * 7 + i * 13) & 0x00FFFFFF;
+
+      InstanceTexturedCube(scene.scn, hrTexture2DCreateFromMemory(texSize, texSize, 4, pixels.data()), i);
+    }
+
+    float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+    hrLightInstance(scene.scn, scene.light, mLight.L());
+    hrSceneClose(scene.scn);
+
+    hrFlush(scene.scn, scene.render, scene.cam);
+
+    // load library back; images are not in memory now and are read from files
+    //
+    float timeCommit = 0.0f;
+    auto pDriver2 = CommitExistingLibrary(L"tests/test_506", HRInitInfo(), &timeCommit);
+
+    const bool sameOrder = (pDriver2->imageIds == scene.pDriver->imageIds) && std::is_sorted(pDriver2->imageIds.begin(), pDriver2->imageIds.end());
+    const bool sameData  = (pDriver2->imageDataSum == scene.pDriver->imageDataSum) && (scene.pDriver->imageDataSum != 0.0);
+
+    // (2) png and jpg files: reference is decoded on main thread by hrTexture2DCreateFromFile, delayed load textures are decoded by workers
+    //
+    const wchar_t* fileNames[] = { L"data/textures/gradient.png", L"data/textures/noise.png", L"data/textures/coloredCylinder.png",
+                                   L"data/textures/163.jpg",      L"data/textures/diff.jpg",  L"data/textures/normal_map.jpg", L"data/textures/0019.jpg" };
+    const int fileNum = int(sizeof(fileNames) / sizeof(fileNames[0]));
+
+    double fileDataSum[2]    = { 0.0, 0.0 };
+    int    pipelineImages[2] = { 0, 0 };
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+      NullDriverScene fileScene(L"tests/test_506");
+      hrSceneOpen(fileScene.scn, HR_WRITE_DISCARD);
+      for (int i = 0; i < fileNum; i++)
+        InstanceTexturedCube(fileScene.scn, (mode == 0) ? hrTexture2DCreateFromFile(fileNames[i]) : hrTexture2DCreateFromFileDL(fileNames[i]), i);
+      hrSceneClose(fileScene.scn);
+
+      hrFlush(fileScene.scn, fileScene.render, fileScene.cam);
+
+      g_test506PipelineImages = 0;
+      hrInfoCallback(&InfoCallBack506);
+      auto pLoaded = CommitExistingLibrary(L"tests/test_506", HRInitInfo());
+      hrInfoCallback(&InfoCallBack);
+
+      fileDataSum[mode]    = pLoaded->imageDataSum;
+      pipelineImages[mode] = g_test506PipelineImages;
+    }
+
+    const bool filesDecoded = (fileDataSum[0] == fileDataSum[1]) && (fileDataSum[1] != 0.0) && (pipelineImages[1] >= fileNum);
+
+    std::cout << std::endl;
+    std::cout << "[test_506]: images = " << pDriver2->imageIds.size() << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_506]: hrCommit after library load = " << std::setw(9) << timeCommit << " ms" << std::endl;
+    std::cout << "[test_506]: png/jpg files = " << fileNum << ", decoded by pipeline workers = " << pipelineImages[1] << std::endl;
+
+    return sameOrder && sameData && (pDriver2->imageIds.size() >= size_t(texNum)) && filesDecoded;
+  }
+
+  /**
+  \brief create many meshes with given virtual buffer size and render the scene twice with null driver.
+  */
+  static void VirtualBufferScene(int64_t a_vbSize, int a_meshNum, std::shared_ptr<RD_NullCounter> a_drivers[2], float a_timeCommit[2], 
+                                 HRSceneLibraryInfo* a_pInfoCreated, HRSceneLibraryInfo* a_pInfo)
+  {
+    HRInitInfo initInfo;
+    initInfo.vbSize = a_vbSize;
+
+    NullDriverScene scene(L"tests/test_507", initInfo);
+
+    const std::vector<HRMeshRef> meshes = CreateSphereMeshes(a_meshNum);
+
+    (*a_pInfoCreated) = hrSceneLibraryInfo();
+
+    float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    for (int i = 0; i < a_meshNum; i++)
+    {
+      float4x4 mTranslate = translate4x4(float3(float(i % 32) * 3.0f, 0.0f, float(i / 32) * 3.0f));
+      hrMeshInstance(scene.scn, meshes[i], mTranslate.L());
+    }
+    hrLightInstance(scene.scn, scene.light, mLight.L());
+    hrSceneClose(scene.scn);
+
+    // each render gets all meshes, so the whole scene passes through the cache twice
+    //
+    a_drivers[0]    = scene.pDriver;
+    a_timeCommit[0] = CommitTimeMs(scene.scn, scene.render, scene.cam);
+
+    a_drivers[1]    = std::make_shared<RD_NullCounter>();
+    a_timeCommit[1] = CommitTimeMs(scene.scn, hrRenderCreateFromExistingDriver(L"NullCounter", a_drivers[1]), scene.cam);
+
+    (*a_pInfo) = hrSceneLibraryInfo();
+  }
+
+  /**
+  \brief all vertices of a sphere from VirtualBufferPinnedPointers have the given radius, so we can see whose data the pointer shows.
+  */
+  static bool SphereMeshData(const HRMeshDriverInput& a_input, float a_radius)
+  {
+    if (a_input.pos4f == nullptr || a_input.indices == nullptr || a_input.vertNum <= 0 || a_input.triNum <= 0)
+      return false;
+
+    bool sameRadius = true;
+    for (int i = 0; i < a_input.vertNum; i++)
+    {
+      const float3 pos(a_input.pos4f[i*4+0], a_input.pos4f[i*4+1], a_input.pos4f[i*4+2]);
+      sameRadius = sameRadius && (fabs(length(pos) - a_radius) < 1e-5f);
+    }
+
+    bool goodIndex = true;
+    for (int i = 0; i < a_input.triNum*3; i++)
+      goodIndex = goodIndex && (a_input.indices[i] >= 0) && (a_input.indices[i] < a_input.vertNum);
+
+    return sameRadius && goodIndex;
+  }
+
+  /**
+  \brief keep pointers to the first mesh while all other meshes are read through small virtual buffer; 
+         both the pinned mesh and the current one must be correct after each read.
+  */
+  static bool VirtualBufferPinnedPointers(int64_t a_vbSize, int a_meshNum, HRSceneLibraryInfo* a_pInfo)
+  {
+    HRInitInfo initInfo;
+    initInfo.vbSize = a_vbSize;
+
+    hrSceneLibraryOpen(L"tests/test_507", HR_WRITE_DISCARD, initInfo);
+
+    const std::vector<HRMeshRef> meshes = CreateSphereMeshes(a_meshNum);
+
+    const HRMeshDataPin firstData(size_t(meshes[0].id)); // was evicted long ago, paged in and pinned here
+
+    bool sameData = SphereMeshData(firstData.input, 1.0f);
+    const std::vector<float> firstPos(firstData.input.pos4f, firstData.input.pos4f + (sameData ? firstData.input.vertNum*4 : 0));
+    const std::vector<int>   firstInd(firstData.input.indices, firstData.input.indices + (sameData ? firstData.input.triNum*3 : 0));
+
+    for (int i = 1; i < a_meshNum && sameData; i++)
+    {
+      const HRMeshDataPin currData(size_t(meshes[i].id));
+      sameData = SphereMeshData(currData.input, 1.0f + 0.001f*float(i)) &&
+                 (memcmp(firstData.input.pos4f,   firstPos.data(), firstPos.size()*sizeof(float)) == 0) &&
+                 (memcmp(firstData.input.indices, firstInd.data(), firstInd.size()*sizeof(int))   == 0);
+    }
+
+    (*a_pInfo) = hrSceneLibraryInfo();
+    return sameData;
+  }
+
+  /**
+  \brief scene is 3 times bigger than virtual buffer; evicted meshes must be paged in back from chunk files with the same data.
+  */
+  bool test_507_virtual_buffer_lru_cache()
+  {
+    hrErrorCallerPlace(L"test_507");
+
+    const int     meshNum = 512;
+    const int64_t vbSmall = int64_t(32) * int64_t(1024 * 1024);
+
+    std::shared_ptr<RD_NullCounter> refDrivers[2], drivers[2];
+    float refTimeCommit[2], timeCommit[2];
+    HRSceneLibraryInfo refInfoCreated, refInfo, infoCreated, info;
+
+    VirtualBufferScene(HRInitInfo().vbSize, meshNum, refDrivers, refTimeCommit, &refInfoCreated, &refInfo); // everything fits in memory
+    VirtualBufferScene(vbSmall,             meshNum, drivers,    timeCommit,    &infoCreated,    &info);
+
+    HRSceneLibraryInfo infoPinned;
+    const bool pinnedOk = VirtualBufferPinnedPointers(vbSmall, meshNum, &infoPinned);
+
+    bool sameData = true;
+    for (int pass = 0; pass < 2; pass++)
+    {
+      sameData = sameData && (drivers[pass]->meshIds  == refDrivers[pass]->meshIds) && (drivers[pass]->meshIds.size() >= size_t(meshNum));
+      sameData = sameData && (drivers[pass]->meshInfo.size() == refDrivers[pass]->meshInfo.size());
+      for (size_t i = 0; sameData && i < refDrivers[pass]->meshInfo.size(); i++)
+      {
+        const float3 a = refDrivers[pass]->meshInfo[i];
+        const float3 b = drivers[pass]->meshInfo[i];
+        sameData = (a.x == b.x) && (a.y == b.y) && (a.z == b.z);
+      }
+    }
+
+    std::cout << std::endl;
+    std::cout << "[test_507]: meshes = " << meshNum << ", virtual buffer = " << vbSmall / (1024 * 1024) << " MB" << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_507]: evictions on create = " << infoCreated.vbCacheEvictions << " (" << double(infoCreated.vbBytesEvicted) / (1024.0 * 1024.0) << " MB)" << std::endl;
+    std::cout << "[test_507]: hits = " << info.vbCacheHits << ", misses = " << info.vbCacheMisses << ", page in fails = " << info.vbCachePageInFails
+              << ", evictions = " << info.vbCacheEvictions << ", paged in = " << double(info.vbBytesPagedIn) / (1024.0 * 1024.0) << " MB" << std::endl;
+    std::cout << "[test_507]: hrCommit (1) = " << std::setw(9) << timeCommit[0] << " ms, everything in memory = " << std::setw(9) << refTimeCommit[0] << " ms" << std::endl;
+    std::cout << "[test_507]: hrCommit (2) = " << std::setw(9) << timeCommit[1] << " ms, everything in memory = " << std::setw(9) << refTimeCommit[1] << " ms" << std::endl;
+    std::cout << "[test_507]: pinned mesh pointers ok = " << pinnedOk << ", misses = " << infoPinned.vbCacheMisses << ", evictions = " << infoPinned.vbCacheEvictions << std::endl;
+
+    return sameData && (refInfo.vbCacheMisses == 0) && (infoCreated.vbCacheEvictions > 0) && (info.vbCacheMisses > 0) && (info.vbCachePageInFails == 0) &&
+           pinnedOk && (infoPinned.vbCacheMisses > 0) && (infoPinned.vbCachePageInFails == 0);
+  }
+
+#ifndef WIN32
+
+  /**
+  \brief results of test_508 reader processes; placed in anonymous shared memory, so parent sees them after fork.
+  */
+  struct SharedVBReaders
+  {
+    static constexpr int READERS = 4;
+    static constexpr int TEX_W   = 128;
+    static constexpr int TEX_H   = 128;
+
+    std::atomic<int> started;
+    std::atomic<int> stop;
+    int              attached[READERS];
+    int64_t          reads   [READERS];
+    int64_t          misses  [READERS];
+    int64_t          retries [READERS];
+    int64_t          corrupt [READERS];
+  };
+
+  static inline uint32_t ChunkWord(uint32_t a_tag, uint32_t k) { return (a_tag * 2654435761u) ^ (k * 40503u); }
+
+  /**
+  \brief fake renderer: attaches to virtual buffer of the parent process and reads random texture chunks in place; 
+         each chunk that was not reported as torn by ChunkPin must have exact data of its texture.
+  */
+  static void SharedVBReader(SharedVBReaders* a_pControl, int a_readerId, uint64_t a_vbSize)
+  {
+    std::vector<int> tempBuffer;
+    VirtualBuffer vb;
+    a_pControl->attached[a_readerId] = vb.Attach(a_vbSize, "HYDRAAPISHMEM2", &tempBuffer) ? 1 : 0;
+    a_pControl->started.fetch_add(1);
+    if (a_pControl->attached[a_readerId] == 0)
+      return;
+
+    const uint32_t pixels = SharedVBReaders::TEX_W*SharedVBReaders::TEX_H;
+    uint32_t rnd = 12345u + uint32_t(a_readerId)*7919u;
+
+    int64_t reads = 0, misses = 0, retries = 0, corrupt = 0;
+    for (int64_t iter = 0; a_pControl->stop.load(std::memory_order_relaxed) == 0; iter++)
+    {
+      if (iter % 256 == 0)
+        vb.RestoreChunks(); // parent creates new textures all the time
+
+      rnd = rnd * 1664525u + 1013904223u;
+      if (vb.size() <= 1)
+        continue;
+      const size_t id = 1 + (rnd >> 8) % (vb.size() - 1); // chunk 0 is white 2x2 texture that is created with library
+
+      for (int attempt = 0; attempt < VB_READ_ATTEMPTS; attempt++)
+      {
+        ChunkPin pin(vb, id);
+        const uint32_t* words = (const uint32_t*)pin.data(); // width, height, pixels
+        if (words == nullptr)
+        {
+          misses++;
+          break;
+        }
+
+        const uint32_t tag = words[2];
+        bool good = (words[0] == SharedVBReaders::TEX_W) && (words[1] == SharedVBReaders::TEX_H);
+        for (uint32_t k = 1; k < pixels && good; k++)
+          good = (words[2 + k] == ChunkWord(tag, k));
+
+        if (pin.IsTorn()) // parent moved or evicted chunk meanwhile, read it again
+        {
+          retries++;
+          continue;
+        }
+
+        reads++;
+        if (!good)
+          corrupt++;
+        break;
+      }
+    }
+
+    vb.Destroy();
+
+    a_pControl->reads  [a_readerId] = reads;
+    a_pControl->misses [a_readerId] = misses;
+    a_pControl->retries[a_readerId] = retries;
+    a_pControl->corrupt[a_readerId] = corrupt;
+  }
+
+  static HRTextureNodeRef CreateTaggedTexture(std::vector<uint32_t>& a_pixels, uint32_t a_tag)
+  {
+    a_pixels[0] = a_tag;
+    for (uint32_t k = 1; k < uint32_t(a_pixels.size()); k++)
+      a_pixels[k] = ChunkWord(a_tag, k);
+    return hrTexture2DCreateFromMemory(SharedVBReaders::TEX_W, SharedVBReaders::TEX_H, 4, a_pixels.data());
+  }
+
+#endif
+
+  /**
+  \brief render processes attach to virtual buffer of this process and read chunks in place while it evicts and compacts them;
+         readers must never use torn data without noticing it.
+  */
+  bool test_508_chunk_table_seqlock()
+  {
+#ifdef WIN32
+    std::cout << "[test_508]: fork() based test, skipped on Windows" << std::endl;
+    g_testWasIgnored = true;
+    return false;
+#else
+    hrErrorCallerPlace(L"test_508");
+
+    if (!SharedVirtualBufferIsEnabled())
+    {
+      std::cout << "[test_508]: virtual buffer is not in shared memory, test skipped" << std::endl;
+      g_testWasIgnored = true;
+      return false;
+    }
+
+    const int     texNum  = 1500;
+    const int     texInit = 64;
+    const int64_t vbSize  = int64_t(16) * int64_t(1024 * 1024);
+
+    HRInitInfo initInfo;
+    initInfo.vbSize = vbSize;
+
+    hrSceneLibraryOpen(L"tests/test_508", HR_WRITE_DISCARD, initInfo);
+
+    HRSceneInstRef scn = hrSceneCreate(L"my scene");
+    hrSceneOpen(scn, HR_WRITE_DISCARD);
+    hrSceneClose(scn);
+
+    std::vector<uint32_t> pixels(SharedVBReaders::TEX_W*SharedVBReaders::TEX_H);
+    for (int i = 0; i < texInit; i++)
+      CreateTaggedTexture(pixels, uint32_t(i));
+    hrCommit(scn); // publish chunk table before readers attach
+
+    auto* pControl = (SharedVBReaders*)mmap(nullptr, sizeof(SharedVBReaders), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pControl == MAP_FAILED)
+    {
+      std::cout << "[test_508]: can't map shared memory for results, test skipped" << std::endl;
+      g_testWasIgnored = true;
+      return false;
+    }
+    new (pControl) SharedVBReaders(); // value-initialization: zero counters and atomics
+
+    std::vector<pid_t> readers;
+    for (int r = 0; r < SharedVBReaders::READERS; r++)
+    {
+      pid_t pid = fork();
+      if (pid == 0)
+      {
+        SharedVBReader(pControl, r, uint64_t(vbSize));
+        _exit(0);
+      }
+      else if (pid < 0) // usually not enough memory to duplicate current process
+        break;
+      readers.push_back(pid);
+    }
+
+    if (readers.empty())
+    {
+      munmap(pControl, sizeof(SharedVBReaders));
+      std::cout << "[test_508]: can't fork reader processes, test skipped" << std::endl;
+      g_testWasIgnored = true;
+      return false;
+    }
+
+    while (pControl->started.load() < int(readers.size()))
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // owner fills virtual buffer several times, so least recently used chunks are evicted and others are compacted under readers
+    //
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    for (int i = texInit; i < texNum; i++)
+    {
+      CreateTaggedTexture(pixels, uint32_t(i));
+      if (i % 32 == 0)
+        hrCommit(scn);
+    }
+    hrCommit(scn);
+    const float timeMs = ElapsedMs(timeBeg);
+
+    pControl->stop.store(1);
+    for (pid_t pid : readers)
+      waitpid(pid, nullptr, 0);
+
+    const HRSceneLibraryInfo info = hrSceneLibraryInfo();
+
+    int     attached = 0;
+    int64_t reads = 0, misses = 0, retries = 0, corrupt = 0;
+    for (size_t r = 0; r < readers.size(); r++)
+    {
+      attached += pControl->attached[r];
+      reads    += pControl->reads[r];
+      misses   += pControl->misses[r];
+      retries  += pControl->retries[r];
+      corrupt  += pControl->corrupt[r];
+    }
+    munmap(pControl, sizeof(SharedVBReaders));
+
+    std::cout << std::endl;
+    std::cout << "[test_508]: readers = " << readers.size() << ", attached = " << attached << ", textures = " << texNum << ", virtual buffer = " << vbSize / (1024 * 1024) << " MB" << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_508]: owner time = " << timeMs << " ms, evictions = " << info.vbCacheEvictions << std::endl;
+    std::cout << "[test_508]: reads = " << reads << ", misses = " << misses << ", torn and retried = " << retries << ", corrupt = " << corrupt << std::endl;
+
+    return (attached == int(readers.size())) && (reads > 0) && (corrupt == 0) && (info.vbCacheEvictions > 0);
+#endif
+  }
+
+
+  /**
+  \brief resolve many material, light and camera names; check name index after rename and library load.
+  */
+  bool test_509_find_by_name_index()
+  {
+    hrErrorCallerPlace(L"test_509");
+
+    const int matNum   = 100000;
+    const int lightNum = 10000;
+    const int camNum   = 1000;
+    const int refNum   = 1000;
+
+    hrSceneLibraryOpen(L"tests/test_509", HR_WRITE_DISCARD);
+
+    std::vector<std::wstring> matNames(matNum), lightNames(lightNum), camNames(camNum);
+    std::vector<HRMaterialRef> mats(matNum);
+    std::vector<HRLightRef>    lights(lightNum);
+    std::vector<HRCameraRef>   cams(camNum);
+
+    for (int i = 0; i < matNum; i++)
+    {
+      std::wstringstream nameOut;
+      nameOut << L"material_" << i;
+      matNames[i] = nameOut.str();
+      mats[i]     = hrMaterialCreate(matNames[i].c_str());
+    }
+
+    for (int i = 0; i < lightNum; i++)
+    {
+      std::wstringstream nameOut;
+      nameOut << L"light_" << i;
+      lightNames[i] = nameOut.str();
+      lights[i]     = hrLightCreate(lightNames[i].c_str());
+    }
+
+    for (int i = 0; i < camNum; i++)
+    {
+      std::wstringstream nameOut;
+      nameOut << L"camera_" << i;
+      camNames[i] = nameOut.str();
+      cams[i]     = hrCameraCreate(camNames[i].c_str());
+    }
+
+    std::vector<const wchar_t*> matNamesPtr(matNum);
+    for (int i = 0; i < matNum; i++)
+      matNamesPtr[i] = matNames[i].c_str();
+
+    // old implementation did a linear search with string compare for each name; measure it for first refNum names
+    //
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    int refFound = 0;
+    for (int i = 0; i < refNum; i++)
+    {
+      for (const auto& name : matNames)
+      {
+        if (name == std::wstring(matNamesPtr[i]))
+        {
+          refFound++;
+          break;
+        }
+      }
+    }
+    const float timeLinear = ElapsedMs(timeBeg)*float(matNum)/float(refNum);
+
+    bool sameIds = (refFound == refNum);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < matNum; i++)
+      sameIds = sameIds && (hrFindMaterialByName(matNamesPtr[i]).id == mats[i].id);
+    const float timeSingle = ElapsedMs(timeBeg);
+
+    std::vector<HRMaterialRef> matsFound(matNum);
+    timeBeg = std::chrono::high_resolution_clock::now();
+    const int32_t matFound = hrFindMaterialsByName(matNamesPtr.data(), matNum, matsFound.data());
+    const float timeBulk = ElapsedMs(timeBeg);
+
+    for (int i = 0; i < matNum; i++)
+      sameIds = sameIds && (matsFound[i].id == mats[i].id);
+
+    // rename and duplicate names
+    //
+    HRMaterialRef dup = hrMaterialCreate(L"material_5");  // the first material with this name should be found
+
+    hrMaterialOpen(mats[5], HR_OPEN_EXISTING);
+    hrMaterialParamNode(mats[5]).attribute(L"name").set_value(L"renamed_material_5");
+    hrMaterialClose(mats[5]);
+
+    hrLightOpen(lights[7], HR_OPEN_EXISTING);
+    hrLightParamNode(lights[7]).attribute(L"name").set_value(L"renamed_light_7");
+    hrLightClose(lights[7]);
+
+    hrCameraOpen(cams[3], HR_OPEN_EXISTING);
+    hrCameraParamNode(cams[3]).attribute(L"name").set_value(L"renamed_camera_3");
+    hrCameraClose(cams[3]);
+
+    auto checkRenamed = [&]()
+    {
+      const wchar_t* matQuery[3]   = { L"material_5", L"renamed_material_5", L"material_6" };
+      const wchar_t* lightQuery[2] = { L"light_7", L"renamed_light_7" };
+      const wchar_t* camQuery[2]   = { L"camera_3", L"renamed_camera_3" };
+
+      HRMaterialRef matRes[3];
+      HRLightRef    lightRes[2];
+      HRCameraRef   camRes[2];
+
+      hrFindMaterialsByName(matQuery, 3, matRes);
+      hrFindLightsByName(lightQuery, 2, lightRes);
+      hrFindCamerasByName(camQuery, 2, camRes);
+
+      return (matRes[0].id   == dup.id)       && (matRes[1].id   == mats[5].id) && (matRes[2].id == mats[6].id) &&
+             (lightRes[0].id == -1)           && (lightRes[1].id == lights[7].id) &&
+             (camRes[0].id   == -1)           && (camRes[1].id   == cams[3].id);
+    };
+
+    const bool renameOk = checkRenamed();
+
+    // save state and check that indices are rebuilt on library load
+    //
+    NullDriverScene scene(nullptr); // library with all names is already open
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    hrMeshInstance(scene.scn, scene.cube, float4x4().L());
+    hrSceneClose(scene.scn);
+
+    hrFlush(scene.scn, scene.render, scene.cam);
+
+    hrSceneLibraryOpen(L"tests/test_509", HR_OPEN_EXISTING);
+
+    const int32_t matFoundLoaded = hrFindMaterialsByName(matNamesPtr.data(), matNum, matsFound.data());
+    bool sameIdsLoaded = (matsFound[5].id == dup.id);
+    for (int i = 0; i < matNum; i++)
+      sameIdsLoaded = sameIdsLoaded && (i == 5 || matsFound[i].id == mats[i].id);
+
+    const bool renameLoadedOk = checkRenamed() && (hrFindCameraByName(L"my camera").id == scene.cam.id);
+
+    std::cout << std::endl;
+    std::cout << "[test_509]: materials = " << matNum << ", lights = " << lightNum << ", cameras = " << camNum << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_509]: linear search x " << matNum << "   ~= " << std::setw(9) << timeLinear << " ms" << std::endl;
+    std::cout << "[test_509]: hrFindMaterialByName  x " << matNum << " = " << std::setw(9) << timeSingle << " ms" << std::endl;
+    std::cout << "[test_509]: hrFindMaterialsByName x " << matNum << " = " << std::setw(9) << timeBulk << " ms" << std::endl;
+
+    return sameIds && (matFound == matNum) && renameOk && sameIdsLoaded && (matFoundLoaded == matNum) && renameLoadedOk;
+  }
+
+
+  static std::string ReadWholeFile(const char* a_fileName)
+  {
+    std::ifstream fin(a_fileName, std::ios::binary);
+    std::stringstream strOut;
+    strOut << fin.rdbuf();
+    return strOut.str();
+  }
+
+  /**
+  \brief first change file must be the same as old DOM copy of all objects; next ones contain only deltas of all commits after hrFlush.
+  */
+  bool test_510_streaming_change_log()
+  {
+    hrErrorCallerPlace(L"test_510");
+
+    const int instNum = 200000;
+
+    NullDriverScene scene(L"tests/test_510");
+
+    HRMaterialRef mats[2] = { hrMaterialCreate(L"mat1"), hrMaterialCreate(L"mat2") };
+    for (auto mat : mats)
+    {
+      hrMaterialOpen(mat, HR_WRITE_DISCARD);
+      hrMaterialClose(mat);
+    }
+
+    float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    InstanceGrid(scene.scn, scene.cube, instNum);
+    hrLightInstance(scene.scn, scene.light, mLight.L());
+    hrSceneClose(scene.scn);
+
+    const float timeFlush1 = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    // reference: copy of all library nodes as old _hrSaveCurrentChanges did for the first commit
+    //
+    pugi::xml_document stateDoc;
+    stateDoc.load_file(L"tests/test_510/statex_00001.xml");
+
+    pugi::xml_document refDoc;
+    const wchar_t* libNames[] = { L"textures_lib", L"materials_lib", L"geometry_lib", L"lights_lib", L"cam_lib", L"render_lib", L"scenes" };
+    for (auto libName : libNames)
+    {
+      auto lib = refDoc.append_child(libName);
+      if (std::wstring(libName) == L"render_lib")
+        continue;
+      for (auto node = stateDoc.child(libName).first_child(); node != nullptr; node = node.next_sibling())
+        lib.append_copy(node);
+    }
+
+    std::stringstream refOut;
+    refDoc.save(refOut, L"  ");
+
+    const std::string change0 = ReadWholeFile("tests/test_510/change_00000.xml");
+    const bool sameAsDomCopy  = (change0 == refOut.str());
+
+    // two commits between flushes; both deltas must be in the change file, scene was not changed
+    //
+    hrMaterialOpen(mats[0], HR_WRITE_DISCARD);
+    hrMaterialParamNode(mats[0]).append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"1 0 0");
+    hrMaterialClose(mats[0]);
+    hrCommit(scene.scn, scene.render, scene.cam);
+
+    hrMaterialOpen(mats[1], HR_WRITE_DISCARD);
+    hrMaterialParamNode(mats[1]).append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"0 1 0");
+    hrMaterialClose(mats[1]);
+
+    const float timeFlush2 = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    pugi::xml_document changeDoc;
+    const bool loaded = changeDoc.load_file(L"tests/test_510/change_00001.xml");
+
+    int matsInChanges = 0, scenesInChanges = 0;
+    for (auto node = changeDoc.first_child(); node != nullptr; node = node.next_sibling())
+    {
+      if (std::wstring(node.name()) == L"materials_lib")
+      {
+        for (auto mat = node.first_child(); mat != nullptr; mat = mat.next_sibling())
+          matsInChanges++;
+      }
+      else if (std::wstring(node.name()) == L"scenes" && node.first_child() != nullptr)
+        scenesInChanges++;
+    }
+
+    std::cout << std::endl;
+    std::cout << "[test_510]: instances = " << instNum << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_510]: change_00000 = " << std::setw(9) << FileSize("tests/test_510/change_00000.xml") / 1024 << " KB, hrFlush = " << std::setw(9) << timeFlush1 << " ms" << std::endl;
+    std::cout << "[test_510]: change_00001 = " << std::setw(9) << FileSize("tests/test_510/change_00001.xml") / 1024 << " KB, hrFlush = " << std::setw(9) << timeFlush2 << " ms" << std::endl;
+
+    return sameAsDomCopy && loaded && (matsInChanges == 2) && (scenesInChanges == 0);
+  }
+
+
+  /**
+  \brief save big library and load it back; driver must get the same objects and instances, load time is reported per phase.
+  */
+  bool test_511_parallel_library_load()
+  {
+    hrErrorCallerPlace(L"test_511");
+
+    const int matNum  = 20000;
+    const int meshNum = 2000;
+    const int instNum = 400000;
+
+    NullDriverScene scene(L"tests/test_511");
+
+    const wchar_t* texFiles[] = { L"data/textures/gradient.png", L"data/textures/noise.png", L"data/textures/163.jpg" };
+    std::vector<HRTextureNodeRef> textures;
+    for (auto texFile : texFiles)
+      textures.push_back(hrTexture2DCreateFromFile(texFile));
+
+    for (int i = 0; i < matNum; i++)
+    {
+      std::wstringstream nameOut;
+      nameOut << L"material_" << i;
+      HRMaterialRef mat = hrMaterialCreate(nameOut.str().c_str());
+      hrMaterialOpen(mat, HR_WRITE_DISCARD);
+      hrMaterialParamNode(mat).append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"0.5 0.5 0.5");
+      hrMaterialClose(mat);
+    }
+
+    std::vector<HRMeshRef> meshes(meshNum);
+    for (int i = 0; i < meshNum; i++)
+    {
+      std::wstringstream nameOut;
+      nameOut << L"cube_" << i;
+      meshes[i] = HRMeshFromSimpleMesh(nameOut.str().c_str(), CreateCube(0.1f + 0.0001f*float(i)), i % matNum);
+    }
+
+    const int side = int(sqrtf(float(instNum))) + 1;
+    float4x4 mLight = translate4x4(float3(0.0f, 10.0f, 0.0f));
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    for (int i = 0; i < instNum; i++)
+    {
+      float4x4 mTranslate = translate4x4(float3(float(i % side), 0.0f, float(i / side)));
+      hrMeshInstance(scene.scn, meshes[i % meshNum], mTranslate.L());
+    }
+    hrLightInstance(scene.scn, scene.light, mLight.L());
+    hrSceneClose(scene.scn);
+
+    hrFlush(scene.scn, scene.render, scene.cam);
+
+    // load library back
+    //
+    auto pDriver2 = CommitExistingLibrary(L"tests/test_511", HRInitInfo());
+    const HRSceneLibraryInfo info = hrSceneLibraryInfo();
+
+    bool sameTextures = (info.texturesNum == int32_t(textures.size()) + 1); // white texture is created with library
+    for (size_t i = 0; i < textures.size(); i++)
+      sameTextures = sameTextures && (hrTexture2DCreateFromFile(texFiles[i]).id == textures[i].id); // texture cache is restored by loader
+
+    const bool sameObjects   = (info.materialsNum == matNum + 2) && (info.meshesNum == meshNum + 1) && (info.camerasNum == 1) && (info.scenesNum == 1);
+    const bool sameInstances = (pDriver2->instancesNum == scene.pDriver->instancesNum) && (pDriver2->matricesSum == scene.pDriver->matricesSum);
+    const bool sameMeshes    = (pDriver2->meshIds == scene.pDriver->meshIds) && (pDriver2->meshInfo.size() == scene.pDriver->meshInfo.size());
+    const bool sameNames     = (hrFindMaterialByName(L"material_12345").id == 12346) && (hrFindCameraByName(L"my camera").id == 0);
+
+    std::cout << std::endl;
+    std::cout << "[test_511]: materials = " << matNum << ", meshes = " << meshNum << ", instances = " << instNum << std::fixed << std::setprecision(2) << std::endl;
+    std::cout << "[test_511]: xml parse      = " << std::setw(9) << info.loadTimeXml           << " ms" << std::endl;
+    std::cout << "[test_511]: virtual buffer = " << std::setw(9) << info.loadTimeVirtualBuffer << " ms" << std::endl;
+    std::cout << "[test_511]: objects        = " << std::setw(9) << info.loadTimeObjects       << " ms" << std::endl;
+    std::cout << "[test_511]: instances      = " << std::setw(9) << info.loadTimeInstances     << " ms" << std::endl;
+    std::cout << "[test_511]: total          = " << std::setw(9) << info.loadTimeTotal         << " ms" << std::endl;
+
+    return sameObjects && sameTextures && sameInstances && sameMeshes && sameNames;
+  }
+
+  /**
+  \brief compare stream based float/matrix conversion with HydraXMLHelpers tokenizer/formatter and check that formatted floats
+   are read back (both by ReadFloats and by strtof) to exactly the same bits.
+  */
+  bool test_512_numeric_parse_format()
+  {
+    std::mt19937 gen(512);
+
+    // (1) round trip for random bit patterns and special values
+    //
+    const int bitsNum   = 4000000;
+    int roundTripErrors = 0;
+    int strtofErrors    = 0;
+    int maxLength       = 0;
+
+    std::vector<float> special = { 0.0f, -0.0f, 1.0f, -1.0f, 0.1f, 1e-4f, 9.99999e-5f, 1e9f, 999999999.0f, 3.4028235e38f, 1.17549435e-38f,
+                                   1.4e-45f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+
+    for (int i = 0; i < bitsNum + int(special.size()); i++)
+    {
+      float val = 0.0f;
+      if (i < int(special.size()))
+        val = special[i];
+      else
+      {
+        const uint32_t bits = uint32_t(gen());
+        memcpy(&val, &bits, sizeof(float));
+        if (std::isnan(val))
+          continue;
+      }
+
+      wchar_t str[HydraXMLHelpers::FLOAT_STR_MAX];
+      const int len = HydraXMLHelpers::FormatFloat(val, str);
+      maxLength     = std::max(maxLength, len);
+
+      float back = 0.0f;
+      HydraXMLHelpers::ReadFloats(str, &back, 1);
+      if (memcmp(&back, &val, sizeof(float)) != 0)
+        roundTripErrors++;
+
+      char strA[HydraXMLHelpers::FLOAT_STR_MAX];
+      for (int j = 0; j <= len; j++)
+        strA[j] = char(str[j]);
+      const float backStd = strtof(strA, nullptr);
+      if (memcmp(&backStd, &val, sizeof(float)) != 0)
+        strtofErrors++;
+    }
+
+    // (2) parse numbers written by the old stream code and in exponent form, compare with strtof
+    //
+    const int parseNum = 1000000;
+    int parseErrors    = 0;
+    std::uniform_real_distribution<float> distr(-1000.0f, 1000.0f);
+    std::uniform_int_distribution<int>    distrExp(-40, 38);
+    for (int i = 0; i < parseNum; i++)
+    {
+      std::stringstream strOut;
+      if (i % 2 == 0)
+        strOut << distr(gen);
+      else
+        strOut << std::setprecision(1 + i % 12) << distr(gen) << "e" << distrExp(gen);
+
+      const std::string  strA = strOut.str();
+      const std::wstring strW(strA.begin(), strA.end());
+
+      float val = 0.0f;
+      HydraXMLHelpers::ReadFloats(strW.c_str(), &val, 1);
+      const float valStd = strtof(strA.c_str(), nullptr);
+      if (memcmp(&val, &valStd, sizeof(float)) != 0)
+        parseErrors++;
+    }
+
+    // (3) values at and around the middle between two neighbour floats, where double rounding of 'double -> float' goes wrong;
+    //     printed with 9, 17 and 26 significant digits and as integers, so mantissa is also truncated by parser. Compare with strtof.
+    //
+    const int boundaryNum = 1000000;
+    int boundaryErrors    = 0;
+    std::uniform_int_distribution<uint32_t> distrBits(0x00800000u, 0x7f7fffffu); // normal positive floats
+    for (int i = 0; i < boundaryNum; i++)
+    {
+      float lo = 0.0f;
+      if (i % 4 == 3) // integers 2^24..2^31, middle between floats is integer too
+        lo = float(16777216u + (uint32_t(gen()) & 0x7fffffffu));
+      else
+      {
+        const uint32_t bits = distrBits(gen);
+        memcpy(&lo, &bits, sizeof(float));
+      }
+
+      const double middle = 0.5*(double(lo) + double(std::nextafter(lo, HUGE_VALF)));
+
+      char strA[64];
+      switch (i % 4)
+      {
+      case 0:  snprintf(strA, sizeof(strA), "%.8e",  middle); break;
+      case 1:  snprintf(strA, sizeof(strA), "%.16e", middle); break;
+      case 2:  snprintf(strA, sizeof(strA), "%.25e", middle); break;
+      default: snprintf(strA, sizeof(strA), "%.0f",  middle); break;
+      };
+
+      const std::string  strS(strA);
+      const std::wstring strW(strS.begin(), strS.end());
+
+      float val = 0.0f;
+      HydraXMLHelpers::ReadFloats(strW.c_str(), &val, 1);
+      const float valStd = strtof(strA, nullptr);
+      if (memcmp(&val, &valStd, sizeof(float)) != 0)
+        boundaryErrors++;
+    }
+
+    // (4) integers
+    //
+    int intErrors = 0;
+    std::vector<int32_t> ints = { 0, -1, 1, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min() };
+    for (int i = 0; i < 100000; i++)
+      ints.push_back(int32_t(gen()));
+
+    std::wstring intStr;
+    for (auto x : ints)
+    {
+      wchar_t str[HydraXMLHelpers::INT_STR_MAX];
+      intStr.append(str, HydraXMLHelpers::FormatInt(x, str));
+      intStr.push_back(L' ');
+    }
+    std::vector<int32_t> intsBack(ints.size());
+    const int intsRead = HydraXMLHelpers::ReadInts(intStr.c_str(), intsBack.data(), int(intsBack.size()));
+    if (intsRead != int(ints.size()) || intsBack != ints)
+      intErrors++;
+
+    // (5) microbenchmark on instance matrices
+    //
+    const int matNum = 200000;
+    std::vector<float> matrices(matNum*16);
+    std::uniform_real_distribution<float> distrPos(-100.0f, 100.0f);
+    for (int i = 0; i < matNum; i++)
+    {
+      float* m = &matrices[i*16];
+      const float angle = distr(gen)*0.01f;
+      float4x4 rot      = mul(translate4x4(float3(distrPos(gen), distrPos(gen), distrPos(gen))), rotate_Y_4x4(angle));
+      memcpy(m, rot.L(), 16*sizeof(float));
+    }
+
+    std::vector<std::wstring> strStream(matNum), strFast(matNum);
+
+    auto timeBegin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < matNum; i++)
+    {
+      std::wstringstream outMat;
+      for (int j = 0; j < 16; j++)
+        outMat << matrices[i*16 + j] << L" ";
+      strStream[i] = outMat.str();
+    }
+    const float timeFormatStream = ElapsedMs(timeBegin);
+
+    timeBegin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < matNum; i++)
+    {
+      wchar_t mstr[16*HydraXMLHelpers::FLOAT_STR_MAX + 1];
+      const int mlen = HydraXMLHelpers::FormatFloats(&matrices[i*16], 16, mstr);
+      mstr[mlen] = L' '; mstr[mlen + 1] = 0;
+      strFast[i] = mstr;
+    }
+    const float timeFormatFast = ElapsedMs(timeBegin);
+
+    double sumStream = 0.0, sumFast = 0.0;
+    int matErrors    = 0;
+
+    timeBegin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < matNum; i++)
+    {
+      float m[16];
+      std::wstringstream inputStream(strFast[i]);
+      for (int j = 0; j < 16; j++)
+        inputStream >> m[j];
+      sumStream += double(m[0] + m[5] + m[10] + m[12]);
+    }
+    const float timeParseStream = ElapsedMs(timeBegin);
+
+    timeBegin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < matNum; i++)
+    {
+      float m[16];
+      HydraXMLHelpers::ReadFloats(strFast[i].c_str(), m, 16);
+      sumFast += double(m[0] + m[5] + m[10] + m[12]);
+      if (memcmp(m, &matrices[i*16], sizeof(m)) != 0)
+        matErrors++;
+    }
+    const float timeParseFast = ElapsedMs(timeBegin);
+
+    std::cout << std::endl;
+    std::cout << "[test_512]: round trip errors = " << roundTripErrors << ", strtof errors = " << strtofErrors << " of " << bitsNum << " floats, max length = " << maxLength << std::endl;
+    std::cout << "[test_512]: parse errors      = " << parseErrors << " of " << parseNum << ", int errors = " << intErrors << ", matrix errors = " << matErrors << std::endl;
+    std::cout << "[test_512]: boundary errors   = " << boundaryErrors << " of " << boundaryNum << " middles between floats" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_512]: format " << matNum << " matrices: stream = " << std::setw(9) << timeFormatStream << " ms, fast = " << std::setw(9) << timeFormatFast << " ms" << std::endl;
+    std::cout << "[test_512]: parse  " << matNum << " matrices: stream = " << std::setw(9) << timeParseStream  << " ms, fast = " << std::setw(9) << timeParseFast  << " ms" << std::endl;
+    std::cout << "[test_512]: stream size = " << strStream[0].size() << " vs " << strFast[0].size() << " symbols for the first matrix" << std::endl;
+
+    return (roundTripErrors == 0) && (strtofErrors == 0) && (parseErrors == 0) && (boundaryErrors == 0) && (intErrors == 0) && (matErrors == 0) && 
+           (maxLength < HydraXMLHelpers::FLOAT_STR_MAX) && (sumStream == sumFast);
+  }
+
+  /**
+  \brief render driver that asks HydraAPI to preprocess displacement, so hrFlush calls HR_PreprocessMeshes.
+  */
+  struct RD_NullDisplace : public RD_NullCounter
+  {
+    HRDriverInfo Info() override { HRDriverInfo info = RD_NullCounter::Info(); info.supportDisplacement = true; return info; }
+  };
+
+  static HRMaterialRef CreateDisplaceMaterial(const wchar_t* a_name, float a_amount)
+  {
+    HRMaterialRef mat = hrMaterialCreate(a_name);
+    hrMaterialOpen(mat, HR_WRITE_DISCARD);
+    {
+      auto matNode = hrMaterialParamNode(mat);
+      matNode.append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"0.5 0.5 0.5");
+
+      auto displacement = matNode.append_child(L"displacement");
+      displacement.append_attribute(L"type").set_value(L"true_displacement");
+      displacement.append_attribute(L"subdivs").set_value(2);
+      displacement.append_child(L"height_map").append_attribute(L"amount").set_value(a_amount);
+    }
+    hrMaterialClose(mat);
+    return mat;
+  }
+
+  /**
+  \brief many instances of a few displaced meshes; HR_PreprocessMeshes must create one fixed mesh per unique (mesh, effective remap list).
+  */
+  bool test_513_displacement_dedup()
+  {
+    hrErrorCallerPlace(L"test_513");
+    NullDriverScene scene(L"tests/test_513", HRInitInfo(), std::make_shared<RD_NullDisplace>());
+
+    HRMaterialRef mat0     = hrFindMaterialByName(L"mat0");
+    HRMaterialRef matDisp1 = CreateDisplaceMaterial(L"displace1", 0.05f);
+    HRMaterialRef matDisp2 = CreateDisplaceMaterial(L"displace2", 0.10f);
+
+    HRMeshRef sphereRef = HRMeshFromSimpleMesh(L"my_sphere", CreateSphere(1.0f, 64), matDisp1.id);
+
+    hrRenderOpen(scene.render, HR_WRITE_DISCARD);
+    hrRenderParamNode(scene.render).force_child(L"doDisplacement").text() = 1;
+    hrRenderClose(scene.render);
+
+    const int32_t remapDisp2[2]  = { matDisp1.id, matDisp2.id }; // sphere with other displacement
+    const int32_t remapCube[2]   = { mat0.id,     matDisp1.id }; // does not change the sphere, displaces the cube
+    const int     instPerGroup   = 500;
+    const int     displacedInst  = 4*instPerGroup;
+    const int     side           = 50;
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    for (int i = 0; i < 5*instPerGroup; i++)
+    {
+      float4x4 mTranslate = translate4x4(float3(float(i % side), 0.0f, float(i / side)));
+      switch (i % 5)
+      {
+      case 0:  hrMeshInstance(scene.scn, sphereRef,  mTranslate.L());                break; // job 1
+      case 1:  hrMeshInstance(scene.scn, sphereRef,  mTranslate.L(), remapDisp2, 2); break; // job 2
+      case 2:  hrMeshInstance(scene.scn, sphereRef,  mTranslate.L(), remapCube, 2);  break; // same as job 1
+      case 3:  hrMeshInstance(scene.scn, scene.cube, mTranslate.L(), remapCube, 2);  break; // job 3
+      default: hrMeshInstance(scene.scn, scene.cube, mTranslate.L());                break; // no displacement
+      };
+    }
+    hrSceneClose(scene.scn);
+
+    const float timeFlush = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    // check the state that was produced by HR_PreprocessMeshes
+    //
+    pugi::xml_document doc;
+    doc.load_file(L"tests/test_513/statex_00001_meshes.xml");
+
+    std::unordered_map<int, std::wstring> meshNames;
+    for (auto node : doc.child(L"geometry_lib").children(L"mesh"))
+      meshNames[node.attribute(L"id").as_int()] = node.attribute(L"name").as_string();
+
+    int fixedMeshes    = 0;
+    int fixedInstances = 0;
+    for (auto& mesh : meshNames)
+      fixedMeshes += (mesh.second.find(L"_fixed_") != std::wstring::npos) ? 1 : 0;
+
+    std::vector<int> fixedPerGroup(5, 0);
+    std::vector<std::set<int> > meshesPerGroup(5);
+    for (auto node : doc.child(L"scenes").child(L"scene").children(L"instance"))
+    {
+      const int id     = node.attribute(L"id").as_int();
+      const int meshId = node.attribute(L"mesh_id").as_int();
+      if (meshNames[meshId].find(L"_fixed_") != std::wstring::npos)
+      {
+        fixedInstances++;
+        fixedPerGroup[id % 5]++;
+      }
+      meshesPerGroup[id % 5].insert(meshId);
+    }
+
+    const bool sharedMeshes = (meshesPerGroup[0].size() == 1) && (meshesPerGroup[0] == meshesPerGroup[2]) && (meshesPerGroup[1].size() == 1) &&
+                              (meshesPerGroup[3].size() == 1) && (meshesPerGroup[0] != meshesPerGroup[1]) && (fixedPerGroup[4] == 0);
+
+    // library with displacement materials is loaded back by application whose driver does not preprocess meshes
+    //
+    auto pDriver2 = CommitExistingLibrary(L"tests/test_513", HRInitInfo());
+    const bool sameInstances = (pDriver2->instancesNum == scene.pDriver->instancesNum);
+
+    std::cout << std::endl;
+    std::cout << "[test_513]: displaced instances = " << fixedInstances << " of " << displacedInst << ", fixed meshes = " << fixedMeshes << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_513]: hrFlush with displacement = " << std::setw(9) << timeFlush << " ms (" << timeFlush/float(fixedMeshes) << " ms per fixed mesh)" << std::endl;
+
+    return (fixedMeshes == 3) && (fixedInstances == displacedInst) && sharedMeshes && sameInstances;
+  }
+
+  static SimpleMesh CreateGrid(int a_side, float a_size)
+  {
+    SimpleMesh grid;
+    const int vertSide = a_side + 1;
+    grid.vPos.resize(vertSide*vertSide*4);
+    grid.vNorm.resize(vertSide*vertSide*4);
+    grid.vTexCoord.resize(vertSide*vertSide*2);
+
+    for (int y = 0; y < vertSide; y++)
+    {
+      for (int x = 0; x < vertSide; x++)
+      {
+        const int v = y*vertSide + x;
+        grid.vPos[v*4 + 0] = a_size*(float(x)/float(a_side) - 0.5f);
+        grid.vPos[v*4 + 1] = 0.0f;
+        grid.vPos[v*4 + 2] = a_size*(float(y)/float(a_side) - 0.5f);
+        grid.vPos[v*4 + 3] = 1.0f;
+        grid.vNorm[v*4 + 0] = 0.0f;
+        grid.vNorm[v*4 + 1] = 1.0f;
+        grid.vNorm[v*4 + 2] = 0.0f;
+        grid.vNorm[v*4 + 3] = 0.0f;
+        grid.vTexCoord[v*2 + 0] = float(x)/float(a_side);
+        grid.vTexCoord[v*2 + 1] = float(y)/float(a_side);
+      }
+    }
+
+    for (int y = 0; y < a_side; y++)
+    {
+      for (int x = 0; x < a_side; x++)
+      {
+        const int v0 = y*vertSide + x;
+        const int v1 = v0 + 1;
+        const int v2 = v0 + vertSide;
+        const int v3 = v2 + 1;
+        grid.triIndices.insert(grid.triIndices.end(), { v0, v2, v1, v1, v2, v3 });
+      }
+    }
+    grid.matIndices.resize(grid.triIndices.size()/3, 0);
+    return grid;
+  }
+
+  /**
+  \brief displacement of a flat grid with 5 levels of sqrt3 subdivision; checks triangle count and that the grid stays flat.
+  */
+  bool test_514_subdivision_adjacency()
+  {
+    hrErrorCallerPlace(L"test_514");
+    NullDriverScene scene(L"tests/test_514", HRInitInfo(), std::make_shared<RD_NullDisplace>());
+
+    const int levels = 5;
+    HRMaterialRef matDisp = hrMaterialCreate(L"displace");
+    hrMaterialOpen(matDisp, HR_WRITE_DISCARD);
+    {
+      auto displacement = hrMaterialParamNode(matDisp).append_child(L"displacement");
+      displacement.append_attribute(L"type").set_value(L"true_displacement");
+      displacement.append_attribute(L"subdivs").set_value(levels);
+      displacement.append_child(L"height_map").append_attribute(L"amount").set_value(0.0f);
+    }
+    hrMaterialClose(matDisp);
+
+    const SimpleMesh grid = CreateGrid(64, 10.0f);
+    HRMeshRef gridRef     = HRMeshFromSimpleMesh(L"my_grid", grid, matDisp.id);
+
+    hrRenderOpen(scene.render, HR_WRITE_DISCARD);
+    hrRenderParamNode(scene.render).force_child(L"doDisplacement").text() = 1;
+    hrRenderClose(scene.render);
+
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    {
+      float4x4 mIdentity;
+      hrMeshInstance(scene.scn, gridRef, mIdentity.L());
+    }
+    hrSceneClose(scene.scn);
+
+    const float timeFlush = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    // find fixed mesh and check it
+    //
+    pugi::xml_document doc;
+    doc.load_file(L"tests/test_514/statex_00001_meshes.xml");
+    HRMeshRef fixedRef;
+    fixedRef.id = doc.child(L"scenes").child(L"scene").child(L"instance").attribute(L"mesh_id").as_int();
+
+    int64_t expectedTris = int64_t(grid.triIndices.size()/3);
+    for (int i = 0; i < levels; i++)
+      expectedTris *= 3;
+
+    hrMeshOpen(fixedRef, HR_TRIANGLE_IND3, HR_OPEN_READ_ONLY);
+    const HRMeshInfo info = hrMeshGetInfo(fixedRef);
+    const float* pos      = (const float*)hrMeshGetAttribPointer(fixedRef, L"pos");
+    float maxHeight       = 0.0f;
+    float maxSide         = 0.0f;
+    for (int i = 0; i < info.vertNum && pos != nullptr; i++)
+    {
+      maxHeight = std::max(maxHeight, fabsf(pos[i*4 + 1]));
+      maxSide   = std::max(maxSide, std::max(fabsf(pos[i*4 + 0]), fabsf(pos[i*4 + 2])));
+    }
+    hrMeshClose(fixedRef);
+
+    std::cout << std::endl;
+    std::cout << "[test_514]: levels = " << levels << ", triangles = " << info.indicesNum/3 << " (expected " << expectedTris << "), vertices = " << info.vertNum << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_514]: hrFlush with displacement = " << std::setw(9) << timeFlush << " ms" << std::endl;
+
+    return (fixedRef.id != gridRef.id) && (pos != nullptr) && (int64_t(info.indicesNum/3) == expectedTris) && (maxHeight < 1e-5f) && (maxSide <= 5.0f + 1e-4f);
+  }
+
+
+  static void CreateNLMInputs(int w, int h, HydraRender::HDRImage4f& a_color, HydraRender::HDRImage4f& a_texColor, HydraRender::HDRImage4f& a_normDepth)
+  {
+    a_color.resize(w, h);
+    a_texColor.resize(w, h);
+    a_normDepth.resize(w, h);
+
+    float* color = a_color.data();
+    float* texc  = a_texColor.data();
+    float* normd = a_normDepth.data();
+
+    std::mt19937 gen(515);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+
+    // floor, back wall and a box in the middle; checker texture on each of them
+    //
+    for (int y = 0; y < h; y++)
+    {
+      for (int x = 0; x < w; x++)
+      {
+        const float fx = float(x) / float(w);
+        const float fy = float(y) / float(h);
+
+        float3 n(0, 0, 1);
+        float  depth = 6.0f;
+        if (fy > 0.6f)                                        { n = float3(0, 1, 0); depth = 6.0f - 10.0f*(fy - 0.6f); }
+        if (fx > 0.35f && fx < 0.65f && fy > 0.3f && fy < 0.8f) { n = float3(0.6f, 0, 0.8f); depth = 3.0f; }
+
+        const int   checker = ((int(fx*24.0f) + int(fy*24.0f)) & 1);
+        const float tex     = checker ? 0.8f : 0.3f;
+        const float light   = 0.4f + 0.6f*fabsf(n.z*0.5f + n.y*0.5f + n.x*0.7f);
+
+        const int i = (y*w + x) * 4;
+        texc[i + 0] = tex; texc[i + 1] = tex*0.9f; texc[i + 2] = tex*0.7f; texc[i + 3] = 1.0f;
+        normd[i + 0] = n.x; normd[i + 1] = n.y; normd[i + 2] = n.z; normd[i + 3] = depth;
+        for (int c = 0; c < 3; c++)
+          color[i + c] = std::max(texc[i + c]*light + noise(gen), 0.0f);
+        color[i + 3] = 1.0f;
+      }
+    }
+  }
+
+  /**
+  \brief NLM denoiser: summed-area table + SSE path against the reference, then the fast path alone at 1080p and 4K.
+  The reference is too slow for full resolution, so it is timed on a small image and its full resolution time is extrapolated.
+  Tolerance: mean abs difference < 1e-6 and less than 0.1% of pixels differ by more than 1e-3 (rounding may flip a threshold).
+  */
+  bool test_515_nlm_fast()
+  {
+    hrErrorCallerPlace(L"test_515");
+
+    const int windowRadius = 5;
+    const int blockRadius  = 1;
+    const float noiseLevel = 0.10f;
+
+    HydraRender::HDRImage4f color, texColor, normDepth, outRef, outFast;
+    CreateNLMInputs(320, 240, color, texColor, normDepth);
+
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    NonLocalMeansGuidedTexNormDepthFilter(color, texColor, normDepth, outRef, windowRadius, blockRadius, noiseLevel);
+    const float timeRef = ElapsedMs(timeBeg);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    NonLocalMeansGuidedTexNormDepthFilterFast(color, texColor, normDepth, outFast, windowRadius, blockRadius, noiseLevel);
+    const float timeFastSmall = ElapsedMs(timeBeg);
+
+    const float* ref  = outRef.data();
+    const float* fast = outFast.data();
+    const int pixels  = outRef.width()*outRef.height();
+
+    double sumDiff = 0.0;
+    float  maxDiff = 0.0f;
+    int    bigDiff = 0;
+    for (int i = 0; i < pixels; i++)
+    {
+      float pixelDiff = 0.0f;
+      for (int c = 0; c < 4; c++)
+        pixelDiff = std::max(pixelDiff, fabsf(ref[i*4 + c] - fast[i*4 + c]));
+      sumDiff += double(pixelDiff);
+      maxDiff  = std::max(maxDiff, pixelDiff);
+      if (pixelDiff > 1e-3f)
+        bigDiff++;
+    }
+    const double meanDiff = sumDiff / double(pixels);
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_515]: 320x240, reference = " << std::setw(9) << timeRef << " ms, fast = " << std::setw(9) << timeFastSmall << " ms" << std::endl;
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "[test_515]: mean abs diff = " << meanDiff << ", max abs diff = " << maxDiff << ", pixels > 1e-3 : " << bigDiff << " of " << pixels << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    const int sizes[2][2] = { {1920, 1080}, {3840, 2160} };
+    for (int i = 0; i < 2; i++)
+    {
+      CreateNLMInputs(sizes[i][0], sizes[i][1], color, texColor, normDepth);
+
+      timeBeg = std::chrono::high_resolution_clock::now();
+      NonLocalMeansGuidedTexNormDepthFilterFast(color, texColor, normDepth, outFast, windowRadius, blockRadius, noiseLevel);
+      const float timeFast = ElapsedMs(timeBeg);
+
+      const float timeRefEst = timeRef*float(sizes[i][0]*sizes[i][1]) / float(pixels);
+      std::cout << "[test_515]: " << sizes[i][0] << "x" << sizes[i][1] << ", fast = " << std::setw(9) << timeFast << " ms, reference (extrapolated) = " << std::setw(10) << timeRefEst << " ms" << std::endl;
+    }
+
+    return (meanDiff < 1e-6) && (bigDiff*1000 < pixels);
+  }
+
+
+  static void CreateFireflyImage(int w, int h, HydraRender::HDRImage4f& a_image, int* a_pFireflies)
+  {
+    a_image.resize(w, h);
+    float* data = a_image.data();
+
+    std::mt19937 gen(516);
+    std::uniform_real_distribution<float> rnd(0.0f, 1.0f);
+
+    int fireflies = 0;
+    for (int y = 0; y < h; y++)
+    {
+      for (int x = 0; x < w; x++)
+      {
+        float* pixel = data + (y*w + x) * 4;
+        for (int c = 0; c < 3; c++)
+          pixel[c] = 0.25f + 0.2f*sinf(0.01f*float(x + c*50)) * cosf(0.013f*float(y)) + 0.02f*rnd(gen);
+        pixel[3] = 1.0f;
+
+        if (rnd(gen) < 0.005f)
+        {
+          pixel[0] = pixel[1] = pixel[2] = 10.0f + 10.0f*rnd(gen);
+          fireflies++;
+        }
+      }
+    }
+
+    if (a_pFireflies != nullptr)
+      (*a_pFireflies) = fireflies;
+  }
+
+  /**
+  \brief plain single-threaded version of HDRImage4f::medianFilterInPlace(threshold): 3x3 median of the input for pixels that differ from 3 or 4 neighbours.
+  */
+  static void MedianFilterReference(const HydraRender::HDRImage4f& a_in, float a_threshold, HydraRender::HDRImage4f& a_out)
+  {
+    const int w = a_in.width();
+    const int h = a_in.height();
+    const float ts2[4] = { a_threshold*a_threshold, a_threshold*a_threshold, a_threshold*a_threshold, 100000.0f };
+    auto pixel = [&](int x, int y) { return a_in.data() + (std::min(std::max(y, 0), h - 1)*w + std::min(std::max(x, 0), w - 1))*4; };
+
+    a_out = a_in;
+    for (int y = 0; y < h; y++)
+    {
+      for (int x = 0; x < w; x++)
+      {
+        const float* xm = pixel(x, y);
+        const float* neighbours[4] = { pixel(x - 1, y), pixel(x + 1, y), pixel(x, y - 1), pixel(x, y + 1) };
+
+        int numFailed = 0;
+        for (auto p : neighbours)
+        {
+          bool failed = false;
+          for (int c = 0; c < 4; c++)
+            failed = failed || ((xm[c] - p[c])*(xm[c] - p[c]) > ts2[c]);
+          numFailed += failed ? 1 : 0;
+        }
+
+        if (numFailed < 3)
+          continue;
+
+        float* out = a_out.data() + (y*w + x)*4;
+        for (int c = 0; c < 3; c++)
+        {
+          float window[9];
+          for (int k = 0; k < 9; k++)
+            window[k] = pixel(x + k % 3 - 1, y + k / 3 - 1)[c];
+          std::sort(window, window + 9);
+          out[c] = window[4];
+        }
+        out[3] = 1.0f;
+      }
+    }
+  }
+
+  /**
+  \brief throughput of HDRImage4f filters (median, median_n, gaussBlur, resampleTo) at 1080p in megapixels per second.
+  Checks that median removes fireflies, that gaussBlur matches plain separable convolution and that 2x downsampling is a 2x2 box.
+  */
+  bool test_516_image_filters_mt()
+  {
+    hrErrorCallerPlace(L"test_516");
+
+    const int w = 1920;
+    const int h = 1080;
+    const float mpix = float(w*h) / 1e6f;
+
+    HydraRender::HDRImage4f source;
+    int fireflies = 0;
+    CreateFireflyImage(w, h, source, &fireflies);
+
+    auto countFireflies = [](const HydraRender::HDRImage4f& a_image)
+    {
+      int res = 0;
+      for (int i = 0; i < a_image.width()*a_image.height(); i++)
+        if (a_image.data()[i * 4 + 0] > 5.0f)
+          res++;
+      return res;
+    };
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    // median
+    //
+    HydraRender::HDRImage4f image = source;
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    image.medianFilterInPlace(0.4f);
+    const float timeMedian = ElapsedMs(timeBeg);
+    const int fireflies1   = countFireflies(image);
+
+    image   = source;
+    timeBeg = std::chrono::high_resolution_clock::now();
+    image.medianFilterInPlace(0.4f, 1, 1000);
+    const float timeMedianN = ElapsedMs(timeBeg);
+
+    std::cout << "[test_516]: median    = " << std::setw(9) << timeMedian  << " ms, " << std::setw(8) << 1000.0f*mpix/timeMedian  << " MPix/s; fireflies " << fireflies << " -> " << fireflies1 << std::endl;
+    std::cout << "[test_516]: median_n  = " << std::setw(9) << timeMedianN << " ms, " << std::setw(8) << 1000.0f*mpix/timeMedianN << " MPix/s" << std::endl;
+
+    // median filters by bands against single-threaded results; fireflies in pairs across every band boundary (32 rows),
+    // so a pixel is filtered differently if it sees a neighbour that other band has already changed
+    //
+    HydraRender::HDRImage4f small;
+    CreateFireflyImage(300, 200, small, nullptr);
+    for (int y = 31; y + 1 < small.height(); y += 32)
+    {
+      for (int x = 0; x < small.width(); x += 3)
+      {
+        for (int c = 0; c < 3; c++)
+        {
+          small.data()[(y*small.width() + x)*4 + c]       = 30.0f;
+          small.data()[((y + 1)*small.width() + x)*4 + c] = 20.0f;
+        }
+      }
+    }
+
+    HydraRender::HDRImage4f medianRef, medianMT, medianOne, medianNMT, medianNOne;
+    MedianFilterReference(small, 0.4f, medianRef);
+    medianMT  = small;
+    medianNMT = small;
+  #ifdef _OPENMP
+    const int oldThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    medianOne  = small;
+    medianNOne = small;
+    medianOne.medianFilterInPlace(0.4f);
+    medianNOne.medianFilterInPlace(0.4f, 1, 1000);
+    omp_set_num_threads(4);
+  #endif
+    medianMT.medianFilterInPlace(0.4f);
+    medianNMT.medianFilterInPlace(0.4f, 1, 1000);
+
+    int roundingLeft = 0; // filters round toward zero; threads of OpenMP pool must get default rounding back
+    #pragma omp parallel reduction(+:roundingLeft)
+    roundingLeft += (_MM_GET_ROUNDING_MODE() != _MM_ROUND_NEAREST) ? 1 : 0;
+  #ifdef _OPENMP
+    omp_set_num_threads(oldThreads);
+  #else
+    medianOne  = medianMT;
+    medianNOne = medianNMT;
+  #endif
+    const size_t smallBytes = size_t(small.width())*size_t(small.height())*4*sizeof(float);
+    const bool sameMedian   = (memcmp(medianMT.data(), medianRef.data(), smallBytes) == 0) && (memcmp(medianOne.data(), medianRef.data(), smallBytes) == 0);
+    const bool sameMedianN  = (memcmp(medianNMT.data(), medianNOne.data(), smallBytes) == 0);
+
+    std::cout << "[test_516]: median by bands == single thread: " << sameMedian << ", median_n: " << sameMedianN << "; threads left rounding toward zero: " << roundingLeft << std::endl;
+
+    // gauss blur against plain separable convolution with the same taps
+    //
+    const int   radius = 8;
+    const float sigma  = 3.0f;
+
+    image   = source;
+    timeBeg = std::chrono::high_resolution_clock::now();
+    image.gaussBlur(radius, sigma);
+    const float timeGauss = ElapsedMs(timeBeg);
+
+    std::vector<float> kernel(2*radius + 1);
+    {
+      float sum = 0.0f;
+      for (int x = -radius; x <= radius; x++)
+      {
+        kernel[x + radius] = expf(-fabsf(float(x)) / (2.0f*sigma*sigma)) / (3.141592654f*2.0f*sigma*sigma);
+        sum += kernel[x + radius];
+      }
+      for (auto& k : kernel)
+        k /= sum;
+    }
+
+    std::vector<float> tmp(size_t(w)*size_t(h)*4, 0.0f);
+    for (int y = 0; y < h; y++)
+      for (int x = radius; x < w - radius; x++)
+        for (int c = 0; c < 4; c++)
+        {
+          float summ = kernel[radius]*source.data()[(y*w + x)*4 + c];
+          for (int wid = 1; wid < radius; wid++)
+            summ += kernel[radius + wid]*(source.data()[(y*w + x - wid)*4 + c] + source.data()[(y*w + x + wid)*4 + c]);
+          tmp[(y*w + x)*4 + c] = summ;
+        }
+
+    float maxGaussDiff = 0.0f;
+    for (int y = 0; y < h; y++)
+      for (int x = 0; x < w; x++)
+        for (int c = 0; c < 4; c++)
+        {
+          float summ = 0.0f;
+          if (y >= radius && y < h - radius)
+          {
+            summ = kernel[radius]*tmp[(y*w + x)*4 + c];
+            for (int wid = 1; wid < radius; wid++)
+              summ += kernel[radius + wid]*(tmp[((y - wid)*w + x)*4 + c] + tmp[((y + wid)*w + x)*4 + c]);
+          }
+          maxGaussDiff = std::max(maxGaussDiff, fabsf(summ - image.data()[(y*w + x)*4 + c]));
+        }
+
+    std::cout << "[test_516]: gaussBlur = " << std::setw(9) << timeGauss << " ms, " << std::setw(8) << 1000.0f*mpix/timeGauss << " MPix/s; max diff = " << maxGaussDiff << std::endl;
+
+    // resample
+    //
+    HydraRender::HDRImage4f half(w/2, h/2), scaled(1280, 720);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    source.resampleTo(half);
+    const float timeHalf = ElapsedMs(timeBeg);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    source.resampleTo(scaled);
+    const float timeScaled = ElapsedMs(timeBeg);
+
+    float maxHalfDiff = 0.0f;
+    for (int y = 0; y < h/2; y++)
+      for (int x = 0; x < w/2; x++)
+        for (int c = 0; c < 4; c++)
+        {
+          const float* s = source.data();
+          const float box = 0.25f*((s[((2*y)*w + 2*x)*4 + c] + s[((2*y)*w + 2*x + 1)*4 + c]) + (s[((2*y + 1)*w + 2*x)*4 + c] + s[((2*y + 1)*w + 2*x + 1)*4 + c]));
+          maxHalfDiff = std::max(maxHalfDiff, fabsf(box - half.data()[(y*(w/2) + x)*4 + c]));
+        }
+
+    std::cout << "[test_516]: resample 1/2      = " << std::setw(9) << timeHalf   << " ms, " << std::setw(8) << 1000.0f*mpix/timeHalf   << " MPix/s (input); max diff = " << maxHalfDiff << std::endl;
+    std::cout << "[test_516]: resample 1280x720 = " << std::setw(9) << timeScaled << " ms, " << std::setw(8) << 1000.0f*mpix/timeScaled << " MPix/s (input)" << std::endl;
+
+    return (fireflies1*20 < fireflies) && sameMedian && sameMedianN && (roundingLeft == 0) && (maxGaussDiff < 1e-5f) && (maxHalfDiff < 1e-5f);
+  }
+
+  /**
+  \brief post_process_hydra1 as a built-in special filter: neutral settings must not change the image, the result must not depend
+         on numThreads, and the fused pass is timed at 1080p and 4K with typical interactive settings.
+  */
+  bool test_517_post_process_hydra1()
+  {
+    hrErrorCallerPlace(L"test_517");
+
+    hrSceneLibraryOpen(L"tests/test_517", HR_WRITE_DISCARD);
+
+    auto createSource = [](int w, int h)
+    {
+      std::vector<float> data(size_t(w)*size_t(h)*4);
+      std::mt19937 gen(517);
+      std::uniform_real_distribution<float> noise(0.9f, 1.1f);
+      for (int y = 0; y < h; y++)
+      {
+        for (int x = 0; x < w; x++)
+        {
+          const float base = 0.5f + 0.45f*sinf(x*0.011f)*cosf(y*0.017f);
+          float* p = &data[(size_t(y)*w + x)*4];
+          p[0] = base*noise(gen)*1.2f;
+          p[1] = base*noise(gen);
+          p[2] = base*noise(gen)*0.7f;
+          p[3] = 1.0f;
+          if ((x / 64 + y / 64) % 5 == 0) // hdr highlights for compress
+          {
+            p[0] *= 8.0f; p[1] *= 8.0f; p[2] *= 8.0f;
+          }
+        }
+      }
+      return data;
+    };
+
+    auto apply = [](HRFBIRef a_in, HRFBIRef a_out, pugi::xml_node a_settings)
+    {
+      hrFilterApply(L"post_process_hydra1", a_settings, HRRenderRef(),
+                    L"in_color",  a_in,
+                    L"out_color", a_out);
+    };
+
+    auto getData = [](HRFBIRef a_image)
+    {
+      int w = 0, h = 0, bpp = 0;
+      return (const float*)hrFBIGetData(a_image, &w, &h, &bpp);
+    };
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+
+    // 1080p: correctness
+    //
+    int w = 1920;
+    int h = 1080;
+    auto source   = createSource(w, h);
+    HRFBIRef in   = hrFBICreate(L"in",   w, h, 16, source.data());
+    HRFBIRef out1 = hrFBICreate(L"out1", w, h, 16);
+    HRFBIRef out2 = hrFBICreate(L"out2", w, h, 16);
+
+    pugi::xml_document docNeutral;
+    pugi::xml_node neutral = docNeutral.append_child(L"settings");
+    neutral.append_attribute(L"exposure")   = 1.0f;
+    neutral.append_attribute(L"saturation") = 1.0f;
+    neutral.append_attribute(L"contrast")   = 1.0f;
+
+    apply(in, out1, neutral);
+    const bool neutralOk = (memcmp(getData(out1), source.data(), source.size()*sizeof(float)) == 0);
+
+    pugi::xml_document docGray;
+    pugi::xml_node gray = docGray.append_child(L"settings");
+    gray.append_attribute(L"saturation") = 0.0f;
+
+    apply(in, out1, gray);
+    float maxGrayDiff = 0.0f;
+    for (int i = 0; i < w*h; i++)
+    {
+      const float* p = getData(out1) + i*4;
+      maxGrayDiff = std::max(maxGrayDiff, std::max(fabsf(p[0] - p[1]), fabsf(p[1] - p[2])));
+    }
+
+    pugi::xml_document docAll;
+    pugi::xml_node all = docAll.append_child(L"settings");
+    all.append_attribute(L"numThreads")      = 1;
+    all.append_attribute(L"exposure")        = 1.3f;
+    all.append_attribute(L"compress")        = 0.5f;
+    all.append_attribute(L"contrast")        = 1.3f;
+    all.append_attribute(L"saturation")      = 1.2f;
+    all.append_attribute(L"whiteBalance")    = 0.5f;
+    all.append_attribute(L"uniformContrast") = 0.3f;
+    all.append_attribute(L"normalize")       = 0.5f;
+    all.append_attribute(L"vignette")        = 0.5f;
+    all.append_attribute(L"chromAberr")      = 0.5f;
+    all.append_attribute(L"sharpness")       = 0.5f;
+
+    apply(in, out1, all);
+    all.attribute(L"numThreads") = 0;
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    apply(in, out2, all);
+    const float timeAll = ElapsedMs(timeBeg);
+
+    const bool sameForThreads = (memcmp(getData(out1), getData(out2), source.size()*sizeof(float)) == 0);
+    bool allFinite = true;
+    for (size_t i = 0; i < source.size(); i++)
+      allFinite = allFinite && std::isfinite(getData(out2)[i]);
+
+    std::cout << "[test_517]: neutral settings keep image   = " << (neutralOk ? "yes" : "no") << std::endl;
+    std::cout << "[test_517]: saturation 0, max |r-g|,|g-b| = " << std::setprecision(7) << maxGrayDiff << std::setprecision(2) << std::endl;
+    std::cout << "[test_517]: numThreads 1 == numThreads 0  = " << (sameForThreads ? "yes" : "no") << std::endl;
+    std::cout << "[test_517]: 1080p, all effects  = " << std::setw(9) << timeAll << " ms" << std::endl;
+
+    // interactive tone mapping (exposure, compress, contrast, saturation, white balance) at 1080p and 4K
+    //
+    pugi::xml_document docTM;
+    pugi::xml_node tm = docTM.append_child(L"settings");
+    tm.append_attribute(L"exposure")     = 1.5f;
+    tm.append_attribute(L"compress")     = 0.7f;
+    tm.append_attribute(L"contrast")     = 1.2f;
+    tm.append_attribute(L"saturation")   = 1.1f;
+    tm.append_attribute(L"whiteBalance") = 0.3f;
+
+    const int runs = 5;
+    for (int pass = 0; pass < 2; pass++)
+    {
+      if (pass == 1)
+      {
+        w = 3840;
+        h = 2160;
+        source = createSource(w, h);
+        in     = hrFBICreate(L"in4k",  w, h, 16, source.data());
+        out1   = hrFBICreate(L"out4k", w, h, 16);
+      }
+
+      apply(in, out1, tm); // warm up
+      timeBeg = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < runs; i++)
+        apply(in, out1, tm);
+      const float timeTM = ElapsedMs(timeBeg) / float(runs);
+
+      std::cout << "[test_517]: " << (pass == 0 ? "1080p" : "4K   ") << ", tone mapping = " << std::setw(9) << timeTM << " ms, " << std::setw(8) << float(w*h) / (1000.0f*timeTM) << " MPix/s" << std::endl;
+    }
+
+    return neutralOk && sameForThreads && allFinite && (maxGrayDiff < 1e-5f);
+  }
+
+
+  /**
+  \brief hrFilterGraphApply: two branches (resample -> median -> post_process_hydra1 and blur -> resample) with intermediate images
+         in graph must give the same result as the same filters applied one by one; compare time of both ways.
+  */
+  bool test_518_filter_graph()
+  {
+    hrErrorCallerPlace(L"test_518");
+
+    hrSceneLibraryOpen(L"tests/test_518", HR_WRITE_DISCARD);
+
+    const int w = 1920;
+    const int h = 1080;
+
+    std::vector<float> source(size_t(w)*size_t(h)*4);
+    std::mt19937 gen(518);
+    std::uniform_real_distribution<float> noise(0.0f, 1.0f);
+    for (size_t i = 0; i < source.size(); i++)
+      source[i] = (i % 4 == 3) ? 1.0f : 4.0f*noise(gen)*noise(gen);
+
+    HRFBIRef in      = hrFBICreate(L"in",      w,   h,   16, source.data());
+    HRFBIRef half    = hrFBICreate(L"half",    w/2, h/2, 16);
+    HRFBIRef med     = hrFBICreate(L"med",     w/2, h/2, 16);
+    HRFBIRef blurred = hrFBICreate(L"blurred", w,   h,   16);
+    HRFBIRef outA1   = hrFBICreate(L"outA1",   w/2, h/2, 16);
+    HRFBIRef outB1   = hrFBICreate(L"outB1",   w/2, h/2, 16);
+    HRFBIRef outA2   = hrFBICreate(L"outA2",   w/2, h/2, 16);
+    HRFBIRef outB2   = hrFBICreate(L"outB2",   w/2, h/2, 16);
+
+    pugi::xml_document docGraph;
+    pugi::xml_node graph = docGraph.append_child(L"graph");
+
+    auto addImage = [&graph](const wchar_t* a_name, int a_width, int a_height)
+    {
+      pugi::xml_node image = graph.append_child(L"image");
+      image.append_attribute(L"name")   = a_name;
+      image.append_attribute(L"width")  = a_width;
+      image.append_attribute(L"height") = a_height;
+      image.append_attribute(L"bpp")    = 16;
+    };
+
+    auto addFilter = [&graph](const wchar_t* a_name, const wchar_t* a_inAttr, const wchar_t* a_in, const wchar_t* a_outAttr, const wchar_t* a_out)
+    {
+      pugi::xml_node filter = graph.append_child(L"filter");
+      filter.append_attribute(L"name") = a_name;
+      filter.append_child(L"settings");
+      pugi::xml_node argIn  = filter.append_child(L"arg");
+      argIn.append_attribute(L"name") = L"in_color";
+      argIn.append_attribute(a_inAttr) = a_in;
+      pugi::xml_node argOut = filter.append_child(L"arg");
+      argOut.append_attribute(L"name") = L"out_color";
+      argOut.append_attribute(a_outAttr) = a_out;
+      return filter.child(L"settings");
+    };
+
+    const std::wstring inId   = std::to_wstring(in.id);
+    const std::wstring outAId = std::to_wstring(outA2.id);
+    const std::wstring outBId = std::to_wstring(outB2.id);
+
+    addImage(L"half",    w/2, h/2);
+    addImage(L"med",     w/2, h/2);
+    addImage(L"blurred", w,   h);
+
+    addFilter(L"resample", L"fbi", inId.c_str(), L"image", L"half");
+    pugi::xml_node medSettings = addFilter(L"median", L"image", L"half", L"image", L"med");
+    medSettings.append_attribute(L"threshold") = 0.4f;
+    pugi::xml_node ppSettings = addFilter(L"post_process_hydra1", L"image", L"med", L"fbi", outAId.c_str());
+    ppSettings.append_attribute(L"exposure") = 1.5f;
+    ppSettings.append_attribute(L"compress") = 0.7f;
+    ppSettings.append_attribute(L"contrast") = 1.2f;
+    pugi::xml_node blurSettings = addFilter(L"blur", L"fbi", inId.c_str(), L"image", L"blurred");
+    blurSettings.append_attribute(L"sigma")  = 2.0f;
+    blurSettings.append_attribute(L"radius") = 4;
+    addFilter(L"resample", L"image", L"blurred", L"fbi", outBId.c_str());
+
+    // filters one by one with full size intermediate frame buffer images
+    //
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    hrFilterApply(L"resample",            pugi::xml_node(), HRRenderRef(), L"in_color", in,      L"out_color", half);
+    hrFilterApply(L"median",              medSettings,      HRRenderRef(), L"in_color", half,    L"out_color", med);
+    hrFilterApply(L"post_process_hydra1", ppSettings,       HRRenderRef(), L"in_color", med,     L"out_color", outA1);
+    hrFilterApply(L"blur",                blurSettings,     HRRenderRef(), L"in_color", in,      L"out_color", blurred);
+    hrFilterApply(L"resample",            pugi::xml_node(), HRRenderRef(), L"in_color", blurred, L"out_color", outB1);
+    const float timeOneByOne = ElapsedMs(timeBeg);
+
+    // the same as graph; intermediate images are freed after each run, so both runs allocate them
+    //
+    timeBeg = std::chrono::high_resolution_clock::now();
+    const bool graphOk1 = hrFilterGraphApply(graph);
+    const float timeGraph1 = ElapsedMs(timeBeg);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    const bool graphOk2 = hrFilterGraphApply(graph);
+    const float timeGraph2 = ElapsedMs(timeBeg);
+
+    auto sameImages = [](HRFBIRef a_image1, HRFBIRef a_image2)
+    {
+      int w1 = 0, h1 = 0, bpp1 = 0, w2 = 0, h2 = 0, bpp2 = 0;
+      const void* data1 = hrFBIGetData(a_image1, &w1, &h1, &bpp1);
+      const void* data2 = hrFBIGetData(a_image2, &w2, &h2, &bpp2);
+      return (w1 == w2 && h1 == h2 && bpp1 == bpp2) && memcmp(data1, data2, size_t(w1)*size_t(h1)*size_t(bpp1)) == 0;
+    };
+
+    const bool sameA = sameImages(outA1, outA2);
+    const bool sameB = sameImages(outB1, outB2);
+
+    // reading intermediate image before it is written must be rejected
+    //
+    pugi::xml_document docBad;
+    pugi::xml_node bad = docBad.append_copy(graph);
+    bad.remove_child(bad.find_child_by_attribute(L"filter", L"name", L"resample"));
+    const bool badRejected = !hrFilterGraphApply(bad);
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_518]: graph result == one by one   = " << ((sameA && sameB) ? "yes" : "no") << std::endl;
+    std::cout << "[test_518]: read before write rejected  = " << (badRejected ? "yes" : "no") << std::endl;
+    std::cout << "[test_518]: one by one                  = " << std::setw(9) << timeOneByOne << " ms" << std::endl;
+    std::cout << "[test_518]: graph (first run)           = " << std::setw(9) << timeGraph1   << " ms" << std::endl;
+    std::cout << "[test_518]: graph (second run)          = " << std::setw(9) << timeGraph2   << " ms" << std::endl;
+
+    return graphOk1 && graphOk2 && sameA && sameB && badRejected;
+  }
+
+
+  /**
+  \brief LDR conversion of frame buffer (float4 -> RGBA8 with gamma 2.2): SSE4.1 and AVX2 kernels against scalar powf version.
+         Channels must differ at most by 1; compare speed with scalar and with previous per pixel HydraSSE::gammaCorr.
+  */
+  bool test_519_ldr_conversion()
+  {
+    hrErrorCallerPlace(L"test_519");
+
+    const int w = 1920;
+    const int h = 1080;
+    const int size = w*h + 3; // odd tail for both kernels
+
+    std::vector<float> data(size_t(size)*4);
+    std::mt19937 gen(519);
+    std::uniform_real_distribution<float> rnd(0.0f, 1.0f);
+    for (size_t i = 0; i < data.size(); i++)
+      data[i] = 64.0f*rnd(gen)*rnd(gen)*rnd(gen); // normalised by 1/spp below, so most values are in [0,1]
+
+    const float special[] = { 0.0f, -1.0f, 1e-40f, 1e-30f, 1e-7f, 1e-4f, 32.0f, 32.0001f, 64.0f, 1e10f, 
+                              std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+    for (size_t i = 0; i < sizeof(special)/sizeof(special[0]); i++)
+      data[i] = special[i];
+
+    const float normConst = 1.0f / 32.0f;
+    const float invGamma  = 1.0f / 2.2f;
+
+    std::vector<int32_t> ref(size), res(size);
+    HydraSSE::ConvertLineToLDRScalar(data.data(), size, normConst, invGamma, ref.data());
+
+    auto maxDiff = [&ref, &res, size]()
+    {
+      int diff = 0;
+      for (int i = 0; i < size; i++)
+      {
+        for (int c = 0; c < 32; c += 8)
+          diff = std::max(diff, abs(((ref[i] >> c) & 0xFF) - ((res[i] >> c) & 0xFF)));
+      }
+      return diff;
+    };
+
+    const int runs = 10;
+    auto timeIt = [&](void (*a_func)(const float*, int, float, float, int32_t*))
+    {
+      auto timeBeg = std::chrono::high_resolution_clock::now();
+      for (int run = 0; run < runs; run++)
+      {
+        for (int y = 0; y < h; y++) // the same lines as in GetFrameBufferLDR
+          a_func(data.data() + size_t(y)*w*4, w, normConst, invGamma, res.data() + size_t(y)*w);
+      }
+      return ElapsedMs(timeBeg) / float(runs);
+    };
+
+    HydraSSE::exp2_init();
+    HydraSSE::log2_init();
+    auto gammaCorrLine = [](const float* a_rgba, int a_size, float a_normConst, float a_invGamma, int32_t* a_out)
+    {
+      const __m128 powerf4 = _mm_set_ps1(a_invGamma);
+      const __m128 normc   = _mm_set_ps1(a_normConst);
+      for (int i = 0; i < a_size; i++)
+        a_out[i] = HydraSSE::gammaCorr(a_rgba + i*4, normc, powerf4);
+    };
+
+    const bool hasAVX2 = HydraSSE::CPUHasAVX2();
+
+    HydraSSE::ConvertLineToLDR_SSE(data.data(), size, normConst, invGamma, res.data());
+    const int diffSSE = maxDiff();
+
+    int diffAVX2 = 0;
+    if (hasAVX2)
+    {
+      HydraSSE::ConvertLineToLDR_AVX2(data.data(), size, normConst, invGamma, res.data());
+      diffAVX2 = maxDiff();
+    }
+
+    HydraSSE::ConvertLineToLDR(data.data(), size, normConst, invGamma, res.data());
+    const int diffDispatch = maxDiff();
+
+    const float timeScalar    = timeIt(&HydraSSE::ConvertLineToLDRScalar);
+    const float timeGammaCorr = timeIt(gammaCorrLine);
+    const float timeSSE       = timeIt(&HydraSSE::ConvertLineToLDR_SSE);
+    const float timeAVX2      = hasAVX2 ? timeIt(&HydraSSE::ConvertLineToLDR_AVX2) : 0.0f;
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_519]: AVX2 supported = " << (hasAVX2 ? "yes" : "no") << std::endl;
+    std::cout << "[test_519]: max channel diff from scalar: SSE = " << diffSSE << ", AVX2 = " << diffAVX2 << ", dispatched = " << diffDispatch << std::endl;
+    std::cout << "[test_519]: 1080p, scalar powf         = " << std::setw(8) << timeScalar    << " ms" << std::endl;
+    std::cout << "[test_519]: 1080p, per pixel gammaCorr = " << std::setw(8) << timeGammaCorr << " ms" << std::endl;
+    std::cout << "[test_519]: 1080p, SSE4.1 kernel       = " << std::setw(8) << timeSSE       << " ms" << std::endl;
+    if (hasAVX2)
+      std::cout << "[test_519]: 1080p, AVX2 kernel         = " << std::setw(8) << timeAVX2      << " ms" << std::endl;
+
+    return (diffSSE <= 1) && (diffAVX2 <= 1) && (diffDispatch <= 1);
+  }
+
+
+  /**
+  \brief HRUtils::getRandomPointsOnMesh on a mesh with areas spread over 8 orders of magnitude: per triangle frequencies, 
+  independence of result from threads number, coverage of 'use_qmc' mode and sampling speed.
+  */
+  bool test_520_mesh_sampling()
+  {
+    hrErrorCallerPlace(L"test_520");
+
+    hrSceneLibraryOpen(L"tests/test_520", HR_WRITE_DISCARD);
+
+    // (1) triangle i lies in plane z = i, so the source triangle of each point is known; area ratio max/min is 1e8
+    //
+    const int triNum = 1000;
+    std::vector<float>    pos(triNum * 3 * 4);
+    std::vector<int>      ind(triNum * 3);
+    std::vector<int>      mind(triNum, 0);
+    std::vector<double>   area(triNum);
+    double totalArea = 0.0;
+
+    for (int i = 0; i < triNum; i++)
+    {
+      const float size = powf(10.0f, -2.0f + 4.0f * float(i) / float(triNum - 1));
+      const float v[3][2] = { {0.0f, 0.0f}, {size, 0.0f}, {0.0f, size} };
+      for (int k = 0; k < 3; k++)
+      {
+        pos[(i * 3 + k) * 4 + 0] = v[k][0];
+        pos[(i * 3 + k) * 4 + 1] = v[k][1];
+        pos[(i * 3 + k) * 4 + 2] = float(i);
+        pos[(i * 3 + k) * 4 + 3] = 1.0f;
+        ind[i * 3 + k] = i * 3 + k;
+      }
+      area[i]    = 0.5 * double(size) * double(size);
+      totalArea += area[i];
+    }
+
+    HRMeshRef spread = hrMeshCreate(L"spread");
+    hrMeshOpen(spread, HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
+    hrMeshVertexAttribPointer4f(spread, L"pos", pos.data());
+    hrMeshPrimitiveAttribPointer1i(spread, L"mind", mind.data());
+    hrMeshAppendTriangles3(spread, int(ind.size()), ind.data());
+
+    const uint32_t pointsNum = 4000000;
+    std::vector<float> points(pointsNum * 3), points2(pointsNum * 3);
+
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    HRUtils::getRandomPointsOnMesh(spread, points.data(), pointsNum, true, 520);
+    const float timeRandom = ElapsedMs(timeBeg);
+
+    auto chiSquarePerDof = [&](const std::vector<float>& a_points)
+    {
+      std::vector<uint32_t> counts(triNum, 0);
+      for (uint32_t i = 0; i < pointsNum; i++)
+        counts[std::min(std::max(int(a_points[i * 3 + 2] + 0.5f), 0), triNum - 1)]++;
+
+      double chi2 = 0.0;
+      int    dof  = 0;
+      for (int i = 0; i < triNum; i++)
+      {
+        const double expected = double(pointsNum) * area[i] / totalArea;
+        if (expected < 5.0) // merge too small bins is not needed for the check, just skip them
+          continue;
+        chi2 += (counts[i] - expected) * (counts[i] - expected) / expected;
+        dof++;
+      }
+      return chi2 / double(std::max(dof - 1, 1));
+    };
+
+    const double chi2Random = chiSquarePerDof(points);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    HRUtils::getRandomPointsOnMesh(spread, points2.data(), pointsNum, true, 520, true);
+    const float timeQMC = ElapsedMs(timeBeg);
+
+    const double chi2QMC = chiSquarePerDof(points2);
+
+    // (2) the same seed must give the same points for any threads number
+    //
+  #ifdef _OPENMP
+    const int oldThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    HRUtils::getRandomPointsOnMesh(spread, points2.data(), pointsNum, true, 520);
+    omp_set_num_threads(4);
+  #endif
+    HRUtils::getRandomPointsOnMesh(spread, points.data(), pointsNum, true, 520);
+  #ifdef _OPENMP
+    omp_set_num_threads(oldThreads);
+  #else
+    HRUtils::getRandomPointsOnMesh(spread, points2.data(), pointsNum, true, 520);
+  #endif
+    const bool sameForThreads = (memcmp(points.data(), points2.data(), points.size() * sizeof(float)) == 0);
+
+    hrMeshClose(spread);
+
+    // (3) unit square from 2 triangles; count points in 16x16 cells
+    //
+    const float quadPos[4 * 4] = { 0,0,0,1,  1,0,0,1,  1,1,0,1,  0,1,0,1 };
+    const int   quadInd[6]     = { 0,1,2,  0,2,3 };
+    const int   quadMat[2]     = { 0,0 };
+
+    HRMeshRef quad = hrMeshCreate(L"quad");
+    hrMeshOpen(quad, HR_TRIANGLE_IND3, HR_WRITE_DISCARD);
+    hrMeshVertexAttribPointer4f(quad, L"pos", quadPos);
+    hrMeshPrimitiveAttribPointer1i(quad, L"mind", quadMat);
+    hrMeshAppendTriangles3(quad, 6, quadInd);
+
+    const uint32_t quadPoints = 4096;
+    const int      cells      = 16;
+    auto cellsVariance = [&](bool a_qmc)
+    {
+      std::vector<float> qpoints(quadPoints * 3);
+      HRUtils::getRandomPointsOnMesh(quad, qpoints.data(), quadPoints, true, 520, a_qmc);
+
+      std::vector<int> counts(cells * cells, 0);
+      for (uint32_t i = 0; i < quadPoints; i++)
+      {
+        const int x = std::min(int(qpoints[i * 3 + 0] * cells), cells - 1);
+        const int y = std::min(int(qpoints[i * 3 + 1] * cells), cells - 1);
+        counts[y * cells + x]++;
+      }
+
+      const double mean = double(quadPoints) / double(cells * cells);
+      double var = 0.0;
+      for (auto c : counts)
+        var += (c - mean) * (c - mean);
+      return var / double(cells * cells);
+    };
+
+    const double varRandom = cellsVariance(false);
+    const double varQMC    = cellsVariance(true);
+
+    hrMeshClose(quad);
+
+    std::cout << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "[test_520]: chi2/dof of per triangle counts: random = " << chi2Random << ", qmc = " << chi2QMC << std::endl;
+    std::cout << "[test_520]: same points for 1 and 4 threads  = " << (sameForThreads ? "yes" : "no") << std::endl;
+    std::cout << "[test_520]: 16x16 cells count variance    : random = " << varRandom << ", qmc = " << varQMC << std::endl;
+    std::cout << "[test_520]: " << pointsNum << " points, random   = " << std::setw(8) << timeRandom << " ms" << std::endl;
+    std::cout << "[test_520]: " << pointsNum << " points, qmc      = " << std::setw(8) << timeQMC    << " ms" << std::endl;
+
+    return (chi2Random < 1.5) && (chi2QMC < 1.5) && sameForThreads && (varQMC < 0.5 * varRandom);
+  }
+
+
+  /**
+  \brief red sphere of radius 1 at (0,1,0) on the floor and point light right above it; camera looks from (0,3,6) at (0,1,0).
+         Scene is closed and is rendered with 'cpuRayCast' driver.
+  */
+  struct RayCastScene
+  {
+    RayCastScene(int a_width, int a_height, int a_sphereTess, bool a_evalGBuffer)
+    {
+      matFloor  = hrMaterialCreate(L"floor");
+      matSphere = hrMaterialCreate(L"sphere");
+
+      hrMaterialOpen(matFloor, HR_WRITE_DISCARD);
+      hrMaterialParamNode(matFloor).append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"0.5 0.5 0.5");
+      hrMaterialClose(matFloor);
+
+      hrMaterialOpen(matSphere, HR_WRITE_DISCARD);
+      hrMaterialParamNode(matSphere).append_child(L"diffuse").append_child(L"color").append_attribute(L"val").set_value(L"0.8 0.2 0.2");
+      hrMaterialClose(matSphere);
+
+      floor  = HRMeshFromSimpleMesh(L"floor",  CreatePlane(4.0f),                matFloor.id);
+      sphere = HRMeshFromSimpleMesh(L"sphere", CreateSphere(1.0f, a_sphereTess), matSphere.id);
+
+      light = hrLightCreate(L"point");
+      hrLightOpen(light, HR_WRITE_DISCARD);
+      {
+        auto lightNode = hrLightParamNode(light);
+        lightNode.attribute(L"type").set_value(L"point");
+        lightNode.attribute(L"shape").set_value(L"point");
+        lightNode.attribute(L"distribution").set_value(L"uniform");
+
+        auto intensityNode = lightNode.append_child(L"intensity");
+        intensityNode.append_child(L"color").append_attribute(L"val")      = L"1 1 1";
+        intensityNode.append_child(L"multiplier").append_attribute(L"val") = 40.0f;
+      }
+      hrLightClose(light);
+
+      cam = hrCameraCreate(L"my camera");
+      hrCameraOpen(cam, HR_WRITE_DISCARD);
+      {
+        auto camNode = hrCameraParamNode(cam);
+        camNode.append_child(L"fov").text().set(L"45");
+        camNode.append_child(L"nearClipPlane").text().set(L"0.01");
+        camNode.append_child(L"farClipPlane").text().set(L"100.0");
+        camNode.append_child(L"up").text().set(L"0 1 0");
+        camNode.append_child(L"position").text().set(L"0 3 6");
+        camNode.append_child(L"look_at").text().set(L"0 1 0");
+      }
+      hrCameraClose(cam);
+
+      render = hrRenderCreate(L"cpuRayCast");
+      hrRenderOpen(render, HR_WRITE_DISCARD);
+      {
+        auto node = hrRenderParamNode(render);
+        node.append_child(L"width").text()  = a_width;
+        node.append_child(L"height").text() = a_height;
+        if (a_evalGBuffer)
+          node.append_child(L"evalgbuffer").text() = 1;
+      }
+      hrRenderClose(render);
+
+      scn = hrSceneCreate(L"scene");
+      hrSceneOpen(scn, HR_WRITE_DISCARD);
+      {
+        float4x4 mSphere = translate4x4(float3(0.0f, 1.0f, 0.0f));
+        float4x4 mLight  = translate4x4(float3(0.0f, 5.0f, 0.0f));
+        float4x4 mIdentity;
+        hrMeshInstance(scn, floor,  mIdentity.L());
+        hrMeshInstance(scn, sphere, mSphere.L());
+        hrLightInstance(scn, light, mLight.L());
+      }
+      hrSceneClose(scn);
+    }
+
+    HRMaterialRef  matFloor;
+    HRMaterialRef  matSphere;
+    HRMeshRef      floor;
+    HRMeshRef      sphere;
+    HRLightRef     light;
+    HRCameraRef    cam;
+    HRRenderRef    render;
+    HRSceneInstRef scn;
+  };
+
+  /**
+  \brief render sphere on the floor and 1000 sphere instances with 'cpuRayCast' driver; check depth, shadow and coverage in gbuffer and measure frame time.
+  */
+  bool test_521_cpu_raycast_driver()
+  {
+    hrErrorCallerPlace(L"test_521");
+
+    hrSceneLibraryOpen(L"tests/test_521", HR_WRITE_DISCARD);
+
+    const int width  = 512;
+    const int height = 512;
+
+    const float3 camPos(0.0f, 3.0f, 6.0f);    // camera of RayCastScene
+    const float3 camLookAt(0.0f, 1.0f, 0.0f);
+
+    // (1) sphere of radius 1 at (0,1,0) on the floor, light is right above the sphere
+    //
+    RayCastScene scene(width, height, 128, false);
+
+    const float timeFirst = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    std::vector<HRGBufferPixel> gbuffer(size_t(width)*size_t(height));
+    for (int y = 0; y < height; y++)
+      hrRenderGetGBufferLine(scene.render, y, gbuffer.data() + size_t(y)*size_t(width), 0, width);
+
+    int sphereHits = 0, floorLit = 0, floorShadow = 0, misses = 0;
+    for (const auto& pixel : gbuffer)
+    {
+      if (pixel.matId < 0)
+        misses++;
+      else if (pixel.matId == scene.matSphere.id)
+        sphereHits++;
+      else if (pixel.shadow > 0.5f)
+        floorShadow++;
+      else
+        floorLit++;
+    }
+
+    // ray through the image center hits the sphere at distance |camPos - center| - radius
+    //
+    const HRGBufferPixel& center = gbuffer[size_t(height/2)*size_t(width) + size_t(width/2)];
+    const float expectedDepth    = length(camPos - camLookAt) - 1.0f;
+    const bool  centerOk         = (center.matId == scene.matSphere.id) && fabsf(center.depth - expectedDepth) < 1e-2f && center.norm[2] > 0.9f;
+
+    std::vector<int32_t> image(size_t(width)*size_t(height));
+    hrRenderGetFrameBufferLDR1i(scene.render, width, height, image.data());
+    const int32_t centerColor = image[size_t(height/2)*size_t(width) + size_t(width/2)];
+    const bool    redSphere   = ((centerColor & 0xFF) > ((centerColor >> 8) & 0xFF));
+
+    // (2) frame time for 1000 instances of the same sphere
+    //
+    hrSceneOpen(scene.scn, HR_WRITE_DISCARD);
+    {
+      for (int i = 0; i < 1000; i++)
+      {
+        float4x4 mSphere = mul(translate4x4(float3(float(i % 10) - 4.5f, float((i / 10) % 10), -float(i / 100)*2.5f)), scale4x4(float3(0.4f, 0.4f, 0.4f)));
+        hrMeshInstance(scene.scn, scene.sphere, mSphere.L());
+      }
+      float4x4 mIdentity;
+      float4x4 mLight = translate4x4(float3(0.0f, 12.0f, 5.0f));
+      hrMeshInstance(scene.scn, scene.floor, mIdentity.L());
+      hrLightInstance(scene.scn, scene.light, mLight.L());
+    }
+    hrSceneClose(scene.scn);
+
+    const float timeManyFirst = FlushTimeMs(scene.scn, scene.render, scene.cam);
+
+    const int frames = 5;
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < frames; i++)
+      hrFlush(scene.scn, scene.render, scene.cam);
+    const float timeFrame = ElapsedMs(timeBeg) / float(frames);
+
+    std::cout << "[test_521]: sphere/floor lit/floor shadow/miss pixels = " << sphereHits << "/" << floorLit << "/" << floorShadow << "/" << misses << std::endl;
+    std::cout << "[test_521]: center depth = " << center.depth << ", expected " << expectedDepth << std::endl;
+    std::cout << "[test_521]: first frame, 2 instances        = " << std::setw(8) << timeFirst     << " ms" << std::endl;
+    std::cout << "[test_521]: first frame, 1001 instances     = " << std::setw(8) << timeManyFirst << " ms" << std::endl;
+    std::cout << "[test_521]: next frames, 1001 instances     = " << std::setw(8) << timeFrame     << " ms" << std::endl;
+
+    return centerOk && redSphere && sphereHits > 0 && floorLit > 0 && floorShadow > 0 && misses > 0;
+  }
+
+
+  /**
+  \brief check HRUtils::scenePickRay, sceneFrustumCull and sceneBoxOverlap against brute force and measure build, refit and query time for 1M instances.
+  */
+  bool test_522_scene_spatial_queries()
+  {
+    hrErrorCallerPlace(L"test_522");
+
+    hrSceneLibraryOpen(L"tests/test_522", HR_WRITE_DISCARD);
+
+    const SimpleMesh sphereData = CreateSphere(0.5f, 32);
+    HRMeshRef sphere = HRMeshFromSimpleMesh(L"sphere", sphereData, 0);
+
+    const int triNum = int(sphereData.triIndices.size() / 3);
+
+    std::mt19937 gen(522);
+    std::uniform_real_distribution<float> rnd(0.0f, 1.0f);
+
+    auto randomMatrices = [&](int a_instNum, float a_size)
+    {
+      std::vector<float4x4> matrices(a_instNum);
+      for (int i = 0; i < a_instNum; i++)
+      {
+        const float3 pos(a_size*(rnd(gen) - 0.5f), a_size*(rnd(gen) - 0.5f), a_size*(rnd(gen) - 0.5f));
+        const float  scale = 0.5f + rnd(gen);
+        matrices[i] = mul(mul(translate4x4(pos), rotate_Y_4x4(6.28f*rnd(gen))), scale4x4(float3(scale, 0.5f*scale, scale)));
+      }
+      return matrices;
+    };
+
+    auto fillScene = [&](HRSceneInstRef a_scn, std::vector<float4x4>& a_matrices)
+    {
+      hrSceneOpen(a_scn, HR_WRITE_DISCARD);
+      for (auto& m : a_matrices)
+        hrMeshInstance(a_scn, sphere, m.L());
+      hrSceneClose(a_scn);
+    };
+
+    // brute force closest hit over all triangles of all instances in world space
+    //
+    auto pickBruteForce = [&](const std::vector<float4x4>& a_matrices, float3 a_pos, float3 a_dir, float* a_pT)
+    {
+      int   bestInst = -1;
+      float bestT    = 1e30f;
+      for (size_t i = 0; i < a_matrices.size(); i++)
+      {
+        for (int tri = 0; tri < triNum; tri++)
+        {
+          float3 v[3];
+          for (int k = 0; k < 3; k++)
+            v[k] = mul(a_matrices[i], float3(&sphereData.vPos[sphereData.triIndices[tri * 3 + k] * 4]));
+
+          const float3 e1 = v[1] - v[0], e2 = v[2] - v[0];
+          const float3 p  = cross(a_dir, e2);
+          const float  det = dot(e1, p);
+          if (fabsf(det) < 1e-12f)
+            continue;
+          const float3 sv = a_pos - v[0];
+          const float  u  = dot(sv, p) / det;
+          const float3 q  = cross(sv, e1);
+          const float  vv = dot(a_dir, q) / det;
+          const float  t  = dot(e2, q) / det;
+          if (u >= 0.0f && vv >= 0.0f && u + vv <= 1.0f && t > 0.0f && t < bestT)
+          {
+            bestT    = t;
+            bestInst = int(i);
+          }
+        }
+      }
+      *a_pT = bestT;
+      return bestInst;
+    };
+
+    // (1) correctness on 500 instances, before and after refit
+    //
+    HRSceneInstRef scnSmall = hrSceneCreate(L"small");
+    std::vector<float4x4> matrices = randomMatrices(500, 20.0f);
+    fillScene(scnSmall, matrices);
+
+    int pickErrors = 0, pickHits = 0;
+    auto checkPicking = [&](const std::vector<float4x4>& a_matrices)
+    {
+      for (int i = 0; i < 200; i++)
+      {
+        const float3 pos(30.0f*(rnd(gen) - 0.5f), 30.0f*(rnd(gen) - 0.5f), 30.0f);
+        const float3 target(10.0f*(rnd(gen) - 0.5f), 10.0f*(rnd(gen) - 0.5f), 0.0f);
+        const float3 dir = target - pos; // not normalized on purpose
+
+        float tRef = 0.0f;
+        const int instRef = pickBruteForce(a_matrices, pos, dir, &tRef);
+
+        HRUtils::PickResult res;
+        const bool hit = HRUtils::scenePickRay(scnSmall, &pos.x, &dir.x, &res);
+
+        if (hit != (instRef >= 0) || (hit && fabsf(res.t - tRef) > 1e-4f*tRef))
+          pickErrors++;
+        pickHits += hit ? 1 : 0;
+      }
+    };
+
+    checkPicking(matrices);
+
+    matrices = randomMatrices(500, 20.0f); // same meshes, other matrices: refit
+    fillScene(scnSmall, matrices);
+    checkPicking(matrices);
+
+    // frustum and box queries: no false negatives for instances whose center is inside and no instance far outside
+    //
+    const float4x4 view     = transpose(lookAtTransposed(float3(0.0f, 0.0f, 25.0f), float3(0.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f)));
+    const float4x4 proj     = transpose(projectionMatrixTransposed(40.0f, 1.0f, 0.1f, 100.0f));
+    float4x4       viewProj = mul(proj, view);
+
+    std::vector<int32_t> visible;
+    HRUtils::sceneFrustumCull(scnSmall, viewProj.L(), visible);
+    std::vector<char> isVisible(matrices.size(), 0);
+    for (int32_t id : visible)
+      isVisible[id] = 1;
+
+    int cullErrors = 0;
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+      const float4 clip = mul(viewProj, float4(matrices[i].row[0].w, matrices[i].row[1].w, matrices[i].row[2].w, 1.0f));
+      const bool centerInside = fabsf(clip.x) < clip.w && fabsf(clip.y) < clip.w && fabsf(clip.z) < clip.w;
+      const bool farOutside   = fabsf(clip.x) > 2.0f*clip.w + 2.0f || fabsf(clip.y) > 2.0f*clip.w + 2.0f;
+      if ((centerInside && !isVisible[i]) || (farOutside && isVisible[i]))
+        cullErrors++;
+    }
+
+    HRUtils::BBox queryBox;
+    queryBox.x_min = -3.0f; queryBox.y_min = -3.0f; queryBox.z_min = -3.0f;
+    queryBox.x_max =  3.0f; queryBox.y_max =  3.0f; queryBox.z_max =  3.0f;
+
+    std::vector<int32_t> overlapped;
+    HRUtils::sceneBoxOverlap(scnSmall, queryBox, overlapped);
+    std::vector<char> isOverlapped(matrices.size(), 0);
+    for (int32_t id : overlapped)
+      isOverlapped[id] = 1;
+
+    int boxErrors = 0;
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+      const float3 c(matrices[i].row[0].w, matrices[i].row[1].w, matrices[i].row[2].w);
+      const float  dist = std::max(fabsf(c.x), std::max(fabsf(c.y), fabsf(c.z)));
+      if ((dist < 3.0f && !isOverlapped[i]) || (dist > 3.0f + 1.5f && isOverlapped[i])) // instance radius is at most 0.75
+        boxErrors++;
+    }
+
+    // (2) timing on 1M instances
+    //
+    const int bigNum = 1000000;
+    HRSceneInstRef scnBig = hrSceneCreate(L"big");
+    std::vector<float4x4> bigMatrices = randomMatrices(bigNum, 1000.0f);
+    fillScene(scnBig, bigMatrices);
+
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    HRUtils::sceneUpdateSpatialIndex(scnBig);
+    const float timeBuild = ElapsedMs(timeBeg);
+
+    for (auto& m : bigMatrices)
+      m = mul(translate4x4(float3(0.5f, 0.0f, 0.0f)), m);
+    fillScene(scnBig, bigMatrices);
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    HRUtils::sceneUpdateSpatialIndex(scnBig);
+    const float timeRefit = ElapsedMs(timeBeg);
+
+    const int rays = 10000;
+    int bigHits = 0;
+    timeBeg = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rays; i++)
+    {
+      const float3 pos(0.0f, 0.0f, 0.0f);
+      const float3 dir(rnd(gen) - 0.5f, rnd(gen) - 0.5f, rnd(gen) - 0.5f);
+      bigHits += HRUtils::scenePickRay(scnBig, &pos.x, &dir.x, nullptr) ? 1 : 0;
+    }
+    const float timePick = 1000.0f*ElapsedMs(timeBeg) / float(rays);
+
+    const float4x4 bigView = transpose(lookAtTransposed(float3(0.0f, 0.0f, 600.0f), float3(0.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f)));
+    float4x4       bigViewProj = mul(transpose(projectionMatrixTransposed(30.0f, 1.0f, 0.1f, 2000.0f)), bigView);
+    timeBeg = std::chrono::high_resolution_clock::now();
+    HRUtils::sceneFrustumCull(scnBig, bigViewProj.L(), visible);
+    const float timeCull = ElapsedMs(timeBeg);
+
+    std::cout << "[test_522]: pick errors = " << pickErrors << " of 400 rays (" << pickHits << " hits), cull errors = " << cullErrors << ", box errors = " << boxErrors << std::endl;
+    std::cout << "[test_522]: 1M instances, build         = " << std::setw(8) << timeBuild << " ms" << std::endl;
+    std::cout << "[test_522]: 1M instances, refit         = " << std::setw(8) << timeRefit << " ms" << std::endl;
+    std::cout << "[test_522]: 1M instances, pick ray      = " << std::setw(8) << timePick  << " us (" << bigHits << " hits of " << rays << ")" << std::endl;
+    std::cout << "[test_522]: 1M instances, frustum cull  = " << std::setw(8) << timeCull  << " ms (" << visible.size() << " visible)" << std::endl;
+
+    return pickErrors == 0 && pickHits > 0 && cullErrors == 0 && boxErrors == 0 && !overlapped.empty() && timeRefit < timeBuild;
+  }
+
+
+  /**
+  \brief bulk gbuffer readback to SoA planes must match line readback; measure it against line by line readback.
+  */
+  bool test_523_gbuffer_planes()
+  {
+    hrErrorCallerPlace(L"test_523");
+
+    hrSceneLibraryOpen(L"tests/test_523", HR_WRITE_DISCARD);
+
+    const int width  = 1024;
+    const int height = 1024;
+
+    RayCastScene scene(width, height, 64, true);
+
+    hrFlush(scene.scn, scene.render, scene.cam);
+
+    const size_t size = size_t(width)*size_t(height);
+
+    // (1) line by line readback, as it was done before
+    //
+    std::vector<HRGBufferPixel> gbuffer(size);
+    auto timeBeg = std::chrono::high_resolution_clock::now();
+    for (int y = 0; y < height; y++)
+      hrRenderGetGBufferLine(scene.render, y, gbuffer.data() + size_t(y)*size_t(width), 0, width);
+    const float timeLines = ElapsedMs(timeBeg);
+
+    // (2) all layers to planes
+    //
+    std::vector<float>   floats[14];
+    std::vector<int32_t> ints[3];
+    for (auto& plane : floats) plane.resize(size);
+    for (auto& plane : ints)   plane.resize(size);
+
+    HRGBufferPlanes planes;
+    planes.depth    = floats[0].data();
+    planes.shadow   = floats[1].data();
+    planes.coverage = floats[2].data();
+    for (int k = 0; k < 3; k++) planes.norm[k] = floats[3 + k].data();
+    for (int k = 0; k < 2; k++) planes.texc[k] = floats[6 + k].data();
+    for (int k = 0; k < 4; k++) planes.rgba[k] = floats[8 + k].data();
+    planes.matId  = ints[0].data();
+    planes.objId  = ints[1].data();
+    planes.instId = ints[2].data();
+
+    hrRenderGetGBuffer(scene.render, &planes); // warm up, the first call also starts OpenMP threads
+    timeBeg = std::chrono::high_resolution_clock::now();
+    const bool gotAll = hrRenderGetGBuffer(scene.render, &planes);
+    const float timeAll = ElapsedMs(timeBeg);
+
+    int errors = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+      const HRGBufferPixel& pixel = gbuffer[i];
+      bool same = pixel.depth == planes.depth[i] && pixel.shadow == planes.shadow[i] && pixel.coverage == planes.coverage[i] &&
+                  pixel.matId == planes.matId[i] && pixel.objId  == planes.objId[i]  && pixel.instId   == planes.instId[i];
+      for (int k = 0; k < 3; k++) same = same && pixel.norm[k] == planes.norm[k][i];
+      for (int k = 0; k < 2; k++) same = same && pixel.texc[k] == planes.texc[k][i];
+      for (int k = 0; k < 4; k++) same = same && pixel.rgba[k] == planes.rgba[k][i];
+      if (!same)
+        errors++;
+    }
+
+    // (3) only depth and instance id, typical for picking and post process
+    //
+    HRGBufferPlanes depthAndId;
+    std::vector<float>   depth(size, -1.0f);
+    std::vector<int32_t> instId(size, -2);
+    depthAndId.depth  = depth.data();
+    depthAndId.instId = instId.data();
+
+    timeBeg = std::chrono::high_resolution_clock::now();
+    const bool gotDepth = hrRenderGetGBuffer(scene.render, &depthAndId);
+    const float timeDepth = ElapsedMs(timeBeg);
+
+    for (size_t i = 0; i < size; i++)
+    {
+      if (depth[i] != gbuffer[i].depth || instId[i] != gbuffer[i].instId)
+        errors++;
+    }
+
+    std::cout << "[test_523]: plane errors = " << errors << std::endl;
+    std::cout << "[test_523]: 1024x1024, line by line     = " << std::setw(8) << timeLines << " ms" << std::endl;
+    std::cout << "[test_523]: 1024x1024, all planes       = " << std::setw(8) << timeAll   << " ms" << std::endl;
+    std::cout << "[test_523]: 1024x1024, depth and instId = " << std::setw(8) << timeDepth << " ms" << std::endl;
+
+    return gotAll && gotDepth && errors == 0;
+  }
+
+  /**
+  \brief frustum culling and draw sorting of OpenGL drivers (HydraDrawList) without GPU: culling against clip space test of instance centers,
+         draw grouping and material remap against brute force, then build time for 200K instances.
+  */
+  bool test_524_draw_list_cull_sort()
+  {
+    using HydraDrawList::DrawListBuilder;
+
+    std::mt19937 gen(524);
+    std::uniform_real_distribution<float> rnd(0.0f, 1.0f);
+
+    const int meshNum = 100;
+    const int matNum  = 50;
+
+    // 3 batches per mesh; 50 materials share 10 texture sets
+    //
+    DrawListBuilder builder;
+    std::vector< std::vector<DrawListBuilder::Batch> > meshBatches(meshNum);
+    for (int meshId = 0; meshId < meshNum; meshId++)
+    {
+      const float boxMin[3] = { -0.5f, -0.25f, -0.5f };
+      const float boxMax[3] = {  0.5f,  0.25f,  0.5f };
+      for (int b = 0; b < 3; b++)
+        meshBatches[meshId].push_back({ (meshId * 3 + b) % matNum, b * 100, b * 100 + 100 });
+      builder.SetMeshBox(meshId, boxMin, boxMax);
+      builder.SetMeshBatches(meshId, meshBatches[meshId].data(), 3);
+    }
+
+    std::vector<int32_t> texSetOf(matNum);
+    for (int matId = 0; matId < matNum; matId++)
+    {
+      texSetOf[matId]          = (matId * 7) % 10;
+      const int32_t texIds[3]  = { texSetOf[matId], texSetOf[matId] + 10, -1 };
+      builder.SetMaterialTextures(matId, texIds, 3);
+    }
+
+    std::vector< std::unordered_map<uint32_t, uint32_t> > remapLists(1);
+    remapLists[0][0] = 1;
+    remapLists[0][5] = 7;
+    builder.SetRemapLists(&remapLists);
+
+    const float4x4 view     = transpose(lookAtTransposed(float3(0.0f, 0.0f, 25.0f), float3(0.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f)));
+    const float4x4 proj     = transpose(projectionMatrixTransposed(40.0f, 1.0f, 0.1f, 100.0f));
+    const float4x4 viewProj = mul(proj, view);
+
+    auto randomMatrices = [&](int a_instNum, float a_size)
+    {
+      std::vector<float4x4> matrices(a_instNum);
+      for (int i = 0; i < a_instNum; i++)
+      {
+        const float3 pos(a_size*(rnd(gen) - 0.5f), a_size*(rnd(gen) - 0.5f), a_size*(rnd(gen) - 0.5f));
+        matrices[i] = mul(translate4x4(pos), rotate_Y_4x4(6.28f*rnd(gen)));
+      }
+      return matrices;
+    };
+
+    // (1) correctness: 10 instances of each mesh, every second one with remap list
+    //
+    std::vector<float4x4> matrices = randomMatrices(meshNum * 10, 60.0f);
+    std::vector<int>      remapIds(matrices.size());
+    for (size_t i = 0; i < remapIds.size(); i++)
+      remapIds[i] = (i % 2 == 0) ? 0 : -1;
+
+    builder.BeginFrame(viewProj.L(), true);
+    for (int meshId = 0; meshId < meshNum; meshId++)
+      builder.AddInstances(meshId, matrices[meshId * 10].L(), 10, &remapIds[meshId * 10]);
+
+    HydraDrawList::DrawList drawList;
+    builder.Build(&drawList);
+
+    int cullErrors = 0;
+    int drawErrors = 0;
+
+    // brute force: instances whose center is inside must be drawn and instances far outside must not;
+    // every drawn (instance, batch) pair must be unique and have remapped material
+    //
+    std::set< std::pair<int, int> > drawnPairs; // (instance, batch)
+    std::vector<char> isDrawn(matrices.size(), 0);
+    for (const auto& draw : drawList.draws)
+    {
+      const auto& batch = meshBatches[draw.meshId][draw.batchId];
+      if (draw.triBegin != batch.triBegin || draw.triEnd != batch.triEnd)
+        drawErrors++;
+
+      for (uint32_t k = 0; k < draw.instanceNum; k++)
+      {
+        const float* m = &drawList.matrices[(draw.firstInstance + k) * 16];
+        int instId = -1;
+        for (int i = draw.meshId * 10; i < draw.meshId * 10 + 10; i++)
+        {
+          if (m[12] == matrices[i].row[0].w && m[13] == matrices[i].row[1].w && m[14] == matrices[i].row[2].w)
+            instId = i;
+        }
+
+        if (instId < 0 || !drawnPairs.insert(std::make_pair(instId, draw.batchId)).second)
+        {
+          drawErrors++;
+          continue;
+        }
+
+        isDrawn[instId] = 1;
+        const int matId = (remapIds[instId] == 0 && remapLists[0].find(batch.matId) != remapLists[0].end()) ? int(remapLists[0][batch.matId]) : batch.matId;
+        if (matId != draw.matId)
+          drawErrors++;
+      }
+    }
+
+    int visibleNum = 0;
+    for (size_t i = 0; i < matrices.size(); i++)
+    {
+      const float4 clip = mul(viewProj, float4(matrices[i].row[0].w, matrices[i].row[1].w, matrices[i].row[2].w, 1.0f));
+      const bool centerInside = fabsf(clip.x) < clip.w && fabsf(clip.y) < clip.w && fabsf(clip.z) < clip.w;
+      const bool farOutside   = clip.w < -2.0f || fabsf(clip.x) > 2.0f*clip.w + 2.0f || fabsf(clip.y) > 2.0f*clip.w + 2.0f;
+      if ((centerInside && !isDrawn[i]) || (farOutside && isDrawn[i]))
+        cullErrors++;
+      visibleNum += isDrawn[i];
+    }
+
+    if (drawnPairs.size() != size_t(visibleNum) * 3 || drawList.instancesTotal != matrices.size() || drawList.instancesCulled != matrices.size() - visibleNum)
+      drawErrors++;
+
+    // draws must be grouped: each texture set is bound once and each (mesh, batch, material) is drawn by one command
+    //
+    int textureChanges = 0;
+    std::set< std::tuple<int, int, int> > drawKeys;
+    for (size_t i = 0; i < drawList.draws.size(); i++)
+    {
+      const auto& draw = drawList.draws[i];
+      if (i == 0 || texSetOf[draw.matId] != texSetOf[drawList.draws[i - 1].matId])
+        textureChanges++;
+      if (!drawKeys.insert(std::make_tuple(draw.meshId, draw.batchId, draw.matId)).second)
+        drawErrors++;
+    }
+
+    std::set<int> texSetsUsed;
+    for (const auto& draw : drawList.draws)
+      texSetsUsed.insert(texSetOf[draw.matId]);
+    if (textureChanges != int(texSetsUsed.size()))
+      drawErrors++;
+
+    const size_t smallNum = matrices.size();
+
+    // (2) performance: 200K instances, 2000 per mesh
+    //
+    const int instPerMesh = 2000;
+    matrices = randomMatrices(meshNum * instPerMesh, 200.0f);
+
+    const int runs = 5;
+    float timeCull = 0.0f, timeBuild = 0.0f;
+    for (int run = 0; run < runs; run++)
+    {
+      auto timeBeg = std::chrono::high_resolution_clock::now();
+      builder.BeginFrame(viewProj.L(), true);
+      for (int meshId = 0; meshId < meshNum; meshId++)
+        builder.AddInstances(meshId, matrices[meshId * instPerMesh].L(), instPerMesh, nullptr);
+      timeCull += ElapsedMs(timeBeg);
+
+      timeBeg = std::chrono::high_resolution_clock::now();
+      builder.Build(&drawList);
+      timeBuild += ElapsedMs(timeBeg);
+    }
+
+    std::cout << "[test_524]: cull errors = " << cullErrors << ", draw errors = " << drawErrors << " (" << visibleNum << " of " << smallNum << " visible, " << textureChanges << " texture changes)" << std::endl;
+    std::cout << "[test_524]: 200K instances, cull           = " << std::setw(8) << timeCull  / float(runs) << " ms (" << drawList.instancesTotal - drawList.instancesCulled << " visible)" << std::endl;
+    std::cout << "[test_524]: 200K instances, sort and group = " << std::setw(8) << timeBuild / float(runs) << " ms (" << drawList.draws.size() << " draws)" << std::endl;
+
+    return (cullErrors == 0) && (drawErrors == 0);
+  }
+
+  /**
+  \brief load test plugins built from main/plugins/filter_plugin_test.cpp; only the valid one must be loaded and its filter is called by hrFilterApply.
+  */
+  bool test_525_filter_plugins()
+  {
+    hrErrorCallerPlace(L"test_525");
+
+    hrSceneLibraryOpen(L"tests/test_525", HR_WRITE_DISCARD);
+
+    const int loadedMissing = hrFilterLoadPlugins(L"tests/test_525/no_such_folder");
+    const int loaded        = hrFilterLoadPlugins(L"../bin/filter_plugins_test"); // valid plugin, unsupported ABI version and no entry points
+    const int loadedAgain   = hrFilterLoadPlugins(L"../bin/filter_plugins_test"); // already loaded plugin is skipped
+
+    const int w = 64, h = 32;
+    std::vector<float> pixels(w*h*4);
+    for (size_t i = 0; i < pixels.size(); i++)
+      pixels[i] = float(i % 17) / 16.0f;
+
+    HRFBIRef imageIn  = hrFBICreate(L"in",  w, h, 16, pixels.data());
+    HRFBIRef imageOut = hrFBICreate(L"out", w, h, 16);
+
+    hrFilterApply(L"test_plugin_invert", pugi::xml_node(), HRRenderRef(),
+                  L"in_color",  imageIn,
+                  L"out_color", imageOut);
+
+    int outW = 0, outH = 0, outBpp = 0;
+    const float* outData = (const float*)hrFBIGetData(imageOut, &outW, &outH, &outBpp);
+
+    bool sameData = (outData != nullptr) && (outW == w) && (outH == h) && (outBpp == 16);
+    for (size_t i = 0; sameData && i < pixels.size(); i++)
+      sameData = (outData[i] == 1.0f - pixels[i]);
+
+    std::cout << "[test_525]: plugins loaded = " << loaded << ", again = " << loadedAgain << ", from missing folder = " << loadedMissing << std::endl;
+    std::cout << "[test_525]: filter output ok = " << sameData << std::endl;
+
+    return (loadedMissing == 0) && (loaded == 1) && (loadedAgain == 0) && sameData;
+  }
+};